@@ -23,6 +23,8 @@ struct Mesh
 {
 	std::vector<Vertex_t> Vertices;
 	std::vector<uint16_t> Indices16;
+	// Used instead of Indices16 when not empty (meshes with more than 0x10000 vertices)
+	std::vector<uint32_t> Indices32;
 
 	std::unordered_map<std::string, SubMesh> DrawArgs;
 
@@ -45,9 +47,9 @@ inline bool Mesh<Vertex_t>::CreateBuffers(ID3D12Device* pDevice, ID3D12GraphicsC
 	VertexBuffer.SetUpSubresource(Vertices.data(), sizeOfVertices);
 	VertexBuffer.UpdateSubresource(pDevice, pCmdList);
 
-	size_t sizeOfIndices = sizeof(uint16_t) * Indices16.size();
+	size_t sizeOfIndices = Indices32.empty() ? sizeof(uint16_t) * Indices16.size() : sizeof(uint32_t) * Indices32.size();
 	IndexBuffer.CreateBuffer(pDevice, sizeOfIndices);
-	IndexBuffer.SetUpSubresource(Indices16.data(), sizeOfIndices);
+	IndexBuffer.SetUpSubresource(Indices32.empty() ? (const void*)Indices16.data() : Indices32.data(), sizeOfIndices);
 	IndexBuffer.UpdateSubresource(pDevice, pCmdList);
 
 	return true;
@@ -61,9 +63,9 @@ inline bool Mesh<Vertex_t>::CreateViews()
 	VertexBufferView.SizeInBytes = sizeOfVertices;
 	VertexBufferView.StrideInBytes = sizeof(Vertex_t);
 
-	uint32_t sizeOfIndices = sizeof(uint16_t) * Indices16.size();
+	uint32_t sizeOfIndices = Indices32.empty() ? sizeof(uint16_t) * Indices16.size() : sizeof(uint32_t) * Indices32.size();
 	IndexBufferView.BufferLocation = IndexBuffer.GetGPUVirtualAddress();
-	IndexBufferView.Format = DXGI_FORMAT_R16_UINT;
+	IndexBufferView.Format = Indices32.empty() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	IndexBufferView.SizeInBytes = sizeOfIndices;
 
 	return true;
@@ -76,5 +78,6 @@ inline bool Mesh<Vertex_t>::ClearSubresource()
 	IndexBuffer.ClearSubresource();
 	Vertices.clear();
 	Indices16.clear();
+	Indices32.clear();
 	return true;
 }
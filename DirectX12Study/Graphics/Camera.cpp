@@ -45,6 +45,13 @@ DirectX::XMFLOAT4X4 Camera::GetCameraSpaceMatrix() const
 	return cameraSpace;
 }
 
+DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix() const
+{
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&proj, m_proj);
+	return proj;
+}
+
 DirectX::XMFLOAT4X4 Camera::GetViewProjectionMatrix() const
 {
 	XMFLOAT4X4 viewProj;
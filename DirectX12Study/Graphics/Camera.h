@@ -30,6 +30,7 @@ public:
 	void Init();
 public:
 	DirectX::XMFLOAT4X4 GetCameraSpaceMatrix() const;
+	DirectX::XMFLOAT4X4 GetProjectionMatrix() const;
 	DirectX::XMFLOAT4X4 GetViewProjectionMatrix() const;
 	DirectX::XMFLOAT3 GetCameraPosition() const;
 	DirectX::XMFLOAT3 GetTargetPosition() const;
@@ -45,6 +45,37 @@ namespace
 
     float g_scalar = 0.1;
     constexpr float scale_speed = 1;
+
+    // Affine3x4 makes bone palette 25% smaller, DualQuaternion 50% smaller
+    // PMD pipelines are built for every layout, the one PMDManager uses is picked when drawing
+    constexpr PMDBonePaletteLayout pmd_bone_palette_layout = PMDBonePaletteLayout::Matrix4x4;
+    const PMDBonePaletteLayout pmd_bone_palette_layouts[] = {
+        PMDBonePaletteLayout::Matrix4x4, PMDBonePaletteLayout::Affine3x4, PMDBonePaletteLayout::DualQuaternion };
+
+    // PMDManager switches to FourBones when it loads a PMX model with vertices on more than 2 bones
+    const PMDVertexLayout pmd_vertex_layouts[] = { PMDVertexLayout::TwoBones, PMDVertexLayout::FourBones };
+
+    // "pmd" -> "pmd", "pmd3x4", "pmdDQ", "pmd4Bones", "pmd4Bones3x4", "pmd4BonesDQ"
+    std::string GetPMDPipelineName(const char* name, PMDVertexLayout vertexLayout, PMDBonePaletteLayout layout)
+    {
+        std::string pipelineName = name;
+        if (vertexLayout == PMDVertexLayout::FourBones)
+            pipelineName += "4Bones";
+        switch (layout)
+        {
+        case PMDBonePaletteLayout::Affine3x4:
+            return pipelineName + "3x4";
+        case PMDBonePaletteLayout::DualQuaternion:
+            return pipelineName + "DQ";
+        default:
+            return pipelineName;
+        }
+    }
+
+    const char* GetPMDInputLayoutName(PMDVertexLayout vertexLayout)
+    {
+        return vertexLayout == PMDVertexLayout::FourBones ? "pmd4Bones" : "pmd";
+    }
 }
 
 void D3D12App::CreateDefaultTexture()
@@ -306,7 +337,8 @@ void D3D12App::RenderToRenderTargetTextures()
     m_cmdList->ClearRenderTargetView(rtBrightTexHeap, rtTexDefaultColor, 0, nullptr);
     m_cmdList->ClearRenderTargetView(rtFocusTexHeap, rtTexDefaultColor, 0, nullptr);
 
-    m_cmdList->SetPipelineState(m_psoMng->GetPSO("pmd"));
+    m_cmdList->SetPipelineState(m_psoMng->GetPSO(GetPMDPipelineName("pmd",
+        m_pmdManager->GetVertexLayout(), m_pmdManager->GetBonePaletteLayout())));
     m_cmdList->SetGraphicsRootSignature(m_psoMng->GetRootSignature("pmd"));
     m_pmdManager->SetWorldPassConstantGpuAddress(m_worldPCBuffer.GetGPUVirtualAddress(m_currentFrameResourceIndex));
     m_pmdManager->Render(m_cmdList.Get());
@@ -815,7 +847,8 @@ void D3D12App::RenderToShadowDepthBuffer()
     m_primitiveManager->SetWorldPassConstantGpuAddress(m_worldPCBuffer.GetGPUVirtualAddress(m_currentFrameResourceIndex));
     m_primitiveManager->RenderDepth(m_cmdList.Get());
 
-    m_cmdList->SetPipelineState(m_psoMng->GetPSO("shadow"));
+    m_cmdList->SetPipelineState(m_psoMng->GetPSO(GetPMDPipelineName("shadow",
+        m_pmdManager->GetVertexLayout(), m_pmdManager->GetBonePaletteLayout())));
     m_pmdManager->SetWorldPassConstantGpuAddress(m_worldPCBuffer.GetGPUVirtualAddress(m_currentFrameResourceIndex));
     m_pmdManager->RenderDepth(m_cmdList.Get());
 
@@ -938,6 +971,32 @@ void D3D12App::CreateInputLayouts()
     };
     m_psoMng->CreateInputLayout("pmd", _countof(pmdLayout), pmdLayout);
 
+    // Same first stream, bones and weights come from PMDSkinWeights in slot 1
+    D3D12_INPUT_ELEMENT_DESC pmd4BonesLayout[] = {
+    pmdLayout[0],
+    pmdLayout[1],
+    pmdLayout[2],
+    {
+    "BONENO",
+    0,
+    DXGI_FORMAT_R16G16B16A16_UINT,
+    1,
+    0,
+    D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+    0
+    },
+    {
+    "WEIGHT",
+    0,
+    DXGI_FORMAT_R16G16B16A16_UNORM,               // 0~65535 -> 0.0~1.0
+    1,
+    D3D12_APPEND_ALIGNED_ELEMENT,
+    D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,
+    0
+    }
+    };
+    m_psoMng->CreateInputLayout("pmd4Bones", _countof(pmd4BonesLayout), pmd4BonesLayout);
+
     D3D12_INPUT_ELEMENT_DESC primitiveLayout[] = {
     {
     "POSITION",                                   //semantic
@@ -1108,18 +1167,32 @@ void D3D12App::CreatePSOs()
     // Shadow
     //
     pso.Reset();
-    pso.SetInputLayout(m_psoMng->GetInputLayout("pmd"));
     pso.SetPrimitiveTopology();
     pso.SetSampleMask();
     pso.SetDepthStencilFormat();
     pso.SetDepthStencilState(depthStencilDesc);
     pso.SetRasterizerState(rasterizerDesc);
     D3D_SHADER_MACRO defines[] = { "SHADOW_PIPELINE", "1", nullptr, nullptr };
-    vsBlob = D12Helper::CompileShaderFromFile(L"Shader/vs.hlsl", "VS", "vs_5_1", defines);
-    pso.SetVertexShader(CD3DX12_SHADER_BYTECODE(vsBlob.Get()));
     pso.SetRootSignature(m_psoMng->GetRootSignature("shadow"));
-    pso.Create(m_device.Get());
-    m_psoMng->CreatePSO("shadow", pso.Get());
+    for (auto vertexLayout : pmd_vertex_layouts)
+    {
+        pso.SetInputLayout(m_psoMng->GetInputLayout(GetPMDInputLayoutName(vertexLayout)));
+        for (auto layout : pmd_bone_palette_layouts)
+        {
+            const D3D_SHADER_MACRO pmdShadowDefines[] =
+            {
+                "SHADOW_PIPELINE", "1",
+                "SKIN_4_BONES", vertexLayout == PMDVertexLayout::FourBones ? "1" : "0",
+                "BONE_PALETTE_3X4", layout == PMDBonePaletteLayout::Affine3x4 ? "1" : "0",
+                "BONE_PALETTE_DQ", layout == PMDBonePaletteLayout::DualQuaternion ? "1" : "0",
+                nullptr, nullptr
+            };
+            vsBlob = D12Helper::CompileShaderFromFile(L"Shader/vs.hlsl", "VS", "vs_5_1", pmdShadowDefines);
+            pso.SetVertexShader(CD3DX12_SHADER_BYTECODE(vsBlob.Get()));
+            pso.Create(m_device.Get());
+            m_psoMng->CreatePSO(GetPMDPipelineName("shadow", vertexLayout, layout), pso.Get());
+        }
+    }
 
     //
     // Primitive Shadow
@@ -1146,15 +1219,12 @@ void D3D12App::CreatePSOs()
     // PMD
     //
     pso.Reset();
-    pso.SetInputLayout(m_psoMng->GetInputLayout("pmd"));
     pso.SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
     pso.SetSampleMask();
     pso.SetRenderTargetFormats(4);
     pso.SetRasterizerState(rasterizerDesc);
     pso.SetDepthStencilState(depthStencilDesc);
     pso.SetBlendState(blendDesc);
-    vsBlob = D12Helper::CompileShaderFromFile(L"Shader/vs.hlsl", "VS", "vs_5_1");
-    pso.SetVertexShader(CD3DX12_SHADER_BYTECODE(vsBlob.Get()));
     const D3D_SHADER_MACRO pmdDefines[] =
     {
         "FOG" , "1",
@@ -1163,8 +1233,24 @@ void D3D12App::CreatePSOs()
     psBlob = D12Helper::CompileShaderFromFile(L"Shader/ps.hlsl", "PS", "ps_5_1", pmdDefines);
     pso.SetPixelShader(CD3DX12_SHADER_BYTECODE(psBlob.Get()));
     pso.SetRootSignature(m_psoMng->GetRootSignature("pmd"));
-    pso.Create(m_device.Get());
-    m_psoMng->CreatePSO("pmd", pso.Get());
+    for (auto vertexLayout : pmd_vertex_layouts)
+    {
+        pso.SetInputLayout(m_psoMng->GetInputLayout(GetPMDInputLayoutName(vertexLayout)));
+        for (auto layout : pmd_bone_palette_layouts)
+        {
+            const D3D_SHADER_MACRO pmdVSDefines[] =
+            {
+                "SKIN_4_BONES", vertexLayout == PMDVertexLayout::FourBones ? "1" : "0",
+                "BONE_PALETTE_3X4", layout == PMDBonePaletteLayout::Affine3x4 ? "1" : "0",
+                "BONE_PALETTE_DQ", layout == PMDBonePaletteLayout::DualQuaternion ? "1" : "0",
+                nullptr, nullptr
+            };
+            vsBlob = D12Helper::CompileShaderFromFile(L"Shader/vs.hlsl", "VS", "vs_5_1", pmdVSDefines);
+            pso.SetVertexShader(CD3DX12_SHADER_BYTECODE(vsBlob.Get()));
+            pso.Create(m_device.Get());
+            m_psoMng->CreatePSO(GetPMDPipelineName("pmd", vertexLayout, layout), pso.Get());
+        }
+    }
 
     //
     // Primitive
@@ -1435,6 +1521,8 @@ bool D3D12App::CreateWorldPassConstant()
             XMMatrixOrthographicRH(200.0f, 200.0f, 1.0f, 500.0f);
 
         XMStoreFloat4x4(&mappedData->Lights[0].ProjectMatrix, lightViewProj);
+        // Upload heap is write-combined, keep a copy to read
+        XMStoreFloat4x4(&m_lightViewProj, lightViewProj);
 
         gpuAddress += stride_bytes;
     }
@@ -1483,11 +1571,12 @@ void D3D12App::CreatePMDModel()
     m_pmdManager->SetDefaultBuffer(m_whiteTexture.Get(), m_blackTexture.Get(), m_gradTexture.Get());
     m_pmdManager->SetWorldPassConstantGpuAddress(m_worldPCBuffer.GetGPUVirtualAddress());
     m_pmdManager->SetWorldShadowMap(m_shadowDepthBuffer.Get());
-    m_pmdManager->CreateModel("Hibiki", model2_path);
-    m_pmdManager->CreateModel("Miku", model1_path);
-    m_pmdManager->CreateModel("Haku", model_path);
-    m_pmdManager->CreateAnimation("Dancing1", motion1_path);
-    m_pmdManager->CreateAnimation("Dancing2", motion2_path);
+    m_pmdManager->SetBonePaletteLayout(pmd_bone_palette_layout);
+    m_pmdManager->CreateModelAsync("Hibiki", model2_path);
+    m_pmdManager->CreateModelAsync("Miku", model1_path);
+    m_pmdManager->CreateModelAsync("Haku", model_path);
+    m_pmdManager->CreateAnimationAsync("Dancing1", motion1_path);
+    m_pmdManager->CreateAnimationAsync("Dancing2", motion2_path);
 
     m_pmdManager->Init(m_cmdList.Get());
     m_pmdManager->Play("Miku", "Dancing1");
@@ -1644,6 +1733,8 @@ bool D3D12App::Update(const float& deltaTime)
     WaitForGPU();
 
     UpdateWorldPassConstant();
+    m_pmdManager->SetCamera(m_camera.GetCameraSpaceMatrix(), m_camera.GetProjectionMatrix());
+    m_pmdManager->SetShadowCamera(m_lightViewProj);
     m_pmdManager->Update(deltaTime);
     
     g_scalar = g_scalar > 5 ? 0.1 : g_scalar;
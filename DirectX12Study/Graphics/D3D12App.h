@@ -141,6 +141,8 @@ private:
 	// World Pass Constant
 	UploadBuffer<WorldPassConstant> m_worldPCBuffer;
 	bool CreateWorldPassConstant();
+	// View projection of Lights[0], the shadow map's camera
+	DirectX::XMFLOAT4X4 m_lightViewProj;
 private:
 	UpdateTextureBuffers m_updateBuffers;
 	
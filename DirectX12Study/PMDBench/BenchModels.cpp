@@ -0,0 +1,72 @@
+#include "BenchModels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <Windows.h>
+
+namespace
+{
+	// Files under directory and its subdirectories ending with extension, sorted so runs are comparable
+	void FindFiles(const std::string& directory, const char* extension, std::vector<std::string>& paths)
+	{
+		WIN32_FIND_DATAA data;
+		auto handle = FindFirstFileA((directory + "/*").c_str(), &data);
+		if (handle == INVALID_HANDLE_VALUE) return;
+		do
+		{
+			const std::string name = data.cFileName;
+			if (name == "." || name == "..") continue;
+			const auto path = directory + "/" + name;
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				FindFiles(path, extension, paths);
+			else if (name.size() > std::strlen(extension) &&
+				_stricmp(name.c_str() + name.size() - std::strlen(extension), extension) == 0)
+				paths.push_back(path);
+		} while (FindNextFileA(handle, &data));
+		FindClose(handle);
+	}
+
+	// Paths found once, the returned pointers stay valid for the whole run
+	struct BenchPaths
+	{
+		std::vector<std::string> Storage;
+		std::vector<const char*> Paths;
+
+		BenchPaths(const char* directory, const char* extension)
+		{
+			FindFiles(directory, extension, Storage);
+			std::sort(Storage.begin(), Storage.end());
+			for (auto& path : Storage)
+				Paths.push_back(path.c_str());
+		}
+	};
+}
+
+const std::vector<const char*>& GetBenchPMDPaths()
+{
+	static const BenchPaths paths("Resource/PMD/model", ".pmd");
+	return paths.Paths;
+}
+
+const std::vector<const char*>& GetBenchPMXPaths()
+{
+	static const BenchPaths paths("Resource/PMD/model", ".pmx");
+	return paths.Paths;
+}
+
+const std::vector<const char*>& GetBenchVMDPaths()
+{
+	static const BenchPaths paths("Resource", ".vmd");
+	return paths.Paths;
+}
+
+const char* GetBenchModelPath()
+{
+	return "Resource/PMD/model/㉹nN.pmd";
+}
+
+const char* GetBenchMotionPath()
+{
+	return "Resource/VMD/SR_X.vmd";
+}
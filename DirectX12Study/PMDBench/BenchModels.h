@@ -0,0 +1,16 @@
+#pragma once
+#include <vector>
+
+// Bundled resources the benchmarks load, paths are relative to DirectX12Study like D3D12App's
+// Paths are in the ANSI code page (Shift-JIS) like the rest of the project's model paths
+
+// Every PMD model under Resource/PMD/model and its subdirectories, found on first call
+const std::vector<const char*>& GetBenchPMDPaths();
+// Every PMX model under Resource/PMD/model
+const std::vector<const char*>& GetBenchPMXPaths();
+// Every VMD motion under Resource
+const std::vector<const char*>& GetBenchVMDPaths();
+
+// Model and motion most benchmarks animate (Haku dancing, as in D3D12App)
+const char* GetBenchModelPath();
+const char* GetBenchMotionPath();
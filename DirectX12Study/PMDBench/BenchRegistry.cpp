@@ -0,0 +1,58 @@
+#include "BenchRegistry.h"
+
+#include <atomic>
+#include <cstdio>
+
+namespace
+{
+	std::atomic<const void*> g_sink{ nullptr };
+}
+
+void TestContext::Fail(const char* file, int line, const char* expression)
+{
+	std::printf("  %s(%d): check failed: %s\n", file, line, expression);
+	m_hasFailed = true;
+}
+
+bool TestContext::HasFailed() const
+{
+	return m_hasFailed;
+}
+
+BenchContext::BenchContext(bool quick) :
+	m_isQuick(quick)
+{
+}
+
+void BenchContext::Report(const std::string& name, double value, const char* unit)
+{
+	std::printf("  %-56s %14.6g %s\n", name.c_str(), value, unit);
+	m_results.push_back({ name, value, unit });
+}
+
+bool BenchContext::IsQuick() const
+{
+	return m_isQuick;
+}
+
+const std::vector<BenchResult>& BenchContext::Results() const
+{
+	return m_results;
+}
+
+std::vector<TestEntry>& GetTests()
+{
+	static std::vector<TestEntry> tests;
+	return tests;
+}
+
+std::vector<BenchEntry>& GetBenches()
+{
+	static std::vector<BenchEntry> benches;
+	return benches;
+}
+
+void DoNotOptimize(const void* pData)
+{
+	g_sink.store(pData, std::memory_order_relaxed);
+}
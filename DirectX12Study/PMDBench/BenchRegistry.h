@@ -0,0 +1,99 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal test and benchmark harness of PMDBench
+// PMD_TEST / PMD_BENCH register a function at static initialization, main runs them by name
+
+class TestContext
+{
+public:
+	void Fail(const char* file, int line, const char* expression);
+	bool HasFailed() const;
+private:
+	bool m_hasFailed = false;
+};
+
+struct BenchResult
+{
+	std::string Name;
+	double Value;
+	std::string Unit;
+};
+
+class BenchContext
+{
+public:
+	// quick = true -> fewer repetitions, for checking benchmarks still run
+	explicit BenchContext(bool quick);
+
+	// Add a result row, printed as a table and written to --json file
+	void Report(const std::string& name, double value, const char* unit);
+	bool IsQuick() const;
+	const std::vector<BenchResult>& Results() const;
+private:
+	std::vector<BenchResult> m_results;
+	bool m_isQuick;
+};
+
+using TestFunction = void(*)(TestContext&);
+using BenchFunction = void(*)(BenchContext&);
+
+struct TestEntry
+{
+	const char* Name;
+	TestFunction Function;
+};
+
+struct BenchEntry
+{
+	const char* Name;
+	BenchFunction Function;
+};
+
+std::vector<TestEntry>& GetTests();
+std::vector<BenchEntry>& GetBenches();
+
+struct TestRegistrar
+{
+	TestRegistrar(const char* name, TestFunction function) { GetTests().push_back({ name, function }); }
+};
+
+struct BenchRegistrar
+{
+	BenchRegistrar(const char* name, BenchFunction function) { GetBenches().push_back({ name, function }); }
+};
+
+#define PMD_TEST(name) \
+	static void name(TestContext& context); \
+	static TestRegistrar name##_registrar(#name, name); \
+	static void name(TestContext& context)
+
+#define PMD_BENCH(name) \
+	static void name(BenchContext& context); \
+	static BenchRegistrar name##_registrar(#name, name); \
+	static void name(BenchContext& context)
+
+#define PMD_CHECK(condition) \
+	do { if (!(condition)) context.Fail(__FILE__, __LINE__, #condition); } while (false)
+
+// Shortest of repeatCount runs of func in nanoseconds
+// Shortest run is the one least disturbed by other processes
+template<typename Func>
+double MeasureNanoseconds(size_t repeatCount, Func&& func)
+{
+	double best = 0.0;
+	for (size_t i = 0; i < repeatCount; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || elapsed < best) best = elapsed;
+	}
+	return best;
+}
+
+// Keep the compiler from removing work whose result isn't used
+void DoNotOptimize(const void* pData);
@@ -0,0 +1,54 @@
+#include "BenchScene.h"
+
+#include <algorithm>
+
+#include "BenchModels.h"
+
+using namespace DirectX;
+
+bool BenchScene::Create()
+{
+	if (!Model.Load(GetBenchModelPath())) return false;
+	if (!Motion.Load(GetBenchMotionPath())) return false;
+	if (!Motion.Resample(1, 0.0f, 0.0f)) return false;
+	Skeleton.Create(Model.Bones);
+	Tracks.clear();
+	for (auto& track : Motion.GetTracks())
+	{
+		auto it = Model.BonesTable.find(track.first);
+		if (it == Model.BonesTable.end()) continue;
+		Tracks.push_back({ it->second, track.second.DenseTrack });
+	}
+	return true;
+}
+
+void BenchScene::EvaluateLocalPose(float frame, VMDSampleBatch& batch, std::vector<uint16_t>& sampledBones,
+	XMFLOAT3X4* transforms) const
+{
+	auto pDenseTracks = Motion.GetDenseTracks();
+	batch.Reset(Tracks.size());
+	sampledBones.clear();
+	for (auto& track : Tracks)
+	{
+		if (pDenseTracks->Push(batch, track.DenseTrack, frame))
+			sampledBones.push_back(track.BoneIndex);
+	}
+	batch.Sample();
+
+	XMFLOAT3X4 identity;
+	XMStoreFloat3x4(&identity, XMMatrixIdentity());
+	std::fill(transforms, transforms + Model.Bones.size(), identity);
+	for (size_t i = 0; i < sampledBones.size(); ++i)
+	{
+		auto index = sampledBones[i];
+		XMFLOAT4 q;
+		XMFLOAT3 move;
+		batch.GetRotation(i, &q.x);
+		batch.GetLocation(i, &move.x);
+		auto& origin = Model.Bones[index].pos;
+		auto mat = XMMatrixTranslation(-origin.x, -origin.y, -origin.z);
+		mat *= XMMatrixRotationQuaternion(XMLoadFloat4(&q));
+		mat *= XMMatrixTranslation(origin.x + move.x, origin.y + move.y, origin.z + move.z);
+		XMStoreFloat3x4(&transforms[index], mat);
+	}
+}
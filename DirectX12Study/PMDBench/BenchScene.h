@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "../PMDModel/PMDLoader.h"
+#include "../PMDModel/PMDSkeleton.h"
+#include "../PMDModel/VMD/VMDMotion.h"
+#include "../PMDModel/VMD/VMDSampler.h"
+
+// Bench model with bench motion bound to its bones, read-only once created
+// Shared by every instance like PMDManager's loaders and motion datas
+struct BenchScene
+{
+	// Bone of model that motion has a track for
+	struct Track
+	{
+		uint16_t BoneIndex;
+		uint32_t DenseTrack;
+	};
+
+	PMDLoader Model;
+	VMDMotion Motion;
+	PMDSkeleton Skeleton;
+	std::vector<Track> Tracks;
+
+	// Load GetBenchModelPath and GetBenchMotionPath, motion is resampled to 1 sample per frame
+	bool Create();
+	// Local transforms of every bone at frame, same as PMDManager's EvaluatePose before skeleton pass
+	// batch and sampledBones are per-instance scratch
+	void EvaluateLocalPose(float frame, VMDSampleBatch& batch, std::vector<uint16_t>& sampledBones,
+		DirectX::XMFLOAT3X4* transforms) const;
+};
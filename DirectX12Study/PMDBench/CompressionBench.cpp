@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "BenchModels.h"
+#include "../PMDModel/VMD/VMDMotion.h"
+#include "../PMDModel/VMD/VMDSampler.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Default tolerances of PMDManager::SetMotionCompression
+	constexpr float compression_angle_error = 0.005f;
+	constexpr float compression_location_error = 0.01f;
+	// Playback samples between frames too
+	constexpr float compression_sample_step = 0.5f;
+	constexpr size_t compression_repeat_count = 10;
+	constexpr size_t quick_compression_repeat_count = 1;
+
+	// Tracks of both motions in the same order, the compressed one keeps every track
+	std::vector<VMDTrack> GetTracks(const VMDMotion& motion, const std::vector<std::string>& names)
+	{
+		std::vector<VMDTrack> tracks;
+		for (auto& name : names)
+			tracks.push_back(motion.GetTracks().at(name));
+		return tracks;
+	}
+
+	// Pose of every track at frame, same keyframe pair and curve as PMDManager::SampleMotion
+	void SampleTracks(const VMDMotion& motion, const std::vector<VMDTrack>& tracks, float frame, VMDSampleBatch& batch)
+	{
+		auto& keys = motion.GetKeyframes();
+		batch.Reset(tracks.size());
+		for (auto& track : tracks)
+		{
+			auto first = keys.FrameNO.begin() + track.First;
+			auto last = first + track.Count;
+			auto it = std::upper_bound(first, last, static_cast<uint32_t>(frame));
+			auto k0 = track.First + static_cast<uint32_t>(it == first ? 0 : it - first - 1);
+			auto k1 = it == last || it == first ? k0 : k0 + 1;
+
+			XMFLOAT4 weights(0.0f, 0.0f, 0.0f, 0.0f);
+			if (k1 != k0)
+			{
+				auto x = (frame - keys.FrameNO[k0]) / static_cast<float>(keys.FrameNO[k1] - keys.FrameNO[k0]);
+				XMStoreFloat4(&weights, EvaluateVMDCurve(keys.GetCurve(k1), x));
+			}
+			float q0[4], q1[4];
+			keys.GetRotation(k0, q0);
+			keys.GetRotation(k1, q1);
+			const float t0[] = { keys.Tx[k0], keys.Ty[k0], keys.Tz[k0] };
+			const float t1[] = { keys.Tx[k1], keys.Ty[k1], keys.Tz[k1] };
+			batch.Push(q0, q1, t0, t1, &weights.x);
+		}
+		batch.Sample();
+	}
+
+	// Angle between two rotations from their chord, acos of the dot product is imprecise near 0
+	float GetAngle(const float q0[4], const float q1[4])
+	{
+		auto v0 = XMQuaternionNormalize(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(q0)));
+		auto v1 = XMQuaternionNormalize(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(q1)));
+		if (XMVectorGetX(XMQuaternionDot(v0, v1)) < 0.0f)
+			v1 = XMVectorNegate(v1);
+		auto chord = XMVectorGetX(XMVector4Length(XMVectorSubtract(v0, v1)));
+		return 4.0f * std::asin((std::min)(0.5f * chord, 1.0f));
+	}
+
+	// Path under Resource, bundled motions of different folders share file names
+	std::string GetMotionName(const char* path)
+	{
+		std::string name = path;
+		auto slash = name.find('/');
+		return slash == std::string::npos ? name : name.substr(slash + 1);
+	}
+}
+
+// Keyframes, footprint, sampling cost and error of every bundled motion
+// before and after VMDMotion::Compress with PMDManager's default tolerances
+PMD_BENCH(MotionCompression)
+{
+	const size_t repeatCount = context.IsQuick() ? quick_compression_repeat_count : compression_repeat_count;
+	for (auto path : GetBenchVMDPaths())
+	{
+		VMDMotion original;
+		if (!original.Load(path)) continue;
+		const auto name = GetMotionName(path);
+
+		// Compress runs once per motion, time a fresh copy each repeat
+		VMDMotion compressed;
+		auto compressNanoseconds = MeasureNanoseconds(repeatCount, [&]()
+			{
+				compressed = original;
+				compressed.Compress(compression_angle_error, compression_location_error);
+			});
+		auto& stats = compressed.GetCompressionStats();
+		context.Report(name + ", keyframes before", static_cast<double>(stats.KeyframeCount), "");
+		context.Report(name + ", keyframes after", static_cast<double>(stats.ReducedKeyframeCount), "");
+		context.Report(name + ", bytes before", static_cast<double>(stats.SizeInBytes), "bytes");
+		context.Report(name + ", bytes after", static_cast<double>(stats.CompressedSizeInBytes), "bytes");
+		context.Report(name + ", compress", compressNanoseconds * 1e-6, "ms");
+
+		std::vector<std::string> trackNames;
+		for (auto& track : original.GetTracks())
+		{
+			if (track.second.Count > 0)
+				trackNames.push_back(track.first);
+		}
+		if (trackNames.empty()) continue;
+		const auto originalTracks = GetTracks(original, trackNames);
+		const auto compressedTracks = GetTracks(compressed, trackNames);
+
+		// Largest difference between the two over the whole motion
+		VMDSampleBatch originalBatch, compressedBatch;
+		float maxAngle = 0.0f, maxDistance = 0.0f;
+		const auto maxFrame = static_cast<float>(original.GetMaxFrame());
+		size_t frameCount = 0;
+		for (float frame = 0.0f; frame <= maxFrame; frame += compression_sample_step, ++frameCount)
+		{
+			SampleTracks(original, originalTracks, frame, originalBatch);
+			SampleTracks(compressed, compressedTracks, frame, compressedBatch);
+			for (size_t t = 0; t < trackNames.size(); ++t)
+			{
+				float q0[4], q1[4], t0[3], t1[3];
+				originalBatch.GetRotation(t, q0);
+				compressedBatch.GetRotation(t, q1);
+				originalBatch.GetLocation(t, t0);
+				compressedBatch.GetLocation(t, t1);
+				maxAngle = (std::max)(maxAngle, GetAngle(q0, q1));
+				maxDistance = (std::max)(maxDistance, std::sqrt(
+					(t0[0] - t1[0]) * (t0[0] - t1[0]) + (t0[1] - t1[1]) * (t0[1] - t1[1]) + (t0[2] - t1[2]) * (t0[2] - t1[2])));
+			}
+		}
+		context.Report(name + ", max angle error", maxAngle, "rad");
+		context.Report(name + ", max location error", maxDistance, "");
+
+		// Unpacking 48-bit rotations costs a sqrt per keyframe read
+		auto sampleNanoseconds = [&](const VMDMotion& motion, const std::vector<VMDTrack>& tracks, VMDSampleBatch& batch)
+		{
+			return MeasureNanoseconds(repeatCount, [&]()
+				{
+					for (float frame = 0.0f; frame <= maxFrame; frame += compression_sample_step)
+						SampleTracks(motion, tracks, frame, batch);
+					DoNotOptimize(&batch);
+				});
+		};
+		const auto sampleCount = static_cast<double>(frameCount * trackNames.size());
+		context.Report(name + ", sample before", sampleNanoseconds(original, originalTracks, originalBatch) / sampleCount, "ns/bone");
+		context.Report(name + ", sample after", sampleNanoseconds(compressed, compressedTracks, compressedBatch) / sampleCount, "ns/bone");
+	}
+}
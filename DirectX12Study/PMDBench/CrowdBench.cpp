@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Windows.h>
+#include <d3d12.h>
+#include <dxgi1_4.h>
+#include <wrl.h>
+
+#include "BenchRegistry.h"
+#include "BenchModels.h"
+#include "../PMDModel/PMDManager.h"
+#include "../PMDModel/VMD/VMDMotion.h"
+#include "../Utility/D12Helper.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	constexpr uint32_t crowd_instance_counts[] = { 1, 16, 64, 256 };
+	constexpr uint32_t quick_crowd_instance_count = 16;
+	constexpr uint32_t crowd_update_count = 120;
+	constexpr uint32_t quick_crowd_update_count = 5;
+	// First updates grow per-model scratch and pose cache, left out of the profile
+	constexpr uint32_t crowd_warm_up_count = 4;
+	constexpr float crowd_delta_time = 1.0f / 60.0f;
+	const char* const crowd_motion_name = "Dance";
+
+	// Device and the engine resources PMDManager::Init asks for, without window or swap chain
+	// Resources are never drawn, their contents don't matter to animation
+	struct HeadlessDevice
+	{
+		ComPtr<ID3D12Device> Device;
+		ComPtr<ID3D12CommandQueue> CmdQueue;
+		ComPtr<ID3D12CommandAllocator> CmdAlloc;
+		ComPtr<ID3D12GraphicsCommandList> CmdList;
+		ComPtr<ID3D12Fence> Fence;
+		uint64_t FenceValue = 0;
+		ComPtr<ID3D12Resource> WorldPassConstant;
+		ComPtr<ID3D12Resource> ShadowDepthBuffer;
+		ComPtr<ID3D12Resource> WhiteTexture;
+		ComPtr<ID3D12Resource> BlackTexture;
+		ComPtr<ID3D12Resource> GradTexture;
+
+		bool Create()
+		{
+			// WARP where there is no hardware adapter (remote sessions, build machines)
+			if (FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(Device.ReleaseAndGetAddressOf()))))
+			{
+				ComPtr<IDXGIFactory4> factory;
+				ComPtr<IDXGIAdapter> warpAdapter;
+				if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf())))) return false;
+				if (FAILED(factory->EnumWarpAdapter(IID_PPV_ARGS(warpAdapter.GetAddressOf())))) return false;
+				if (FAILED(D3D12CreateDevice(warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0,
+					IID_PPV_ARGS(Device.ReleaseAndGetAddressOf())))) return false;
+			}
+
+			const auto command_list_type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+			D3D12_COMMAND_QUEUE_DESC cmdQdesc = {};
+			cmdQdesc.Type = command_list_type;
+			if (FAILED(Device->CreateCommandQueue(&cmdQdesc, IID_PPV_ARGS(CmdQueue.GetAddressOf())))) return false;
+			if (FAILED(Device->CreateCommandAllocator(command_list_type, IID_PPV_ARGS(CmdAlloc.GetAddressOf())))) return false;
+			if (FAILED(Device->CreateCommandList(0, command_list_type, CmdAlloc.Get(), nullptr,
+				IID_PPV_ARGS(CmdList.GetAddressOf())))) return false;
+			if (FAILED(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(Fence.GetAddressOf())))) return false;
+
+			WorldPassConstant = D12Helper::CreateBuffer(Device.Get(), D12Helper::AlignedConstantBufferMemory(1));
+			CD3DX12_CLEAR_VALUE clearValue(DXGI_FORMAT_D32_FLOAT, 1.0f, 0);
+			ShadowDepthBuffer = D12Helper::CreateTexture2D(Device.Get(), 4, 4, DXGI_FORMAT_R32_TYPELESS,
+				D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_DEPTH_WRITE, &clearValue);
+			WhiteTexture = D12Helper::CreateTexture2D(Device.Get(), 4, 4);
+			BlackTexture = D12Helper::CreateTexture2D(Device.Get(), 4, 4);
+			GradTexture = D12Helper::CreateTexture2D(Device.Get(), 4, 4);
+			return true;
+		}
+
+		// Run commands recorded so far (Init's uploads) and wait for GPU to finish them
+		void ExecuteAndWait()
+		{
+			CmdList->Close();
+			ID3D12CommandList* cmdLists[] = { CmdList.Get() };
+			CmdQueue->ExecuteCommandLists(1, cmdLists);
+			CmdQueue->Signal(Fence.Get(), ++FenceValue);
+			if (Fence->GetCompletedValue() < FenceValue)
+			{
+				auto fenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+				Fence->SetEventOnCompletion(FenceValue, fenceEvent);
+				WaitForSingleObject(fenceEvent, INFINITE);
+				CloseHandle(fenceEvent);
+			}
+			CmdAlloc->Reset();
+			CmdList->Reset(CmdAlloc.Get(), nullptr);
+		}
+	};
+
+	std::string GetCrowdName(uint32_t index)
+	{
+		return "Crowd" + std::to_string(index);
+	}
+
+	// Bench model loaded once and instanced instanceCount - 1 times, every instance dancing
+	// from its own random time, then updateCount updates profiled
+	bool RunCrowd(HeadlessDevice& device, uint32_t instanceCount, size_t workerCount, uint32_t updateCount,
+		float maxTimeOffset, PMDAnimationProfile& profile, uint64_t& processCycles)
+	{
+		PMDManager manager(device.Device.Get());
+		manager.SetWorldPassConstantGpuAddress(device.WorldPassConstant->GetGPUVirtualAddress());
+		manager.SetWorldShadowMap(device.ShadowDepthBuffer.Get());
+		manager.SetDefaultBuffer(device.WhiteTexture.Get(), device.BlackTexture.Get(), device.GradTexture.Get());
+		manager.SetAnimationWorkerCount(workerCount);
+		if (!manager.CreateModel(GetCrowdName(0), GetBenchModelPath())) return false;
+		if (!manager.CreateAnimation(crowd_motion_name, GetBenchMotionPath())) return false;
+		for (uint32_t i = 1; i < instanceCount; ++i)
+			manager.CreateModelInstance(GetCrowdName(i), GetCrowdName(0));
+		if (!manager.Init(device.CmdList.Get())) return false;
+		device.ExecuteAndWait();
+		manager.ClearSubresources();
+
+		// Fixed seed so runs are comparable
+		// Different times keep instances from sharing poses through pose cache
+		std::mt19937 random(0);
+		std::uniform_real_distribution<float> timeOffset(0.0f, maxTimeOffset);
+		for (uint32_t i = 0; i < instanceCount; ++i)
+		{
+			manager.Play(GetCrowdName(i), crowd_motion_name);
+			manager.SetLayerTime(GetCrowdName(i), 0, timeOffset(random));
+		}
+		for (uint32_t i = 0; i < crowd_warm_up_count; ++i)
+			manager.Update(crowd_delta_time);
+
+		// Cycles of every thread of the process, workers included
+		ULONG64 cyclesBefore = 0, cyclesAfter = 0;
+		manager.BeginAnimationProfile();
+		QueryProcessCycleTime(GetCurrentProcess(), &cyclesBefore);
+		for (uint32_t i = 0; i < updateCount; ++i)
+			manager.Update(crowd_delta_time);
+		QueryProcessCycleTime(GetCurrentProcess(), &cyclesAfter);
+		manager.EndAnimationProfile(profile);
+		processCycles = cyclesAfter - cyclesBefore;
+		return profile.AnimatedBoneCount > 0;
+	}
+}
+
+// PMDManager::Update of 1..256 instances of one model on 1..hardware workers, no window
+// Covers keyframe search, bezier, slerp, hierarchy, IK, springs and palette write as the app runs them
+// Cache misses aren't reported: Windows only exposes CPU performance counters to kernel mode
+// (ETW PMC sampling or VTune's driver), run those on this bench for them
+PMD_BENCH(CrowdAnimation)
+{
+	HeadlessDevice device;
+	if (!device.Create())
+	{
+		context.Report("no D3D12 device", 0.0, "");
+		return;
+	}
+	// Motion holds its last frame, start times leave room for every update
+	VMDMotion motion;
+	if (!motion.Load(GetBenchMotionPath()))
+	{
+		context.Report("bench motion missing", 0.0, "");
+		return;
+	}
+	const uint32_t updateCount = context.IsQuick() ? quick_crowd_update_count : crowd_update_count;
+	const float maxTimeOffset = (std::max)(motion.GetMaxFrame() / 30.0f - (crowd_warm_up_count + updateCount) * crowd_delta_time, 0.0f);
+
+	const size_t maxWorkerCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+	std::vector<size_t> workerCounts;
+	for (size_t workerCount = 1; workerCount < maxWorkerCount; workerCount *= 2)
+		workerCounts.push_back(workerCount);
+	workerCounts.push_back(maxWorkerCount);
+	std::vector<uint32_t> instanceCounts(std::begin(crowd_instance_counts), std::end(crowd_instance_counts));
+	if (context.IsQuick())
+	{
+		instanceCounts = { quick_crowd_instance_count };
+		workerCounts = { 1, maxWorkerCount };
+	}
+
+	for (auto instanceCount : instanceCounts)
+	{
+		for (auto workerCount : workerCounts)
+		{
+			PMDAnimationProfile profile;
+			uint64_t processCycles = 0;
+			if (!RunCrowd(device, instanceCount, workerCount, updateCount, maxTimeOffset, profile, processCycles))
+			{
+				context.Report("bench model or motion missing", 0.0, "");
+				return;
+			}
+
+			const auto bones = static_cast<double>(profile.AnimatedBoneCount);
+			const auto wallSeconds = profile.UpdateNanoseconds * 1e-9;
+			const auto workerSeconds = profile.AnimationWorkerNanoseconds * 1e-9;
+			const auto poseCount = (std::max)(profile.PoseEvaluationCount + profile.PoseCacheHitCount, uint64_t(1));
+			auto name = std::to_string(instanceCount) + " instance(s), " + std::to_string(profile.WorkerCount) + " worker(s)";
+			context.Report(name + ", update", profile.UpdateNanoseconds * 1e-6 / profile.UpdateCount, "ms");
+			context.Report(name + ", slowest update", profile.MaxUpdateNanoseconds * 1e-6, "ms");
+			context.Report(name + ", ns per bone", profile.AnimationWorkerNanoseconds / bones, "ns");
+			context.Report(name + ", cycles per bone", processCycles / bones, "cycles");
+			context.Report(name + ", bones per second", bones / wallSeconds, "1/s");
+			context.Report(name + ", bones per second per thread", bones / workerSeconds, "1/s");
+			// Busy time of workers over the time all of them were available, 1 is perfect scaling
+			context.Report(name + ", parallel efficiency", workerSeconds / (wallSeconds * profile.WorkerCount), "");
+			context.Report(name + ", pose cache hit rate", 100.0 * profile.PoseCacheHitCount / poseCount, "%");
+			context.Report(name + ", bone upload per update", static_cast<double>(profile.BoneUploadBytes) / profile.UpdateCount, "bytes");
+		}
+	}
+}
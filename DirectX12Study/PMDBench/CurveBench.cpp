@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "../PMDModel/VMD/VMDCurve.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Control points are in 1/127 steps in VMD, the test walks every step_th one
+	constexpr int curve_control_step = 9;
+	constexpr size_t curve_test_sample_count = 33;
+	constexpr size_t curve_sample_count = 257;
+	constexpr size_t curve_repeat_count = 20;
+	// EvaluateVMDCurve keeps |x(t) - x| below this
+	constexpr double max_curve_x_error = 3e-5;
+
+	// Bezier of one channel with control points (0,0), p1, p2, (1,1)
+	double Bezier(double t, double p1, double p2)
+	{
+		auto rt = 1.0 - t;
+		return 3.0 * rt * rt * t * p1 + 3.0 * rt * t * t * p2 + t * t * t;
+	}
+
+	// Solve x(t) = x by bisection in double, x(t) is monotonic for control points in [0, 1]
+	double ReferenceCurve(double x, double x1, double y1, double x2, double y2)
+	{
+		double lo = 0.0, hi = 1.0;
+		for (size_t i = 0; i < 60; ++i)
+		{
+			auto mid = (lo + hi) * 0.5;
+			if (Bezier(mid, x1, x2) < x) lo = mid;
+			else hi = mid;
+		}
+		return Bezier((lo + hi) * 0.5, y1, y2);
+	}
+
+	// Interpolation block with the same control points for all 4 channels
+	void FillInterpolation(uint8_t interpolation[64], int x1, int y1, int x2, int y2)
+	{
+		for (size_t c = 0; c < 4; ++c)
+		{
+			interpolation[c] = static_cast<uint8_t>(x1);
+			interpolation[4 + c] = static_cast<uint8_t>(y1);
+			interpolation[8 + c] = static_cast<uint8_t>(x2);
+			interpolation[12 + c] = static_cast<uint8_t>(y2);
+		}
+		for (size_t i = 16; i < 64; ++i)
+			interpolation[i] = interpolation[i % 16];
+	}
+
+	// Largest y(x) error allowed at x for the x error bound : bound x (max slope of y over x near x)
+	double AllowedCurveError(double x, double x1, double y1, double x2, double y2)
+	{
+		auto lo = (std::max)(0.0, x - max_curve_x_error);
+		auto hi = (std::min)(1.0, x + max_curve_x_error);
+		return std::abs(ReferenceCurve(hi, x1, y1, x2, y2) - ReferenceCurve(lo, x1, y1, x2, y2)) + 1e-6;
+	}
+}
+// EvaluateVMDCurve against a double precision bisection over a grid of control points
+// Error in y is checked against how far y can move within the solver's x error bound
+PMD_TEST(CurveMatchesReference)
+{
+	uint8_t interpolation[64];
+	for (int x1 = 0; x1 <= 127; x1 += curve_control_step)
+	for (int y1 = 0; y1 <= 127; y1 += curve_control_step)
+	for (int x2 = 0; x2 <= 127; x2 += curve_control_step)
+	for (int y2 = 0; y2 <= 127; y2 += curve_control_step)
+	{
+		FillInterpolation(interpolation, x1, y1, x2, y2);
+		auto curve = CreateVMDCurve(interpolation);
+		for (size_t i = 0; i < curve_test_sample_count; ++i)
+		{
+			auto x = static_cast<double>(i) / (curve_test_sample_count - 1);
+			auto y = XMVectorGetX(EvaluateVMDCurve(curve, static_cast<float>(x)));
+			auto reference = ReferenceCurve(x, x1 / 127.0, y1 / 127.0, x2 / 127.0, y2 / 127.0);
+			auto allowed = AllowedCurveError(x, x1 / 127.0, y1 / 127.0, x2 / 127.0, y2 / 127.0);
+			PMD_CHECK(std::abs(y - reference) <= allowed);
+			if (context.HasFailed()) return;
+		}
+	}
+}
+
+// Error and throughput of EvaluateVMDCurve (4 channels per call)
+PMD_BENCH(CurveEvaluation)
+{
+	uint8_t interpolation[64];
+	std::vector<VMDCurve> curves;
+	std::vector<double> controls;
+	for (int x1 = 0; x1 <= 127; x1 += curve_control_step * 2)
+	for (int y1 = 0; y1 <= 127; y1 += curve_control_step * 2)
+	for (int x2 = 0; x2 <= 127; x2 += curve_control_step * 2)
+	for (int y2 = 0; y2 <= 127; y2 += curve_control_step * 2)
+	{
+		FillInterpolation(interpolation, x1, y1, x2, y2);
+		curves.push_back(CreateVMDCurve(interpolation));
+		controls.insert(controls.end(), { x1 / 127.0, y1 / 127.0, x2 / 127.0, y2 / 127.0 });
+	}
+
+	double maxError = 0.0;
+	double errorSum = 0.0;
+	size_t sampleCount = 0;
+	for (size_t c = 0; c < curves.size(); ++c)
+	{
+		auto p = &controls[c * 4];
+		for (size_t i = 0; i < curve_sample_count; ++i)
+		{
+			auto x = static_cast<double>(i) / (curve_sample_count - 1);
+			auto error = std::abs(XMVectorGetX(EvaluateVMDCurve(curves[c], static_cast<float>(x))) - ReferenceCurve(x, p[0], p[1], p[2], p[3]));
+			maxError = (std::max)(maxError, error);
+			errorSum += error;
+			++sampleCount;
+		}
+	}
+
+	const size_t repeatCount = context.IsQuick() ? 2 : curve_repeat_count;
+	auto evaluateTime = MeasureNanoseconds(repeatCount, [&]()
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (auto& curve : curves)
+				for (size_t i = 0; i < curve_sample_count; ++i)
+					sum = XMVectorAdd(sum, EvaluateVMDCurve(curve, static_cast<float>(i) / (curve_sample_count - 1)));
+			DoNotOptimize(&sum);
+		});
+	auto referenceTime = MeasureNanoseconds(repeatCount, [&]()
+		{
+			double sum = 0.0;
+			for (size_t c = 0; c < curves.size(); ++c)
+				for (size_t i = 0; i < curve_sample_count; ++i)
+					sum += ReferenceCurve(static_cast<double>(i) / (curve_sample_count - 1), controls[c * 4], controls[c * 4 + 1], controls[c * 4 + 2], controls[c * 4 + 3]);
+			DoNotOptimize(&sum);
+		});
+
+	context.Report("EvaluateVMDCurve max |y - reference|", maxError, "");
+	context.Report("EvaluateVMDCurve mean |y - reference|", errorSum / sampleCount, "");
+	context.Report("EvaluateVMDCurve, 4 channels", evaluateTime / sampleCount, "ns/call");
+	context.Report("double bisection reference, 1 channel", referenceTime / sampleCount, "ns/call");
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "BenchScene.h"
+#include "../PMDModel/PMDIKSolver.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Poses spread over the motion, feet in many different places
+	constexpr size_t ik_pose_count = 64;
+	constexpr float ik_pose_frame_step = 7.0f;
+	constexpr size_t ik_repeat_count = 20;
+	constexpr size_t quick_ik_repeat_count = 2;
+
+	// Local and world transforms of a pose before IK, as CalculateWorldTransforms has them
+	struct IKPose
+	{
+		std::vector<XMFLOAT3X4> Locals;
+		std::vector<XMFLOAT3X4> Worlds;
+	};
+
+	std::vector<IKPose> CreateIKPoses(const BenchScene& scene)
+	{
+		VMDSampleBatch batch;
+		std::vector<uint16_t> sampledBones;
+		std::vector<IKPose> poses(ik_pose_count);
+		for (size_t i = 0; i < ik_pose_count; ++i)
+		{
+			auto& pose = poses[i];
+			pose.Locals.resize(scene.Skeleton.BoneCount());
+			scene.EvaluateLocalPose(i * ik_pose_frame_step, batch, sampledBones, pose.Locals.data());
+			pose.Worlds = pose.Locals;
+			scene.Skeleton.CalculateWorldTransforms(pose.Worlds.data());
+		}
+		return poses;
+	}
+
+	// Solve every pose from a fresh copy, stats are summed over poses
+	void SolvePoses(const PMDIKSolver& solver, const std::vector<IKPose>& poses, uint32_t iterationBudget,
+		IKPose& scratch, PMDIKSolveStats& stats)
+	{
+		for (auto& pose : poses)
+		{
+			scratch.Locals = pose.Locals;
+			scratch.Worlds = pose.Worlds;
+			solver.Solve(scratch.Locals.data(), scratch.Worlds.data(), iterationBudget, stats);
+		}
+	}
+
+	// Time of copying poses only, taken out of solve time
+	void CopyPoses(const std::vector<IKPose>& poses, IKPose& scratch)
+	{
+		for (auto& pose : poses)
+		{
+			scratch.Locals = pose.Locals;
+			scratch.Worlds = pose.Worlds;
+			DoNotOptimize(scratch.Worlds.data());
+		}
+	}
+}
+
+// Iteration budget is shared by all chains of the model and never exceeded
+PMD_TEST(IKSolveStaysInBudget)
+{
+	BenchScene scene;
+	PMD_CHECK(scene.Create());
+	if (context.HasFailed()) return;
+	PMDIKSolver solver;
+	solver.Create(scene.Model.IKChains, scene.Model.IKLinks, scene.Model.Bones, scene.Skeleton);
+	PMD_CHECK(!solver.Empty());
+	if (context.HasFailed()) return;
+
+	const auto poses = CreateIKPoses(scene);
+	const auto demand = solver.IterationCount();
+	IKPose full, limited;
+	for (auto budget : { 0u, 1u, demand / 4, demand / 2, demand, demand * 2 })
+	{
+		for (auto& pose : poses)
+		{
+			PMDIKSolveStats stats;
+			limited.Locals = pose.Locals;
+			limited.Worlds = pose.Worlds;
+			solver.Solve(limited.Locals.data(), limited.Worlds.data(), budget, stats);
+			PMD_CHECK(stats.IterationCount <= budget);
+
+			// Enough budget for every chain -> same pose as an unlimited solve
+			if (budget < demand) continue;
+			PMDIKSolveStats fullStats;
+			full.Locals = pose.Locals;
+			full.Worlds = pose.Worlds;
+			solver.Solve(full.Locals.data(), full.Worlds.data(), UINT32_MAX, fullStats);
+			PMD_CHECK(std::memcmp(full.Worlds.data(), limited.Worlds.data(), full.Worlds.size() * sizeof(XMFLOAT3X4)) == 0);
+		}
+	}
+}
+
+// CCD cost of the bench model's chains over poses of the bench motion
+// With the full budget and with half of it, the way an over-budget model is solved
+PMD_BENCH(IKChainCost)
+{
+	BenchScene scene;
+	if (!scene.Create())
+	{
+		context.Report("bench model or motion missing", 0.0, "");
+		return;
+	}
+	PMDIKSolver solver;
+	solver.Create(scene.Model.IKChains, scene.Model.IKLinks, scene.Model.Bones, scene.Skeleton);
+	if (solver.Empty())
+	{
+		context.Report("bench model has no IK chain", 0.0, "");
+		return;
+	}
+
+	const size_t repeatCount = context.IsQuick() ? quick_ik_repeat_count : ik_repeat_count;
+	const auto poses = CreateIKPoses(scene);
+	IKPose scratch;
+	const auto copyNanoseconds = MeasureNanoseconds(repeatCount, [&]() { CopyPoses(poses, scratch); });
+
+	context.Report("IK chains", static_cast<double>(solver.ChainCount()), "");
+	context.Report("CCD iterations per solve (sum of chains in PMD)", solver.IterationCount(), "");
+	const uint32_t budgets[] = { solver.IterationCount(), solver.IterationCount() / 2 };
+	const char* names[] = { "full budget", "half budget" };
+	for (size_t b = 0; b < 2; ++b)
+	{
+		PMDIKSolveStats stats;
+		SolvePoses(solver, poses, budgets[b], scratch, stats);
+		const auto solveNanoseconds = (std::max)(
+			MeasureNanoseconds(repeatCount, [&]() { PMDIKSolveStats s; SolvePoses(solver, poses, budgets[b], scratch, s); }) - copyNanoseconds,
+			0.0);
+
+		const std::string name = names[b];
+		context.Report(name + ", ns per model", solveNanoseconds / poses.size(), "ns");
+		context.Report(name + ", ns per chain", solveNanoseconds / stats.ChainCount, "ns");
+		context.Report(name + ", ns per iteration", solveNanoseconds / stats.IterationCount, "ns");
+		context.Report(name + ", iterations per chain", static_cast<double>(stats.IterationCount) / stats.ChainCount, "");
+		context.Report(name + ", converged chains", 100.0 * stats.ConvergedChainCount / stats.ChainCount, "%");
+	}
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "BenchScene.h"
+#include "../PMDModel/PMDBonePalette.h"
+#include "../Utility/Jobs/JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t instance_counts[] = { 1, 10, 100, 1000 };
+	constexpr size_t frame_count = 30;
+	constexpr size_t quick_frame_count = 5;
+
+	// Per-instance state of PMDManager's animation update
+	struct Instance
+	{
+		VMDSampleBatch Batch;
+		std::vector<uint16_t> SampledBones;
+		std::vector<XMFLOAT3X4> Transforms;
+		std::vector<XMFLOAT3X4> Palette;
+		float FrameOffset = 0.0f;
+	};
+
+	// Same steps as PMDManager::Impl::EvaluatePose followed by the palette write
+	void UpdateInstance(const BenchScene& scene, Instance& instance, float frame)
+	{
+		scene.EvaluateLocalPose(frame + instance.FrameOffset, instance.Batch, instance.SampledBones,
+			instance.Transforms.data());
+		scene.Skeleton.CalculateWorldTransforms(instance.Transforms.data());
+		WriteBonePalette(PMDBonePaletteLayout::Affine3x4, instance.Transforms.data(),
+			instance.Palette.size(), instance.Palette.data());
+	}
+}
+
+// Animation update of 1..1000 instances of one model on 1..hardware workers
+// Time is per frame, speedup is over one worker with the same instance count
+PMD_BENCH(JobSystemScaling)
+{
+	BenchScene scene;
+	if (!scene.Create())
+	{
+		context.Report("bench model or motion missing", 0.0, "");
+		return;
+	}
+
+	const size_t frameCount = context.IsQuick() ? quick_frame_count : frame_count;
+	const size_t maxWorkerCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+	std::vector<size_t> workerCounts;
+	for (size_t workerCount = 1; workerCount < maxWorkerCount; workerCount *= 2)
+		workerCounts.push_back(workerCount);
+	workerCounts.push_back(maxWorkerCount);
+
+	for (auto instanceCount : instance_counts)
+	{
+		std::vector<Instance> instances(instanceCount);
+		for (size_t i = 0; i < instanceCount; ++i)
+		{
+			instances[i].Transforms.resize(scene.Skeleton.BoneCount());
+			instances[i].Palette.resize(GetPaletteBoneCount(scene.Skeleton.BoneCount()));
+			// Instances at different points of the motion, like a crowd
+			instances[i].FrameOffset = static_cast<float>(i % 97) * 3.0f;
+		}
+
+		double singleWorker = 0.0;
+		for (auto workerCount : workerCounts)
+		{
+			JobSystem jobSystem(workerCount);
+			float frame = 0.0f;
+			auto frameNanoseconds = MeasureNanoseconds(frameCount, [&]()
+				{
+					// Grain of 1 like PMDManager::Update
+					jobSystem.ParallelFor(instances.size(), 1, [&](size_t begin, size_t end)
+						{
+							for (size_t i = begin; i < end; ++i)
+								UpdateInstance(scene, instances[i], frame);
+						});
+					frame += 1.0f;
+				});
+			DoNotOptimize(instances.back().Palette.data());
+			if (workerCount == 1)
+				singleWorker = frameNanoseconds;
+
+			auto name = std::to_string(instanceCount) + " instance(s), " + std::to_string(workerCount) + " worker(s)";
+			context.Report(name + ", frame", frameNanoseconds * 1e-3, "us");
+			context.Report(name + ", speedup", singleWorker / frameNanoseconds, "x");
+		}
+	}
+}
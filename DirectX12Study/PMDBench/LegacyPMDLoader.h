@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../PMDModel/PMDCommon.h"
+
+// PMD loader the project had before PMDLoader read mapped files
+// Reads every block with fread_s into temporary vectors, skips IK and skins with fseek
+// Kept only as the baseline of LoaderBench
+class LegacyPMDLoader
+{
+public:
+	bool Load(const char* path);
+
+	struct Bone
+	{
+		std::string name;
+		DirectX::XMFLOAT3 pos;
+		std::vector<uint16_t> children;
+	};
+
+	std::vector<PMDVertex> Vertices;
+	std::vector<uint16_t> Indices;
+	std::vector<PMDMaterial> Materials;
+	std::vector<PMDSubMaterial> SubMaterials;
+	std::vector<std::string> ModelPaths;
+	std::vector<std::string> ToonPaths;
+	std::vector<Bone> Bones;
+	std::unordered_map<std::string, uint16_t> BonesTable;
+	std::string Path;
+};
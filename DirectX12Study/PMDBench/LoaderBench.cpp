@@ -0,0 +1,492 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "BenchRegistry.h"
+#include "BenchModels.h"
+#include "LegacyPMDLoader.h"
+#include "../PMDModel/PMDBonePalette.h"
+#include "../PMDModel/PMDLoader.h"
+#include "../PMDModel/PMXLoader.h"
+#include "../PMDModel/VMD/VMDMotion.h"
+#include "../Utility/ThreadPool.h"
+
+namespace
+{
+	constexpr size_t load_repeat_count = 10;
+	constexpr size_t quick_load_repeat_count = 2;
+	constexpr size_t startup_repeat_count = 5;
+
+	// Load every bundled model and motion on a pool of threadCount threads, like PMDManager's async loads
+	void LoadAll(size_t threadCount, bool useCache)
+	{
+		ThreadPool pool(threadCount);
+		std::vector<std::future<bool>> results;
+		for (auto path : GetBenchPMDPaths())
+			results.push_back(pool.Submit([path, useCache]() { PMDLoader loader; return loader.Load(path, useCache); }));
+		for (auto path : GetBenchPMXPaths())
+			results.push_back(pool.Submit([path, useCache]() { PMDLoader loader; return loader.Load(path, useCache); }));
+		for (auto path : GetBenchVMDPaths())
+			results.push_back(pool.Submit([path]() { VMDMotion motion; return motion.Load(path); }));
+		for (auto& result : results)
+			result.get();
+	}
+
+	size_t GetFileSize(const char* path)
+	{
+		FILE* fp = nullptr;
+		if (fopen_s(&fp, path, "rb") != 0 || fp == nullptr) return 0;
+		fseek(fp, 0, SEEK_END);
+		auto size = static_cast<size_t>(ftell(fp));
+		fclose(fp);
+		return size;
+	}
+
+	bool IsSameVertex(const PMDVertex& a, const PMDVertex& b)
+	{
+		return std::memcmp(&a, &b, sizeof(PMDVertex)) == 0;
+	}
+
+	PMXVertex CreatePMXVertex(std::array<uint16_t, 4> bones, std::array<uint8_t, 4> weights)
+	{
+		PMXVertex vertex = {};
+		std::copy(bones.begin(), bones.end(), vertex.boneNo);
+		std::copy(weights.begin(), weights.end(), vertex.weight);
+		return vertex;
+	}
+
+	bool IsSameSkinWeights(const PMDSkinWeights& a, const PMDSkinWeights& b)
+	{
+		return std::memcmp(&a, &b, sizeof(PMDSkinWeights)) == 0;
+	}
+
+	template<typename T>
+	void WriteValue(FILE* fp, const T& value)
+	{
+		fwrite(&value, sizeof(T), 1, fp);
+	}
+
+	// PMX 2.0 with BDEF4 vertices, 32-bit vertex indices and bones "0" ~ "3", no materials or morphs
+	bool WriteTestPMX(const char* path, const std::vector<std::array<float, 4>>& weights,
+		const std::vector<uint32_t>& indices)
+	{
+		FILE* fp = nullptr;
+		if (fopen_s(&fp, path, "wb") != 0 || fp == nullptr) return false;
+		fwrite("PMX ", 1, 4, fp);
+		WriteValue(fp, 2.0f);
+		// UTF-16, no additional UV, vertex / texture / material / bone / morph / rigid body index sizes
+		const uint8_t globals[] = { 8, 0, 0, 4, 1, 1, 2, 1, 1 };
+		fwrite(globals, 1, sizeof(globals), fp);
+		// Model names and comments
+		for (int i = 0; i < 4; ++i)
+			WriteValue(fp, int32_t(0));
+
+		WriteValue(fp, static_cast<int32_t>(weights.size()));
+		for (size_t i = 0; i < weights.size(); ++i)
+		{
+			const float vertex[] = { float(i), 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+			fwrite(vertex, sizeof(vertex), 1, fp);
+			// BDEF4
+			WriteValue(fp, uint8_t(2));
+			for (int16_t b = 0; b < 4; ++b)
+				WriteValue(fp, b);
+			fwrite(weights[i].data(), sizeof(float), 4, fp);
+			// Edge scale
+			WriteValue(fp, 1.0f);
+		}
+		WriteValue(fp, static_cast<int32_t>(indices.size()));
+		fwrite(indices.data(), sizeof(uint32_t), indices.size(), fp);
+
+		// Textures, materials
+		WriteValue(fp, int32_t(0));
+		WriteValue(fp, int32_t(0));
+		WriteValue(fp, int32_t(4));
+		for (int16_t b = 0; b < 4; ++b)
+		{
+			// Name "0" ~ "3" in UTF-16, no English name
+			WriteValue(fp, int32_t(2));
+			WriteValue(fp, static_cast<uint16_t>(u'0' + b));
+			WriteValue(fp, int32_t(0));
+			WriteValue(fp, DirectX::XMFLOAT3(0.0f, float(b), 0.0f));
+			// Parent, deform layer, flags and tail offset
+			WriteValue(fp, static_cast<int16_t>(b - 1));
+			WriteValue(fp, int32_t(0));
+			WriteValue(fp, uint16_t(0));
+			WriteValue(fp, DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+		}
+		// Morphs
+		WriteValue(fp, int32_t(0));
+
+		bool isSucceeded = ferror(fp) == 0;
+		fclose(fp);
+		return isSucceeded;
+	}
+
+	// Parse and cache load of every model of one format
+	struct FormatLoadTimes
+	{
+		double ParseNanoseconds = 0.0;
+		double CacheNanoseconds = 0.0;
+		size_t ByteCount = 0;
+		size_t VertexCount = 0;
+		size_t BoneCount = 0;
+		size_t ModelCount = 0;
+	};
+
+	FormatLoadTimes MeasureFormat(const std::vector<const char*>& paths, size_t repeatCount)
+	{
+		FormatLoadTimes times;
+		for (auto path : paths)
+		{
+			// Also writes the cache timed below
+			PMDLoader model;
+			if (!model.Load(path)) continue;
+			times.ParseNanoseconds += MeasureNanoseconds(repeatCount, [path]()
+				{
+					PMDLoader loader;
+					loader.Load(path, false);
+					DoNotOptimize(loader.Vertices.Data);
+				});
+			times.CacheNanoseconds += MeasureNanoseconds(repeatCount, [path]()
+				{
+					PMDLoader loader;
+					loader.Load(path);
+					DoNotOptimize(loader.Vertices.Data);
+				});
+			times.ByteCount += GetFileSize(path);
+			times.VertexCount += model.Vertices.size();
+			times.BoneCount += model.Bones.size();
+			++times.ModelCount;
+		}
+		return times;
+	}
+}
+
+// Mapped reader must give the same model as the fread loader it replaced
+PMD_TEST(PMDLoaderMatchesLegacyLoader)
+{
+	for (auto path : GetBenchPMDPaths())
+	{
+		LegacyPMDLoader legacy;
+		PMDLoader loader;
+		PMD_CHECK(legacy.Load(path));
+		PMD_CHECK(loader.Load(path, false));
+
+		PMD_CHECK(loader.Vertices.size() == legacy.Vertices.size());
+		PMD_CHECK(loader.Indices.size() == legacy.Indices.size());
+		PMD_CHECK(loader.Materials.size() == legacy.Materials.size());
+		PMD_CHECK(loader.Bones.size() == legacy.Bones.size());
+		if (context.HasFailed()) return;
+
+		for (size_t i = 0; i < legacy.Vertices.size(); ++i)
+			PMD_CHECK(IsSameVertex(loader.Vertices[i], legacy.Vertices[i]));
+		for (size_t i = 0; i < legacy.Indices.size(); ++i)
+			PMD_CHECK(loader.Indices[i] == legacy.Indices[i]);
+		for (size_t i = 0; i < legacy.SubMaterials.size(); ++i)
+			PMD_CHECK(loader.SubMaterials[i].indexCount == legacy.SubMaterials[i].indexCount);
+		for (size_t i = 0; i < legacy.Bones.size(); ++i)
+			PMD_CHECK(loader.Bones[i].name == legacy.Bones[i].name);
+	}
+}
+
+// Model read from .pmdc / .pmxc cache must be the model the file parses to, names included
+PMD_TEST(CachedModelMatchesParsedModel)
+{
+	auto paths = GetBenchPMDPaths();
+	paths.insert(paths.end(), GetBenchPMXPaths().begin(), GetBenchPMXPaths().end());
+	for (auto path : paths)
+	{
+		// First load writes the cache when it is missing or stale, second one reads it
+		PMDLoader parsed, cached;
+		PMD_CHECK(parsed.Load(path, false));
+		PMD_CHECK(cached.Load(path) && cached.Load(path));
+		PMD_CHECK(cached.Vertices.size() == parsed.Vertices.size());
+		PMD_CHECK(cached.Indices.size() == parsed.Indices.size());
+		PMD_CHECK(cached.Indices32.size() == parsed.Indices32.size());
+		PMD_CHECK(cached.SkinWeights.size() == parsed.SkinWeights.size());
+		PMD_CHECK(cached.Bones.size() == parsed.Bones.size());
+		PMD_CHECK(cached.Morphs.size() == parsed.Morphs.size());
+		if (context.HasFailed()) return;
+
+		for (size_t i = 0; i < parsed.Vertices.size(); ++i)
+			PMD_CHECK(IsSameVertex(cached.Vertices[i], parsed.Vertices[i]));
+		for (size_t i = 0; i < parsed.Indices.size(); ++i)
+			PMD_CHECK(cached.Indices[i] == parsed.Indices[i]);
+		for (size_t i = 0; i < parsed.Indices32.size(); ++i)
+			PMD_CHECK(cached.Indices32[i] == parsed.Indices32[i]);
+		for (size_t i = 0; i < parsed.SkinWeights.size(); ++i)
+			PMD_CHECK(IsSameSkinWeights(cached.SkinWeights[i], parsed.SkinWeights[i]));
+		for (size_t i = 0; i < parsed.Bones.size(); ++i)
+		{
+			PMD_CHECK(cached.Bones[i].name == parsed.Bones[i].name);
+			PMD_CHECK(cached.Bones[i].parentNo == parsed.Bones[i].parentNo);
+		}
+		PMD_CHECK(cached.BonesTable == parsed.BonesTable);
+		for (size_t i = 0; i < parsed.Morphs.size(); ++i)
+			PMD_CHECK(cached.Morphs[i].Name == parsed.Morphs[i].Name);
+	}
+}
+
+// PMX names have no length limit, bundled models' names all fit PMD's 20 bytes
+// -> bake a cache of a model with longer names and read it back
+PMD_TEST(CacheKeepsLongNames)
+{
+	if (GetBenchPMXPaths().empty()) return;
+	const auto path = GetBenchPMXPaths().front();
+	const std::string cachePath = std::string(path) + "c";
+	PMDLoader parsed;
+	PMD_CHECK(parsed.Load(path, false));
+	if (context.HasFailed() || parsed.Bones.empty() || parsed.Morphs.empty()) return;
+
+	const std::string boneName(40, 'b');
+	const std::string morphName(40, 'm');
+	parsed.Bones.front().name = boneName;
+	parsed.Morphs.front().Name = morphName;
+	PMD_CHECK(parsed.SaveCache(cachePath.c_str()));
+
+	PMDLoader cached;
+	PMD_CHECK(cached.Load(path));
+	PMD_CHECK(!cached.Bones.empty() && cached.Bones.front().name == boneName);
+	PMD_CHECK(cached.BonesTable.count(boneName) == 1);
+	PMD_CHECK(!cached.Morphs.empty() && cached.Morphs.front().Name == morphName);
+	// Next load parses the model again and writes a cache with its real names
+	std::remove(cachePath.c_str());
+}
+
+// Reduction keeps the two heaviest bones with a palette slot and renormalizes them
+PMD_TEST(PMXVerticesReduceToPaletteBones)
+{
+	const auto maxBone = static_cast<uint16_t>(pmd_max_bone_count);
+	auto reduced = ReducePMXVertex(CreatePMXVertex({ maxBone, 3, 7, 1 }, { 100, 80, 50, 25 }));
+	PMD_CHECK(reduced.boneNo[0] == 3 && reduced.boneNo[1] == 7);
+	PMD_CHECK(reduced.weight == 80.0f / 130.0f);
+
+	// Single bone weighs fully on both slots
+	reduced = ReducePMXVertex(CreatePMXVertex({ 5, 0, 0, 0 }, { 255, 0, 0, 0 }));
+	PMD_CHECK(reduced.boneNo[0] == 5 && reduced.boneNo[1] == 5);
+	PMD_CHECK(reduced.weight == 1.0f);
+
+	// Nothing inside the palette -> bone 0
+	reduced = ReducePMXVertex(CreatePMXVertex({ maxBone, static_cast<uint16_t>(maxBone + 1), 0, 0 }, { 200, 55, 0, 0 }));
+	PMD_CHECK(reduced.boneNo[0] == 0 && reduced.boneNo[1] == 0);
+	PMD_CHECK(reduced.weight == 1.0f);
+
+	for (auto path : GetBenchPMXPaths())
+	{
+		PMDLoader loader;
+		PMD_CHECK(loader.Load(path, false));
+		if (context.HasFailed()) return;
+		const auto boneCount = (std::min)((std::max)(loader.Bones.size(), size_t(1)), pmd_max_bone_count);
+		for (auto& vertex : loader.Vertices)
+		{
+			PMD_CHECK(vertex.boneNo[0] < boneCount && vertex.boneNo[1] < boneCount);
+			PMD_CHECK(vertex.weight >= 0.0f && vertex.weight <= 1.0f);
+		}
+	}
+}
+
+// Every bundled PMD loaded by the old fread loader, parsed by PMDLoader and read from .pmdc cache
+// Best of several runs, so files are in the OS cache and the difference is parsing cost
+PMD_BENCH(PMDLoadLegacyVsMapped)
+{
+	const size_t repeatCount = context.IsQuick() ? quick_load_repeat_count : load_repeat_count;
+	double legacyTotal = 0.0;
+	double parseTotal = 0.0;
+	double cacheTotal = 0.0;
+	size_t byteTotal = 0;
+	for (auto path : GetBenchPMDPaths())
+	{
+		// Make sure the cache exists before timing cache loads
+		{
+			PMDLoader loader;
+			if (!loader.Load(path)) continue;
+		}
+
+		legacyTotal += MeasureNanoseconds(repeatCount, [path]()
+			{
+				LegacyPMDLoader loader;
+				loader.Load(path);
+				DoNotOptimize(loader.Vertices.data());
+			});
+		parseTotal += MeasureNanoseconds(repeatCount, [path]()
+			{
+				PMDLoader loader;
+				loader.Load(path, false);
+				DoNotOptimize(loader.Vertices.Data);
+			});
+		cacheTotal += MeasureNanoseconds(repeatCount, [path]()
+			{
+				PMDLoader loader;
+				loader.Load(path);
+				DoNotOptimize(loader.Vertices.Data);
+			});
+		byteTotal += GetFileSize(path);
+	}
+
+	const double modelCount = static_cast<double>(GetBenchPMDPaths().size());
+	context.Report("legacy fread loader, ms per model", legacyTotal / modelCount * 1e-6, "ms");
+	context.Report("mapped PMDLoader, ms per model", parseTotal / modelCount * 1e-6, "ms");
+	context.Report(".pmdc cache, ms per model", cacheTotal / modelCount * 1e-6, "ms");
+	context.Report("legacy fread loader throughput", byteTotal / (legacyTotal * 1e-9) / (1024.0 * 1024.0), "MB/s");
+	context.Report("mapped PMDLoader throughput", byteTotal / (parseTotal * 1e-9) / (1024.0 * 1024.0), "MB/s");
+	context.Report("mapped PMDLoader speedup over legacy", legacyTotal / parseTotal, "x");
+}
+
+// 4 bones with a palette slot, heaviest first, UNORM16 weights adding up to one
+PMD_TEST(PMXSkinWeightsKeepFourBones)
+{
+	const auto maxBone = static_cast<uint16_t>(pmd_max_bone_count);
+	auto skinWeights = GetPMXSkinWeights(CreatePMXVertex({ 2, 3, 7, 1 }, { 25, 100, 80, 50 }));
+	PMD_CHECK(skinWeights.boneNo[0] == 3 && skinWeights.boneNo[1] == 7);
+	PMD_CHECK(skinWeights.boneNo[2] == 1 && skinWeights.boneNo[3] == 2);
+	PMD_CHECK(skinWeights.weight[0] + skinWeights.weight[1] + skinWeights.weight[2] + skinWeights.weight[3] ==
+		pmd_skin_weight_one);
+	PMD_CHECK(skinWeights.weight[3] == (25 * pmd_skin_weight_one + 127) / 255);
+
+	// Bone past the palette is dropped and the others renormalized, empty slots repeat the heaviest bone
+	skinWeights = GetPMXSkinWeights(CreatePMXVertex({ maxBone, 3, 7, 0 }, { 55, 100, 100, 0 }));
+	PMD_CHECK(skinWeights.boneNo[0] == 3 && skinWeights.boneNo[1] == 7);
+	PMD_CHECK(skinWeights.boneNo[2] == 3 && skinWeights.boneNo[3] == 3);
+	PMD_CHECK(skinWeights.weight[0] + skinWeights.weight[1] == pmd_skin_weight_one);
+	PMD_CHECK(skinWeights.weight[2] == 0 && skinWeights.weight[3] == 0);
+
+	// Nothing inside the palette -> bone 0
+	skinWeights = GetPMXSkinWeights(CreatePMXVertex({ maxBone, static_cast<uint16_t>(maxBone + 1), 0, 0 }, { 200, 55, 0, 0 }));
+	PMD_CHECK(skinWeights.boneNo[0] == 0 && skinWeights.weight[0] == pmd_skin_weight_one);
+}
+
+// Bundled PMX models have no vertex on more than 2 bones and fit 16-bit indices
+// -> write one with BDEF4 vertices past 0x10000 and check what the loader and its cache keep
+PMD_TEST(PMXKeepsFourBonesAndWideIndices)
+{
+	const char* path = "PMDBenchFourBones.pmx";
+	const std::string cachePath = std::string(path) + "c";
+	std::vector<std::array<float, 4>> weights(0x10000 + 2);
+	for (size_t i = 0; i < weights.size(); ++i)
+		weights[i] = i % 2 ? std::array<float, 4>{ 0.1f, 0.2f, 0.3f, 0.4f } : std::array<float, 4>{ 0.5f, 0.5f, 0.0f, 0.0f };
+	const std::vector<uint32_t> indices = { 0, 0x10000, 0x10001, 1, 2, 3 };
+	PMD_CHECK(WriteTestPMX(path, weights, indices));
+	if (context.HasFailed()) return;
+
+	PMDLoader parsed;
+	PMD_CHECK(parsed.Load(path, false));
+	PMD_CHECK(parsed.Indices.empty() && parsed.Indices32.size() == indices.size());
+	PMD_CHECK(parsed.SkinWeights.size() == weights.size());
+	if (!context.HasFailed())
+	{
+		PMD_CHECK(std::equal(indices.begin(), indices.end(), parsed.Indices32.begin()));
+		auto& fourBones = parsed.SkinWeights[1];
+		PMD_CHECK(fourBones.boneNo[0] == 3 && fourBones.boneNo[1] == 2 && fourBones.boneNo[2] == 1 && fourBones.boneNo[3] == 0);
+		PMD_CHECK(fourBones.weight[3] > 0 && fourBones.weight[0] > fourBones.weight[3]);
+		auto& twoBones = parsed.SkinWeights[0x10000];
+		PMD_CHECK(twoBones.weight[0] + twoBones.weight[1] == pmd_skin_weight_one && twoBones.weight[2] == 0);
+	}
+
+	// First load writes the cache, second one reads it
+	PMDLoader cached;
+	PMD_CHECK(cached.Load(path) && cached.Load(path));
+	PMD_CHECK(cached.Indices32.size() == parsed.Indices32.size());
+	PMD_CHECK(cached.SkinWeights.size() == parsed.SkinWeights.size());
+	if (!context.HasFailed())
+	{
+		PMD_CHECK(std::equal(parsed.Indices32.begin(), parsed.Indices32.end(), cached.Indices32.begin()));
+		for (size_t i = 0; i < parsed.SkinWeights.size(); ++i)
+			PMD_CHECK(IsSameSkinWeights(cached.SkinWeights[i], parsed.SkinWeights[i]));
+	}
+	std::remove(cachePath.c_str());
+	std::remove(path);
+}
+
+// Bundled PMD and PMX models parsed and read from cache, per format
+// PMX costs more per byte: variable index sizes, UTF-16 names converted to Shift-JIS, 4-bone weights
+PMD_BENCH(PMXLoadVsPMD)
+{
+	const size_t repeatCount = context.IsQuick() ? quick_load_repeat_count : load_repeat_count;
+	const std::pair<const char*, const std::vector<const char*>*> formats[] = {
+		{ "PMD", &GetBenchPMDPaths() },
+		{ "PMX", &GetBenchPMXPaths() } };
+	for (auto& format : formats)
+	{
+		auto times = MeasureFormat(*format.second, repeatCount);
+		if (times.ModelCount == 0) continue;
+		const std::string name = format.first;
+		const double modelCount = static_cast<double>(times.ModelCount);
+		context.Report(name + " models", modelCount, "");
+		context.Report(name + " vertices per model", times.VertexCount / modelCount, "");
+		context.Report(name + " bones per model", times.BoneCount / modelCount, "");
+		context.Report(name + " parse, ms per model", times.ParseNanoseconds / modelCount * 1e-6, "ms");
+		context.Report(name + " parse throughput", times.ByteCount / (times.ParseNanoseconds * 1e-9) / (1024.0 * 1024.0), "MB/s");
+		context.Report(name + " parse, vertices per second", times.VertexCount / (times.ParseNanoseconds * 1e-9), "1/s");
+		context.Report(name + " cache, ms per model", times.CacheNanoseconds / modelCount * 1e-6, "ms");
+		context.Report(name + " cache, vertices per second", times.VertexCount / (times.CacheNanoseconds * 1e-9), "1/s");
+	}
+
+	// Part of PMX parse spent in PMXLoader, and the vertices that need the 4-bone layout
+	double pmxNanoseconds = 0.0;
+	size_t modelCount = 0, vertexCount = 0, fourBoneVertexCount = 0, fourBoneModelCount = 0;
+	for (auto path : GetBenchPMXPaths())
+	{
+		PMXLoader pmx;
+		if (!pmx.Load(path)) continue;
+		pmxNanoseconds += MeasureNanoseconds(repeatCount, [path]()
+			{
+				PMXLoader loader;
+				loader.Load(path);
+				DoNotOptimize(loader.Vertices.data());
+			});
+		size_t modelFourBoneCount = 0;
+		for (auto& vertex : pmx.Vertices)
+		{
+			// Third bone of heaviest-first weights only has weight on vertices with more than 2 bones
+			if (GetPMXSkinWeights(vertex).weight[2] > 0)
+				++modelFourBoneCount;
+		}
+		fourBoneVertexCount += modelFourBoneCount;
+		fourBoneModelCount += modelFourBoneCount > 0 ? 1 : 0;
+		vertexCount += pmx.Vertices.size();
+		++modelCount;
+	}
+	if (vertexCount == 0) return;
+	context.Report("PMXLoader alone, ms per model", pmxNanoseconds / modelCount * 1e-6, "ms");
+	context.Report("PMX vertices on more than 2 bones", 100.0 * fourBoneVertexCount / vertexCount, "%");
+	context.Report("PMX models drawn with 4-bone layout", static_cast<double>(fourBoneModelCount), "");
+}
+
+// Startup load of all bundled models and motions on 1..hardware threads
+// Parse = model files parsed (first launch), cache = .pmdc/.pmxc read (later launches)
+PMD_BENCH(StartupLoadThreadScaling)
+{
+	const size_t repeatCount = context.IsQuick() ? 1 : startup_repeat_count;
+	const size_t maxThreadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+	// Write caches before timing cache loads
+	LoadAll(maxThreadCount, true);
+
+	// Powers of two then all hardware threads
+	std::vector<size_t> threadCounts;
+	for (size_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+		threadCounts.push_back(threadCount);
+	threadCounts.push_back(maxThreadCount);
+
+	double parseSingle = 0.0;
+	double cacheSingle = 0.0;
+	for (auto threadCount : threadCounts)
+	{
+		auto parse = MeasureNanoseconds(repeatCount, [threadCount]() { LoadAll(threadCount, false); });
+		auto cache = MeasureNanoseconds(repeatCount, [threadCount]() { LoadAll(threadCount, true); });
+		if (threadCount == 1)
+		{
+			parseSingle = parse;
+			cacheSingle = cache;
+		}
+		auto threads = std::to_string(threadCount) + " thread(s)";
+		context.Report("startup parse, " + threads, parse * 1e-6, "ms");
+		context.Report("startup parse speedup, " + threads, parseSingle / parse, "x");
+		context.Report("startup cache, " + threads, cache * 1e-6, "ms");
+		context.Report("startup cache speedup, " + threads, cacheSingle / cache, "x");
+	}
+}
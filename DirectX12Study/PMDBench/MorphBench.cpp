@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BenchRegistry.h"
+#include "BenchModels.h"
+#include "../PMDModel/PMDLoader.h"
+#include "../PMDModel/PMDMorpher.h"
+
+namespace
+{
+	constexpr size_t active_morph_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+	constexpr size_t morph_repeat_count = 200;
+	constexpr size_t quick_morph_repeat_count = 10;
+
+	// Bundled model with the most morphs, the bench needs up to 64 of them
+	std::unique_ptr<PMDLoader> LoadMorphModel()
+	{
+		std::unique_ptr<PMDLoader> best;
+		auto paths = GetBenchPMDPaths();
+		paths.insert(paths.end(), GetBenchPMXPaths().begin(), GetBenchPMXPaths().end());
+		for (auto path : paths)
+		{
+			auto loader = std::make_unique<PMDLoader>();
+			if (!loader->Load(path)) continue;
+			if (!best || loader->Morphs.size() > best->Morphs.size())
+				best = std::move(loader);
+		}
+		return best;
+	}
+}
+
+// Morph evaluation of one model with 1..64 morphs changing weight every update
+// A talking, blinking face moves a handful, a full expression change a few dozens
+PMD_BENCH(MorphEvaluation)
+{
+	auto pModel = LoadMorphModel();
+	if (!pModel || pModel->Morphs.empty())
+	{
+		context.Report("no bundled model has morphs", 0.0, "");
+		return;
+	}
+	context.Report("morphs of bench model", static_cast<double>(pModel->Morphs.size()), "");
+
+	const size_t repeatCount = context.IsQuick() ? quick_morph_repeat_count : morph_repeat_count;
+	for (auto activeCount : active_morph_counts)
+	{
+		if (activeCount > pModel->Morphs.size()) break;
+
+		PMDMorpher morpher;
+		auto morphs = pModel->Morphs;
+		auto morphVertices = pModel->MorphVertices;
+		morpher.Create(std::move(morphs), std::move(morphVertices), pModel->Vertices);
+
+		// Morphs spread over the model's list, weights change every update
+		const auto stride = pModel->Morphs.size() / activeCount;
+		size_t update = 0;
+		PMDMorphStats stats;
+		uint64_t dirtyVertexCount = 0;
+		auto nanoseconds = MeasureNanoseconds(repeatCount, [&]()
+			{
+				const float weight = 0.25f + 0.5f * static_cast<float>(update++ % 2);
+				for (size_t i = 0; i < activeCount; ++i)
+					morpher.SetWeight(i * stride, weight);
+				stats = PMDMorphStats();
+				morpher.Evaluate(stats);
+				uint32_t first, count;
+				if (morpher.GetDirtyRange(first, count))
+					dirtyVertexCount = count;
+				morpher.ClearDirty();
+				DoNotOptimize(morpher.Vertices());
+			});
+
+		auto name = std::to_string(activeCount) + " active morph(s)";
+		context.Report(name + ", evaluation", nanoseconds * 1e-3, "us");
+		context.Report(name + ", morph vertices", static_cast<double>(stats.MorphVertexCount), "");
+		context.Report(name + ", morph vertices per second", stats.MorphVertexCount / (nanoseconds * 1e-9), "1/s");
+		context.Report(name + ", vertices uploaded", static_cast<double>(dirtyVertexCount), "");
+	}
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "../PMDModel/PMDBonePalette.h"
+#include "../PMDModel/PMDCommon.h"
+#include "../PMDModel/PMDSkeleton.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// More bones than the palette has slots
+	constexpr size_t large_skeleton_bone_count = 600;
+	constexpr uint8_t guard_byte = 0xcd;
+	constexpr size_t guard_size = 256;
+	constexpr size_t conversion_bone_count = 64;
+	constexpr size_t conversion_point_count = 16;
+	constexpr float conversion_tolerance = 1e-4f;
+
+	const PMDBonePaletteLayout all_layouts[] = {
+		PMDBonePaletteLayout::Matrix4x4, PMDBonePaletteLayout::Affine3x4, PMDBonePaletteLayout::DualQuaternion };
+
+	// Chain of bones, each one 1 unit above its parent
+	std::vector<PMDBone> CreateChain(size_t boneCount)
+	{
+		std::vector<PMDBone> bones(boneCount);
+		for (size_t i = 0; i < boneCount; ++i)
+		{
+			bones[i].name = "bone" + std::to_string(i);
+			bones[i].parentNo = i == 0 ? PMDSkeleton::no_parent : static_cast<uint16_t>(i - 1);
+			bones[i].pos = XMFLOAT3(0.0f, static_cast<float>(i), 0.0f);
+		}
+		return bones;
+	}
+
+	// Random rotations and translations like an animated pose, stored as PMDSkeleton does
+	std::vector<XMFLOAT3X4> CreateRigidTransforms(size_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> offset(-20.0f, 20.0f);
+		std::vector<XMFLOAT3X4> transforms(count);
+		for (auto& transform : transforms)
+		{
+			auto rotation = XMQuaternionNormalize(XMVectorSet(unit(random), unit(random), unit(random), unit(random)));
+			auto matrix = XMMatrixRotationQuaternion(rotation) *
+				XMMatrixTranslation(offset(random), offset(random), offset(random));
+			XMStoreFloat3x4(&transform, matrix);
+		}
+		return transforms;
+	}
+
+	// mul(g_bones[i], pos) of VS.hlsl, "matrix" is column_major -> each float4 is a column
+	XMFLOAT3 TransformMatrix4x4(const XMFLOAT4X4& bone, const XMFLOAT3& pos)
+	{
+		XMFLOAT3 ret;
+		ret.x = bone._11 * pos.x + bone._21 * pos.y + bone._31 * pos.z + bone._41;
+		ret.y = bone._12 * pos.x + bone._22 * pos.y + bone._32 * pos.z + bone._42;
+		ret.z = bone._13 * pos.x + bone._23 * pos.y + bone._33 * pos.z + bone._43;
+		return ret;
+	}
+
+	// mul(g_bones[i], pos) of VS.hlsl, row_major float3x4 -> each float4 is a row
+	XMFLOAT3 TransformAffine3x4(const XMFLOAT3X4& bone, const XMFLOAT3& pos)
+	{
+		XMFLOAT3 ret;
+		ret.x = bone._11 * pos.x + bone._12 * pos.y + bone._13 * pos.z + bone._14;
+		ret.y = bone._21 * pos.x + bone._22 * pos.y + bone._23 * pos.z + bone._24;
+		ret.z = bone._31 * pos.x + bone._32 * pos.y + bone._33 * pos.z + bone._34;
+		return ret;
+	}
+
+	// Dual quaternion transform of VS.hlsl
+	XMFLOAT3 TransformDualQuaternion(const PMDDualQuaternion& bone, const XMFLOAT3& pos)
+	{
+		auto real = XMLoadFloat4(&bone.Real);
+		auto dual = XMLoadFloat4(&bone.Dual);
+		auto p = XMLoadFloat3(&pos);
+		auto realW = XMVectorSplatW(real);
+		auto dualW = XMVectorSplatW(dual);
+		auto rotated = p + 2.0f * XMVector3Cross(real, XMVector3Cross(real, p) + realW * p);
+		auto translation = 2.0f * (realW * dual - dualW * real + XMVector3Cross(real, dual));
+		XMFLOAT3 ret;
+		XMStoreFloat3(&ret, rotated + translation);
+		return ret;
+	}
+
+	float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMVectorGetX(XMVector3Length(XMLoadFloat3(&a) - XMLoadFloat3(&b)));
+	}
+}
+
+// Skeleton pass runs over every bone, only the palette is clamped to pmd_max_bone_count
+PMD_TEST(LargeSkeletonClampsOnlyPalette)
+{
+	PMD_CHECK(GetPaletteBoneCount(100) == 100);
+	PMD_CHECK(GetPaletteBoneCount(pmd_max_bone_count) == pmd_max_bone_count);
+	PMD_CHECK(GetPaletteBoneCount(large_skeleton_bone_count) == pmd_max_bone_count);
+
+	auto bones = CreateChain(large_skeleton_bone_count);
+	PMDSkeleton skeleton;
+	skeleton.Create(bones);
+	PMD_CHECK(skeleton.BoneCount() == large_skeleton_bone_count);
+
+	// Local transforms move each bone 1 unit up from its parent
+	std::vector<XMFLOAT3X4> transforms(skeleton.BoneCount());
+	for (auto& transform : transforms)
+		XMStoreFloat3x4(&transform, XMMatrixTranslation(0.0f, 1.0f, 0.0f));
+	skeleton.CalculateWorldTransforms(transforms.data());
+	PMD_CHECK(std::abs(transforms.back()._24 - static_cast<float>(large_skeleton_bone_count)) < 1e-3f);
+
+	const auto paletteCount = GetPaletteBoneCount(skeleton.BoneCount());
+	for (auto layout : all_layouts)
+	{
+		const auto stride = GetBoneStride(layout);
+		std::vector<uint8_t> palette(paletteCount * stride + guard_size, guard_byte);
+		WriteBonePalette(layout, transforms.data(), paletteCount, palette.data());
+		auto guardBegin = palette.begin() + paletteCount * stride;
+		PMD_CHECK(std::all_of(guardBegin, palette.end(), [](uint8_t byte) { return byte == guard_byte; }));
+	}
+}
+
+// Every layout read the way VS.hlsl reads it must move points like the source transforms
+PMD_TEST(PaletteLayoutsTransformLikeSource)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+	auto transforms = CreateRigidTransforms(conversion_bone_count, random);
+
+	std::vector<XMFLOAT4X4> matrices(conversion_bone_count);
+	std::vector<XMFLOAT3X4> affines(conversion_bone_count);
+	std::vector<PMDDualQuaternion> dualQuaternions(conversion_bone_count);
+	WriteBonePalette(PMDBonePaletteLayout::Matrix4x4, transforms.data(), conversion_bone_count, matrices.data());
+	WriteBonePalette(PMDBonePaletteLayout::Affine3x4, transforms.data(), conversion_bone_count, affines.data());
+	WriteBonePalette(PMDBonePaletteLayout::DualQuaternion, transforms.data(), conversion_bone_count, dualQuaternions.data());
+
+	for (size_t i = 0; i < conversion_bone_count; ++i)
+	{
+		// 3x4 palette is the transforms as they are
+		PMD_CHECK(std::memcmp(&affines[i], &transforms[i], sizeof(XMFLOAT3X4)) == 0);
+		// Real part is a unit rotation
+		auto realLength = XMVectorGetX(XMVector4Length(XMLoadFloat4(&dualQuaternions[i].Real)));
+		PMD_CHECK(std::abs(realLength - 1.0f) < conversion_tolerance);
+
+		auto source = XMLoadFloat3x4(&transforms[i]);
+		for (size_t j = 0; j < conversion_point_count; ++j)
+		{
+			XMFLOAT3 pos(coordinate(random), coordinate(random), coordinate(random));
+			XMFLOAT3 expected;
+			XMStoreFloat3(&expected, XMVector3Transform(XMLoadFloat3(&pos), source));
+			PMD_CHECK(Distance(TransformMatrix4x4(matrices[i], pos), expected) < conversion_tolerance);
+			PMD_CHECK(Distance(TransformAffine3x4(affines[i], pos), expected) < conversion_tolerance);
+			PMD_CHECK(Distance(TransformDualQuaternion(dualQuaternions[i], pos), expected) < conversion_tolerance);
+		}
+	}
+}
+
+// q and -q are the same rotation, the dual part has to follow the sign of the real part
+PMD_TEST(DualQuaternionKeepsTranslationForEitherSign)
+{
+	XMFLOAT3X4 transform;
+	// 180 degree turn, the quaternion with w == 0 has no preferred sign
+	XMStoreFloat3x4(&transform, XMMatrixRotationY(XM_PI) * XMMatrixTranslation(1.0f, 2.0f, 3.0f));
+	PMDDualQuaternion dualQuaternion;
+	ToDualQuaternions(&transform, 1, &dualQuaternion);
+
+	PMDDualQuaternion negated;
+	XMStoreFloat4(&negated.Real, -XMLoadFloat4(&dualQuaternion.Real));
+	XMStoreFloat4(&negated.Dual, -XMLoadFloat4(&dualQuaternion.Dual));
+
+	XMFLOAT3 pos(1.0f, 0.0f, 0.0f);
+	XMFLOAT3 expected(0.0f, 2.0f, 3.0f);
+	PMD_CHECK(Distance(TransformDualQuaternion(dualQuaternion, pos), expected) < conversion_tolerance);
+	PMD_CHECK(Distance(TransformDualQuaternion(negated, pos), expected) < conversion_tolerance);
+}
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <random>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "../PMDModel/PMDPose.h"
+#include "../Utility/ScratchArena.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t pose_bone_count = 37;
+	constexpr float pose_tolerance = 1e-4f;
+
+	// Random rotations and locations, every skipEvery-th bone is left out of the pose
+	void RandomPose(PMDLocalPose& pose, std::mt19937& random, size_t skipEvery)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		pose.SetIdentity(0.0f);
+		for (size_t i = 0; i < pose.BoneCount; ++i)
+		{
+			XMFLOAT4 q(unit(random), unit(random), unit(random), unit(random));
+			XMStoreFloat4(&q, XMQuaternionNormalize(XMLoadFloat4(&q)));
+			const float location[] = { unit(random), unit(random), unit(random) };
+			pose.Set(i, &q.x, location);
+			pose.Weight[i] = i % skipEvery == 0 ? 0.0f : 1.0f;
+		}
+	}
+
+	void CopyPose(const PMDLocalPose& source, PMDLocalPose& destination)
+	{
+		for (size_t i = 0; i < source.BoneCount; ++i)
+		{
+			const float rotation[] = { source.Qx[i], source.Qy[i], source.Qz[i], source.Qw[i] };
+			const float location[] = { source.Tx[i], source.Ty[i], source.Tz[i] };
+			destination.Set(i, rotation, location);
+			destination.Weight[i] = source.Weight[i];
+		}
+	}
+
+	// Same rotation (either sign) and location
+	bool IsSameBone(const PMDLocalPose& a, const PMDLocalPose& b, size_t i)
+	{
+		const auto dot = a.Qx[i] * b.Qx[i] + a.Qy[i] * b.Qy[i] + a.Qz[i] * b.Qz[i] + a.Qw[i] * b.Qw[i];
+		return std::abs(std::abs(dot) - 1.0f) < pose_tolerance &&
+			std::abs(a.Tx[i] - b.Tx[i]) < pose_tolerance &&
+			std::abs(a.Ty[i] - b.Ty[i]) < pose_tolerance &&
+			std::abs(a.Tz[i] - b.Tz[i]) < pose_tolerance;
+	}
+}
+
+// Frozen layer pose (AccumulatePose) must blend like the two motions it was made from
+// That is what keeps an interrupted crossfade from popping
+PMD_TEST(AccumulatedPoseBlendsLikeItsSources)
+{
+	ScratchArena arena(8 * PMDLocalPose::RequiredBytes(pose_bone_count));
+	PMDLocalPose below, previous, current, frozen, expected, actual, scratch;
+	for (auto pPose : { &below, &previous, &current, &frozen, &expected, &actual, &scratch })
+		PMD_CHECK(pPose->Allocate(arena, pose_bone_count));
+	if (context.HasFailed()) return;
+
+	std::mt19937 random(14);
+	for (auto fade : { 0.0f, 0.3f, 0.75f, 1.0f })
+	{
+		// Bones driven by both motions, by one of them and by neither
+		RandomPose(below, random, pose_bone_count + 1);
+		RandomPose(previous, random, 2);
+		RandomPose(current, random, 3);
+
+		// Crossfade as EvaluateBlendedPose does it
+		CopyPose(below, expected);
+		BlendPose(expected, previous, 1.0f, PMDLayerBlendMode::Override);
+		BlendPose(expected, current, fade, PMDLayerBlendMode::Override);
+
+		// Both motions merged first, then blended once
+		frozen.SetIdentity(0.0f);
+		CopyPose(previous, scratch);
+		AccumulatePose(frozen, scratch, 1.0f, PMDLayerBlendMode::Override);
+		CopyPose(current, scratch);
+		AccumulatePose(frozen, scratch, fade, PMDLayerBlendMode::Override);
+		CopyPose(below, actual);
+		BlendPose(actual, frozen, 1.0f, PMDLayerBlendMode::Override);
+
+		for (size_t i = 0; i < pose_bone_count; ++i)
+			PMD_CHECK(IsSameBone(expected, actual, i));
+	}
+}
@@ -0,0 +1,157 @@
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "../PMDModel/VMD/VMDSampler.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t sample_bone_counts[] = { 16, 128, 1024 };
+	constexpr size_t sample_repeat_count = 200;
+	// Largest difference from XMQuaternionSlerp / XMVectorLerp per component
+	constexpr float max_sample_error = 1e-5f;
+
+	struct BonePair
+	{
+		float From[4], To[4];
+		float FromLocation[3], ToLocation[3];
+		float Weights[4];
+	};
+
+	void RandomQuaternion(std::mt19937& random, float out[4])
+	{
+		std::normal_distribution<float> normal;
+		XMFLOAT4 q(normal(random), normal(random), normal(random), normal(random));
+		XMStoreFloat4(&q, XMQuaternionNormalize(XMLoadFloat4(&q)));
+		out[0] = q.x; out[1] = q.y; out[2] = q.z; out[3] = q.w;
+	}
+
+	// Random keyframe pairs, a quarter of them nearly the same rotation
+	// and a quarter in opposite hemispheres (slerp must take the short arc)
+	std::vector<BonePair> CreateBonePairs(size_t count)
+	{
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<BonePair> pairs(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& pair = pairs[i];
+			RandomQuaternion(random, pair.From);
+			RandomQuaternion(random, pair.To);
+			if (i % 4 == 1)
+			{
+				for (size_t c = 0; c < 4; ++c) pair.To[c] = pair.From[c] + 1e-6f * unit(random);
+			}
+			else if (i % 4 == 2 && pair.From[3] * pair.To[3] > 0.0f)
+			{
+				for (size_t c = 0; c < 4; ++c) pair.To[c] = -pair.To[c];
+			}
+			for (size_t c = 0; c < 3; ++c)
+			{
+				pair.FromLocation[c] = unit(random) * 10.0f - 5.0f;
+				pair.ToLocation[c] = unit(random) * 10.0f - 5.0f;
+			}
+			for (size_t c = 0; c < 4; ++c)
+				pair.Weights[c] = unit(random);
+		}
+		return pairs;
+	}
+
+	void FillBatch(VMDSampleBatch& batch, const std::vector<BonePair>& pairs)
+	{
+		batch.Reset(pairs.size());
+		for (auto& pair : pairs)
+			batch.Push(pair.From, pair.To, pair.FromLocation, pair.ToLocation, pair.Weights);
+	}
+
+	void SamplePerBone(const std::vector<BonePair>& pairs, std::vector<XMFLOAT4>& rotations, std::vector<XMFLOAT3>& locations)
+	{
+		for (size_t i = 0; i < pairs.size(); ++i)
+		{
+			auto& pair = pairs[i];
+			auto rotation = XMQuaternionSlerp(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pair.From)),
+				XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pair.To)), pair.Weights[3]);
+			XMStoreFloat4(&rotations[i], rotation);
+			auto from = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pair.FromLocation));
+			auto to = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pair.ToLocation));
+			auto weights = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pair.Weights));
+			XMStoreFloat3(&locations[i], XMVectorLerpV(from, to, weights));
+		}
+	}
+}
+
+// 4-wide SoA slerp must match XMQuaternionSlerp and XMVectorLerp bone by bone
+PMD_TEST(SampleBatchMatchesPerBoneSlerp)
+{
+	auto pairs = CreateBonePairs(1023);
+	VMDSampleBatch batch;
+	FillBatch(batch, pairs);
+	batch.Sample();
+
+	std::vector<XMFLOAT4> rotations(pairs.size());
+	std::vector<XMFLOAT3> locations(pairs.size());
+	SamplePerBone(pairs, rotations, locations);
+
+	for (size_t i = 0; i < pairs.size(); ++i)
+	{
+		float rotation[4], location[3];
+		batch.GetRotation(i, rotation);
+		batch.GetLocation(i, location);
+		const float expected[4] = { rotations[i].x, rotations[i].y, rotations[i].z, rotations[i].w };
+		const float expectedLocation[3] = { locations[i].x, locations[i].y, locations[i].z };
+		for (size_t c = 0; c < 4; ++c)
+			PMD_CHECK(std::abs(rotation[c] - expected[c]) < max_sample_error);
+		for (size_t c = 0; c < 3; ++c)
+			PMD_CHECK(std::abs(location[c] - expectedLocation[c]) < max_sample_error);
+		if (context.HasFailed()) return;
+	}
+}
+
+// ns per bone of SoA batch (Push + Sample + Get) and of one XMQuaternionSlerp per bone
+PMD_BENCH(SampleBatchVsPerBoneSlerp)
+{
+	const size_t repeatCount = context.IsQuick() ? 10 : sample_repeat_count;
+	for (auto boneCount : sample_bone_counts)
+	{
+		auto pairs = CreateBonePairs(boneCount);
+		VMDSampleBatch batch;
+		std::vector<XMFLOAT4> rotations(boneCount);
+		std::vector<XMFLOAT3> locations(boneCount);
+
+		auto batchTime = MeasureNanoseconds(repeatCount, [&]()
+			{
+				FillBatch(batch, pairs);
+				batch.Sample();
+				float rotation[4], location[3];
+				for (size_t i = 0; i < boneCount; ++i)
+				{
+					batch.GetRotation(i, rotation);
+					batch.GetLocation(i, location);
+					rotations[i] = XMFLOAT4(rotation);
+					locations[i] = XMFLOAT3(location[0], location[1], location[2]);
+				}
+				DoNotOptimize(rotations.data());
+			});
+		FillBatch(batch, pairs);
+		auto sampleTime = MeasureNanoseconds(repeatCount, [&]()
+			{
+				batch.Sample();
+				DoNotOptimize(&batch);
+			});
+		auto perBoneTime = MeasureNanoseconds(repeatCount, [&]()
+			{
+				SamplePerBone(pairs, rotations, locations);
+				DoNotOptimize(rotations.data());
+			});
+
+		auto bones = std::to_string(boneCount) + " bones";
+		context.Report("SoA batch push+sample+get, " + bones, batchTime / boneCount, "ns/bone");
+		context.Report("SoA batch sample only, " + bones, sampleTime / boneCount, "ns/bone");
+		context.Report("XMQuaternionSlerp per bone, " + bones, perBoneTime / boneCount, "ns/bone");
+	}
+}
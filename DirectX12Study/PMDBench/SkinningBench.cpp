@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "BenchScene.h"
+#include "../PMDModel/PMDBonePalette.h"
+#include "../PMDModel/PMDSkinning.h"
+#include "../Utility/Jobs/JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t skinning_test_bone_count = 40;
+	// Odd count -> AVX kernel leaves one vertex to SSE
+	constexpr size_t skinning_test_vertex_count = 1001;
+	constexpr float skinning_tolerance = 1e-4f;
+	// Half a UNORM16 step of weight over bones about 20 units apart
+	constexpr float skinning_weight_tolerance = 1e-3f;
+	constexpr size_t skinning_repeat_count = 50;
+	constexpr size_t quick_skinning_repeat_count = 5;
+	// Points around a joint twisted between its two bones
+	constexpr size_t twist_ring_point_count = 32;
+	const float twist_angles[] = { 45.0f, 90.0f, 135.0f, 170.0f };
+
+	const PMDSkinningKernel all_kernels[] = { PMDSkinningKernel::SSE, PMDSkinningKernel::AVX };
+	const PMDSkinningStore all_stores[] = { PMDSkinningStore::Cached, PMDSkinningStore::Streaming };
+
+	// Output of streaming stores, 32-byte aligned for the AVX kernel
+	class SkinnedVertexBuffer
+	{
+	public:
+		explicit SkinnedVertexBuffer(size_t count) : m_storage(count + 1), m_count(count) {}
+		PMDSkinnedVertex* Data()
+		{
+			auto address = (reinterpret_cast<uintptr_t>(m_storage.data()) + 31) & ~uintptr_t(31);
+			return reinterpret_cast<PMDSkinnedVertex*>(address);
+		}
+		size_t Size() const { return m_count; }
+	private:
+		std::vector<PMDSkinnedVertex> m_storage;
+		size_t m_count;
+	};
+
+	float Distance(const XMFLOAT4& a, const XMFLOAT4& b)
+	{
+		return XMVectorGetX(XMVector4Length(XMLoadFloat4(&a) - XMLoadFloat4(&b)));
+	}
+
+	float Length3(const XMFLOAT4& v)
+	{
+		return XMVectorGetX(XMVector3Length(XMLoadFloat4(&v)));
+	}
+
+	const char* GetKernelName(PMDSkinningKernel kernel)
+	{
+		return kernel == PMDSkinningKernel::AVX ? "AVX" : "SSE";
+	}
+
+	const char* GetStoreName(PMDSkinningStore store)
+	{
+		return store == PMDSkinningStore::Streaming ? "streaming" : "cached";
+	}
+
+	// Random rotations and translations of skinning_test_bone_count bones
+	std::vector<XMFLOAT3X4> CreateTestTransforms(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<XMFLOAT3X4> transforms(skinning_test_bone_count);
+		for (auto& transform : transforms)
+		{
+			auto rotation = XMQuaternionNormalize(XMVectorSet(unit(random), unit(random), unit(random), unit(random)));
+			XMStoreFloat3x4(&transform, XMMatrixRotationQuaternion(rotation) *
+				XMMatrixTranslation(10.0f * unit(random), 10.0f * unit(random), 10.0f * unit(random)));
+		}
+		return transforms;
+	}
+
+	// A few bone numbers past the palette, those are skinned with identity
+	uint16_t CreateTestBoneNo(std::mt19937& random)
+	{
+		std::uniform_int_distribution<int> boneNo(0, skinning_test_bone_count + 3);
+		return static_cast<uint16_t>(boneNo(random));
+	}
+
+	std::vector<PMDVertex> CreateTestVertices(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> weight(0.0f, 1.0f);
+		std::vector<PMDVertex> vertices(skinning_test_vertex_count);
+		for (auto& vertex : vertices)
+		{
+			vertex.pos = XMFLOAT3(10.0f * unit(random), 10.0f * unit(random), 10.0f * unit(random));
+			vertex.normal = XMFLOAT3(unit(random), unit(random), unit(random));
+			vertex.uv = XMFLOAT2(unit(random), unit(random));
+			vertex.boneNo[0] = CreateTestBoneNo(random);
+			vertex.boneNo[1] = CreateTestBoneNo(random);
+			vertex.weight = weight(random);
+		}
+		return vertices;
+	}
+
+	// 2-bone vertex's bones in the 4-bone layout, like PMDManager uploads them next to PMX models
+	PMDSkinWeights ToSkinWeights(const PMDVertex& vertex)
+	{
+		PMDSkinWeights skinWeights = {};
+		const auto weight = static_cast<uint16_t>(vertex.weight * pmd_skin_weight_one + 0.5f);
+		skinWeights.boneNo[0] = vertex.boneNo[0];
+		skinWeights.boneNo[1] = vertex.boneNo[1];
+		skinWeights.weight[0] = weight;
+		skinWeights.weight[1] = pmd_skin_weight_one - weight;
+		return skinWeights;
+	}
+}
+
+// Both SIMD kernels must blend like the scalar reference, bones out of palette included
+PMD_TEST(SkinningKernelsMatchReference)
+{
+	std::mt19937 random(17);
+	const auto transforms = CreateTestTransforms(random);
+	const auto vertices = CreateTestVertices(random);
+
+	std::vector<PMDSkinnedVertex> expected(vertices.size());
+	SkinVerticesReference(vertices.data(), vertices.size(), transforms.data(), transforms.size(), expected.data());
+	PMDSkinningPalette palette;
+	palette.Create(transforms.data(), transforms.size());
+	PMD_CHECK(palette.BoneCount() == transforms.size());
+
+	JobSystem jobSystem(2);
+	SkinnedVertexBuffer actual(vertices.size());
+	for (auto kernel : all_kernels)
+	{
+		for (auto store : all_stores)
+		{
+			for (size_t pass = 0; pass < 2; ++pass)
+			{
+				std::fill(actual.Data(), actual.Data() + actual.Size(), PMDSkinnedVertex());
+				if (pass == 0)
+					SkinVertices(vertices.data(), vertices.size(), palette, actual.Data(), store, kernel);
+				else
+					SkinVertices(jobSystem, vertices.data(), vertices.size(), palette, actual.Data(), store, kernel);
+				for (size_t i = 0; i < vertices.size(); ++i)
+				{
+					PMD_CHECK(Distance(actual.Data()[i].Position, expected[i].Position) < skinning_tolerance);
+					PMD_CHECK(Distance(actual.Data()[i].Normal, expected[i].Normal) < skinning_tolerance);
+				}
+			}
+		}
+	}
+}
+
+// 4-bone kernels against the 4-bone reference, which must agree with the 2-bone one on 2-bone vertices
+PMD_TEST(FourBoneSkinningMatchesReference)
+{
+	std::mt19937 random(23);
+	const auto transforms = CreateTestTransforms(random);
+	const auto vertices = CreateTestVertices(random);
+	// Weights cut 0~65535 in 4, some of them 0
+	std::uniform_int_distribution<int> cut(0, pmd_skin_weight_one);
+	std::vector<PMDSkinWeights> skinWeights(vertices.size());
+	for (auto& weights : skinWeights)
+	{
+		int cuts[] = { cut(random), cut(random), cut(random) };
+		std::sort(std::begin(cuts), std::end(cuts));
+		if (cuts[0] < 10000) cuts[0] = 0;
+		weights.weight[0] = static_cast<uint16_t>(cuts[0]);
+		weights.weight[1] = static_cast<uint16_t>(cuts[1] - cuts[0]);
+		weights.weight[2] = static_cast<uint16_t>(cuts[2] - cuts[1]);
+		weights.weight[3] = static_cast<uint16_t>(pmd_skin_weight_one - cuts[2]);
+		for (auto& bone : weights.boneNo)
+			bone = CreateTestBoneNo(random);
+	}
+
+	std::vector<PMDSkinnedVertex> expected(vertices.size());
+	SkinVerticesReference(vertices.data(), skinWeights.data(), vertices.size(), transforms.data(), transforms.size(),
+		expected.data());
+	PMDSkinningPalette palette;
+	palette.Create(transforms.data(), transforms.size());
+
+	JobSystem jobSystem(2);
+	SkinnedVertexBuffer actual(vertices.size());
+	for (auto kernel : all_kernels)
+	{
+		for (auto store : all_stores)
+		{
+			for (size_t pass = 0; pass < 2; ++pass)
+			{
+				std::fill(actual.Data(), actual.Data() + actual.Size(), PMDSkinnedVertex());
+				if (pass == 0)
+					SkinVertices(vertices.data(), skinWeights.data(), vertices.size(), palette, actual.Data(), store, kernel);
+				else
+					SkinVertices(jobSystem, vertices.data(), skinWeights.data(), vertices.size(), palette, actual.Data(),
+						store, kernel);
+				for (size_t i = 0; i < vertices.size(); ++i)
+				{
+					PMD_CHECK(Distance(actual.Data()[i].Position, expected[i].Position) < skinning_tolerance);
+					PMD_CHECK(Distance(actual.Data()[i].Normal, expected[i].Normal) < skinning_tolerance);
+				}
+			}
+		}
+	}
+
+	// Same vertices on their 2 bones, UNORM16 weights only round the blend
+	std::vector<PMDSkinWeights> twoBoneWeights(vertices.size());
+	std::transform(vertices.begin(), vertices.end(), twoBoneWeights.begin(), ToSkinWeights);
+	std::vector<PMDDualQuaternion> dualQuaternions(transforms.size());
+	ToDualQuaternions(transforms.data(), transforms.size(), dualQuaternions.data());
+	std::vector<PMDSkinnedVertex> twoBones(vertices.size());
+	std::vector<PMDSkinnedVertex> fourBones(vertices.size());
+	for (size_t pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 0)
+		{
+			SkinVerticesReference(vertices.data(), vertices.size(), transforms.data(), transforms.size(), twoBones.data());
+			SkinVerticesReference(vertices.data(), twoBoneWeights.data(), vertices.size(), transforms.data(),
+				transforms.size(), fourBones.data());
+		}
+		else
+		{
+			SkinVerticesDualQuaternionReference(vertices.data(), vertices.size(), dualQuaternions.data(),
+				dualQuaternions.size(), twoBones.data());
+			SkinVerticesDualQuaternionReference(vertices.data(), twoBoneWeights.data(), vertices.size(),
+				dualQuaternions.data(), dualQuaternions.size(), fourBones.data());
+		}
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			PMD_CHECK(Distance(fourBones[i].Position, twoBones[i].Position) < skinning_weight_tolerance);
+			PMD_CHECK(Distance(fourBones[i].Normal, twoBones[i].Normal) < skinning_weight_tolerance);
+		}
+	}
+}
+
+// Skinned vertices per second of the bench model in one pose, per kernel and store
+// Palette build is once per model and update, reported on its own
+PMD_BENCH(SkinningThroughput)
+{
+	BenchScene scene;
+	if (!scene.Create())
+	{
+		context.Report("bench model or motion missing", 0.0, "");
+		return;
+	}
+
+	const size_t repeatCount = context.IsQuick() ? quick_skinning_repeat_count : skinning_repeat_count;
+	const auto& vertices = scene.Model.Vertices;
+	VMDSampleBatch batch;
+	std::vector<uint16_t> sampledBones;
+	std::vector<XMFLOAT3X4> transforms(scene.Skeleton.BoneCount());
+	scene.EvaluateLocalPose(30.0f, batch, sampledBones, transforms.data());
+	scene.Skeleton.CalculateWorldTransforms(transforms.data());
+
+	context.Report("vertices", static_cast<double>(vertices.size()), "");
+	context.Report("AVX supported", IsAVXSupported() ? 1.0 : 0.0, "");
+
+	PMDSkinningPalette palette;
+	auto paletteNanoseconds = MeasureNanoseconds(repeatCount, [&]()
+		{
+			palette.Create(transforms.data(), transforms.size());
+			DoNotOptimize(&palette.GetBone(0));
+		});
+	context.Report("palette build", paletteNanoseconds * 1e-3, "us");
+
+	SkinnedVertexBuffer output(vertices.size());
+	auto report = [&](const std::string& name, double nanoseconds)
+	{
+		DoNotOptimize(output.Data());
+		context.Report(name + ", skinning", nanoseconds * 1e-3, "us");
+		context.Report(name + ", vertices per second", vertices.size() / (nanoseconds * 1e-9), "1/s");
+	};
+
+	report("scalar reference", MeasureNanoseconds(repeatCount, [&]()
+		{
+			SkinVerticesReference(vertices.Data, vertices.size(), transforms.data(), transforms.size(), output.Data());
+		}));
+
+	JobSystem jobSystem;
+	for (auto kernel : all_kernels)
+	{
+		for (auto store : all_stores)
+		{
+			const auto name = std::string(GetKernelName(kernel)) + " " + GetStoreName(store);
+			report(name, MeasureNanoseconds(repeatCount, [&]()
+				{
+					SkinVertices(vertices.Data, vertices.size(), palette, output.Data(), store, kernel);
+				}));
+			report(name + " on job system", MeasureNanoseconds(repeatCount, [&]()
+				{
+					SkinVertices(jobSystem, vertices.Data, vertices.size(), palette, output.Data(), store, kernel);
+				}));
+		}
+	}
+
+	// Same vertices in the 4-bone layout PMX models switch the mesh to
+	std::vector<PMDSkinWeights> skinWeights(vertices.size());
+	std::transform(vertices.begin(), vertices.end(), skinWeights.begin(), ToSkinWeights);
+	for (auto kernel : all_kernels)
+	{
+		report(std::string(GetKernelName(kernel)) + " cached, 4 bones", MeasureNanoseconds(repeatCount, [&]()
+			{
+				SkinVertices(vertices.Data, skinWeights.data(), vertices.size(), palette, output.Data(),
+					PMDSkinningStore::Cached, kernel);
+			}));
+	}
+}
+
+// Half-half weighted vertices of a twisted joint: linear blend pulls them to the axis
+// (candy-wrapper), dual quaternion blend keeps them on their ring
+PMD_TEST(DualQuaternionKeepsTwistedJointVolume)
+{
+	std::vector<PMDVertex> ring(twist_ring_point_count);
+	for (size_t i = 0; i < ring.size(); ++i)
+	{
+		const float angle = XM_2PI * i / ring.size();
+		auto& vertex = ring[i];
+		vertex.pos = XMFLOAT3(0.0f, std::cos(angle), std::sin(angle));
+		vertex.normal = vertex.pos;
+		vertex.uv = XMFLOAT2(0.0f, 0.0f);
+		vertex.boneNo[0] = 0;
+		vertex.boneNo[1] = 1;
+		vertex.weight = 0.5f;
+	}
+
+	std::vector<PMDSkinnedVertex> linear(ring.size());
+	std::vector<PMDSkinnedVertex> dualQuaternion(ring.size());
+	for (auto degrees : twist_angles)
+	{
+		// Bone 0 at rest, bone 1 twisted around the X axis
+		XMFLOAT3X4 transforms[2];
+		XMStoreFloat3x4(&transforms[0], XMMatrixIdentity());
+		XMStoreFloat3x4(&transforms[1], XMMatrixRotationX(XMConvertToRadians(degrees)));
+		PMDDualQuaternion dualQuaternions[2];
+		ToDualQuaternions(transforms, 2, dualQuaternions);
+
+		SkinVerticesReference(ring.data(), ring.size(), transforms, 2, linear.data());
+		SkinVerticesDualQuaternionReference(ring.data(), ring.size(), dualQuaternions, 2, dualQuaternion.data());
+		const float linearRadius = std::cos(XMConvertToRadians(degrees) * 0.5f);
+		for (size_t i = 0; i < ring.size(); ++i)
+		{
+			PMD_CHECK(std::abs(Length3(dualQuaternion[i].Position) - 1.0f) < skinning_tolerance);
+			PMD_CHECK(std::abs(Length3(dualQuaternion[i].Normal) - 1.0f) < skinning_tolerance);
+			PMD_CHECK(std::abs(Length3(linear[i].Position) - linearRadius) < skinning_tolerance);
+		}
+	}
+}
+
+// How far linear blend is from dual quaternion blend on the bench model in motion
+// Normal scale is skinned normal length over rest normal length, rigid skinning keeps 1
+PMD_BENCH(LinearVsDualQuaternionSkinning)
+{
+	BenchScene scene;
+	if (!scene.Create())
+	{
+		context.Report("bench model or motion missing", 0.0, "");
+		return;
+	}
+
+	const auto& vertices = scene.Model.Vertices;
+	VMDSampleBatch batch;
+	std::vector<uint16_t> sampledBones;
+	std::vector<XMFLOAT3X4> transforms(scene.Skeleton.BoneCount());
+	std::vector<PMDDualQuaternion> dualQuaternions(transforms.size());
+	std::vector<PMDSkinnedVertex> linear(vertices.size());
+	std::vector<PMDSkinnedVertex> dualQuaternion(vertices.size());
+
+	// Poses spread over the motion
+	double distanceSum = 0.0;
+	float maxDistance = 0.0f;
+	double linearScaleSum = 0.0, dualQuaternionScaleSum = 0.0;
+	float minLinearScale = 1.0f, minDualQuaternionScale = 1.0f;
+	size_t normalCount = 0;
+	const size_t poseCount = context.IsQuick() ? 2 : 16;
+	for (size_t pose = 0; pose < poseCount; ++pose)
+	{
+		scene.EvaluateLocalPose(pose * 20.0f, batch, sampledBones, transforms.data());
+		scene.Skeleton.CalculateWorldTransforms(transforms.data());
+		ToDualQuaternions(transforms.data(), transforms.size(), dualQuaternions.data());
+		SkinVerticesReference(vertices.Data, vertices.size(), transforms.data(), transforms.size(), linear.data());
+		SkinVerticesDualQuaternionReference(vertices.Data, vertices.size(), dualQuaternions.data(),
+			dualQuaternions.size(), dualQuaternion.data());
+
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			const auto distance = Distance(linear[i].Position, dualQuaternion[i].Position);
+			distanceSum += distance;
+			maxDistance = (std::max)(maxDistance, distance);
+
+			const auto restLength = XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertices[i].normal)));
+			if (restLength <= 0.0f) continue;
+			const auto linearScale = Length3(linear[i].Normal) / restLength;
+			const auto dualQuaternionScale = Length3(dualQuaternion[i].Normal) / restLength;
+			linearScaleSum += linearScale;
+			dualQuaternionScaleSum += dualQuaternionScale;
+			minLinearScale = (std::min)(minLinearScale, linearScale);
+			minDualQuaternionScale = (std::min)(minDualQuaternionScale, dualQuaternionScale);
+			++normalCount;
+		}
+	}
+
+	const auto sampleCount = static_cast<double>(poseCount * vertices.size());
+	context.Report("poses", static_cast<double>(poseCount), "");
+	context.Report("position difference, mean", distanceSum / sampleCount, "");
+	context.Report("position difference, max", maxDistance, "");
+	context.Report("linear blend normal scale, mean", linearScaleSum / normalCount, "");
+	context.Report("linear blend normal scale, min", minLinearScale, "");
+	context.Report("dual quaternion normal scale, mean", dualQuaternionScaleSum / normalCount, "");
+	context.Report("dual quaternion normal scale, min", minDualQuaternionScale, "");
+
+	// Scalar cost of each blend, as a hint of the extra ALU the DQ vertex shader does
+	const size_t repeatCount = context.IsQuick() ? quick_skinning_repeat_count : skinning_repeat_count;
+	auto linearNanoseconds = MeasureNanoseconds(repeatCount, [&]()
+		{
+			SkinVerticesReference(vertices.Data, vertices.size(), transforms.data(), transforms.size(), linear.data());
+			DoNotOptimize(linear.data());
+		});
+	auto dualQuaternionNanoseconds = MeasureNanoseconds(repeatCount, [&]()
+		{
+			SkinVerticesDualQuaternionReference(vertices.Data, vertices.size(), dualQuaternions.data(),
+				dualQuaternions.size(), dualQuaternion.data());
+			DoNotOptimize(dualQuaternion.data());
+		});
+	context.Report("linear blend, ns per vertex", linearNanoseconds / vertices.size(), "ns");
+	context.Report("dual quaternion blend, ns per vertex", dualQuaternionNanoseconds / vertices.size(), "ns");
+}
@@ -0,0 +1,96 @@
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "BenchRegistry.h"
+#include "../PMDModel/PMDCommon.h"
+#include "../PMDModel/PMDSkeleton.h"
+#include "../PMDModel/PMDSpringBones.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// "Hair" in Shift-JIS
+	const char* const hair_name = "\x94\xaf";
+	// "Vu" then half-width "tsu", its bytes contain hair_name across the two characters
+	const char* const false_hair_name = "\x83\x94\xaf";
+	constexpr float spring_tolerance = 1e-4f;
+
+	// Root with two chains of 3 bones hanging from it, bone names are chain's name and index
+	struct SpringModel
+	{
+		std::vector<PMDBone> Bones;
+		std::unordered_map<std::string, uint16_t> BonesTable;
+		PMDSkeleton Skeleton;
+
+		SpringModel(const std::string& firstChain, const std::string& secondChain)
+		{
+			Bones.resize(7);
+			Bones[0].name = "root";
+			Bones[0].pos = XMFLOAT3(0.0f, 10.0f, 0.0f);
+			const std::string chainNames[] = { firstChain, secondChain };
+			for (uint16_t c = 0; c < 2; ++c)
+			{
+				for (uint16_t i = 0; i < 3; ++i)
+				{
+					auto bone = static_cast<uint16_t>(1 + c * 3 + i);
+					Bones[bone].name = chainNames[c] + std::to_string(i);
+					Bones[bone].parentNo = i == 0 ? 0 : bone - 1;
+					Bones[bone].pos = XMFLOAT3(2.0f * c - 1.0f, 10.0f - i, 0.0f);
+				}
+			}
+			for (uint16_t b = 0; b < Bones.size(); ++b)
+				BonesTable[Bones[b].name] = b;
+			Skeleton.Create(Bones);
+		}
+	};
+
+	std::vector<XMFLOAT3X4> CreateTranslations(size_t count, float x)
+	{
+		std::vector<XMFLOAT3X4> transforms(count);
+		for (auto& transform : transforms)
+			XMStoreFloat3x4(&transform, XMMatrixTranslation(x, 0.0f, 0.0f));
+		return transforms;
+	}
+}
+
+// Part of a name only selects bones where it starts at a character boundary
+PMD_TEST(SpringNamesMatchWholeShiftJISCharacters)
+{
+	SpringModel model(hair_name, false_hair_name);
+	PMDSpringBones springs;
+	PMD_CHECK(springs.Create(model.Bones, model.Skeleton, model.BonesTable, { hair_name }, PMDSpringParams()));
+	PMD_CHECK(springs.ChainCount() == 1);
+	PMD_CHECK(springs.ParticleCount() == 3);
+
+	// Default names select the same chain
+	PMD_CHECK(springs.Create(model.Bones, model.Skeleton, model.BonesTable, {}, PMDSpringParams()));
+	PMD_CHECK(springs.ChainCount() == 1);
+}
+
+// Pinned top bones are where animation puts them even on updates without a whole step
+PMD_TEST(PinnedSpringBonesFollowAnimationWithoutSteps)
+{
+	SpringModel model(hair_name, "tail");
+	PMDSpringBones springs;
+	PMD_CHECK(springs.Create(model.Bones, model.Skeleton, model.BonesTable, { hair_name }, PMDSpringParams()));
+	if (context.HasFailed()) return;
+
+	PMDSpringStats stats;
+	auto transforms = CreateTranslations(model.Bones.size(), 0.0f);
+	springs.Simulate(transforms.data(), 1, stats);
+
+	for (auto x : { 5.0f, -3.0f })
+	{
+		transforms = CreateTranslations(model.Bones.size(), x);
+		springs.Simulate(transforms.data(), 0, stats);
+		// Top bone of the chain stays where animation moved it, only its rotation swings
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMVector3Transform(XMLoadFloat3(&model.Bones[1].pos), XMLoadFloat3x4(&transforms[1])));
+		PMD_CHECK(std::abs(position.x - (model.Bones[1].pos.x + x)) < spring_tolerance);
+		PMD_CHECK(std::abs(position.y - model.Bones[1].pos.y) < spring_tolerance);
+	}
+}
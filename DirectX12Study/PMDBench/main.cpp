@@ -0,0 +1,115 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <Windows.h>
+
+#include "BenchRegistry.h"
+#include "../Utility/StringHelper.h"
+
+// PMDBench [--test] [--bench] [--quick] [--filter text] [--json path]
+// Runs tests and benchmarks of PMDModel without a window
+// Working directory must be DirectX12Study (resource paths are relative to it)
+// Without --test or --bench both are run, --filter runs only names containing text
+namespace
+{
+	bool Matches(const char* name, const std::string& filter)
+	{
+		return filter.empty() || std::strstr(name, filter.c_str()) != nullptr;
+	}
+
+	// JSON string of text in the ANSI code page (names hold Shift-JIS file names), UTF-8 and escaped
+	std::string ToJsonString(const std::string& text)
+	{
+		auto wide = StringHelper::ConvertStringToWideString(text);
+		std::string utf8;
+		auto wideLength = static_cast<int>(wide.size());
+		auto length = WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideLength, nullptr, 0, nullptr, nullptr);
+		utf8.resize(length);
+		if (length > 0)
+			WideCharToMultiByte(CP_UTF8, 0, wide.data(), wideLength, &utf8[0], length, nullptr, nullptr);
+
+		std::string json = "\"";
+		for (auto c : utf8)
+		{
+			if (c == '"' || c == '\\')
+			{
+				json += '\\';
+				json += c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+				json += escaped;
+			}
+			else
+				json += c;
+		}
+		return json + "\"";
+	}
+
+	void WriteJson(const char* path, const std::vector<BenchResult>& results)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << "{\n  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			// JSON has no inf or nan
+			file << "    { \"name\": " << ToJsonString(results[i].Name) << ", \"value\": ";
+			if (std::isfinite(results[i].Value))
+				file << results[i].Value;
+			else
+				file << "null";
+			file << ", \"unit\": " << ToJsonString(results[i].Unit) << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bool runTests = false;
+	bool runBenches = false;
+	bool quick = false;
+	std::string filter;
+	const char* jsonPath = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--test") == 0) runTests = true;
+		else if (std::strcmp(argv[i], "--bench") == 0) runBenches = true;
+		else if (std::strcmp(argv[i], "--quick") == 0) quick = true;
+		else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+	}
+	if (!runTests && !runBenches) runTests = runBenches = true;
+
+	int failedCount = 0;
+	if (runTests)
+	{
+		for (auto& test : GetTests())
+		{
+			if (!Matches(test.Name, filter)) continue;
+			TestContext context;
+			test.Function(context);
+			std::printf("[%s] %s\n", context.HasFailed() ? "FAIL" : " OK ", test.Name);
+			if (context.HasFailed()) ++failedCount;
+		}
+	}
+
+	if (runBenches)
+	{
+		BenchContext context(quick);
+		for (auto& bench : GetBenches())
+		{
+			if (!Matches(bench.Name, filter)) continue;
+			std::printf("%s\n", bench.Name);
+			bench.Function(context);
+		}
+		if (jsonPath != nullptr) WriteJson(jsonPath, context.Results());
+	}
+
+	if (failedCount > 0) std::printf("%d test(s) failed\n", failedCount);
+	return failedCount == 0 ? 0 : 1;
+}
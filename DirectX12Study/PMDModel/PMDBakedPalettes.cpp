@@ -0,0 +1,115 @@
+#include "PMDBakedPalettes.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr float snorm16_scale = 32767.0f;
+	constexpr float unorm16_scale = 65535.0f;
+}
+
+bool PMDBakedPalettes::Create(const std::vector<XMFLOAT3X4>& frames, uint32_t boneCount, float frameRate,
+	PMDBakeEncoding encoding, uint64_t skeletonSignature)
+{
+	if (boneCount == 0 || frames.empty() || frames.size() % boneCount != 0 || frameRate <= 0.0f)
+		return false;
+
+	m_encoding = encoding;
+	m_boneCount = boneCount;
+	m_frameCount = static_cast<uint32_t>(frames.size() / boneCount);
+	m_frameRate = frameRate;
+	m_skeletonSignature = skeletonSignature;
+	m_frames.clear();
+	m_quantizedFrames.clear();
+
+	if (encoding == PMDBakeEncoding::Float)
+	{
+		m_frames = frames;
+		return true;
+	}
+
+	// Translation range of the whole clip, rotation part of rigid transforms is already in [-1, 1]
+	for (size_t c = 0; c < 3; ++c)
+	{
+		auto minValue = frames[0].m[c][3];
+		auto maxValue = minValue;
+		for (auto& transform : frames)
+		{
+			minValue = (std::min)(minValue, transform.m[c][3]);
+			maxValue = (std::max)(maxValue, transform.m[c][3]);
+		}
+		m_translationMin[c] = minValue;
+		m_translationScale[c] = (maxValue - minValue) / unorm16_scale;
+	}
+
+	m_quantizedFrames.resize(frames.size());
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		auto& transform = frames[i];
+		auto& bone = m_quantizedFrames[i];
+		for (size_t r = 0; r < 3; ++r)
+		{
+			for (size_t c = 0; c < 3; ++c)
+			{
+				auto value = (std::min)((std::max)(transform.m[r][c], -1.0f), 1.0f);
+				bone.Rotation[r][c] = static_cast<int16_t>(std::lround(value * snorm16_scale));
+			}
+			auto value = m_translationScale[r] > 0.0f ?
+				(transform.m[r][3] - m_translationMin[r]) / m_translationScale[r] : 0.0f;
+			bone.Translation[r] = static_cast<uint16_t>(std::lround((std::min)((std::max)(value, 0.0f), unorm16_scale)));
+		}
+	}
+	return true;
+}
+
+uint32_t PMDBakedPalettes::GetFrameIndex(float time) const
+{
+	if (m_frameCount == 0 || time <= 0.0f) return 0;
+	auto frame = static_cast<uint64_t>(time * m_frameRate + 0.5f);
+	return static_cast<uint32_t>((std::min)(frame, static_cast<uint64_t>(m_frameCount - 1)));
+}
+
+void PMDBakedPalettes::GetFrame(uint32_t frame, XMFLOAT3X4* transforms) const
+{
+	const size_t first = static_cast<size_t>(frame) * m_boneCount;
+	if (m_encoding == PMDBakeEncoding::Float)
+	{
+		std::copy(m_frames.begin() + first, m_frames.begin() + first + m_boneCount, transforms);
+		return;
+	}
+
+	for (size_t i = 0; i < m_boneCount; ++i)
+	{
+		auto& bone = m_quantizedFrames[first + i];
+		auto& transform = transforms[i];
+		for (size_t r = 0; r < 3; ++r)
+		{
+			for (size_t c = 0; c < 3; ++c)
+				transform.m[r][c] = bone.Rotation[r][c] / snorm16_scale;
+			transform.m[r][3] = m_translationMin[r] + bone.Translation[r] * m_translationScale[r];
+		}
+	}
+}
+
+uint32_t PMDBakedPalettes::FrameCount() const
+{
+	return m_frameCount;
+}
+
+uint32_t PMDBakedPalettes::BoneCount() const
+{
+	return m_boneCount;
+}
+
+uint64_t PMDBakedPalettes::SkeletonSignature() const
+{
+	return m_skeletonSignature;
+}
+
+size_t PMDBakedPalettes::SizeInBytes() const
+{
+	return m_frames.size() * sizeof(XMFLOAT3X4) + m_quantizedFrames.size() * sizeof(QuantizedBone);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+enum class PMDBakeEncoding
+{
+	// XMFLOAT3X4 per bone, 48 bytes
+	Float,
+	// 16-bit per element, 24 bytes per bone
+	// Rotation part is snorm, translation is normalized to clip's translation range
+	Quantized16
+};
+
+// Bone transforms of a motion sampled at a fixed rate for one skeleton
+// Playing it is a lookup of the frame at given time, no keyframe search or curve evaluation
+class PMDBakedPalettes
+{
+public:
+	// frames are frameCount * boneCount bone transforms (see PMDSkeleton), frame after frame
+	bool Create(const std::vector<DirectX::XMFLOAT3X4>& frames, uint32_t boneCount, float frameRate,
+		PMDBakeEncoding encoding, uint64_t skeletonSignature);
+
+	// Frame shown at time (seconds), held at the last frame
+	uint32_t GetFrameIndex(float time) const;
+	// Decode frame's bone transforms to transforms (BoneCount elements)
+	void GetFrame(uint32_t frame, DirectX::XMFLOAT3X4* transforms) const;
+
+	uint32_t FrameCount() const;
+	uint32_t BoneCount() const;
+	uint64_t SkeletonSignature() const;
+	size_t SizeInBytes() const;
+private:
+	struct QuantizedBone
+	{
+		int16_t Rotation[3][3];
+		uint16_t Translation[3];
+	};
+
+	PMDBakeEncoding m_encoding = PMDBakeEncoding::Float;
+	uint32_t m_boneCount = 0;
+	uint32_t m_frameCount = 0;
+	float m_frameRate = 0.0f;
+	uint64_t m_skeletonSignature = 0;
+
+	std::vector<DirectX::XMFLOAT3X4> m_frames;
+	std::vector<QuantizedBone> m_quantizedFrames;
+	// translation = m_translationMin + value * m_translationScale
+	float m_translationMin[3] = {};
+	float m_translationScale[3] = {};
+};
@@ -0,0 +1,121 @@
+#include "PMDBoneBounds.h"
+
+#include <cfloat>
+
+using namespace DirectX;
+
+void PMDBoneBounds::Create(ArrayView<PMDVertex> vertices, ArrayView<PMDSkinWeights> skinWeights,
+	const std::vector<PMDMorphVertex>& morphVertices, size_t boneCount)
+{
+	*this = PMDBoneBounds();
+	if (vertices.empty() || boneCount == 0) return;
+
+	// Range every morph can move each vertex to
+	std::vector<XMFLOAT3> morphLows, morphHighs;
+	if (!morphVertices.empty())
+	{
+		morphLows.assign(vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		morphHighs.assign(vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		const auto zero = XMVectorZero();
+		for (auto& morphVertex : morphVertices)
+		{
+			if (morphVertex.Index >= vertices.size()) continue;
+			auto delta = XMLoadFloat3(&morphVertex.Delta);
+			auto& low = morphLows[morphVertex.Index];
+			auto& high = morphHighs[morphVertex.Index];
+			XMStoreFloat3(&low, XMVectorAdd(XMLoadFloat3(&low), XMVectorMin(delta, zero)));
+			XMStoreFloat3(&high, XMVectorAdd(XMLoadFloat3(&high), XMVectorMax(delta, zero)));
+		}
+	}
+
+	std::vector<XMFLOAT3> minPos(boneCount, XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+	std::vector<XMFLOAT3> maxPos(boneCount, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	auto restMin = XMVectorReplicate(FLT_MAX);
+	auto restMax = XMVectorReplicate(-FLT_MAX);
+	auto staticMin = restMin;
+	auto staticMax = restMax;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto& vertex = vertices[i];
+		auto low = XMLoadFloat3(&vertex.pos);
+		auto high = low;
+		if (!morphLows.empty())
+		{
+			low = XMVectorAdd(low, XMLoadFloat3(&morphLows[i]));
+			high = XMVectorAdd(high, XMLoadFloat3(&morphHighs[i]));
+		}
+		restMin = XMVectorMin(restMin, low);
+		restMax = XMVectorMax(restMax, high);
+
+		// weight is boneNo[0]'s, the rest is boneNo[1]'s
+		const float weights[] = { vertex.weight, 1.0f - vertex.weight };
+		const bool isFourBones = !skinWeights.empty();
+		for (size_t b = 0; b < (isFourBones ? 4 : 2); ++b)
+		{
+			auto bone = isFourBones ? skinWeights[i].boneNo[b] : vertex.boneNo[b];
+			if (isFourBones ? skinWeights[i].weight[b] == 0 : weights[b] <= 0.0f) continue;
+			if (bone >= boneCount)
+			{
+				staticMin = XMVectorMin(staticMin, low);
+				staticMax = XMVectorMax(staticMax, high);
+				continue;
+			}
+			XMStoreFloat3(&minPos[bone], XMVectorMin(XMLoadFloat3(&minPos[bone]), low));
+			XMStoreFloat3(&maxPos[bone], XMVectorMax(XMLoadFloat3(&maxPos[bone]), high));
+		}
+	}
+
+	XMStoreFloat3(&m_restCenter, XMVectorScale(XMVectorAdd(restMin, restMax), 0.5f));
+	XMStoreFloat3(&m_restExtents, XMVectorScale(XMVectorSubtract(restMax, restMin), 0.5f));
+	XMStoreFloat3(&m_staticMin, staticMin);
+	XMStoreFloat3(&m_staticMax, staticMax);
+	for (size_t b = 0; b < boneCount; ++b)
+	{
+		// Bone doesn't move any vertex
+		if (minPos[b].x > maxPos[b].x) continue;
+		auto boneMin = XMLoadFloat3(&minPos[b]);
+		auto boneMax = XMLoadFloat3(&maxPos[b]);
+		m_bones.push_back(static_cast<uint16_t>(b));
+		m_centers.emplace_back();
+		m_extents.emplace_back();
+		XMStoreFloat3(&m_centers.back(), XMVectorScale(XMVectorAdd(boneMin, boneMax), 0.5f));
+		XMStoreFloat3(&m_extents.back(), XMVectorScale(XMVectorSubtract(boneMax, boneMin), 0.5f));
+	}
+}
+
+bool PMDBoneBounds::Empty() const
+{
+	return m_bones.empty();
+}
+
+void PMDBoneBounds::GetRestBox(XMFLOAT3& center, XMFLOAT3& extents) const
+{
+	center = m_restCenter;
+	extents = m_restExtents;
+}
+
+void PMDBoneBounds::GetPoseBox(const XMFLOAT3X4* transforms, XMFLOAT3& center, XMFLOAT3& extents) const
+{
+	if (Empty())
+	{
+		GetRestBox(center, extents);
+		return;
+	}
+
+	auto minPos = XMLoadFloat3(&m_staticMin);
+	auto maxPos = XMLoadFloat3(&m_staticMax);
+	for (size_t i = 0; i < m_bones.size(); ++i)
+	{
+		auto transform = XMLoadFloat3x4(&transforms[m_bones[i]]);
+		auto extent = XMLoadFloat3(&m_extents[i]);
+		// Transformed box's half size on each axis is the sum of |rotation scale| x half size
+		auto boneCenter = XMVector3Transform(XMLoadFloat3(&m_centers[i]), transform);
+		auto boneExtent = XMVectorMultiply(XMVectorSplatX(extent), XMVectorAbs(transform.r[0]));
+		boneExtent = XMVectorMultiplyAdd(XMVectorSplatY(extent), XMVectorAbs(transform.r[1]), boneExtent);
+		boneExtent = XMVectorMultiplyAdd(XMVectorSplatZ(extent), XMVectorAbs(transform.r[2]), boneExtent);
+		minPos = XMVectorMin(minPos, XMVectorSubtract(boneCenter, boneExtent));
+		maxPos = XMVectorMax(maxPos, XMVectorAdd(boneCenter, boneExtent));
+	}
+	XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(minPos, maxPos), 0.5f));
+	XMStoreFloat3(&extents, XMVectorScale(XMVectorSubtract(maxPos, minPos), 0.5f));
+}
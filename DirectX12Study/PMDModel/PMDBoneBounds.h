@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "PMDCommon.h"
+#include "../Utility/ByteReader.h"
+
+// Boxes around the vertices each bone moves, in rest pose
+// Box of a posed model is the union of its bone boxes moved by bone transforms
+// -> O(bones) per pose instead of skinning every vertex
+// A vertex is in the boxes of all its bones, linear blend of them keeps it inside their union
+// (dual quaternion blend can bulge slightly past it at strongly twisted joints)
+class PMDBoneBounds
+{
+public:
+	// Morph offsets are added at full weight (stacked morphs add up)
+	// so morphs with weights in 0~1 stay inside the boxes
+	// boneCount is the bones skinning can use, vertices of other bones stay at rest like in VS.hlsl
+	// skinWeights is empty for 2-bone vertices, otherwise it replaces their boneNo and weight
+	void Create(ArrayView<PMDVertex> vertices, ArrayView<PMDSkinWeights> skinWeights,
+		const std::vector<PMDMorphVertex>& morphVertices, size_t boneCount);
+	bool Empty() const;
+
+	// Box of the whole model in model space
+	void GetRestBox(DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents) const;
+	// transforms are model's bone transforms (see PMDSkeleton)
+	void GetPoseBox(const DirectX::XMFLOAT3X4* transforms, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents) const;
+private:
+	// Bones that move at least one vertex and their rest box
+	std::vector<uint16_t> m_bones;
+	std::vector<DirectX::XMFLOAT3> m_centers;
+	std::vector<DirectX::XMFLOAT3> m_extents;
+	DirectX::XMFLOAT3 m_restCenter = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 m_restExtents = { 0.0f, 0.0f, 0.0f };
+	// Vertices of bones out of boneCount, empty box (min > max) when there is none
+	DirectX::XMFLOAT3 m_staticMin = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 m_staticMax = { 0.0f, 0.0f, 0.0f };
+};
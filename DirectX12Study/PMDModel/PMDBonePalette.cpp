@@ -0,0 +1,59 @@
+#include "PMDBonePalette.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+size_t GetBoneStride(PMDBonePaletteLayout layout)
+{
+	switch (layout)
+	{
+	case PMDBonePaletteLayout::Affine3x4:
+		return sizeof(XMFLOAT3X4);
+	case PMDBonePaletteLayout::DualQuaternion:
+		return sizeof(PMDDualQuaternion);
+	default:
+		return sizeof(XMMATRIX);
+	}
+}
+
+size_t GetPaletteBoneCount(size_t boneCount)
+{
+	return boneCount < pmd_max_bone_count ? boneCount : pmd_max_bone_count;
+}
+
+void ToDualQuaternions(const XMFLOAT3X4* transforms, size_t count, PMDDualQuaternion* pDestination)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto matrix = XMLoadFloat3x4(&transforms[i]);
+		auto real = XMQuaternionNormalize(XMQuaternionRotationMatrix(matrix));
+		// XMQuaternionMultiply(a, b) is b * a -> translation * real
+		auto translation = XMVectorSetW(matrix.r[3], 0.0f);
+		auto dual = XMVectorScale(XMQuaternionMultiply(real, translation), 0.5f);
+		XMStoreFloat4(&pDestination[i].Real, real);
+		XMStoreFloat4(&pDestination[i].Dual, dual);
+	}
+}
+
+void WriteBonePalette(PMDBonePaletteLayout layout, const XMFLOAT3X4* transforms,
+	size_t count, void* pDestination)
+{
+	// 3x4 transforms are already in the layout of row_major float3x4
+	if (layout == PMDBonePaletteLayout::Affine3x4)
+	{
+		std::memcpy(pDestination, transforms, count * sizeof(XMFLOAT3X4));
+		return;
+	}
+
+	if (layout == PMDBonePaletteLayout::DualQuaternion)
+	{
+		ToDualQuaternions(transforms, count, static_cast<PMDDualQuaternion*>(pDestination));
+		return;
+	}
+
+	// Shader reads XMMATRIX as column_major so it sees the transposed matrix, same as 3x4 rows
+	auto pMatrices = static_cast<XMFLOAT4X4*>(pDestination);
+	for (size_t i = 0; i < count; ++i)
+		XMStoreFloat4x4(&pMatrices[i], XMLoadFloat3x4(&transforms[i]));
+}
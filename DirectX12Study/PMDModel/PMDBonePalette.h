@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <DirectXMath.h>
+
+// Layout of bone matrices in object constant
+// Vertex shader must be compiled with the matching define (BONE_PALETTE_3X4, BONE_PALETTE_DQ)
+enum class PMDBonePaletteLayout
+{
+	// matrix g_bones[], 64 bytes per bone
+	Matrix4x4,
+	// row_major float3x4 g_bones[], 48 bytes per bone
+	Affine3x4,
+	// float4 g_bones[] of unit dual quaternions, 32 bytes per bone
+	// Skinning blends rotations instead of matrices (no candy-wrapper on twisted joints)
+	DualQuaternion
+};
+
+// Rigid transform as unit dual quaternion
+struct PMDDualQuaternion
+{
+	// Rotation
+	DirectX::XMFLOAT4 Real;
+	// 0.5 * translation * Real
+	DirectX::XMFLOAT4 Dual;
+};
+
+// Size of g_bones in VS.hlsl
+constexpr size_t pmd_max_bone_count = 512;
+
+// Bones of a boneCount skeleton that have a palette slot
+// Only the palette is clamped, pose and skeleton pass still cover every bone
+// ReducePMXVertex and GetPMXSkinWeights move PMX vertex weights off bones past the palette
+size_t GetPaletteBoneCount(size_t boneCount);
+
+// Bytes of one bone in palette
+size_t GetBoneStride(PMDBonePaletteLayout layout);
+
+// Write bone transforms to palette in given layout
+// Transforms are affine and stored transposed in 3x4 (see PMDSkeleton)
+// Destination is written sequentially and never read -> fine for write-combined memory
+// Bone transforms are rigid (rotation and translation only)
+// -> they convert to dual quaternions exactly
+void ToDualQuaternions(const DirectX::XMFLOAT3X4* transforms, size_t count, PMDDualQuaternion* pDestination);
+
+void WriteBonePalette(PMDBonePaletteLayout layout, const DirectX::XMFLOAT3X4* transforms,
+	size_t count, void* pDestination);
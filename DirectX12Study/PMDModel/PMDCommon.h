@@ -1,4 +1,7 @@
 #pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
 #include <DirectXMath.h>
 
 struct PMDVertex
@@ -10,6 +13,24 @@ struct PMDVertex
 	float weight;
 };
 
+// Bones of a vertex skinned by up to 4 bones, second vertex stream beside PMDVertex
+// Weights are UNORM16 and add up to pmd_skin_weight_one, unused bones have weight 0
+struct PMDSkinWeights
+{
+	uint16_t boneNo[4];
+	uint16_t weight[4];
+};
+
+constexpr uint16_t pmd_skin_weight_one = 0xffff;
+
+// Vertex streams a PMD mesh is drawn with
+// TwoBones : PMDVertex only, FourBones : PMDVertex + PMDSkinWeights
+enum class PMDVertexLayout
+{
+	TwoBones,
+	FourBones,
+};
+
 struct PMDMaterial
 {
 	DirectX::XMFLOAT3 diffuse; // diffuse color;
@@ -24,19 +45,76 @@ struct PMDSubMaterial
 	uint32_t indexCount;
 };
 
+// Texture files of one material
+// Paths are already resolved relative to the working directory
+// Empty path means the material doesn't use that texture
+struct PMDTexturePaths
+{
+	std::string Texture;
+	std::string Sph;
+	std::string Spa;
+	std::string Toon;
+	// Name of toon texture, use for finding default toon texture
+	// when Toon path can't be loaded
+	std::string ToonName;
+};
+
 struct PMDBone
 {
 	std::string name;
-	std::vector<int> children;
-#ifdef _DEBUG
-	std::vector<std::string> childrenName;
-#endif
+	uint16_t parentNo = 0xffff;	// 0xffff -> root bone
 	DirectX::XMFLOAT3 pos;			// rotation at origin position
 };
 
-struct PMDObjectConstant
+// IK chain of PMD model
+// Links of all chains are in one array, chain's links are [FirstLink, FirstLink + LinkCount)
+// and go from effector's side to the root's side
+struct PMDIKChain
+{
+	// Bone whose position effector is pulled to
+	uint16_t IKBone;
+	// Bone at the end of chain
+	uint16_t EffectorBone;
+	uint16_t Iterations;
+	uint16_t LinkCount;
+	uint32_t FirstLink;
+	// Max rotation of a link in one iteration (radian)
+	float LimitAngle;
+};
+
+struct PMDIKLink
+{
+	uint16_t Bone;
+	// Knee only bends around its X axis
+	uint8_t IsKnee;
+	uint8_t Padding;
+};
+
+// Vertex moved by a morph (facial skin)
+struct PMDMorphVertex
+{
+	// Index of model's vertex
+	uint32_t Index;
+	// Offset from rest position at full weight
+	DirectX::XMFLOAT3 Delta;
+};
+
+// Morph of PMD model, relative to rest pose
+// Vertices of all morphs are in one array, morph's vertices are [First, First + Count)
+struct PMDMorph
+{
+	std::string Name;
+	uint32_t First = 0;
+	uint32_t Count = 0;
+	// Range of model's vertices the morph moves (inclusive)
+	uint32_t MinVertex = 0;
+	uint32_t MaxVertex = 0;
+};
+
+// Head of object constant
+// Bone palette of model's bone count follows it (see PMDBonePalette)
+struct PMDObjectTransform
 {
 	DirectX::XMMATRIX world;
 	DirectX::XMMATRIX texTransform;
-	DirectX::XMMATRIX bones[512];
 };
\ No newline at end of file
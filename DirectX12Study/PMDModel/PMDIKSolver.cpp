@@ -0,0 +1,204 @@
+#include "PMDIKSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PMDSkeleton.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Effector closer than this to IK bone (model units) counts as converged
+	constexpr float converge_distance = 1.0e-3f;
+	// Rotations smaller than this aren't worth recalculating the chain
+	constexpr float min_rotation_angle = 1.0e-5f;
+	// Knee is kept slightly bent so that CCD has a bending direction to start from
+	constexpr float min_knee_angle = 0.5f * XM_PI / 180.0f;
+
+	// Keep only rotation around X axis and bend it backward like MMD knees
+	XMVECTOR LimitKnee(FXMVECTOR rotation)
+	{
+		XMFLOAT4 q;
+		XMStoreFloat4(&q, rotation);
+		if (q.w < 0.0f)
+		{
+			q.x = -q.x;
+			q.w = -q.w;
+		}
+		auto angle = 2.0f * std::atan2(q.x, q.w);
+		angle = (std::min)((std::max)(angle, -XM_PI), -min_knee_angle);
+		return XMQuaternionRotationNormal(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), angle);
+	}
+}
+
+void PMDIKSolver::Create(const std::vector<PMDIKChain>& chains, const std::vector<PMDIKLink>& links,
+	const std::vector<PMDBone>& bones, const PMDSkeleton& skeleton)
+{
+	const auto boneCount = bones.size();
+	m_parents = skeleton.Parents();
+	m_positions.resize(boneCount);
+	for (size_t i = 0; i < boneCount; ++i)
+		m_positions[i] = bones[i].pos;
+	m_links = links;
+
+	// Position of each bone in skeleton order, top link is the one visited first
+	auto& order = skeleton.Order();
+	std::vector<uint32_t> orderIndices(boneCount);
+	for (size_t i = 0; i < order.size(); ++i)
+		orderIndices[order[i]] = static_cast<uint32_t>(i);
+
+	m_chains.clear();
+	m_affected.clear();
+	m_iterationCount = 0;
+	std::vector<uint8_t> isAffected(boneCount);
+	for (auto& data : chains)
+	{
+		if (data.IKBone >= boneCount || data.EffectorBone >= boneCount || data.LinkCount == 0 ||
+			data.FirstLink + data.LinkCount > links.size())
+			continue;
+
+		uint16_t topLink = links[data.FirstLink].Bone;
+		bool isValid = true;
+		for (uint32_t l = data.FirstLink; l < data.FirstLink + data.LinkCount; ++l)
+		{
+			auto bone = links[l].Bone;
+			if (bone >= boneCount)
+			{
+				isValid = false;
+				break;
+			}
+			if (orderIndices[bone] < orderIndices[topLink])
+				topLink = bone;
+		}
+		if (!isValid) continue;
+
+		Chain chain;
+		chain.Data = data;
+		chain.FirstAffected = static_cast<uint32_t>(m_affected.size());
+		std::fill(isAffected.begin(), isAffected.end(), 0);
+		for (auto bone : order)
+		{
+			auto parent = m_parents[bone];
+			isAffected[bone] = bone == topLink || (parent != PMDSkeleton::no_parent && isAffected[parent]);
+			if (isAffected[bone])
+				m_affected.push_back(bone);
+		}
+		chain.AffectedCount = static_cast<uint32_t>(m_affected.size()) - chain.FirstAffected;
+		m_chains.push_back(chain);
+		m_iterationCount += data.Iterations;
+	}
+}
+
+bool PMDIKSolver::Empty() const
+{
+	return m_chains.empty();
+}
+
+size_t PMDIKSolver::ChainCount() const
+{
+	return m_chains.size();
+}
+
+uint32_t PMDIKSolver::IterationCount() const
+{
+	return m_iterationCount;
+}
+
+void PMDIKSolver::Solve(XMFLOAT3X4* locals, XMFLOAT3X4* worlds,
+	uint32_t iterationBudget, PMDIKSolveStats& stats) const
+{
+	auto remainingBudget = iterationBudget;
+	auto remainingDemand = m_iterationCount;
+	for (auto& chain : m_chains)
+	{
+		auto& data = chain.Data;
+		// Chains after this one keep their share of a short budget
+		const uint32_t demand = data.Iterations;
+		const auto iterations = remainingBudget >= remainingDemand ? demand :
+			static_cast<uint32_t>(static_cast<uint64_t>(remainingBudget) * demand / remainingDemand);
+		remainingDemand -= demand;
+		if (iterations == 0) continue;
+		++stats.ChainCount;
+
+		// Chains are solved in file order, IK bone may be moved by a previous chain
+		const auto target = GetPosition(data.IKBone, worlds);
+		bool isConverged = false;
+		for (uint32_t i = 0; i < iterations && !isConverged; ++i)
+		{
+			++stats.IterationCount;
+			--remainingBudget;
+			for (uint32_t l = data.FirstLink; l < data.FirstLink + data.LinkCount; ++l)
+			{
+				auto effector = GetPosition(data.EffectorBone, worlds);
+				if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(effector, target))) < converge_distance * converge_distance)
+				{
+					isConverged = true;
+					break;
+				}
+
+				auto& link = m_links[l];
+				auto origin = GetPosition(link.Bone, worlds);
+				auto toEffector = XMVector3Normalize(XMVectorSubtract(effector, origin));
+				auto toTarget = XMVector3Normalize(XMVectorSubtract(target, origin));
+				auto axis = XMVector3Cross(toEffector, toTarget);
+				// Effector is already on the line to IK bone
+				if (XMVectorGetX(XMVector3LengthSq(axis)) < min_rotation_angle * min_rotation_angle) continue;
+
+				auto cosAngle = (std::min)((std::max)(XMVectorGetX(XMVector3Dot(toEffector, toTarget)), -1.0f), 1.0f);
+				auto angle = (std::min)(std::acos(cosAngle), data.LimitAngle);
+				if (angle < min_rotation_angle) continue;
+
+				RotateLink(link, XMVector3Normalize(axis), angle, locals, worlds);
+				UpdateAffected(chain, locals, worlds);
+			}
+		}
+		if (isConverged)
+			++stats.ConvergedChainCount;
+	}
+}
+
+void PMDIKSolver::RotateLink(const PMDIKLink& link, FXMVECTOR worldAxis, float angle,
+	XMFLOAT3X4* locals, const XMFLOAT3X4* worlds) const
+{
+	// World rotation after parent's rotation is a local rotation around the axis seen from parent
+	// Bone transforms are rigid -> inverse of parent's rotation is its transpose
+	auto axis = worldAxis;
+	auto parent = m_parents[link.Bone];
+	if (parent != PMDSkeleton::no_parent)
+		axis = XMVector3Normalize(XMVector3TransformNormal(axis, XMMatrixTranspose(XMLoadFloat3x4(&worlds[parent]))));
+
+	// Local transform is T(-pos) * R * T(pos + move)
+	// -> change R and keep rotation center (pos + move) where it is
+	auto& local = locals[link.Bone];
+	auto localMatrix = XMLoadFloat3x4(&local);
+	auto position = XMLoadFloat3(&m_positions[link.Bone]);
+	auto center = XMVector3Transform(position, localMatrix);
+	auto rotation = XMQuaternionNormalize(XMQuaternionRotationMatrix(localMatrix));
+	rotation = XMQuaternionMultiply(rotation, XMQuaternionRotationNormal(axis, angle));
+	if (link.IsKnee)
+		rotation = LimitKnee(rotation);
+
+	auto mat = XMMatrixTranslationFromVector(XMVectorNegate(position));
+	mat *= XMMatrixRotationQuaternion(rotation);
+	mat *= XMMatrixTranslationFromVector(center);
+	XMStoreFloat3x4(&local, mat);
+}
+
+void PMDIKSolver::UpdateAffected(const Chain& chain, const XMFLOAT3X4* locals, XMFLOAT3X4* worlds) const
+{
+	for (uint32_t i = chain.FirstAffected; i < chain.FirstAffected + chain.AffectedCount; ++i)
+	{
+		auto bone = m_affected[i];
+		auto parent = m_parents[bone];
+		if (parent == PMDSkeleton::no_parent)
+			worlds[bone] = locals[bone];
+		else
+			MultiplyAffine(locals[bone], worlds[parent], worlds[bone]);
+	}
+}
+
+XMVECTOR PMDIKSolver::GetPosition(uint16_t bone, const XMFLOAT3X4* worlds) const
+{
+	return XMVector3Transform(XMLoadFloat3(&m_positions[bone]), XMLoadFloat3x4(&worlds[bone]));
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "PMDCommon.h"
+
+class PMDSkeleton;
+
+// Counters of IK solves
+struct PMDIKSolveStats
+{
+	uint32_t ChainCount = 0;
+	uint32_t IterationCount = 0;
+	// Chains whose effector reached IK bone before running out of iterations
+	uint32_t ConvergedChainCount = 0;
+};
+
+// CCD (cyclic coordinate descent) solver of PMD IK chains
+// Each iteration rotates links one by one, from effector's side to root's side,
+// so that the direction to effector points to IK bone
+class PMDIKSolver
+{
+public:
+	// Chains with invalid bone numbers are dropped
+	void Create(const std::vector<PMDIKChain>& chains, const std::vector<PMDIKLink>& links,
+		const std::vector<PMDBone>& bones, const PMDSkeleton& skeleton);
+	bool Empty() const;
+	size_t ChainCount() const;
+	// Sum of chains' iteration counts in PMD, iterations a full solve may take
+	uint32_t IterationCount() const;
+
+	// locals are bone transforms before skeleton pass and worlds after it
+	// Both are updated for the bones IK moves
+	// iterationBudget is shared by all chains, each one gets what is left in proportion
+	// to its iteration count and iterations a converged chain doesn't use go to the chains after it
+	void Solve(DirectX::XMFLOAT3X4* locals, DirectX::XMFLOAT3X4* worlds,
+		uint32_t iterationBudget, PMDIKSolveStats& stats) const;
+private:
+	struct Chain
+	{
+		PMDIKChain Data;
+		// Bones under chain's top link in skeleton order
+		// world transforms of them are recalculated after a link rotates
+		uint32_t FirstAffected = 0;
+		uint32_t AffectedCount = 0;
+	};
+
+	void RotateLink(const PMDIKLink& link, DirectX::FXMVECTOR worldAxis, float angle,
+		DirectX::XMFLOAT3X4* locals, const DirectX::XMFLOAT3X4* worlds) const;
+	void UpdateAffected(const Chain& chain, const DirectX::XMFLOAT3X4* locals, DirectX::XMFLOAT3X4* worlds) const;
+	DirectX::XMVECTOR GetPosition(uint16_t bone, const DirectX::XMFLOAT3X4* worlds) const;
+private:
+	std::vector<Chain> m_chains;
+	std::vector<PMDIKLink> m_links;
+	std::vector<uint16_t> m_affected;
+	std::vector<uint16_t> m_parents;
+	// Rest positions of bones
+	std::vector<DirectX::XMFLOAT3> m_positions;
+	uint32_t m_iterationCount = 0;
+};
@@ -1,21 +1,17 @@
 #include "PMDLoader.h"
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <emmintrin.h>
 #include <Windows.h>
 
-bool PMDLoader::Load(const char* path)
-{
-	Path = path;
+#include "PMDBonePalette.h"
+#include "PMXLoader.h"
+#include "../Utility/StringHelper.h"
 
-	//ʎq"pmd"
-	FILE* fp = nullptr;
-	auto err = fopen_s(&fp, path, "rb");
-	if (fp == nullptr || err != 0)
-	{
-		char cerr[256];
-		strerror_s(cerr, _countof(cerr), err);
-		OutputDebugStringA(cerr);
-	}
+namespace
+{
 #pragma pack(1)
 	struct PMDHeader {
 		char id[3];
@@ -60,124 +56,696 @@ bool PMDLoader::Load(const char* path)
 		uint16_t ikParentNo;
 		DirectX::XMFLOAT3 pos;
 	}; // 39 bytes
+
+	struct IKData
+	{
+		uint16_t ikBoneNo;
+		uint16_t targetBoneNo;
+		uint8_t chainLength;
+		uint16_t iterations;
+		float limit;
+	}; // 11 bytes, followed by chainLength bone numbers
+
+	struct SkinData
+	{
+		char skinName[20];
+		uint32_t vertexCount;
+		uint8_t type;
+	}; // 25 bytes, followed by vertexCount SkinVertex
+
+	struct SkinVertex
+	{
+		uint32_t index;
+		DirectX::XMFLOAT3 pos;
+	};
 #pragma pack()
 
+	constexpr size_t bone_name_size = 20;
+	constexpr size_t skin_name_size = 20;
+	constexpr size_t toon_name_size = 100;
+	constexpr size_t toon_count = 10;
+	// Type of the skin holding rest positions of all vertices other skins move
+	constexpr uint8_t base_skin_type = 0;
+	// PMD stores IK limit per iteration in units of 4 radians
+	constexpr float ik_limit_scale = 4.0f;
+	// "Ђ" in Shift-JIS, knees only bend around X axis in MMD
+	constexpr char knee_name[] = "\x82\xd0\x82\xb4";
+
+	bool IsKneeBone(const std::string& name)
+	{
+		return name.find(knee_name) != std::string::npos;
+	}
+
+	// pos, normal, uv and bone numbers have the same layout in file and in PMDVertex
+	// -> copy the first 36 bytes as two 16-byte blocks + 4 bytes
+	// and widen the one-byte weight (0~100) to float
+	constexpr size_t same_layout_size = offsetof(Vertex, bone_weight);
+	static_assert(sizeof(Vertex) == 38, "PMD vertex is 38 bytes in file");
+	static_assert(offsetof(PMDVertex, weight) == same_layout_size, "PMDVertex layout must match PMD file up to weight");
+
+	void WidenVertices(const Vertex* src, size_t count, PMDVertex* dst)
+	{
+		auto pSrc = reinterpret_cast<const uint8_t*>(src);
+		for (size_t i = 0; i < count; ++i, pSrc += sizeof(Vertex), ++dst)
+		{
+			auto pDst = reinterpret_cast<uint8_t*>(dst);
+			__m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+			__m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), block0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 16), block1);
+			std::memcpy(pDst + 32, pSrc + 32, same_layout_size - 32);
+			dst->weight = static_cast<float>(pSrc[same_layout_size]) / 100.0f;
+		}
+	}
+
+	//
+	// Baked model cache (.pmdc)
+	//
+	// [PMDCacheHeader]
+	// [PMDVertex  x vertexCount]	-> GPU-ready vertex blob
+	// [PMDSkinWeights x skinWeightCount]	-> second vertex stream of 4-bone PMX models (0 or vertexCount)
+	// [uint16_t / uint32_t x indexCount]	-> GPU-ready index blob (indexSize bytes each), padded to 4 bytes
+	// [PMDMaterial x materialCount]
+	// [PMDSubMaterial x materialCount]
+	// [PMDCacheBone x boneCount]	-> flattened bone hierarchy (parent index)
+	// [PMDIKChain x ikChainCount]
+	// [PMDIKLink  x ikLinkCount]
+	// [PMDCacheMorph x morphCount]
+	// [PMDMorphVertex x morphVertexCount]
+	// [string table]				-> resolved texture paths, 5 strings per material,
+	//								   then bone names and morph names (PMX names have no length limit)
+	//
+	constexpr char cache_id[4] = { 'P','M','D','C' };
+	// Bump when layout of cache or any struct in it changes
+	constexpr uint32_t cache_version = 6;
+
+	struct PMDCacheHeader
+	{
+		char id[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t materialCount;
+		uint32_t boneCount;
+		uint32_t ikChainCount;
+		uint32_t ikLinkCount;
+		uint32_t morphCount;
+		uint32_t morphVertexCount;
+		uint32_t skinWeightCount;
+		uint32_t indexSize;
+	};
+
+	struct PMDCacheBone
+	{
+		uint16_t parentNo;
+		uint16_t padding;
+		DirectX::XMFLOAT3 pos;
+	};
+
+	struct PMDCacheMorph
+	{
+		uint32_t first;
+		uint32_t count;
+		uint32_t minVertex;
+		uint32_t maxVertex;
+	};
+
+	std::string GetCachePath(const char* modelPath)
+	{
+		return std::string(modelPath) + "c";
+	}
+
+	// Cheap identity of the source file : FNV-1a of its size and last write time
+	// Return 0 if file doesn't exist
+	uint64_t HashSourceFile(const char* path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attribute = {};
+		if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attribute))
+			return 0;
+
+		const DWORD keys[] = {
+			attribute.nFileSizeLow, attribute.nFileSizeHigh,
+			attribute.ftLastWriteTime.dwLowDateTime, attribute.ftLastWriteTime.dwHighDateTime };
+		uint64_t hash = 14695981039346656037ull;
+		auto bytes = reinterpret_cast<const uint8_t*>(keys);
+		for (size_t i = 0; i < sizeof(keys); ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		// 0 is reserved for "no source"
+		return hash == 0 ? 1 : hash;
+	}
+
+	// Split "texture*sphere" file name of PMD material and resolve each path
+	void ResolveTexturePaths(const char* modelPath, const std::string& fileName, PMDTexturePaths& paths)
+	{
+		if (fileName.empty()) return;
+		for (auto& path : StringHelper::SplitFilePath(fileName, '*'))
+		{
+			if (path.empty()) continue;
+			auto resolvedPath = StringHelper::GetTexturePathFromModelPath(modelPath, path.c_str());
+			auto ext = StringHelper::GetFileExtension(path);
+			if (ext == "sph")
+				paths.Sph = std::move(resolvedPath);
+			else if (ext == "spa")
+				paths.Spa = std::move(resolvedPath);
+			else
+				paths.Texture = std::move(resolvedPath);
+		}
+	}
+
+	void WriteString(FILE* fp, const std::string& str)
+	{
+		uint16_t length = static_cast<uint16_t>(str.size());
+		fwrite(&length, sizeof(length), 1, fp);
+		fwrite(str.data(), 1, length, fp);
+	}
+
+	bool ReadString(ByteReader& reader, std::string& str)
+	{
+		uint16_t length = 0;
+		auto chars = reader.Read(length) ? reader.View<char>(length) : nullptr;
+		if (chars == nullptr && length != 0) return false;
+		str.assign(chars, length);
+		return !reader.Failed();
+	}
+
+	bool IsPMXVertexOverTwoBones(const PMXVertex& vertex)
+	{
+		size_t boneCount = 0;
+		for (size_t b = 0; b < 4; ++b)
+		{
+			if (vertex.boneNo[b] < pmd_max_bone_count && vertex.weight[b] > 0)
+				++boneCount;
+		}
+		return boneCount > 2;
+	}
+}
+
+bool PMDLoader::Load(const char* path, bool useCache)
+{
+	Path = path;
+	m_sourceHash = HashSourceFile(path);
+	if (m_sourceHash == 0)
+	{
+		OutputDebugStringA("PMDLoader: PMD file doesn't exist\n");
+		return false;
+	}
+
+	auto cachePath = GetCachePath(path);
+	if (useCache && LoadCache(cachePath.c_str()))
+		return true;
+
+	auto isPMX = StringHelper::GetFileExtension(path) == "pmx";
+	if (!(isPMX ? LoadPMX(path) : LoadPMD(path)))
+		return false;
+	if (!useCache) return true;
+
+	// Failing to write cache isn't an error, the model is just parsed again next time
+	SaveCache(cachePath.c_str());
+	return true;
+}
+
+bool PMDLoader::LoadPMD(const char* path)
+{
+	if (!m_file.Open(path))
+	{
+		OutputDebugStringA("PMDLoader: can't open PMD file\n");
+		return false;
+	}
+	ByteReader reader(m_file.Data(), m_file.Size());
+
+	// identifier "Pmd"
 	PMDHeader header;
-	fread_s(&header, sizeof(header), sizeof(header), 1, fp);
-	uint32_t cVertex = 0;
-	fread_s(&cVertex, sizeof(cVertex), sizeof(cVertex), 1, fp);
-	std::vector<Vertex> vertices(cVertex);
-	fread_s(vertices.data(), vertices.size() * sizeof(Vertex), vertices.size() * sizeof(Vertex), 1, fp);
-	Vertices.resize(cVertex);
-	for (uint32_t i = 0; i < cVertex; ++i)
-	{
-		Vertices[i].pos = vertices[i].pos;
-		Vertices[i].normal = vertices[i].normal_vec;
-		Vertices[i].uv = vertices[i].uv;
-		std::copy(std::begin(vertices[i].bone_num),
-			std::end(vertices[i].bone_num), Vertices[i].boneNo);
-		Vertices[i].weight = static_cast<float>(vertices[i].bone_weight) / 100.0f;
+	if (!reader.Read(header) || std::memcmp(header.id, "Pmd", 3) != 0)
+	{
+		OutputDebugStringA("PMDLoader: file isn't PMD format\n");
+		return false;
 	}
+
+	uint32_t cVertex = 0;
+	reader.Read(cVertex);
+	auto vertices = reader.View<Vertex>(cVertex);
+	if (vertices == nullptr) return false;
+	m_widenedVertices.resize(cVertex);
+	WidenVertices(vertices, cVertex, m_widenedVertices.data());
+	Vertices.Data = m_widenedVertices.data();
+	Vertices.Count = m_widenedVertices.size();
+
 	uint32_t cIndex = 0;
-	fread_s(&cIndex, sizeof(cIndex), sizeof(cIndex), 1, fp);
-	Indices.resize(cIndex);
-	fread_s(Indices.data(), sizeof(Indices[0]) * Indices.size(), sizeof(Indices[0]) * Indices.size(), 1, fp);
-	uint32_t cMaterial = 0;
-	fread_s(&cMaterial, sizeof(cMaterial), sizeof(cMaterial), 1, fp);
-	std::vector<Material> materials(cMaterial);
-	fread_s(materials.data(), sizeof(materials[0]) * materials.size(), sizeof(materials[0]) * materials.size(), 1, fp);
+	reader.Read(cIndex);
+	if (!reader.View(cIndex, Indices)) return false;
 
-	uint16_t boneNum = 0;
-	fread_s(&boneNum, sizeof(boneNum), sizeof(boneNum), 1, fp);
+	uint32_t cMaterial = 0;
+	reader.Read(cMaterial);
+	auto materials = reader.View<Material>(cMaterial);
+	if (materials == nullptr && cMaterial != 0) return false;
 
 	// Bone
-	std::vector<BoneData> boneData(boneNum);
-	fread_s(boneData.data(), sizeof(boneData[0]) * boneData.size(), sizeof(boneData[0]) * boneData.size(), 1, fp);
+	uint16_t boneNum = 0;
+	reader.Read(boneNum);
+	auto boneData = reader.View<BoneData>(boneNum);
+	if (boneData == nullptr && boneNum != 0) return false;
 	Bones.resize(boneNum);
 	for (uint16_t i = 0; i < boneNum; ++i)
 	{
-		Bones[i].name = boneData[i].boneName;
+		Bones[i].name.assign(boneData[i].boneName, strnlen(boneData[i].boneName, bone_name_size));
 		Bones[i].pos = boneData[i].pos;
-		BonesTable[boneData[i].boneName] = i;
-	}
-
-	for (uint16_t i = 0; i < boneNum; ++i)
-	{
-		if (boneData[i].parentNo == 0xffff) continue;
-		auto pno = boneData[i].parentNo;
-		Bones[pno].children.push_back(i);
-#ifdef _DEBUG
-		Bones[pno].childrenName.push_back(boneData[i].boneName);
-#endif
+		Bones[i].parentNo = boneData[i].parentNo < boneNum ? boneData[i].parentNo : 0xffff;
 	}
+	CreateBonesTable();
 
-	// IK(inverse kematic)
+	// IK(inverse kinematics)
+	// Bone numbers are validated by PMDIKSolver
 	uint16_t ikNum = 0;
-	fread_s(&ikNum, sizeof(ikNum), sizeof(ikNum), 1, fp);
+	reader.Read(ikNum);
+	IKChains.reserve(ikNum);
 	for (uint16_t i = 0; i < ikNum; ++i)
 	{
-		fseek(fp, 4, SEEK_CUR);
-		uint8_t chainNum;
-		fread_s(&chainNum, sizeof(chainNum), sizeof(chainNum), 1, fp);
-		fseek(fp, sizeof(uint16_t) + sizeof(float), SEEK_CUR);
-		fseek(fp, sizeof(uint16_t) * chainNum, SEEK_CUR);
+		IKData ik;
+		if (!reader.Read(ik)) break;
+
+		PMDIKChain chain = {};
+		chain.IKBone = ik.ikBoneNo;
+		chain.EffectorBone = ik.targetBoneNo;
+		chain.Iterations = ik.iterations;
+		chain.LinkCount = ik.chainLength;
+		chain.FirstLink = static_cast<uint32_t>(IKLinks.size());
+		chain.LimitAngle = ik.limit * ik_limit_scale;
+		IKChains.push_back(chain);
+
+		// Bone numbers aren't 2-byte aligned
+		for (uint8_t c = 0; c < ik.chainLength; ++c)
+		{
+			PMDIKLink link = {};
+			reader.Read(link.Bone);
+			link.IsKnee = link.Bone < boneNum && IsKneeBone(Bones[link.Bone].name);
+			IKLinks.push_back(link);
+		}
 	}
 
+	// Facial skins (morphs)
+	// Base skin lists every vertex other skins move,
+	// other skins index into base skin's list and store offsets from rest position
 	uint16_t skinNum = 0;
-	fread_s(&skinNum, sizeof(skinNum), sizeof(skinNum), 1, fp);
+	reader.Read(skinNum);
+	std::vector<uint32_t> baseVertices;
+	Morphs.reserve(skinNum);
 	for (uint16_t i = 0; i < skinNum; ++i)
 	{
-		fseek(fp, 20, SEEK_CUR);	// Name of facial skin
-		uint32_t skinVertCnt = 0;		// number of facial vertex
-		fread_s(&skinVertCnt, sizeof(skinVertCnt), sizeof(skinVertCnt), 1, fp);
-		fseek(fp, 1, SEEK_CUR);		// kind of facial
-		fseek(fp, 16 * skinVertCnt, SEEK_CUR); // position of vertices
+		SkinData skin;
+		if (!reader.Read(skin)) break;
+		auto skinVertices = reader.View<SkinVertex>(skin.vertexCount);
+		if (skinVertices == nullptr && skin.vertexCount != 0) break;
+
+		if (skin.type == base_skin_type)
+		{
+			baseVertices.resize(skin.vertexCount);
+			for (uint32_t v = 0; v < skin.vertexCount; ++v)
+				baseVertices[v] = skinVertices[v].index;
+			continue;
+		}
+
+		PMDMorph morph;
+		morph.Name.assign(skin.skinName, strnlen(skin.skinName, skin_name_size));
+		morph.First = static_cast<uint32_t>(MorphVertices.size());
+		morph.MinVertex = cVertex;
+		for (uint32_t v = 0; v < skin.vertexCount; ++v)
+		{
+			auto& skinVertex = skinVertices[v];
+			if (skinVertex.index >= baseVertices.size()) continue;
+			auto index = baseVertices[skinVertex.index];
+			if (index >= cVertex) continue;
+			MorphVertices.push_back({ index, skinVertex.pos });
+			morph.MinVertex = (std::min)(morph.MinVertex, index);
+			morph.MaxVertex = (std::max)(morph.MaxVertex, index);
+		}
+		morph.Count = static_cast<uint32_t>(MorphVertices.size()) - morph.First;
+		if (morph.Count == 0)
+			morph.MinVertex = 0;
+		Morphs.push_back(std::move(morph));
 	}
 
 	uint8_t skinDispNum = 0;
-	fread_s(&skinDispNum, sizeof(skinDispNum), sizeof(skinDispNum), 1, fp);
-	fseek(fp, sizeof(uint16_t) * skinDispNum, SEEK_CUR);
+	reader.Read(skinDispNum);
+	reader.Skip(sizeof(uint16_t) * skinDispNum);
 
 	uint8_t ikNameNum = 0;
-	fread_s(&ikNameNum, sizeof(ikNameNum), sizeof(ikNameNum), 1, fp);
-	fseek(fp, 50 * ikNameNum, SEEK_CUR);
+	reader.Read(ikNameNum);
+	reader.Skip(50 * ikNameNum);
 
 	uint32_t boneDispNum = 0;
-	fread_s(&boneDispNum, sizeof(boneDispNum), sizeof(boneDispNum), 1, fp);
-	fseek(fp,
-		(sizeof(uint16_t) + sizeof(uint8_t)) * boneDispNum,
-		SEEK_CUR);
+	reader.Read(boneDispNum);
+	reader.Skip((sizeof(uint16_t) + sizeof(uint8_t)) * static_cast<size_t>(boneDispNum));
 
+	if (reader.Failed())
+	{
+		OutputDebugStringA("PMDLoader: PMD file is truncated\n");
+		return false;
+	}
+
+	// English names and toon names are optional extensions
+	// -> old PMD files end here
 	uint8_t isEngAvalable = 0;
-	fread_s(&isEngAvalable, sizeof(isEngAvalable), sizeof(isEngAvalable), 1, fp);
+	reader.Read(isEngAvalable);
 	if (isEngAvalable)
 	{
-		fseek(fp, 276, SEEK_CUR);
-		fseek(fp, boneNum * 20, SEEK_CUR);
-		fseek(fp, (skinNum - 1) * 20, SEEK_CUR);		// list of facial skin's English name
-		fseek(fp, ikNameNum * 50, SEEK_CUR);
+		reader.Skip(276);
+		reader.Skip(boneNum * bone_name_size);
+		if (skinNum > 0)
+			reader.Skip((skinNum - 1) * 20);		// list of facial skin's English name
+		reader.Skip(ikNameNum * 50);
 	}
 
-	std::array<char[100], 10> toonNames;
-	fread_s(toonNames.data(), sizeof(toonNames[0]) * toonNames.size(), sizeof(toonNames[0]) * toonNames.size(), 1, fp);
+	std::array<std::string, toon_count> toonNames;
+	for (auto& toonName : toonNames)
+		reader.ReadFixedString(toon_name_size, toonName);
 
 	// Load materials
-	Materials.reserve(materials.size());
-	SubMaterials.reserve(materials.size());
-	ModelPaths.reserve(materials.size());
-	for (auto& m : materials)
+	Materials.reserve(cMaterial);
+	SubMaterials.reserve(cMaterial);
+	TexturePaths.resize(cMaterial);
+	for (uint32_t i = 0; i < cMaterial; ++i)
 	{
+		auto& m = materials[i];
+		auto& paths = TexturePaths[i];
 		if (m.toon_index > toonNames.size() - 1)
-			ToonPaths.push_back(toonNames[0]);
+			paths.ToonName = toonNames[0];
 		else
-			ToonPaths.push_back(toonNames[m.toon_index]);
+			paths.ToonName = toonNames[m.toon_index];
+		if (!paths.ToonName.empty())
+			paths.Toon = StringHelper::GetTexturePathFromModelPath(path, paths.ToonName.c_str());
 
-		ModelPaths.push_back(m.textureFileName);
+		ResolveTexturePaths(path,
+			std::string(m.textureFileName, strnlen(m.textureFileName, sizeof(m.textureFileName))), paths);
 		Materials.push_back({ m.diffuse,m.alpha,m.specular_color,m.specularity,m.mirror_color });
 		SubMaterials.push_back({ m.face_vert_count });
 	}
 
-	fclose(fp);
+	return true;
+}
+
+PMDSkinWeights GetPMXSkinWeights(const PMXVertex& vertex)
+{
+	// Bones the palette holds, heaviest first
+	std::array<size_t, 4> order = { 0, 1, 2, 3 };
+	uint8_t weights[4] = {};
+	for (size_t b = 0; b < 4; ++b)
+		weights[b] = vertex.boneNo[b] < pmd_max_bone_count ? vertex.weight[b] : 0;
+	std::stable_sort(order.begin(), order.end(),
+		[&weights](size_t a, size_t b) { return weights[a] > weights[b]; });
+
+	// No bone left -> vertex follows bone 0 like PMXLoader's weightless vertices
+	PMDSkinWeights skinWeights = {};
+	const uint32_t sum = weights[0] + weights[1] + weights[2] + weights[3];
+	if (sum == 0)
+	{
+		skinWeights.weight[0] = pmd_skin_weight_one;
+		return skinWeights;
+	}
 
+	// Rescale 1/255 weights to UNORM16, rounding error goes to the heaviest bone so they still add up to one
+	uint32_t rest = pmd_skin_weight_one;
+	for (size_t b = 1; b < 4; ++b)
+	{
+		const auto weight = weights[order[b]];
+		// Unused slots repeat the heaviest bone with weight 0
+		skinWeights.boneNo[b] = weight > 0 ? vertex.boneNo[order[b]] : vertex.boneNo[order[0]];
+		skinWeights.weight[b] = static_cast<uint16_t>((weight * pmd_skin_weight_one + sum / 2) / sum);
+		rest -= skinWeights.weight[b];
+	}
+	skinWeights.boneNo[0] = vertex.boneNo[order[0]];
+	skinWeights.weight[0] = static_cast<uint16_t>(rest);
+	return skinWeights;
+}
+
+PMDVertex ReducePMXVertex(const PMXVertex& vertex)
+{
+	PMDVertex reduced = {};
+	reduced.pos = vertex.pos;
+	reduced.normal = vertex.normal;
+	reduced.uv = vertex.uv;
+
+	// Two heaviest bones the palette holds
+	uint8_t weights[4] = {};
+	for (size_t b = 0; b < 4; ++b)
+		weights[b] = vertex.boneNo[b] < pmd_max_bone_count ? vertex.weight[b] : 0;
+	size_t first = 0, second = 1;
+	if (weights[second] > weights[first]) std::swap(first, second);
+	for (size_t b = 2; b < 4; ++b)
+	{
+		if (weights[b] > weights[first])
+		{
+			second = first;
+			first = b;
+		}
+		else if (weights[b] > weights[second])
+			second = b;
+	}
+
+	// No bone left -> vertex follows bone 0 like PMXLoader's weightless vertices
+	const auto sum = static_cast<float>(weights[first] + weights[second]);
+	if (sum <= 0.0f)
+	{
+		reduced.weight = 1.0f;
+		return reduced;
+	}
+	reduced.boneNo[0] = vertex.boneNo[first];
+	reduced.boneNo[1] = weights[second] > 0 ? vertex.boneNo[second] : vertex.boneNo[first];
+	reduced.weight = weights[first] / sum;
+	return reduced;
+}
+
+bool PMDLoader::LoadPMX(const char* path)
+{
+	PMXLoader pmx;
+	if (!pmx.Load(path)) return false;
+
+	m_widenedVertices.resize(pmx.Vertices.size());
+	std::transform(pmx.Vertices.begin(), pmx.Vertices.end(), m_widenedVertices.begin(), ReducePMXVertex);
+	Vertices.Data = m_widenedVertices.data();
+	Vertices.Count = m_widenedVertices.size();
+
+	// Models whose vertices all fit in 2 bones stay on the lighter 2-bone layout
+	if (std::any_of(pmx.Vertices.begin(), pmx.Vertices.end(), IsPMXVertexOverTwoBones))
+	{
+		m_skinWeights.resize(pmx.Vertices.size());
+		std::transform(pmx.Vertices.begin(), pmx.Vertices.end(), m_skinWeights.begin(), GetPMXSkinWeights);
+		SkinWeights.Data = m_skinWeights.data();
+		SkinWeights.Count = m_skinWeights.size();
+	}
+
+	// Indices are relative to model's first vertex, only models past 16 bits keep 32-bit ones
+	if (pmx.Vertices.size() > 0x10000)
+	{
+		m_wideIndices = std::move(pmx.Indices);
+		Indices32.Data = m_wideIndices.data();
+		Indices32.Count = m_wideIndices.size();
+	}
+	else
+	{
+		m_narrowedIndices.assign(pmx.Indices.begin(), pmx.Indices.end());
+		Indices.Data = m_narrowedIndices.data();
+		Indices.Count = m_narrowedIndices.size();
+	}
+
+	Materials = std::move(pmx.Materials);
+	SubMaterials = std::move(pmx.SubMaterials);
+	TexturePaths = std::move(pmx.TexturePaths);
+	Bones = std::move(pmx.Bones);
+	BonesTable = std::move(pmx.BonesTable);
+	IKChains = std::move(pmx.IKChains);
+	IKLinks = std::move(pmx.IKLinks);
+	Morphs = std::move(pmx.Morphs);
+	MorphVertices = std::move(pmx.MorphVertices);
 	return true;
 }
+
+bool PMDLoader::LoadCache(const char* cachePath)
+{
+	if (!m_file.Open(cachePath)) return false;
+	ByteReader reader(m_file.Data(), m_file.Size());
+
+	PMDCacheHeader header;
+	if (!reader.Read(header) ||
+		std::memcmp(header.id, cache_id, sizeof(cache_id)) != 0 ||
+		header.version != cache_version ||
+		header.sourceHash != m_sourceHash ||
+		(header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t)) ||
+		(header.skinWeightCount != 0 && header.skinWeightCount != header.vertexCount))
+	{
+		m_file.Close();
+		return false;
+	}
+
+	reader.View(header.vertexCount, Vertices);
+	reader.View(header.skinWeightCount, SkinWeights);
+	if (header.indexSize == sizeof(uint32_t))
+		reader.View(header.indexCount, Indices32);
+	else
+	{
+		reader.View(header.indexCount, Indices);
+		reader.Skip((header.indexCount % 2) * sizeof(uint16_t));
+	}
+
+	auto materials = reader.View<PMDMaterial>(header.materialCount);
+	auto subMaterials = reader.View<PMDSubMaterial>(header.materialCount);
+	auto bones = reader.View<PMDCacheBone>(header.boneCount);
+	auto ikChains = reader.View<PMDIKChain>(header.ikChainCount);
+	auto ikLinks = reader.View<PMDIKLink>(header.ikLinkCount);
+	auto morphs = reader.View<PMDCacheMorph>(header.morphCount);
+	auto morphVertices = reader.View<PMDMorphVertex>(header.morphVertexCount);
+	if (reader.Failed())
+	{
+		m_file.Close();
+		return false;
+	}
+
+	Materials.assign(materials, materials + header.materialCount);
+	SubMaterials.assign(subMaterials, subMaterials + header.materialCount);
+
+	Bones.resize(header.boneCount);
+	for (uint32_t i = 0; i < header.boneCount; ++i)
+	{
+		Bones[i].parentNo = bones[i].parentNo;
+		Bones[i].pos = bones[i].pos;
+	}
+	IKChains.assign(ikChains, ikChains + header.ikChainCount);
+	IKLinks.assign(ikLinks, ikLinks + header.ikLinkCount);
+
+	Morphs.resize(header.morphCount);
+	for (uint32_t i = 0; i < header.morphCount; ++i)
+	{
+		Morphs[i].First = morphs[i].first;
+		Morphs[i].Count = morphs[i].count;
+		Morphs[i].MinVertex = morphs[i].minVertex;
+		Morphs[i].MaxVertex = morphs[i].maxVertex;
+	}
+	MorphVertices.assign(morphVertices, morphVertices + header.morphVertexCount);
+
+	TexturePaths.resize(header.materialCount);
+	for (auto& paths : TexturePaths)
+	{
+		ReadString(reader, paths.Texture);
+		ReadString(reader, paths.Sph);
+		ReadString(reader, paths.Spa);
+		ReadString(reader, paths.Toon);
+		ReadString(reader, paths.ToonName);
+	}
+	for (auto& bone : Bones)
+		ReadString(reader, bone.name);
+	for (auto& morph : Morphs)
+		ReadString(reader, morph.Name);
+	CreateBonesTable();
+
+	if (reader.Failed())
+	{
+		// Broken cache -> caller falls back to the PMD file
+		Vertices = {};
+		SkinWeights = {};
+		Indices = {};
+		Indices32 = {};
+		Materials.clear();
+		SubMaterials.clear();
+		TexturePaths.clear();
+		Bones.clear();
+		BonesTable.clear();
+		IKChains.clear();
+		IKLinks.clear();
+		Morphs.clear();
+		MorphVertices.clear();
+		m_file.Close();
+		return false;
+	}
+	return true;
+}
+
+bool PMDLoader::SaveCache(const char* cachePath) const
+{
+	FILE* fp = nullptr;
+	if (fopen_s(&fp, cachePath, "wb") != 0 || fp == nullptr)
+		return false;
+
+	PMDCacheHeader header = {};
+	std::memcpy(header.id, cache_id, sizeof(cache_id));
+	header.version = cache_version;
+	header.sourceHash = m_sourceHash;
+	header.vertexCount = static_cast<uint32_t>(Vertices.size());
+	header.indexCount = static_cast<uint32_t>(Indices32.empty() ? Indices.size() : Indices32.size());
+	header.materialCount = static_cast<uint32_t>(Materials.size());
+	header.boneCount = static_cast<uint32_t>(Bones.size());
+	header.ikChainCount = static_cast<uint32_t>(IKChains.size());
+	header.ikLinkCount = static_cast<uint32_t>(IKLinks.size());
+	header.morphCount = static_cast<uint32_t>(Morphs.size());
+	header.morphVertexCount = static_cast<uint32_t>(MorphVertices.size());
+	header.skinWeightCount = static_cast<uint32_t>(SkinWeights.size());
+	header.indexSize = Indices32.empty() ? sizeof(uint16_t) : sizeof(uint32_t);
+	fwrite(&header, sizeof(header), 1, fp);
+
+	fwrite(Vertices.Data, sizeof(PMDVertex), Vertices.size(), fp);
+	fwrite(SkinWeights.Data, sizeof(PMDSkinWeights), SkinWeights.size(), fp);
+	if (Indices32.empty())
+	{
+		fwrite(Indices.Data, sizeof(uint16_t), Indices.size(), fp);
+		// keep next sections 4-byte aligned
+		const uint16_t padding = 0;
+		if (Indices.size() % 2)
+			fwrite(&padding, sizeof(padding), 1, fp);
+	}
+	else
+		fwrite(Indices32.Data, sizeof(uint32_t), Indices32.size(), fp);
+
+	fwrite(Materials.data(), sizeof(PMDMaterial), Materials.size(), fp);
+	fwrite(SubMaterials.data(), sizeof(PMDSubMaterial), SubMaterials.size(), fp);
+
+	for (auto& bone : Bones)
+	{
+		PMDCacheBone cacheBone = {};
+		cacheBone.parentNo = bone.parentNo;
+		cacheBone.pos = bone.pos;
+		fwrite(&cacheBone, sizeof(cacheBone), 1, fp);
+	}
+	fwrite(IKChains.data(), sizeof(PMDIKChain), IKChains.size(), fp);
+	fwrite(IKLinks.data(), sizeof(PMDIKLink), IKLinks.size(), fp);
+
+	for (auto& morph : Morphs)
+	{
+		PMDCacheMorph cacheMorph = {};
+		cacheMorph.first = morph.First;
+		cacheMorph.count = morph.Count;
+		cacheMorph.minVertex = morph.MinVertex;
+		cacheMorph.maxVertex = morph.MaxVertex;
+		fwrite(&cacheMorph, sizeof(cacheMorph), 1, fp);
+	}
+	fwrite(MorphVertices.data(), sizeof(PMDMorphVertex), MorphVertices.size(), fp);
+
+	for (auto& paths : TexturePaths)
+	{
+		WriteString(fp, paths.Texture);
+		WriteString(fp, paths.Sph);
+		WriteString(fp, paths.Spa);
+		WriteString(fp, paths.Toon);
+		WriteString(fp, paths.ToonName);
+	}
+	for (auto& bone : Bones)
+		WriteString(fp, bone.name);
+	for (auto& morph : Morphs)
+		WriteString(fp, morph.Name);
+
+	bool isSucceeded = ferror(fp) == 0;
+	fclose(fp);
+	// Don't leave a half-written cache behind
+	if (!isSucceeded)
+		remove(cachePath);
+	return isSucceeded;
+}
+
+void PMDLoader::CreateBonesTable()
+{
+	const uint16_t boneNum = static_cast<uint16_t>(Bones.size());
+	BonesTable.reserve(boneNum);
+	for (uint16_t i = 0; i < boneNum; ++i)
+		BonesTable[Bones[i].name] = i;
+}
@@ -4,22 +4,65 @@
 #include <unordered_map>
 
 #include "PMDCommon.h"
+#include "../Utility/MappedFile.h"
+#include "../Utility/ByteReader.h"
+
+struct PMXVertex;
+
+// PMX vertex on the two heaviest of its bones that have a palette slot (pmd_max_bone_count), renormalized
+// Exact for vertices with up to 2 bones, the others are skinned with GetPMXSkinWeights
+PMDVertex ReducePMXVertex(const PMXVertex& vertex);
+
+// Up to 4 bones of PMX vertex that have a palette slot, heaviest first, renormalized
+PMDSkinWeights GetPMXSkinWeights(const PMXVertex& vertex);
 
 class PMDLoader
 {
 public:
 	PMDLoader() = default;
 	~PMDLoader() = default;
-	bool Load(const char* path);
 
-	std::vector<PMDVertex> Vertices;
-	std::vector<uint16_t> Indices;
+	// Load baked cache (.pmdc / .pmxc) beside the model file if it is still valid
+	// Otherwise parse the PMD or PMX file and write a new cache for next launch
+	// useCache = false always parses the model file and leaves the cache alone (benchmarks)
+	bool Load(const char* path, bool useCache = true);
+
+	// Bake loaded model to a cache file
+	// Tools can call this to bake caches offline
+	bool SaveCache(const char* cachePath) const;
+
+	// Views into the mapped file (or widened vertices), valid while the loader is alive
+	ArrayView<PMDVertex> Vertices;
+	// Second vertex stream, only filled for PMX models with vertices on more than 2 bones
+	ArrayView<PMDSkinWeights> SkinWeights;
+	// When loaded from PMD file, indices' position isn't 2-byte aligned -> copy it with memcpy
+	ArrayView<uint16_t> Indices;
+	// Used instead of Indices by models with more than 0x10000 vertices
+	ArrayView<uint32_t> Indices32;
 	std::vector<PMDMaterial> Materials;
 	std::vector<PMDSubMaterial> SubMaterials;
-	std::vector<std::string> ModelPaths;
-	std::vector<std::string> ToonPaths;
+	std::vector<PMDTexturePaths> TexturePaths;
 	std::vector<PMDBone> Bones;
 	std::unordered_map<std::string, uint16_t> BonesTable;
-	const char* Path;
+	std::vector<PMDIKChain> IKChains;
+	std::vector<PMDIKLink> IKLinks;
+	std::vector<PMDMorph> Morphs;
+	std::vector<PMDMorphVertex> MorphVertices;
+	std::string Path;
+private:
+	bool LoadPMD(const char* path);
+	// PMX vertices go through ReducePMXVertex (and GetPMXSkinWeights)
+	bool LoadPMX(const char* path);
+	bool LoadCache(const char* cachePath);
+	void CreateBonesTable();
+private:
+	MappedFile m_file;
+	std::vector<PMDVertex> m_widenedVertices;
+	std::vector<PMDSkinWeights> m_skinWeights;
+	// PMX indices narrowed to 16 bits
+	std::vector<uint16_t> m_narrowedIndices;
+	std::vector<uint32_t> m_wideIndices;
+	// Identity of source PMD file, stored in cache header
+	uint64_t m_sourceHash = 0;
 };
 
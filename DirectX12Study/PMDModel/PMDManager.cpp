@@ -1,20 +1,88 @@
 ﻿#include "PMDManager.h"
 
 #include <unordered_map>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
 #include <sstream>
+#include <type_traits>
 
 #include "../common.h"
 #include "PMDModel.h"
 #include "PMDMesh.h"
+#include "PMDBonePalette.h"
+#include "PMDSkeleton.h"
+#include "PMDPoseCache.h"
+#include "PMDPose.h"
+#include "PMDIKSolver.h"
+#include "PMDMorpher.h"
+#include "PMDSkinning.h"
+#include "PMDSpringBones.h"
+#include "PMDBoneBounds.h"
 #include "VMD/VMDMotion.h"
+#include "VMD/VMDSampler.h"
 #include "../Graphics/UploadBuffer.h"
 #include "../Graphics/TextureManager.h"
 #include "../Utility/D12Helper.h"
 #include "../Utility/StringHelper.h"
+#include "../Utility/ThreadPool.h"
+#include "../Utility/ScratchArena.h"
+#include "../Utility/Jobs/JobSystem.h"
 
 #define IMPL (*m_impl)
 
+namespace
+{
+	// VMD keyframes are numbered at 30 frames per second
+	constexpr float vmd_frame_rate = 30.0f;
+	// Poses are sampled at 1/subframe_count of a motion frame
+	// -> smooth on high refresh displays while equal times still share pose cache entries
+	constexpr uint64_t subframe_count = 16;
+	constexpr uint64_t no_tick = static_cast<uint64_t>(-1);
+	// Models at LOD n are updated once every lod_update_intervals[n] frames
+	constexpr uint32_t lod_update_intervals[pmd_animation_lod_count] = { 1, 2, 4 };
+	// Bones whose chain is shorter than this ratio of skeleton's size aren't sampled at LOD n
+	// 0.02 drops finger tips and eyes, 0.05 drops whole fingers
+	constexpr float lod_min_chain_ratios[pmd_animation_lod_count] = { 0.0f, 0.02f, 0.05f };
+	// CCD iterations of all models per update
+	// About 190 models with the usual leg and toe chains (2 x 40 + 2 x 3 iterations)
+	constexpr uint32_t default_ik_iteration_budget = 16 * 1024;
+	// Morphed vertices are staged in one slice per frame the GPU may still be reading
+	// D3D12App keeps up to 3 frames in flight
+	constexpr size_t morph_staging_slice_count = 3;
+	// Spring bones catch up at most this many fixed steps per update
+	constexpr uint32_t max_spring_steps = 4;
+	// Particles x steps of all models per update, about 1000 links at 60 Hz per model for 16 models
+	constexpr uint32_t default_spring_step_budget = 16 * 1024 * 4;
+	const DirectX::XMFLOAT3X4 identity_transform(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f);
+
+	// 2-bone vertex in the 4-bone layout, the first weight is rounded and the second takes the rest
+	PMDSkinWeights ToSkinWeights(const PMDVertex& vertex)
+	{
+		PMDSkinWeights skinWeights = {};
+		const auto weight = static_cast<uint16_t>(vertex.weight * pmd_skin_weight_one + 0.5f);
+		skinWeights.boneNo[0] = vertex.boneNo[0];
+		skinWeights.boneNo[1] = vertex.boneNo[1];
+		skinWeights.boneNo[2] = vertex.boneNo[0];
+		skinWeights.boneNo[3] = vertex.boneNo[0];
+		skinWeights.weight[0] = weight;
+		skinWeights.weight[1] = pmd_skin_weight_one - weight;
+		return skinWeights;
+	}
+
+	inline uint64_t ElapsedNanoseconds(std::chrono::steady_clock::time_point start)
+	{
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+}
+
 class PMDManager::Impl
 {
 public:
@@ -31,7 +99,27 @@ private:
 	bool HasAnimation(std::string const& animationName);
 	bool ClearSubresource();
 
-	PMDObjectConstant* GetObjectConstant(const std::string& modelName);
+	PMDObjectTransform* GetObjectConstant(const std::string& modelName);
+	// Multiply model's world by transform, keeping CPU copy and object constant in sync
+	bool TransformWorld(const std::string& modelName, const DirectX::XMMATRIX& transform);
+	uint8_t* GetBonePalette(uint16_t modelIndex);
+
+	/*----------ASYNCHRONOUS LOADING----------*/
+	struct PendingLoad
+	{
+		std::string Name;
+		bool IsModel;
+		std::shared_future<bool> Result;
+	};
+	// Worker threads are created at first asynchronous load
+	// and released when Init finishes
+	std::unique_ptr<ThreadPool> m_loadPool;
+	std::vector<PendingLoad> m_pendingLoads;
+
+	ThreadPool& GetLoadPool();
+	// Wait for all asynchronous loads and remove models/animations that failed
+	void WaitForPendingLoads();
+	/*-----------------------------------------*/
 private:
 	void Update(const float& deltaTime);
 	void Render(ID3D12GraphicsCommandList* cmdList);
@@ -87,41 +175,274 @@ private:
 	std::unordered_map<std::string, PMDModel> m_loaders;
 	std::vector<PMDResource> m_resources;
 	std::vector<PMDRenderResource> m_renderResources;
-	UploadBuffer<PMDObjectConstant> m_objectConstant;
+	// Object constants of all models in one buffer
+	// Each one is PMDObjectTransform followed by bone palette sized to model's bone count
+	UploadBuffer<uint8_t> m_objectConstant;
+	std::vector<size_t> m_objectConstantOffsets;
+	// CPU copy of models' world matrices, object constant is write-combined memory
+	std::vector<DirectX::XMFLOAT4X4> m_worlds;
+	PMDBonePaletteLayout m_bonePaletteLayout = PMDBonePaletteLayout::Matrix4x4;
 	ComPtr<ID3D12DescriptorHeap> m_objectHeap;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE m_transformConstantHeapStart;
 	
 	std::unordered_map<std::string, uint16_t> m_modelIndices;
 	uint16_t m_count = -1;
+	// Instances from CreateModelInstance and the loaded model they share, built after models by Init
+	std::vector<std::pair<std::string, std::string>> m_instances;
+	// Model's first material descriptor in object heap, instances use their source's
+	std::vector<uint32_t> m_materialDescriptorStarts;
 	PMDMesh m_mesh;
+	// FourBones when a model has vertices on more than 2 bones, all models are drawn with it then
+	PMDVertexLayout m_vertexLayout = PMDVertexLayout::TwoBones;
+	// Second vertex stream of FourBones layout, one PMDSkinWeights per vertex of m_mesh
+	DefaultBuffer m_skinWeightBuffer;
+	D3D12_VERTEX_BUFFER_VIEW m_skinWeightBufferView = {};
 
 private:
-	struct PMDAnimation
+	// Bone track of motion resolved to model's bone index
+	// Bound once when motion is played on model
+	struct PMDBoneTrack
+	{
+		uint16_t BoneIndex = 0;
+		// Range of bone's keyframes in motion's VMDKeyframes
+		uint32_t First = 0;
+		uint32_t Count = 0;
+		// Track in motion's dense tracks when motion is resampled
+		uint32_t DenseTrack = 0;
+		// Index of keyframe used last time, relative to First
+		// -> sequential playback only needs to step forward from here
+		size_t Cursor = 0;
+	};
+
+	// Motion playing on an animation layer
+	struct PMDMotionState
 	{
 		VMDMotion* pMotionData = nullptr;
+		std::vector<PMDBoneTrack> Tracks;
+		// Tracks are sorted by bone's chain length, LOD n samples the first LODTrackCounts[n]
+		uint32_t LODTrackCounts[pmd_animation_lod_count] = {};
+		// Motion time in seconds since motion started playing
+		float Time = 0.0f;
+
+		// Motion time in 1/subframe_count of motion frame, held at the last keyframe
+		uint64_t Tick() const
+		{
+			auto endTick = pMotionData->GetMaxFrame() * subframe_count;
+			return (std::min)(static_cast<uint64_t>(Time * vmd_frame_rate * subframe_count), endTick);
+		}
+	};
+
+	struct PMDAnimationLayer
+	{
+		PMDLayerBlendMode BlendMode = PMDLayerBlendMode::Override;
+		PMDMotionState Current;
+		// Motion being crossfaded out, Current is blended over it
+		PMDMotionState Previous;
+		// Pose of layer frozen when a crossfade was interrupted, replaces Previous
+		// -> new motion fades in from where the layer was, not from one of its motions
+		PMDLocalPose FadeFrom;
+		PMDLayerBlendMode FadeFromBlendMode = PMDLayerBlendMode::Override;
+		bool HasFadeFrom = false;
+		// Memory of FadeFrom, reserved by the first interrupted crossfade
+		ScratchArena FadeFromMemory;
+		// Crossfade progress of Current, goes from 0 to 1 at FadeSpeed per second
+		float Fade = 1.0f;
+		float FadeSpeed = 0.0f;
+		// Weight moves toward TargetWeight at WeightSpeed per second
+		float Weight = 1.0f;
+		float TargetWeight = 1.0f;
+		float WeightSpeed = 0.0f;
+		// Motions are stopped when weight reaches 0
+		bool Stopping = false;
+
+		bool IsActive() const { return Current.pMotionData || Previous.pMotionData || HasFadeFrom; }
+	};
+
+	struct PMDAnimation
+	{
+		// Layer 0 is the base layer driven by Play
+		PMDAnimationLayer Layers[pmd_animation_layer_count];
+		// Per-tick scratch, kept to reuse its memory
+		VMDSampleBatch SampleBatch;
+		std::vector<uint16_t> SampledBones;
+		// Local poses of blended layers, reset every evaluation
+		ScratchArena Scratch;
+		// Bone transforms in 3x4, local pose then world after skeleton pass
+		std::vector<DirectX::XMFLOAT3X4> Transforms;
+		// Copy of transforms last written to upload heap
+		// Upload heap is write-combined, never read it back to find changes
+		std::vector<DirectX::XMFLOAT3X4> Palette;
 		std::vector<PMDBone> Bones;
 		std::unordered_map<std::string, uint16_t> BonesTable;
-		float Timer = 0.0f;
-		uint64_t FrameCnt = 0.0f;
+		PMDSkeleton Skeleton;
+		PMDIKSolver IKSolver;
+		// Local transforms kept through skeleton pass for IK, empty when model has no IK
+		std::vector<DirectX::XMFLOAT3X4> Locals;
+		// Secondary motion of hair and skirt chains, run after skeleton pass and IK
+		PMDSpringBones Springs;
+		// Fixed spring steps granted to this update by spring step budget
+		uint32_t SpringSteps = 0;
+		// CCD iterations granted to this update by IK iteration budget
+		uint32_t IKIterations = 0;
+		// Pose of this update may not be fully solved -> keep it out of pose cache
+		bool IsIKLimited = false;
+		// Tick and LOD of the pose in palette, pose only changes when one of them does
+		// no_tick while layers are blended
+		uint64_t SampledTick = no_tick;
+		uint8_t LOD = 0;
+		bool HasPose = false;
+		// Rest boxes of bones, moved with the pose into model's box
+		PMDBoneBounds BoneBounds;
+		// Box of current pose in model space, rest box until the first pose
+		DirectX::XMFLOAT3 BoxCenter = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 BoxExtents = { 0.0f, 0.0f, 0.0f };
+		// Counters of last update, summed into manager's stats after jobs join
+		PMDManagerStats Stats;
+		// Baked clip replaces layers while it plays
+		const PMDBakedPalettes* pBakedClip = nullptr;
+		float BakedTime = 0.0f;
 
 		explicit PMDAnimation(std::vector<PMDBone>&& bones, 
-			std::unordered_map<std::string, uint16_t>&& bonesTable) noexcept
+			std::unordered_map<std::string, uint16_t>&& bonesTable,
+			const std::vector<PMDIKChain>& ikChains, const std::vector<PMDIKLink>& ikLinks) noexcept
 			:Bones(bones), BonesTable(bonesTable)
 		{
+			Skeleton.Create(Bones);
+			IKSolver.Create(ikChains, ikLinks, Bones, Skeleton);
+			if (!IKSolver.Empty())
+				Locals.resize(Bones.size());
+			// Pose and skeleton pass cover every bone, only the upload is clamped
+			Transforms.resize(Bones.size());
+			Palette.resize(GetPaletteBoneCount(Bones.size()), identity_transform);
+			// Every motion has at most one track per bone
+			// -> reserve everything here and evaluation doesn't allocate
+			SampleBatch.Reset(Bones.size());
+			SampledBones.reserve(Bones.size());
+			Scratch.Reserve(2 * PMDLocalPose::RequiredBytes(Bones.size()));
+		}
 
+		bool IsPlaying() const
+		{
+			if (pBakedClip) return true;
+			for (auto& layer : Layers)
+				if (layer.IsActive()) return true;
+			return false;
 		}
-		~PMDAnimation() { pMotionData = nullptr; };
 
+		// False when only one motion drives model at full weight
+		// -> pose comes from a single motion frame and can be shared through pose cache
+		bool IsBlending() const
+		{
+			auto& base = Layers[0];
+			if (!base.Current.pMotionData || base.Previous.pMotionData || base.Fade < 1.0f ||
+				base.Weight != 1.0f || base.BlendMode != PMDLayerBlendMode::Override)
+				return true;
+			for (size_t i = 1; i < pmd_animation_layer_count; ++i)
+				if (Layers[i].IsActive()) return true;
+			return false;
+		}
 	};
 	std::unordered_map<std::string, VMDMotion> m_motionDatas;
-	std::vector<DirectX::XMMATRIX> m_defaultMatrices;
+	PMDManagerStats m_stats;
+	PMDRenderStats m_renderStats;
+	// Workers for per-frame animation, created in Init
+	std::unique_ptr<JobSystem> m_jobSystem;
+	// 0 -> one worker per hardware thread
+	size_t m_workerCount = 0;
+	// Models to update this tick
+	std::vector<uint16_t> m_updateIndices;
+	uint64_t m_updateCount = 0;
+
+	// Animation LOD
+	bool m_hasCamera = false;
+	DirectX::XMFLOAT4X4 m_viewProj;
+	// proj._22, NDC height of one unit at view depth 1
+	float m_projScaleY = 1.0f;
+	// Screen size under which LOD n is used, LOD 0 has none
+	float m_lodScreenSizes[pmd_animation_lod_count] = { 0.0f, 0.25f, 0.1f };
+	uint8_t SelectLOD(uint16_t modelIndex) const;
+	// Culling, with the camera for the color pass and the light for the depth pass
+	bool m_hasShadowCamera = false;
+	DirectX::XMFLOAT4X4 m_shadowViewProj;
+	// False when model's box is completely outside the view volume of viewProj
+	bool IsInsideView(uint16_t modelIndex, const DirectX::XMFLOAT4X4& viewProj) const;
 	std::vector<PMDAnimation> m_animations;
-
-	void UpdateMotionTransform(uint16_t modelIndex, const size_t& currentFrame = 0);
-	void RecursiveCalculate(std::vector<PMDBone>& bones, std::vector<DirectX::XMMATRIX>& matrices, size_t index);
-	// Root-finding algorithm ( finding ZERO or finding ROOT )
-	// There are 4 beizer points, but 2 of them are default at (0,0) and (127, 127)->(1,1) respectively
-	float CalculateFromBezierByHalfSolve(float x, const DirectX::XMFLOAT2& p1, const DirectX::XMFLOAT2& p2, size_t n = 8);
+	std::unordered_map<std::string, PMDBakedPalettes> m_bakedClips;
+	// Sample motion on model's skeleton at frameRate into clip
+	bool BakeAnimation(const std::string& clipName, uint16_t modelIndex, VMDMotion& motion,
+		float frameRate, PMDBakeEncoding encoding);
+	// CCD iterations of all models per update, 0 disables IK
+	uint32_t m_ikIterationBudget = default_ik_iteration_budget;
+	uint32_t m_springStepBudget = default_spring_step_budget;
+	// Grant model's pending spring steps that fit in the budget left this update
+	void ScheduleSpringSteps(PMDAnimation& animation, uint32_t& budget);
+	// Grant model's IK iterations that fit in the budget left this update
+	// Models whose pose at tick is in pose cache don't take any
+	void ScheduleIKIterations(PMDAnimation& animation, uint64_t tick, uint32_t& budget);
+	PMDPoseCache::Key GetPoseKey(const PMDAnimation& animation, uint64_t tick) const;
+
+	// Sums of stats of every Update between BeginAnimationProfile and EndAnimationProfile
+	bool m_isProfiling = false;
+	PMDAnimationProfile m_profile;
+	void AddToProfile(const PMDManagerStats& stats);
+
+	// Resolve bone names of motion to model's bone indices and restart state's time
+	void BindMotion(const PMDAnimation& animation, PMDMotionState& state, VMDMotion* pMotion);
+	// Move layers' time, crossfades and weights forward
+	void AdvanceLayers(PMDAnimation& animation, float deltaTime);
+	// Store the pose layer has now in its FadeFrom, Previous and Current are merged by crossfade progress
+	void FreezeLayerPose(PMDAnimation& animation, size_t layerIndex);
+	// Sample state's motion into layerPose, base layer covers every bone
+	void SampleLayerPose(PMDAnimation& animation, PMDMotionState& state, size_t layerIndex, PMDLocalPose& layerPose);
+	// tick is motion time in 1/subframe_count of motion frame of base layer
+	// no_tick when layers are blended
+	void UpdateMotionTransform(uint16_t modelIndex, uint64_t tick);
+	// Sample bones of state's motion at frame (with fraction) into SampleBatch and SampledBones
+	void SampleMotion(PMDAnimation& animation, PMDMotionState& state, float frame);
+	// Sample a single motion and combine bone hierarchy into animation's Transforms
+	void EvaluatePose(PMDAnimation& animation, PMDMotionState& state, float frame);
+	// Blend local poses of every active layer then combine bone hierarchy
+	void EvaluateBlendedPose(PMDAnimation& animation);
+	// Combine bone hierarchy of local pose in Transforms then solve IK chains
+	void CalculateWorldTransforms(PMDAnimation& animation);
+	// Write changed bones of animation's Transforms to object constant
+	void UploadBonePalette(uint16_t modelIndex);
+
+	// Morphs
+	std::vector<PMDMorpher> m_morphers;
+	// Models whose morphed vertices changed and wait for copying to vertex buffer
+	std::vector<uint16_t> m_morphDirtyIndices;
+	// 1 for models in m_morphDirtyIndices, one per model
+	std::vector<uint8_t> m_isMorphDirty;
+	// Models whose morph weights changed this update
+	std::vector<uint16_t> m_morphUpdateIndices;
+	std::vector<PMDMorphStats> m_morphStats;
+	// Staging of morphed vertices, each slice has a range for every model with morphs
+	UploadBuffer<uint8_t> m_morphStaging;
+	std::vector<size_t> m_morphStagingOffsets;
+	size_t m_morphStagingSliceSize = 0;
+	size_t m_morphStagingSlice = 0;
+	// Model's first vertex in m_mesh's vertex buffer
+	std::vector<uint32_t> m_baseVertices;
+	// Rest vertices of all models, kept on CPU for CPU skinning
+	std::vector<PMDVertex> m_restVertices;
+	// Rest skin weights of all models in FourBones layout, empty otherwise
+	std::vector<PMDSkinWeights> m_restSkinWeights;
+	std::vector<uint32_t> m_vertexCounts;
+	void UpdateMorphs();
+	// Copy dirty ranges of morphed vertices to model's slice of m_mesh's vertex buffer
+	// Run before the first draw of the frame
+	void UploadMorphedVertices(ID3D12GraphicsCommandList* cmdList);
+	PMDPoseCache m_poseCache;
+
+	// Keyframe reduction and packing of motions at load
+	bool m_isMotionCompressed = false;
+	float m_motionCompressionAngleError = 0.0f;
+	float m_motionCompressionLocationError = 0.0f;
+	// Resampling of motions at load, 0 samples per frame keeps keyframes
+	uint32_t m_motionSamplesPerFrame = 0;
+	float m_motionMaxAngleError = 0.0f;
+	float m_motionMaxLocationError = 0.0f;
 };
 
 PMDManager::Impl::Impl()
@@ -140,6 +461,9 @@ PMDManager::Impl::Impl(ID3D12Device* pDevice) :m_device(pDevice)
 
 PMDManager::Impl::~Impl()
 {
+	// Unfinished loads write to m_loaders / m_motionDatas and use m_device,
+	// which are destroyed before m_loadPool -> join loading threads first
+	m_loadPool.reset();
 }
 
 void PMDManager::Impl::Update(const float& deltaTime)
@@ -169,26 +493,287 @@ void PMDManager::Impl::SleepRender(ID3D12GraphicsCommandList* cmdList)
 
 void PMDManager::Impl::NormalUpdate(const float& deltaTime)
 {
-	constexpr float animation_speed = 50.0f / second_to_millisecond;
+	const auto updateStart = std::chrono::steady_clock::now();
+	m_stats = PMDManagerStats();
+	m_stats.WorkerCount = static_cast<uint32_t>(m_jobSystem->WorkerCount());
+	m_updateIndices.clear();
+	auto springBudget = m_springStepBudget;
+	auto ikBudget = m_ikIterationBudget;
 	for (const auto& data : m_modelIndices)
 	{
-		const auto& name = data.first;
 		const auto& index = data.second;
 		auto& animation = m_animations[index];
-		if (animation.Timer <= 0.0f)
+		// Spring bones keep swinging on a model without motion (rest pose)
+		if (!animation.IsPlaying() && animation.Springs.Empty()) continue;
+
+		// Layer stopped this update still needs one more pose without it
+		AdvanceLayers(animation, deltaTime);
+		// Updates skipped by LOD leave their time to the next one
+		animation.Springs.AddTime(deltaTime);
+		auto lod = SelectLOD(index);
+		++m_stats.LODModelCount[lod];
+
+		// Sample at the exact render time, but only re-evaluate when the pose can change:
+		// same tick (paused, very high frame rate) or past the last keyframe (pose holds)
+		// Blended pose changes with every layer's time and weight
+		// Baked clip's pose only changes with its frame
+		auto tick = animation.pBakedClip ? animation.pBakedClip->GetFrameIndex(animation.BakedTime) :
+			animation.IsBlending() ? no_tick : animation.Layers[0].Current.Tick();
+		// Spring bones keep moving while the pose holds
+		if (tick != no_tick && tick == animation.SampledTick && lod == animation.LOD && animation.Springs.Empty()) continue;
+
+		// Far models hold their pose for a few frames
+		// Offset by model index so they don't all update on the same frame
+		if (animation.HasPose && (m_updateCount + index) % lod_update_intervals[lod] != 0)
 		{
-			animation.Timer += animation_speed;
-			++animation.FrameCnt;
-			UpdateMotionTransform(index, animation.FrameCnt);
+			++m_stats.LODSkippedUpdateCount[lod];
+			continue;
 		}
-		animation.Timer -= deltaTime;
+
+		animation.SampledTick = tick;
+		animation.LOD = lod;
+		animation.HasPose = true;
+		ScheduleSpringSteps(animation, springBudget);
+		ScheduleIKIterations(animation, tick, ikBudget);
+		m_updateIndices.push_back(index);
 	}
+	++m_updateCount;
+
+	// Models don't share any state but pose cache (thread-safe)
+	// -> update them in parallel, ParallelFor returns after all of them are done
+	m_jobSystem->ParallelFor(m_updateIndices.size(), 1, [this](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				auto index = m_updateIndices[i];
+				auto& animation = m_animations[index];
+				animation.Stats = PMDManagerStats();
+				const auto start = std::chrono::steady_clock::now();
+				UpdateMotionTransform(index, animation.SampledTick);
+				animation.Stats.AnimationWorkerNanoseconds = ElapsedNanoseconds(start);
+				animation.Stats.AnimatedBoneCount = static_cast<uint32_t>(animation.Transforms.size());
+			}
+		});
+
+	for (auto index : m_updateIndices)
+	{
+		auto& animation = m_animations[index];
+		++m_stats.AnimatedModelCount;
+		m_stats.AnimatedBoneCount += animation.Stats.AnimatedBoneCount;
+		m_stats.AnimationWorkerNanoseconds += animation.Stats.AnimationWorkerNanoseconds;
+		m_stats.BoneUploadBytes += animation.Stats.BoneUploadBytes;
+		m_stats.PoseEvaluationCount += animation.Stats.PoseEvaluationCount;
+		m_stats.PoseCacheHitCount += animation.Stats.PoseCacheHitCount;
+		m_stats.IKChainCount += animation.Stats.IKChainCount;
+		m_stats.IKIterationCount += animation.Stats.IKIterationCount;
+		m_stats.IKConvergedChainCount += animation.Stats.IKConvergedChainCount;
+		m_stats.BakedPoseCount += animation.Stats.BakedPoseCount;
+		m_stats.SpringParticleCount += animation.Stats.SpringParticleCount;
+		m_stats.SpringStepCount += animation.Stats.SpringStepCount;
+		m_stats.LODSkippedBoneCount[animation.LOD] += animation.Stats.LODSkippedBoneCount[animation.LOD];
+	}
+
+	UpdateMorphs();
+
+	m_stats.UpdateNanoseconds = ElapsedNanoseconds(updateStart);
+	if (m_isProfiling)
+		AddToProfile(m_stats);
+}
+
+void PMDManager::Impl::AddToProfile(const PMDManagerStats& stats)
+{
+	++m_profile.UpdateCount;
+	m_profile.UpdateNanoseconds += stats.UpdateNanoseconds;
+	m_profile.MaxUpdateNanoseconds = (std::max)(m_profile.MaxUpdateNanoseconds, stats.UpdateNanoseconds);
+	m_profile.AnimationWorkerNanoseconds += stats.AnimationWorkerNanoseconds;
+	m_profile.AnimatedModelCount += stats.AnimatedModelCount;
+	m_profile.AnimatedBoneCount += stats.AnimatedBoneCount;
+	m_profile.PoseEvaluationCount += stats.PoseEvaluationCount;
+	m_profile.PoseCacheHitCount += stats.PoseCacheHitCount;
+	m_profile.BoneUploadBytes += stats.BoneUploadBytes;
+	m_profile.WorkerCount = stats.WorkerCount;
+}
+
+void PMDManager::Impl::ScheduleSpringSteps(PMDAnimation& animation, uint32_t& budget)
+{
+	animation.SpringSteps = 0;
+	if (animation.Springs.Empty()) return;
+
+	// Steps over the budget are dropped, chains slow down instead of the frame
+	const auto particleCount = static_cast<uint32_t>(animation.Springs.ParticleCount());
+	const auto pending = (std::min)(animation.Springs.PendingSteps(), max_spring_steps);
+	const auto steps = (std::min)(pending, budget / particleCount);
+	if (steps < pending)
+		++m_stats.SpringBudgetLimitedModelCount;
+	animation.Springs.ConsumeSteps();
+	budget -= steps * particleCount;
+	animation.SpringSteps = steps;
+}
+
+void PMDManager::Impl::ScheduleIKIterations(PMDAnimation& animation, uint64_t tick, uint32_t& budget)
+{
+	animation.IKIterations = 0;
+	animation.IsIKLimited = false;
+	if (animation.IKSolver.Empty() || animation.pBakedClip || m_ikIterationBudget == 0) return;
+
+	// Model that evaluated the cached pose already paid for its IK
+	// If it is evicted before this model looks it up, the unsolved pose isn't cached again
+	if (tick != no_tick && m_poseCache.Contains(GetPoseKey(animation, tick)))
+	{
+		animation.IsIKLimited = true;
+		return;
+	}
+
+	// Iterations over the budget are dropped, feet slide instead of the frame slowing down
+	const auto demand = animation.IKSolver.IterationCount();
+	const auto iterations = (std::min)(demand, budget);
+	if (iterations < demand)
+	{
+		++m_stats.IKBudgetLimitedModelCount;
+		animation.IsIKLimited = true;
+	}
+	budget -= iterations;
+	animation.IKIterations = iterations;
+}
+
+PMDPoseCache::Key PMDManager::Impl::GetPoseKey(const PMDAnimation& animation, uint64_t tick) const
+{
+	PMDPoseCache::Key poseKey;
+	poseKey.pMotion = animation.Layers[0].Current.pMotionData;
+	poseKey.SkeletonSignature = animation.Skeleton.Signature();
+	poseKey.Frame = tick;
+	poseKey.LOD = animation.LOD;
+	return poseKey;
+}
+
+void PMDManager::Impl::UpdateMorphs()
+{
+	m_morphUpdateIndices.clear();
+	for (uint16_t i = 0; i < m_morphers.size(); ++i)
+	{
+		if (m_morphers[i].IsWeightChanged())
+			m_morphUpdateIndices.push_back(i);
+	}
+	if (m_morphUpdateIndices.empty()) return;
+
+	// Each model's morphs only touch its own vertices -> evaluate them in parallel
+	m_morphStats.assign(m_morphUpdateIndices.size(), PMDMorphStats());
+	m_jobSystem->ParallelFor(m_morphUpdateIndices.size(), 1, [this](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				m_morphers[m_morphUpdateIndices[i]].Evaluate(m_morphStats[i]);
+		});
+
+	for (size_t i = 0; i < m_morphUpdateIndices.size(); ++i)
+	{
+		++m_stats.MorphEvaluationCount;
+		m_stats.ActiveMorphCount += m_morphStats[i].ActiveMorphCount;
+		m_stats.MorphVertexCount += m_morphStats[i].MorphVertexCount;
+
+		auto index = m_morphUpdateIndices[i];
+		uint32_t first, count;
+		// Model stays dirty over several updates when nothing renders in between
+		if (m_morphers[index].GetDirtyRange(first, count) && !m_isMorphDirty[index])
+		{
+			m_isMorphDirty[index] = 1;
+			m_morphDirtyIndices.push_back(index);
+		}
+	}
+}
+
+void PMDManager::Impl::UploadMorphedVertices(ID3D12GraphicsCommandList* cmdList)
+{
+	if (m_morphDirtyIndices.empty()) return;
+
+	const auto sliceOffset = m_morphStagingSlice * m_morphStagingSliceSize;
+	m_morphStagingSlice = (m_morphStagingSlice + 1) % morph_staging_slice_count;
+
+	auto vertexBuffer = m_mesh.VertexBuffer.Resource();
+	D12Helper::TransitionResourceState(cmdList, vertexBuffer,
+		D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+	for (auto index : m_morphDirtyIndices)
+	{
+		m_isMorphDirty[index] = 0;
+		auto& morpher = m_morphers[index];
+		uint32_t first, count;
+		if (!morpher.GetDirtyRange(first, count)) continue;
+
+		const auto bytes = count * sizeof(PMDVertex);
+		const auto stagingOffset = sliceOffset + m_morphStagingOffsets[index] +
+			(first - morpher.FirstVertex()) * sizeof(PMDVertex);
+		std::memcpy(m_morphStaging.GetHandleMappedData(static_cast<uint32_t>(stagingOffset)),
+			morpher.Vertices() + (first - morpher.FirstVertex()), bytes);
+		cmdList->CopyBufferRegion(vertexBuffer, (m_baseVertices[index] + first) * sizeof(PMDVertex),
+			m_morphStaging.Get(), stagingOffset, bytes);
+		morpher.ClearDirty();
+		m_stats.MorphUploadBytes += bytes;
+	}
+	D12Helper::TransitionResourceState(cmdList, vertexBuffer,
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+	m_morphDirtyIndices.clear();
+}
+
+uint8_t PMDManager::Impl::SelectLOD(uint16_t modelIndex) const
+{
+	if (!m_hasCamera) return 0;
+
+	auto& animation = m_animations[modelIndex];
+	auto world = XMLoadFloat4x4(&m_worlds[modelIndex]);
+	auto center = XMVector3Transform(XMLoadFloat3(&animation.BoxCenter), world);
+	// Clip space w is view depth with perspective projection
+	auto depth = XMVectorGetW(XMVector3Transform(center, XMLoadFloat4x4(&m_viewProj)));
+	// Radius grows with the largest scale of world
+	auto scale = XMVectorMax(XMVectorMax(XMVector3LengthSq(world.r[0]), XMVector3LengthSq(world.r[1])),
+		XMVector3LengthSq(world.r[2]));
+	// Sphere around the box of last pose
+	auto radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&animation.BoxExtents))) * XMVectorGetX(XMVectorSqrt(scale));
+	// Camera is inside model
+	if (depth <= radius) return 0;
+
+	// Fraction of screen height covered by bounding sphere
+	auto screenSize = radius * m_projScaleY / depth;
+	for (auto lod = static_cast<uint8_t>(pmd_animation_lod_count - 1); lod > 0; --lod)
+	{
+		if (screenSize < m_lodScreenSizes[lod]) return lod;
+	}
+	return 0;
+}
+
+bool PMDManager::Impl::IsInsideView(uint16_t modelIndex, const XMFLOAT4X4& viewProj) const
+{
+	auto& animation = m_animations[modelIndex];
+	auto worldViewProj = XMLoadFloat4x4(&m_worlds[modelIndex]) * XMLoadFloat4x4(&viewProj);
+	auto center = XMLoadFloat3(&animation.BoxCenter);
+	auto extents = XMLoadFloat3(&animation.BoxExtents);
+	// Box is outside when all 8 corners are outside the same clip plane
+	// -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	uint32_t outside = 0x3f;
+	for (uint32_t corner = 0; corner < 8 && outside != 0; ++corner)
+	{
+		auto sign = XMVectorSet(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f, 0.0f);
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMVectorMultiplyAdd(extents, sign, center), worldViewProj));
+		uint32_t planes = 0;
+		if (clip.x < -clip.w) planes |= 0x01;
+		if (clip.x > clip.w) planes |= 0x02;
+		if (clip.y < -clip.w) planes |= 0x04;
+		if (clip.y > clip.w) planes |= 0x08;
+		if (clip.z < 0.0f) planes |= 0x10;
+		if (clip.z > clip.w) planes |= 0x20;
+		outside &= planes;
+	}
+	return outside == 0;
 }
 
 void PMDManager::Impl::NormalRender(ID3D12GraphicsCommandList* cmdList)
 {
+	m_renderStats.CulledModelCount = 0;
+	UploadMorphedVertices(cmdList);
+
 	// Set Input Assembler
-	cmdList->IASetVertexBuffers(0, 1, &m_mesh.VertexBufferView);
+	// Skin weights are the second stream of FourBones layout
+	const D3D12_VERTEX_BUFFER_VIEW vertexBufferViews[] = { m_mesh.VertexBufferView, m_skinWeightBufferView };
+	cmdList->IASetVertexBuffers(0, m_vertexLayout == PMDVertexLayout::FourBones ? 2 : 1, vertexBufferViews);
 	cmdList->IASetIndexBuffer(&m_mesh.IndexBufferView);
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -204,23 +789,29 @@ void PMDManager::Impl::NormalRender(ID3D12GraphicsCommandList* cmdList)
 	CD3DX12_GPU_DESCRIPTOR_HANDLE objectHeapHandle(m_objectHeap->GetGPUDescriptorHandleForHeapStart());
 	auto heapSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	
-	auto transformHeap = m_transformConstantHeapStart;
 	for (auto& index : m_modelIndices)
 	{
-		auto it = m_modelIndices.begin();
 		auto& name = index.first;
 		auto& renderResource = m_renderResources[index.second];
 
 		auto& startIndex = m_mesh.DrawArgs[name].StartIndexLocation;
 		auto& baseVertex = m_mesh.DrawArgs[name].BaseVertexLocation;
+
+		if (m_hasCamera && !IsInsideView(index.second, m_viewProj))
+		{
+			++m_renderStats.CulledModelCount;
+			continue;
+		}
+
 		/*-------------Set up transform-------------*/
-		
+		// Descriptors are found by model index, instances share material descriptors
+		CD3DX12_GPU_DESCRIPTOR_HANDLE transformHeap(m_transformConstantHeapStart, static_cast<INT>(index.second), heapSize);
 		cmdList->SetGraphicsRootDescriptorTable(2, transformHeap);
-		transformHeap.Offset(1, heapSize);
 		/*-------------------------------------------*/
 
 		/*-------------Set up material-------------*/
-		auto& materialHeapHandle = objectHeapHandle;
+		CD3DX12_GPU_DESCRIPTOR_HANDLE materialHeapHandle(objectHeapHandle,
+			static_cast<INT>(m_materialDescriptorStarts[index.second]), heapSize);
 		uint32_t indexOffset = startIndex;
 		for (auto& m : renderResource.SubMaterials)
 		{
@@ -240,8 +831,14 @@ void PMDManager::Impl::NormalRender(ID3D12GraphicsCommandList* cmdList)
 
 void PMDManager::Impl::DepthRender(ID3D12GraphicsCommandList* cmdList)
 {
+	m_renderStats.ShadowCulledModelCount = 0;
+	// Depth pass is the first to draw models in a frame
+	UploadMorphedVertices(cmdList);
+
 	// Set Input Assembler
-	cmdList->IASetVertexBuffers(0, 1, &m_mesh.VertexBufferView);
+	// Skin weights are the second stream of FourBones layout
+	const D3D12_VERTEX_BUFFER_VIEW vertexBufferViews[] = { m_mesh.VertexBufferView, m_skinWeightBufferView };
+	cmdList->IASetVertexBuffers(0, m_vertexLayout == PMDVertexLayout::FourBones ? 2 : 1, vertexBufferViews);
 	cmdList->IASetIndexBuffer(&m_mesh.IndexBufferView);
 	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -250,18 +847,23 @@ void PMDManager::Impl::DepthRender(ID3D12GraphicsCommandList* cmdList)
 
 	// Object constant
 	cmdList->SetDescriptorHeaps(1, m_objectHeap.GetAddressOf());
-	auto transformHeap = m_transformConstantHeapStart;
 	auto heapSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	for (auto& index : m_modelIndices)
 	{
 		auto& name = index.first;
-		auto& heapOffset = m_renderResources[index.second].MaterialsHeapOffset;
 		auto& indexCount = m_mesh.DrawArgs[name].IndexCount;
 		auto& startIndex = m_mesh.DrawArgs[name].StartIndexLocation;
 		auto& baseVertex = m_mesh.DrawArgs[name].BaseVertexLocation;
 		
+		// Model outside light's view casts no shadow into shadow map
+		if (m_hasShadowCamera && !IsInsideView(index.second, m_shadowViewProj))
+		{
+			++m_renderStats.ShadowCulledModelCount;
+			continue;
+		}
+
+		CD3DX12_GPU_DESCRIPTOR_HANDLE transformHeap(m_transformConstantHeapStart, static_cast<INT>(index.second), heapSize);
 		cmdList->SetGraphicsRootDescriptorTable(1, transformHeap);
-		transformHeap.Offset(1, heapSize);
 		cmdList->DrawIndexedInstanced(indexCount, 1, startIndex, baseVertex, 0);
 	}
 }
@@ -304,96 +906,477 @@ void PMDManager::Impl::CreateDefaultToonTextures(ID3D12GraphicsCommandList* pCmd
 	
 }
 
-void PMDManager::Impl::UpdateMotionTransform(uint16_t modelIndex, const size_t& currentFrame)
+namespace
 {
-	// If model don't have animtion, don't need to do motion
-	if (!m_animations[modelIndex].pMotionData) return;
+	constexpr size_t no_keyframe = static_cast<size_t>(-1);
+	// When frame jumps further than this many keyframes, binary search is cheaper
+	constexpr size_t max_cursor_steps = 4;
+
+	// Return index of the last keyframe whose frame number <= frame
+	// or no_keyframe if frame is before the first keyframe
+	// Cursor caches the result -> amortized O(1) for sequential playback
+	size_t FindKeyframe(const uint32_t* frames, size_t count, size_t& cursor, size_t frame)
+	{
+		if (count == 0) return no_keyframe;
 
-	auto& animation = m_animations[modelIndex];
-	auto& resource = m_resources[modelIndex];
-	auto& motionData = animation.pMotionData->GetVMDMotionData();
-	auto mats = m_defaultMatrices;
+		if (cursor < count && frames[cursor] <= frame)
+		{
+			size_t steps = 0;
+			while (cursor + 1 < count && frames[cursor + 1] <= frame)
+			{
+				++cursor;
+				if (++steps >= max_cursor_steps) break;
+			}
+			// Reached the right keyframe in a few steps
+			if (cursor + 1 == count || frames[cursor + 1] > frame)
+				return cursor;
+		}
+
+		// Random seek (or playback went backward) -> binary search
+		auto it = std::upper_bound(frames, frames + count, frame,
+			[](size_t f, uint32_t keyFrame)
+			{
+				return f < keyFrame;
+			});
+		if (it == frames)
+		{
+			cursor = 0;
+			return no_keyframe;
+		}
+		cursor = static_cast<size_t>(it - frames) - 1;
+		return cursor;
+	}
 
-	for (auto& motion : motionData)
+	// Rotate around bone's rest position then move: T(-origin) * R * T(origin + move)
+	void StoreBoneTransform(const XMFLOAT3& origin, FXMVECTOR rotation, const XMFLOAT3& move, XMFLOAT3X4& out)
 	{
-		auto index = animation.BonesTable[motion.first];
-		auto& rotationOrigin = animation.Bones[index].pos;
-		auto& keyframe = motion.second;
+		auto mat = XMMatrixTranslation(-origin.x, -origin.y, -origin.z);
+		mat *= XMMatrixRotationQuaternion(rotation);
+		mat *= XMMatrixTranslation(origin.x + move.x, origin.y + move.y, origin.z + move.z);
+		XMStoreFloat3x4(&out, mat);
+	}
+}
 
-		auto rit = std::find_if(keyframe.rbegin(), keyframe.rend(),
-			[currentFrame](const VMDData& it)
+void PMDManager::Impl::BindMotion(const PMDAnimation& animation, PMDMotionState& state, VMDMotion* pMotion)
+{
+	state.pMotionData = pMotion;
+	state.Time = 0.0f;
+	state.Tracks.clear();
+	if (!pMotion) return;
+
+	auto& motionTracks = pMotion->GetTracks();
+	state.Tracks.reserve(motionTracks.size());
+	for (auto& motion : motionTracks)
+	{
+		// Motion may have bones that model doesn't have
+		auto it = animation.BonesTable.find(motion.first);
+		if (it == animation.BonesTable.end()) continue;
+
+		PMDBoneTrack track;
+		track.BoneIndex = it->second;
+		track.First = motion.second.First;
+		track.Count = motion.second.Count;
+		track.DenseTrack = motion.second.DenseTrack;
+		state.Tracks.push_back(track);
+	}
+
+	// Longest chains first -> every LOD samples a prefix of tracks
+	// and short chains (fingers, hair tips) are the first to follow their parent
+	auto& chainLengths = animation.Skeleton.ChainLengths();
+	std::stable_sort(state.Tracks.begin(), state.Tracks.end(),
+		[&chainLengths](const PMDBoneTrack& a, const PMDBoneTrack& b)
+		{
+			return chainLengths[a.BoneIndex] > chainLengths[b.BoneIndex];
+		});
+	for (size_t lod = 0; lod < pmd_animation_lod_count; ++lod)
+	{
+		auto minLength = lod_min_chain_ratios[lod] * animation.Skeleton.Size();
+		auto it = std::partition_point(state.Tracks.begin(), state.Tracks.end(),
+			[&chainLengths, minLength](const PMDBoneTrack& track)
 			{
-				return it.frameNO <= currentFrame;
+				return chainLengths[track.BoneIndex] >= minLength;
 			});
-		auto it = rit.base();
+		state.LODTrackCounts[lod] = static_cast<uint32_t>(it - state.Tracks.begin());
+	}
+	// LOD 0 samples every bone even if skeleton has no length
+	state.LODTrackCounts[0] = static_cast<uint32_t>(state.Tracks.size());
+}
+
+void PMDManager::Impl::AdvanceLayers(PMDAnimation& animation, float deltaTime)
+{
+	if (animation.pBakedClip)
+	{
+		animation.BakedTime += deltaTime;
+		return;
+	}
+
+	for (auto& layer : animation.Layers)
+	{
+		if (!layer.IsActive()) continue;
+
+		layer.Current.Time += deltaTime;
+		layer.Previous.Time += deltaTime;
+
+		if (layer.Fade < 1.0f)
+		{
+			layer.Fade = (std::min)(layer.Fade + layer.FadeSpeed * deltaTime, 1.0f);
+			if (layer.Fade >= 1.0f)
+			{
+				layer.Previous.pMotionData = nullptr;
+				layer.HasFadeFrom = false;
+			}
+		}
+
+		if (layer.Weight != layer.TargetWeight)
+		{
+			auto step = layer.WeightSpeed * deltaTime;
+			layer.Weight = layer.Weight < layer.TargetWeight ?
+				(std::min)(layer.Weight + step, layer.TargetWeight) :
+				(std::max)(layer.Weight - step, layer.TargetWeight);
+		}
+
+		if (layer.Stopping && layer.Weight <= 0.0f)
+		{
+			layer.Current.pMotionData = nullptr;
+			layer.Previous.pMotionData = nullptr;
+			layer.HasFadeFrom = false;
+			layer.Stopping = false;
+		}
+	}
+}
+
+void PMDManager::Impl::FreezeLayerPose(PMDAnimation& animation, size_t layerIndex)
+{
+	auto& layer = animation.Layers[layerIndex];
+	const auto boneCount = animation.Bones.size();
+
+	// Frozen pose is merged in place, only the first freeze allocates
+	if (!layer.HasFadeFrom)
+	{
+		const auto requiredBytes = PMDLocalPose::RequiredBytes(boneCount);
+		if (layer.FadeFromMemory.Capacity() < requiredBytes)
+			layer.FadeFromMemory.Reserve(requiredBytes);
+		layer.FadeFromMemory.Reset();
+		if (!layer.FadeFrom.Allocate(layer.FadeFromMemory, boneCount))
+		{
+			assert(false);
+			return;
+		}
+		layer.FadeFromBlendMode = layer.BlendMode;
+		layer.FadeFrom.SetIdentity(layer.BlendMode == PMDLayerBlendMode::Additive ? 1.0f : 0.0f);
+	}
+
+	animation.Scratch.Reset();
+	PMDLocalPose layerPose;
+	if (!layerPose.Allocate(animation.Scratch, boneCount))
+	{
+		assert(false);
+		return;
+	}
+
+	// Layer weight isn't part of frozen pose, it still applies while the new motion fades in
+	PMDMotionState* states[] = { &layer.Previous, &layer.Current };
+	const float weights[] = { 1.0f, layer.Fade };
+	for (size_t s = 0; s < 2; ++s)
+	{
+		auto& state = *states[s];
+		if (!state.pMotionData) continue;
+		SampleLayerPose(animation, state, layerIndex, layerPose);
+		AccumulatePose(layer.FadeFrom, layerPose, weights[s], layer.FadeFromBlendMode);
+	}
+	layer.Previous.pMotionData = nullptr;
+	layer.HasFadeFrom = true;
+}
+
+void PMDManager::Impl::SampleLayerPose(PMDAnimation& animation, PMDMotionState& state, size_t layerIndex,
+	PMDLocalPose& layerPose)
+{
+	auto& batch = animation.SampleBatch;
+	auto& sampledBones = animation.SampledBones;
+
+	// Base layer drives every bone (bones without track are at rest)
+	// upper layers only drive bones their motion has
+	layerPose.SetIdentity(layerIndex == 0 ? 1.0f : 0.0f);
+	SampleMotion(animation, state, static_cast<float>(state.Tick()) / subframe_count);
+	for (size_t i = 0; i < sampledBones.size(); ++i)
+	{
+		float rotation[4];
+		float location[3];
+		batch.GetRotation(i, rotation);
+		batch.GetLocation(i, location);
+		layerPose.Set(sampledBones[i], rotation, location);
+		layerPose.Weight[sampledBones[i]] = 1.0f;
+	}
+}
+
+void PMDManager::Impl::UpdateMotionTransform(uint16_t modelIndex, uint64_t tick)
+{
+	auto& animation = m_animations[modelIndex];
+	auto& transforms = animation.Transforms;
+
+	// Baked clip is a lookup of the frame, tick is its frame index
+	if (animation.pBakedClip)
+	{
+		animation.pBakedClip->GetFrame(static_cast<uint32_t>(tick), transforms.data());
+		++animation.Stats.BakedPoseCount;
+	}
+	// Blended pose depends on time and weight of every layer, it is rarely shared
+	else if (tick == no_tick)
+	{
+		EvaluateBlendedPose(animation);
+	}
+	else
+	{
+		// Other model with the same skeleton may already have evaluated this frame
+		auto& state = animation.Layers[0].Current;
+		const auto poseKey = GetPoseKey(animation, tick);
+		if (m_poseCache.Find(poseKey, transforms))
+		{
+			++animation.Stats.PoseCacheHitCount;
+		}
+		else
+		{
+			EvaluatePose(animation, state, static_cast<float>(tick) / subframe_count);
+			if (!animation.IsIKLimited)
+				m_poseCache.Insert(poseKey, transforms);
+		}
+	}
 
-		if (rit == keyframe.rend()) continue;
+	// Springs depend on model's own history, they go on top of the shared pose
+	if (!animation.Springs.Empty())
+	{
+		PMDSpringStats springStats;
+		animation.Springs.Simulate(transforms.data(), animation.SpringSteps, springStats);
+		animation.Stats.SpringParticleCount += springStats.ParticleCount;
+		animation.Stats.SpringStepCount += springStats.StepCount;
+	}
 
-		float t = 0.0f;
-		auto q = XMLoadFloat4(&rit->quaternion);
-		auto move = rit->location;
+	animation.BoneBounds.GetPoseBox(transforms.data(), animation.BoxCenter, animation.BoxExtents);
+	UploadBonePalette(modelIndex);
+}
 
-		if (it != keyframe.end())
+bool PMDManager::Impl::BakeAnimation(const std::string& clipName, uint16_t modelIndex, VMDMotion& motion,
+	float frameRate, PMDBakeEncoding encoding)
+{
+	auto& animation = m_animations[modelIndex];
+	const auto boneCount = animation.Transforms.size();
+	const auto maxFrame = static_cast<float>(motion.GetMaxFrame());
+	const auto frameCount = static_cast<uint32_t>(std::ceil(maxFrame / vmd_frame_rate * frameRate)) + 1;
+
+	// Models playing the old clip were checked against its skeleton -> new clip must fit the same one
+	auto it = m_bakedClips.find(clipName);
+	if (it != m_bakedClips.end() &&
+		(it->second.SkeletonSignature() != animation.Skeleton.Signature() || it->second.BoneCount() != boneCount))
+		return false;
+
+	// Sampling goes through model's own evaluation (at full detail, with IK)
+	// -> keep what Update relies on and put it back after
+	// Baking happens once, IK isn't limited by the per-update budget
+	auto transforms = animation.Transforms;
+	auto lod = animation.LOD;
+	auto ikIterations = animation.IKIterations;
+	animation.LOD = 0;
+	animation.IKIterations = m_ikIterationBudget > 0 ? animation.IKSolver.IterationCount() : 0;
+
+	PMDMotionState state;
+	BindMotion(animation, state, &motion);
+	std::vector<XMFLOAT3X4> frames(frameCount * boneCount);
+	for (uint32_t f = 0; f < frameCount; ++f)
+	{
+		EvaluatePose(animation, state, (std::min)(f * vmd_frame_rate / frameRate, maxFrame));
+		std::copy(animation.Transforms.begin(), animation.Transforms.end(), frames.begin() + f * boneCount);
+	}
+
+	animation.Transforms = std::move(transforms);
+	animation.LOD = lod;
+	animation.IKIterations = ikIterations;
+	animation.Stats = PMDManagerStats();
+
+	PMDBakedPalettes clip;
+	if (!clip.Create(frames, static_cast<uint32_t>(boneCount), frameRate, encoding, animation.Skeleton.Signature()))
+		return false;
+	if (it == m_bakedClips.end())
+	{
+		m_bakedClips.emplace(clipName, std::move(clip));
+		return true;
+	}
+
+	// Models playing the old clip keep pointing to the same map entry
+	// Its frame count may change (GetFrameIndex holds at the last frame), sample it again
+	it->second = std::move(clip);
+	for (auto& other : m_animations)
+	{
+		if (other.pBakedClip == &it->second)
+			other.SampledTick = no_tick;
+	}
+	return true;
+}
+
+void PMDManager::Impl::SampleMotion(PMDAnimation& animation, PMDMotionState& state, float frame)
+{
+	auto& keys = state.pMotionData->GetKeyframes();
+	auto& batch = animation.SampleBatch;
+	auto& sampledBones = animation.SampledBones;
+
+	// Gather the keyframe pair of every bone, then blend them 4 bones at a time
+	// Bones left out by LOD aren't sampled
+	const auto trackCount = state.LODTrackCounts[animation.LOD];
+	animation.Stats.LODSkippedBoneCount[animation.LOD] += static_cast<uint32_t>(state.Tracks.size() - trackCount);
+	batch.Reset(trackCount);
+	sampledBones.clear();
+
+	// Resampled motion reads the two samples around frame, no search or curve evaluation
+	if (auto pDenseTracks = state.pMotionData->GetDenseTracks())
+	{
+		for (size_t t = 0; t < trackCount; ++t)
 		{
-			t = static_cast<float>(currentFrame - rit->frameNO) / static_cast<float>(it->frameNO - rit->frameNO);
-			t = CalculateFromBezierByHalfSolve(t, it->b1, it->b2);
-			q = XMQuaternionSlerp(q, XMLoadFloat4(&it->quaternion), t);
-			XMStoreFloat3(&move, XMVectorLerp(XMLoadFloat3(&move), XMLoadFloat3(&it->location), t));
+			auto& track = state.Tracks[t];
+			if (pDenseTracks->Push(batch, track.DenseTrack, frame))
+				sampledBones.push_back(track.BoneIndex);
 		}
-		mats[index] *= XMMatrixTranslation(-rotationOrigin.x, -rotationOrigin.y, -rotationOrigin.z);
-		mats[index] *= XMMatrixRotationQuaternion(q);
-		mats[index] *= XMMatrixTranslation(rotationOrigin.x, rotationOrigin.y, rotationOrigin.z);
-		mats[index] *= XMMatrixTranslation(move.x, move.y, move.z);
+		batch.Sample();
+		return;
 	}
 
-	RecursiveCalculate(animation.Bones, mats, 0);
-	auto mappedBones = m_objectConstant.GetHandleMappedData(modelIndex);
-	std::copy(mats.begin(), mats.end(), mappedBones->bones);
+	for (size_t t = 0; t < trackCount; ++t)
+	{
+		auto& track = state.Tracks[t];
+		auto keyIndex = FindKeyframe(&keys.FrameNO[track.First], track.Count, track.Cursor, static_cast<size_t>(frame));
+		if (keyIndex == no_keyframe) continue;
+
+		auto k0 = track.First + keyIndex;
+		// Last keyframe holds its pose
+		auto k1 = keyIndex + 1 < track.Count ? k0 + 1 : k0;
+
+		XMFLOAT4 weights(0.0f, 0.0f, 0.0f, 0.0f);
+		if (k1 != k0)
+		{
+			auto x = (frame - keys.FrameNO[k0]) / static_cast<float>(keys.FrameNO[k1] - keys.FrameNO[k0]);
+			XMStoreFloat4(&weights, EvaluateVMDCurve(keys.GetCurve(k1), x));
+		}
+		float q0[4], q1[4];
+		keys.GetRotation(k0, q0);
+		keys.GetRotation(k1, q1);
+		const float t0[] = { keys.Tx[k0], keys.Ty[k0], keys.Tz[k0] };
+		const float t1[] = { keys.Tx[k1], keys.Ty[k1], keys.Tz[k1] };
+		batch.Push(q0, q1, t0, t1, &weights.x);
+		sampledBones.push_back(track.BoneIndex);
+	}
+	batch.Sample();
 }
 
-void PMDManager::Impl::RecursiveCalculate(std::vector<PMDBone>& bones, std::vector<DirectX::XMMATRIX>& matrices, size_t index)
-// bones : bones' data
-// matrices : matrices use for bone's Transformation
+void PMDManager::Impl::EvaluatePose(PMDAnimation& animation, PMDMotionState& state, float frame)
 {
-	auto& bonePos = bones[index].pos;
-	auto& mat = matrices[index];    // parent's matrix 
+	auto& batch = animation.SampleBatch;
+	auto& sampledBones = animation.SampledBones;
+	auto& transforms = animation.Transforms;
+	// Bones without track keep identity and follow their parent
+	std::fill(transforms.begin(), transforms.end(), identity_transform);
+
+	SampleMotion(animation, state, frame);
+	for (size_t i = 0; i < sampledBones.size(); ++i)
+	{
+		auto index = sampledBones[i];
+		XMFLOAT4 q;
+		XMFLOAT3 move;
+		batch.GetRotation(i, &q.x);
+		batch.GetLocation(i, &move.x);
+		StoreBoneTransform(animation.Bones[index].pos, XMLoadFloat4(&q), move, transforms[index]);
+	}
 
-	for (auto& childIndex : bones[index].children)
+	CalculateWorldTransforms(animation);
+	++animation.Stats.PoseEvaluationCount;
+}
+
+void PMDManager::Impl::EvaluateBlendedPose(PMDAnimation& animation)
+{
+	auto& transforms = animation.Transforms;
+	const auto boneCount = animation.Bones.size();
+
+	// Both poses come from arena reserved when animation was created
+	animation.Scratch.Reset();
+	PMDLocalPose pose, layerPose;
+	if (!pose.Allocate(animation.Scratch, boneCount) || !layerPose.Allocate(animation.Scratch, boneCount))
+	{
+		assert(false);
+		return;
+	}
+	pose.SetIdentity(1.0f);
+
+	for (size_t l = 0; l < pmd_animation_layer_count; ++l)
 	{
-		matrices[childIndex] *= mat;
-		RecursiveCalculate(bones, matrices, childIndex);
+		auto& layer = animation.Layers[l];
+		if (!layer.IsActive() || layer.Weight <= 0.0f) continue;
+
+		// Motion (or frozen pose) being faded out goes first at layer's weight
+		// then current motion over it by crossfade progress
+		if (layer.HasFadeFrom)
+			BlendPose(pose, layer.FadeFrom, layer.Weight, layer.FadeFromBlendMode);
+		PMDMotionState* states[] = { &layer.Previous, &layer.Current };
+		const float weights[] = { layer.Weight, layer.Weight * layer.Fade };
+		for (size_t s = 0; s < 2; ++s)
+		{
+			auto& state = *states[s];
+			if (!state.pMotionData || weights[s] <= 0.0f) continue;
+
+			SampleLayerPose(animation, state, l, layerPose);
+			BlendPose(pose, layerPose, weights[s], layer.BlendMode);
+		}
 	}
+
+	for (size_t i = 0; i < boneCount; ++i)
+	{
+		auto rotation = XMVectorSet(pose.Qx[i], pose.Qy[i], pose.Qz[i], pose.Qw[i]);
+		XMFLOAT3 move(pose.Tx[i], pose.Ty[i], pose.Tz[i]);
+		StoreBoneTransform(animation.Bones[i].pos, rotation, move, transforms[i]);
+	}
+
+	CalculateWorldTransforms(animation);
+	++animation.Stats.PoseEvaluationCount;
 }
 
-float PMDManager::Impl::CalculateFromBezierByHalfSolve(float x, const DirectX::XMFLOAT2& p1, const DirectX::XMFLOAT2& p2, size_t n)
+void PMDManager::Impl::CalculateWorldTransforms(PMDAnimation& animation)
 {
-	// (y = x) is a straight line -> do not need to calculate
-	if (p1.x == p1.y && p2.x == p2.y)
-		return x;
-	// Bezier method
-	float t = x;
-	float k0 = 3 * p1.x - 3 * p2.x + 1;         // t^3
-	float k1 = -6 * p1.x + 3 * p2.x;            // t^2
-	float k2 = 3 * p1.x;                        // t
+	auto& transforms = animation.Transforms;
+	const bool solveIK = !animation.IKSolver.Empty() && animation.IKIterations > 0;
+	// Skeleton pass overwrites local pose, IK needs it to rotate links
+	if (solveIK)
+		std::copy(transforms.begin(), transforms.end(), animation.Locals.begin());
+
+	animation.Skeleton.CalculateWorldTransforms(transforms.data());
+	if (!solveIK) return;
+
+	PMDIKSolveStats ikStats;
+	animation.IKSolver.Solve(animation.Locals.data(), transforms.data(), animation.IKIterations, ikStats);
+	animation.Stats.IKChainCount += ikStats.ChainCount;
+	animation.Stats.IKIterationCount += ikStats.IterationCount;
+	animation.Stats.IKConvergedChainCount += ikStats.ConvergedChainCount;
+}
 
-	constexpr float eplison = 0.00005f;
-	for (int i = 0; i < n; ++i)
+void PMDManager::Impl::UploadBonePalette(uint16_t modelIndex)
+{
+	auto& animation = m_animations[modelIndex];
+	auto& transforms = animation.Transforms;
+	auto& palette = animation.Palette;
+
+	// Write only the range of bones that changed since last upload
+	// Bones over shader's palette size aren't uploaded
+	size_t first = palette.size();
+	size_t last = 0;
+	for (size_t i = 0; i < palette.size(); ++i)
 	{
-		// f(t) = t*t*t*k0 + t*t*k1 + t*k2
-		// f = f(t) - x
-		// process [f(t) - x] to reach approximate 0
-		// => f -> ~0
-		// => |f| = ~eplison
-		auto f = t * t * t * k0 + t * t * k1 + t * k2 - x;
-		if (f >= -eplison || f <= eplison) break;
-		t -= f / 2;
+		if (std::memcmp(&transforms[i], &palette[i], sizeof(transforms[i])) == 0) continue;
+		first = (std::min)(first, i);
+		last = i;
 	}
+	if (first > last) return;
+
+	const auto stride = GetBoneStride(m_bonePaletteLayout);
+	const auto count = last - first + 1;
+	WriteBonePalette(m_bonePaletteLayout, &transforms[first], count, GetBonePalette(modelIndex) + first * stride);
+	animation.Stats.BoneUploadBytes += count * stride;
 
-	auto rt = 1 - t;
-	// y = f(t)
-	// t = g(x)
-	// -> y = f(g(x))
-	return t * t * t + 3 * (rt * rt) * t * p1.y + 3 * rt * (t * t) * p2.y;
+	std::copy(transforms.begin() + first, transforms.begin() + last + 1, palette.begin() + first);
 }
 
 
@@ -406,11 +1389,16 @@ bool PMDManager::Impl::Init(ID3D12GraphicsCommandList* cmdList)
 
 	if (!CheckDefaultBuffers()) return false;
 
+	WaitForPendingLoads();
+
 	m_texMng.SetDevice(m_device.Get());
 	CreateDefaultToonTextures(cmdList);
 
 	InitModels(cmdList);
 
+	// Thread calling Init becomes worker 0 and must be the one calling Update
+	m_jobSystem = std::make_unique<JobSystem>(m_workerCount);
+
 	m_updateFunc = &PMDManager::Impl::NormalUpdate;
 	m_renderFunc = &PMDManager::Impl::NormalRender;
 	m_renderDepthFunc = &PMDManager::Impl::DepthRender;
@@ -421,8 +1409,19 @@ bool PMDManager::Impl::Init(ID3D12GraphicsCommandList* cmdList)
 
 void PMDManager::Impl::InitModels(ID3D12GraphicsCommandList* cmdList)
 {
+	// Instances of models that failed to load go with them
+	m_instances.erase(std::remove_if(m_instances.begin(), m_instances.end(),
+		[this](const std::pair<std::string, std::string>& instance)
+		{
+			if (m_loaders.count(instance.second)) return false;
+			m_modelIndices.erase(instance.first);
+			return true;
+		}), m_instances.end());
+
 	// Init all models
-	const uint16_t model_count = m_loaders.size();
+	// Loaded models take the first indices in m_loaders' order, instances follow them
+	const uint16_t loader_count = static_cast<uint16_t>(m_loaders.size());
+	const uint16_t model_count = static_cast<uint16_t>(loader_count + m_instances.size());
 
 	uint16_t descriptor_count = 0;
 	uint16_t materials_descriptor_count = 0;
@@ -452,49 +1451,82 @@ void PMDManager::Impl::InitModels(ID3D12GraphicsCommandList* cmdList)
 	}
 
 	// Load model datas to Manager's resources
+	// Model index is the position of model's data in Manager's resources
 	uint16_t index = 0;
+	uint32_t materialDescriptorStart = 0;
 	m_resources.reserve(model_count);
 	m_renderResources.reserve(model_count);
+	m_materialDescriptorStarts.reserve(model_count);
 	for (auto& model : m_loaders)
 	{
 		auto& name = model.first;
 		auto& data = model.second;
 		m_resources.push_back(std::move(data.Resource));
 		m_renderResources.push_back(std::move(data.RenderResource));
+		m_materialDescriptorStarts.push_back(materialDescriptorStart);
+		materialDescriptorStart += data.MaterialDescriptorCount;
+		m_modelIndices[name] = index;
 		++index;
 	}
-	
-	// Create default bones matrices
-	m_defaultMatrices.reserve(512);
-	for (uint16_t i = 0; i < 512; ++i)
+	// Instance draws with its source's materials and textures, resources stay owned by the source
+	std::vector<uint16_t> sourceIndices;
+	sourceIndices.reserve(m_instances.size());
+	for (auto& instance : m_instances)
 	{
-		m_defaultMatrices.push_back(XMMatrixIdentity());
+		auto sourceIndex = m_modelIndices[instance.second];
+		sourceIndices.push_back(sourceIndex);
+		PMDRenderResource renderResource;
+		renderResource.SubMaterials = m_renderResources[sourceIndex].SubMaterials;
+		renderResource.MaterialsHeapOffset = m_renderResources[sourceIndex].MaterialsHeapOffset;
+		m_resources.emplace_back();
+		m_renderResources.push_back(std::move(renderResource));
+		m_materialDescriptorStarts.push_back(m_materialDescriptorStarts[sourceIndex]);
+		m_modelIndices[instance.first] = index;
+		++index;
 	}
-
+	
 	// Create object constant
-	m_objectConstant.Create(m_device.Get(), model_count, true);
+	// Size each model's constant to its bone count instead of the whole shader palette
+	// Shader reads beyond the view as zero, but vertices only use model's own bones
+	const auto bone_stride = GetBoneStride(m_bonePaletteLayout);
+	std::vector<size_t> boneCounts;
+	std::vector<size_t> objectConstantSizes;
+	boneCounts.reserve(model_count);
+	objectConstantSizes.reserve(model_count);
+	m_objectConstantOffsets.reserve(model_count);
+	size_t objectConstantBytes = 0;
+	auto addObjectConstant = [&](size_t boneCount)
+	{
+		auto size = D12Helper::AlignedConstantBufferMemory(sizeof(PMDObjectTransform) + boneCount * bone_stride);
+		m_objectConstantOffsets.push_back(objectConstantBytes);
+		boneCounts.push_back(boneCount);
+		objectConstantSizes.push_back(size);
+		objectConstantBytes += size;
+	};
+	for (auto& model : m_loaders)
+		addObjectConstant(GetPaletteBoneCount(model.second.Bones.size()));
+	for (auto sourceIndex : sourceIndices)
+		addObjectConstant(boneCounts[sourceIndex]);
+	m_objectConstant.Create(m_device.Get(), static_cast<uint32_t>(objectConstantBytes));
 	for (uint16_t i = 0; i < model_count; ++i)
 	{
-		auto hMappedData = m_objectConstant.GetHandleMappedData(i);
-		hMappedData->world = XMMatrixIdentity();
-		hMappedData->texTransform = XMMatrixIdentity();
-		std::copy(m_defaultMatrices.begin(), m_defaultMatrices.end(), hMappedData->bones);
+		auto pTransform = reinterpret_cast<PMDObjectTransform*>(m_objectConstant.GetHandleMappedData(static_cast<uint32_t>(m_objectConstantOffsets[i])));
+		pTransform->world = XMMatrixIdentity();
+		pTransform->texTransform = XMMatrixIdentity();
+		std::vector<XMFLOAT3X4> identityBones(boneCounts[i], identity_transform);
+		WriteBonePalette(m_bonePaletteLayout, identityBones.data(), identityBones.size(), GetBonePalette(i));
 	}
 
 	// Create object constant view
-	auto objectConstantAddress = m_objectConstant.GetGPUVirtualAddress();
-	const auto object_constant_element_size = m_objectConstant.ElementSize();
-
 	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-	cbvDesc.SizeInBytes = object_constant_element_size;
 	for (uint16_t i = 0; i < model_count; ++i)
 	{
-		cbvDesc.BufferLocation = objectConstantAddress;
+		cbvDesc.BufferLocation = m_objectConstant.GetGPUVirtualAddress(static_cast<uint32_t>(m_objectConstantOffsets[i]));
+		cbvDesc.SizeInBytes = static_cast<UINT>(objectConstantSizes[i]);
 		
 		m_device->CreateConstantBufferView(&cbvDesc, heapHandle);
 
 		heapHandle.Offset(1, heapSize);
-		objectConstantAddress += object_constant_element_size;
 	}
 
 	// Init model animation
@@ -503,8 +1535,32 @@ void PMDManager::Impl::InitModels(ID3D12GraphicsCommandList* cmdList)
 	{
 		auto& name = model.first;
 		auto& data = model.second;
-		m_animations.emplace_back(std::move(data.Bones), std::move(data.BonesTable));
+		m_animations.emplace_back(std::move(data.Bones), std::move(data.BonesTable), data.IKChains, data.IKLinks);
+		// Bounds for culling and animation LOD, morph vertices are moved to morpher below
+		auto& animation = m_animations.back();
+		animation.BoneBounds.Create(data.Vertices(), data.SkinWeights(), data.MorphVertices, animation.Palette.size());
+		animation.BoneBounds.GetRestBox(animation.BoxCenter, animation.BoxExtents);
+		m_morphers.emplace_back();
+		m_morphers.back().Create(std::move(data.Morphs), std::move(data.MorphVertices), data.Vertices());
+	}
+	// Instance has its own pose and no morphs, morphs would change vertices it shares with its source
+	for (size_t i = 0; i < m_instances.size(); ++i)
+	{
+		auto& source = m_loaders[m_instances[i].second];
+		auto& sourceAnimation = m_animations[sourceIndices[i]];
+		auto bones = sourceAnimation.Bones;
+		auto bonesTable = sourceAnimation.BonesTable;
+		auto boneBounds = sourceAnimation.BoneBounds;
+		m_animations.emplace_back(std::move(bones), std::move(bonesTable), source.IKChains, source.IKLinks);
+		auto& animation = m_animations.back();
+		animation.BoneBounds = std::move(boneBounds);
+		animation.BoneBounds.GetRestBox(animation.BoxCenter, animation.BoxExtents);
+		m_morphers.emplace_back();
 	}
+	m_isMorphDirty.assign(m_morphers.size(), 0);
+	m_worlds.resize(model_count);
+	for (auto& world : m_worlds)
+		XMStoreFloat4x4(&world, XMMatrixIdentity());
 
 	uint32_t indexCount = 0;
 	uint32_t vertexCount = 0;
@@ -517,13 +1573,29 @@ void PMDManager::Impl::InitModels(ID3D12GraphicsCommandList* cmdList)
 
 		m_mesh.DrawArgs[name].StartIndexLocation = indexCount;
 		m_mesh.DrawArgs[name].BaseVertexLocation = vertexCount;
-		m_mesh.DrawArgs[name].IndexCount = data.Indices().size();
-		indexCount += data.Indices().size();
+		const auto modelIndexCount = data.Indices32().empty() ? data.Indices().size() : data.Indices32().size();
+		m_mesh.DrawArgs[name].IndexCount = modelIndexCount;
+		indexCount += modelIndexCount;
 		vertexCount += data.Vertices().size();
 	}
-
-	m_mesh.Indices16.reserve(indexCount);
+	// Instances draw their source's range of the buffers
+	for (auto& instance : m_instances)
+		m_mesh.DrawArgs[instance.first] = m_mesh.DrawArgs[instance.second];
+
+	// One model with more than 0x10000 vertices moves the whole mesh to 32-bit indices
+	// and one with vertices on more than 2 bones moves it to FourBones layout
+	const bool hasIndices32 = std::any_of(m_loaders.begin(), m_loaders.end(),
+		[](const auto& model) { return !model.second.Indices32().empty(); });
+	const bool hasSkinWeights = std::any_of(m_loaders.begin(), m_loaders.end(),
+		[](const auto& model) { return !model.second.SkinWeights().empty(); });
+	m_vertexLayout = hasSkinWeights ? PMDVertexLayout::FourBones : PMDVertexLayout::TwoBones;
+	if (hasIndices32)
+		m_mesh.Indices32.reserve(indexCount);
+	else
+		m_mesh.Indices16.reserve(indexCount);
 	m_mesh.Vertices.reserve(vertexCount);
+	if (hasSkinWeights)
+		m_restSkinWeights.reserve(vertexCount);
 
 	// Add all vertices and indices to PMDMeshes
 	for (auto& model : m_loaders)
@@ -531,17 +1603,77 @@ void PMDManager::Impl::InitModels(ID3D12GraphicsCommandList* cmdList)
 		auto& name = model.first;;
 		auto& data = model.second;
 
-		for (const auto& index : data.Indices())
-			m_mesh.Indices16.push_back(index);
+		// Indices are a view in the mapped PMD file and may be unaligned
+		auto indices = data.Indices();
+		if (hasIndices32)
+		{
+			auto indices32 = data.Indices32();
+			m_mesh.Indices32.insert(m_mesh.Indices32.end(), indices32.begin(), indices32.end());
+			// 16-bit indices of the other models are widened
+			auto indexOffset = m_mesh.Indices32.size();
+			m_mesh.Indices32.resize(indexOffset + indices.size());
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				uint16_t index;
+				std::memcpy(&index, indices.Data + i, sizeof(index));
+				m_mesh.Indices32[indexOffset + i] = index;
+			}
+		}
+		else
+		{
+			auto indexOffset = m_mesh.Indices16.size();
+			m_mesh.Indices16.resize(indexOffset + indices.size());
+			std::memcpy(m_mesh.Indices16.data() + indexOffset, indices.Data, indices.size() * sizeof(uint16_t));
+		}
 
-		for (const auto& vertex : data.Vertices())
-			m_mesh.Vertices.push_back(vertex);
+		auto vertices = data.Vertices();
+		m_mesh.Vertices.insert(m_mesh.Vertices.end(), vertices.begin(), vertices.end());
+
+		if (!hasSkinWeights) continue;
+		auto skinWeights = data.SkinWeights();
+		if (skinWeights.empty())
+			std::transform(vertices.begin(), vertices.end(), std::back_inserter(m_restSkinWeights), ToSkinWeights);
+		else
+			m_restSkinWeights.insert(m_restSkinWeights.end(), skinWeights.begin(), skinWeights.end());
 	}
 
 	m_mesh.CreateBuffers(m_device.Get(), cmdList);
 	m_mesh.CreateViews();
+	// Vertex data is already copied to upload heap, keep it (without copying) for CPU skinning
+	m_restVertices = std::move(m_mesh.Vertices);
+
+	if (hasSkinWeights)
+	{
+		const auto sizeOfSkinWeights = sizeof(PMDSkinWeights) * m_restSkinWeights.size();
+		m_skinWeightBuffer.CreateBuffer(m_device.Get(), sizeOfSkinWeights);
+		m_skinWeightBuffer.SetUpSubresource(m_restSkinWeights.data(), sizeOfSkinWeights);
+		m_skinWeightBuffer.UpdateSubresource(m_device.Get(), cmdList);
+		m_skinWeightBufferView.BufferLocation = m_skinWeightBuffer.GetGPUVirtualAddress();
+		m_skinWeightBufferView.SizeInBytes = static_cast<UINT>(sizeOfSkinWeights);
+		m_skinWeightBufferView.StrideInBytes = sizeof(PMDSkinWeights);
+	}
+
+	// Model's range in vertex buffer
+	// and staging of morphed vertices, sized to the vertices morphs can move
+	m_baseVertices.resize(model_count);
+	m_vertexCounts.resize(model_count);
+	m_morphStagingOffsets.resize(model_count);
+	m_morphStagingSliceSize = 0;
+	for (auto& model : m_modelIndices)
+	{
+		auto index = model.second;
+		m_baseVertices[index] = m_mesh.DrawArgs[model.first].BaseVertexLocation;
+		m_vertexCounts[index] = index < loader_count ? static_cast<uint32_t>(m_loaders[model.first].Vertices().size()) : 0;
+		m_morphStagingOffsets[index] = m_morphStagingSliceSize;
+		m_morphStagingSliceSize += m_morphers[index].VertexCount() * sizeof(PMDVertex);
+	}
+	for (size_t i = 0; i < m_instances.size(); ++i)
+		m_vertexCounts[loader_count + i] = m_vertexCounts[sourceIndices[i]];
+	if (m_morphStagingSliceSize > 0)
+		m_morphStaging.Create(m_device.Get(), static_cast<uint32_t>(m_morphStagingSliceSize * morph_staging_slice_count));
 
 	m_loaders.clear();
+	m_instances.clear();
 }
 
 bool PMDManager::Impl::HasModel(std::string const& modelName)
@@ -557,14 +1689,58 @@ bool PMDManager::Impl::HasAnimation(std::string const& animationName)
 bool PMDManager::Impl::ClearSubresource()
 {
 	m_mesh.ClearSubresource();
+	m_skinWeightBuffer.ClearSubresource();
 	for (auto& model : m_loaders)
 		model.second.ClearSubresources();
 	return true;
 }
 
-PMDObjectConstant* PMDManager::Impl::GetObjectConstant(const std::string& modelName)
+PMDObjectTransform* PMDManager::Impl::GetObjectConstant(const std::string& modelName)
+{
+	auto offset = m_objectConstantOffsets[m_modelIndices[modelName]];
+	return reinterpret_cast<PMDObjectTransform*>(m_objectConstant.GetHandleMappedData(static_cast<uint32_t>(offset)));
+}
+
+bool PMDManager::Impl::TransformWorld(const std::string& modelName, const XMMATRIX& transform)
+{
+	auto index = m_modelIndices[modelName];
+	auto world = XMLoadFloat4x4(&m_worlds[index]) * transform;
+	XMStoreFloat4x4(&m_worlds[index], world);
+	GetObjectConstant(modelName)->world = world;
+	return true;
+}
+
+uint8_t* PMDManager::Impl::GetBonePalette(uint16_t modelIndex)
 {
-	return m_objectConstant.GetHandleMappedData(m_modelIndices[modelName]);
+	auto offset = m_objectConstantOffsets[modelIndex] + sizeof(PMDObjectTransform);
+	return m_objectConstant.GetHandleMappedData(static_cast<uint32_t>(offset));
+}
+
+ThreadPool& PMDManager::Impl::GetLoadPool()
+{
+	if (!m_loadPool)
+		m_loadPool = std::make_unique<ThreadPool>();
+	return *m_loadPool;
+}
+
+void PMDManager::Impl::WaitForPendingLoads()
+{
+	for (auto& load : m_pendingLoads)
+	{
+		if (load.Result.get()) continue;
+
+		if (load.IsModel)
+		{
+			m_loaders.erase(load.Name);
+			m_modelIndices.erase(load.Name);
+		}
+		else
+		{
+			m_motionDatas.erase(load.Name);
+		}
+	}
+	m_pendingLoads.clear();
+	m_loadPool.reset();
 }
 
 //
@@ -606,6 +1782,78 @@ bool PMDManager::SetDefaultBuffer(ID3D12Resource* pWhiteTexture, ID3D12Resource*
 	return true;
 }
 
+bool PMDManager::SetPoseCacheSize(size_t maxBytes)
+{
+	IMPL.m_poseCache.SetMaxBytes(maxBytes);
+	return true;
+}
+
+bool PMDManager::SetIKIterationBudget(uint32_t maxIterations)
+{
+	IMPL.m_ikIterationBudget = maxIterations;
+	// Cached poses were solved with the old budget
+	IMPL.m_poseCache.Clear();
+	return true;
+}
+
+bool PMDManager::SetSpringBoneBudget(uint32_t maxParticleSteps)
+{
+	IMPL.m_springStepBudget = maxParticleSteps;
+	return true;
+}
+
+bool PMDManager::SetAnimationWorkerCount(size_t workerCount)
+{
+	// Workers are created by Init
+	if (IMPL.m_isInitDone) return false;
+	IMPL.m_workerCount = workerCount;
+	return true;
+}
+
+bool PMDManager::SetMotionResampling(uint32_t samplesPerFrame, float maxAngleError, float maxLocationError)
+{
+	if (maxAngleError < 0.0f || maxLocationError < 0.0f) return false;
+	IMPL.m_motionSamplesPerFrame = samplesPerFrame;
+	IMPL.m_motionMaxAngleError = maxAngleError;
+	IMPL.m_motionMaxLocationError = maxLocationError;
+	return true;
+}
+
+bool PMDManager::SetMotionCompression(bool isEnabled, float maxAngleError, float maxLocationError)
+{
+	if (maxAngleError < 0.0f || maxLocationError < 0.0f) return false;
+	IMPL.m_isMotionCompressed = isEnabled;
+	IMPL.m_motionCompressionAngleError = maxAngleError;
+	IMPL.m_motionCompressionLocationError = maxLocationError;
+	return true;
+}
+
+bool PMDManager::SetAnimationLODScreenSizes(float lod1ScreenSize, float lod2ScreenSize)
+{
+	if (lod2ScreenSize < 0.0f || lod1ScreenSize < lod2ScreenSize) return false;
+	IMPL.m_lodScreenSizes[1] = lod1ScreenSize;
+	IMPL.m_lodScreenSizes[2] = lod2ScreenSize;
+	return true;
+}
+
+bool PMDManager::SetBonePaletteLayout(PMDBonePaletteLayout layout)
+{
+	// Object constants are already created with the old layout
+	if (IMPL.m_isInitDone) return false;
+	IMPL.m_bonePaletteLayout = layout;
+	return true;
+}
+
+PMDBonePaletteLayout PMDManager::GetBonePaletteLayout() const
+{
+	return IMPL.m_bonePaletteLayout;
+}
+
+PMDVertexLayout PMDManager::GetVertexLayout() const
+{
+	return IMPL.m_vertexLayout;
+}
+
 bool PMDManager::Init(ID3D12GraphicsCommandList* cmdList)
 {
 	return IMPL.Init(cmdList);
@@ -694,6 +1942,32 @@ bool PMDManager::SetViewDepth(ID3D12Resource* pViewDepthBuffer)
 	return true;
 }
 
+const PMDManagerStats& PMDManager::GetStats() const
+{
+	return m_impl->m_stats;
+}
+
+const PMDRenderStats& PMDManager::GetRenderStats() const
+{
+	return m_impl->m_renderStats;
+}
+
+bool PMDManager::BeginAnimationProfile()
+{
+	if (!IMPL.m_isInitDone) return false;
+	IMPL.m_profile = PMDAnimationProfile();
+	IMPL.m_isProfiling = true;
+	return true;
+}
+
+bool PMDManager::EndAnimationProfile(PMDAnimationProfile& profile)
+{
+	if (!IMPL.m_isProfiling) return false;
+	IMPL.m_isProfiling = false;
+	profile = IMPL.m_profile;
+	return true;
+}
+
 bool PMDManager::IsInitialized()
 {
 	return IMPL.m_isInitDone;
@@ -704,16 +1978,125 @@ bool PMDManager::CreateModel(const std::string& modelName, const char* modelFile
 	assert(!IMPL.HasModel(modelName));
 	if (IMPL.HasModel(modelName)) return false;
 	IMPL.m_loaders[modelName].SetDevice(IMPL.m_device.Get());
-	IMPL.m_loaders[modelName].Load(modelFilePath);
+	if (!IMPL.m_loaders[modelName].Load(modelFilePath))
+	{
+		IMPL.m_loaders.erase(modelName);
+		return false;
+	}
 	IMPL.m_modelIndices[modelName] = ++IMPL.m_count;
 	return true;
 }
 
+bool PMDManager::GetMotionCompressionStats(const std::string& animationName, VMDCompressionStats& stats)
+{
+	if (!IMPL.m_isInitDone) return false;
+	if (!IMPL.HasAnimation(animationName)) return false;
+	auto& compressionStats = IMPL.m_motionDatas[animationName].GetCompressionStats();
+	if (compressionStats.KeyframeCount == 0) return false;
+	stats = compressionStats;
+	return true;
+}
+
 bool PMDManager::CreateAnimation(const std::string& animationName, const char* animationFilePath)
 {
 	assert(!IMPL.HasAnimation(animationName));
 	if (IMPL.HasAnimation(animationName)) return false;
-	IMPL.m_motionDatas[animationName].Load(animationFilePath);
+	auto& motion = IMPL.m_motionDatas[animationName];
+	if (!motion.Load(animationFilePath))
+	{
+		IMPL.m_motionDatas.erase(animationName);
+		return false;
+	}
+	if (IMPL.m_isMotionCompressed)
+		motion.Compress(IMPL.m_motionCompressionAngleError, IMPL.m_motionCompressionLocationError);
+	if (IMPL.m_motionSamplesPerFrame > 0)
+		motion.Resample(IMPL.m_motionSamplesPerFrame, IMPL.m_motionMaxAngleError, IMPL.m_motionMaxLocationError);
+	return true;
+}
+
+bool PMDManager::CreateModelInstance(const std::string& instanceName, const std::string& sourceModelName)
+{
+	// Instances are built with models by Init
+	if (IMPL.m_isInitDone) return false;
+	assert(!IMPL.HasModel(instanceName));
+	if (IMPL.HasModel(instanceName) || !IMPL.HasModel(sourceModelName)) return false;
+
+	// Instance of an instance shares the same loaded model
+	auto source = sourceModelName;
+	for (auto& instance : IMPL.m_instances)
+	{
+		if (instance.first == sourceModelName)
+			source = instance.second;
+	}
+	IMPL.m_instances.emplace_back(instanceName, source);
+	IMPL.m_modelIndices[instanceName] = ++IMPL.m_count;
+	return true;
+}
+
+std::shared_future<bool> PMDManager::CreateModelAsync(const std::string& modelName, const char* modelFilePath)
+{
+	assert(!IMPL.HasModel(modelName));
+	if (IMPL.HasModel(modelName)) return {};
+
+	// Insert model on calling thread, worker only fills its data
+	// -> reference to model stays valid while other models are inserted
+	auto& model = IMPL.m_loaders[modelName];
+	model.SetDevice(IMPL.m_device.Get());
+	IMPL.m_modelIndices[modelName] = ++IMPL.m_count;
+
+	std::string path = modelFilePath;
+	auto result = IMPL.GetLoadPool().Submit([&model, path]() { return model.Load(path.c_str()); }).share();
+	IMPL.m_pendingLoads.push_back({ modelName, true, result });
+	return result;
+}
+
+std::shared_future<bool> PMDManager::CreateAnimationAsync(const std::string& animationName, const char* animationFilePath)
+{
+	assert(!IMPL.HasAnimation(animationName));
+	if (IMPL.HasAnimation(animationName)) return {};
+
+	auto& motion = IMPL.m_motionDatas[animationName];
+	std::string path = animationFilePath;
+	auto isCompressed = IMPL.m_isMotionCompressed;
+	auto compressionAngleError = IMPL.m_motionCompressionAngleError;
+	auto compressionLocationError = IMPL.m_motionCompressionLocationError;
+	auto samplesPerFrame = IMPL.m_motionSamplesPerFrame;
+	auto maxAngleError = IMPL.m_motionMaxAngleError;
+	auto maxLocationError = IMPL.m_motionMaxLocationError;
+	auto result = IMPL.GetLoadPool().Submit([&motion, path, isCompressed, compressionAngleError, compressionLocationError,
+		samplesPerFrame, maxAngleError, maxLocationError]()
+		{
+			if (!motion.Load(path.c_str())) return false;
+			if (isCompressed)
+				motion.Compress(compressionAngleError, compressionLocationError);
+			return samplesPerFrame == 0 || motion.Resample(samplesPerFrame, maxAngleError, maxLocationError);
+		}).share();
+	IMPL.m_pendingLoads.push_back({ animationName, false, result });
+	return result;
+}
+
+void PMDManager::SetCamera(const XMFLOAT4X4& view, const XMFLOAT4X4& proj)
+{
+	XMStoreFloat4x4(&IMPL.m_viewProj, XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj));
+	IMPL.m_projScaleY = proj._22;
+	IMPL.m_hasCamera = true;
+}
+
+void PMDManager::SetShadowCamera(const XMFLOAT4X4& lightViewProj)
+{
+	IMPL.m_shadowViewProj = lightViewProj;
+	IMPL.m_hasShadowCamera = true;
+}
+
+bool PMDManager::GetModelBounds(const std::string& modelName, XMFLOAT3& center, XMFLOAT3& extents)
+{
+	if (!IMPL.m_isInitDone) return false;
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+
+	auto& animation = IMPL.m_animations[IMPL.m_modelIndices[modelName]];
+	center = animation.BoxCenter;
+	extents = animation.BoxExtents;
 	return true;
 }
 
@@ -732,61 +2115,265 @@ void PMDManager::RenderDepth(ID3D12GraphicsCommandList* cmdList)
 	IMPL.RenderDepth(cmdList);
 }
 
-bool PMDManager::Play(const std::string& modelName, const std::string& animationName)
+bool PMDManager::SetMorphWeight(const std::string& modelName, const std::string& morphName, float weight)
+{
+	if (!IMPL.m_isInitDone) return false;
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+
+	auto& morpher = IMPL.m_morphers[IMPL.m_modelIndices[modelName]];
+	return morpher.SetWeight(morpher.FindMorph(morphName), weight);
+}
+
+bool PMDManager::EnableSpringBones(const std::string& modelName, const std::vector<std::string>& boneNames,
+	const PMDSpringParams& params)
+{
+	if (!IMPL.m_isInitDone) return false;
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+
+	auto& animation = IMPL.m_animations[IMPL.m_modelIndices[modelName]];
+	return animation.Springs.Create(animation.Bones, animation.Skeleton, animation.BonesTable, boneNames, params);
+}
+
+bool PMDManager::DisableSpringBones(const std::string& modelName)
+{
+	if (!IMPL.m_isInitDone) return false;
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+
+	IMPL.m_animations[IMPL.m_modelIndices[modelName]].Springs = PMDSpringBones();
+	return true;
+}
+
+bool PMDManager::GetSkinnedVertices(const std::string& modelName, std::vector<PMDSkinnedVertex>& skinnedVertices)
+{
+	if (!IMPL.m_isInitDone) return false;
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+
+	auto index = IMPL.m_modelIndices[modelName];
+	auto& animation = IMPL.m_animations[index];
+	auto& morpher = IMPL.m_morphers[index];
+	const auto vertexCount = IMPL.m_vertexCounts[index];
+	auto vertices = IMPL.m_restVertices.data() + IMPL.m_baseVertices[index];
+	// Morpher only moves positions, skin weights of every range are the rest ones
+	auto skinWeights = IMPL.m_restSkinWeights.empty() ? nullptr : IMPL.m_restSkinWeights.data() + IMPL.m_baseVertices[index];
+	skinnedVertices.resize(vertexCount);
+
+	// Model without pose is at rest, empty palette skins every vertex with identity
+	const auto boneCount = animation.HasPose ? animation.Transforms.size() : 0;
+	auto transforms = animation.Transforms.data();
+	auto& jobSystem = *IMPL.m_jobSystem;
+
+	// Blend the same way as the vertex shader
+	const bool isDualQuaternion = IMPL.m_bonePaletteLayout == PMDBonePaletteLayout::DualQuaternion;
+	std::vector<PMDDualQuaternion> dualQuaternions;
+	PMDSkinningPalette palette;
+	if (isDualQuaternion)
+	{
+		dualQuaternions.resize(boneCount);
+		ToDualQuaternions(transforms, boneCount, dualQuaternions.data());
+	}
+	else
+	{
+		// Once for all three ranges
+		palette.Create(transforms, boneCount);
+	}
+	auto skin = [&](const PMDVertex* source, size_t first, size_t count)
+	{
+		auto pDestination = skinnedVertices.data() + first;
+		auto sourceWeights = skinWeights ? skinWeights + first : nullptr;
+		if (isDualQuaternion)
+			SkinVerticesDualQuaternionReference(source, sourceWeights, count, dualQuaternions.data(), boneCount, pDestination);
+		else if (sourceWeights)
+			SkinVertices(jobSystem, source, sourceWeights, count, palette, pDestination);
+		else
+			SkinVertices(jobSystem, source, count, palette, pDestination);
+	};
+
+	// Vertices morphs can move come from morpher, the rest are at rest position
+	const auto morphFirst = morpher.Empty() ? vertexCount : morpher.FirstVertex();
+	const auto morphEnd = morpher.Empty() ? vertexCount : morphFirst + morpher.VertexCount();
+	skin(vertices, 0, morphFirst);
+	skin(morpher.Vertices(), morphFirst, morphEnd - morphFirst);
+	skin(vertices + morphEnd, morphEnd, vertexCount - morphEnd);
+	return true;
+}
+
+bool PMDManager::Play(const std::string& modelName, const std::string& animationName, float fadeTime)
+{
+	return PlayLayer(modelName, 0, animationName, PMDLayerBlendMode::Override, fadeTime);
+}
+
+bool PMDManager::PlayLayer(const std::string& modelName, uint8_t layer, const std::string& animationName,
+	PMDLayerBlendMode blendMode, float fadeTime)
 {
 	if (!IMPL.m_isInitDone) return false;
 	assert(IMPL.HasModel(modelName));
 	if (!IMPL.HasModel(modelName)) return false;
 	assert(IMPL.HasAnimation(animationName));
 	if (!IMPL.HasAnimation(animationName)) return false;
+	if (layer >= pmd_animation_layer_count) return false;
 
-	IMPL.m_animations[IMPL.m_modelIndices[modelName]].pMotionData = &IMPL.m_motionDatas[animationName];
+	auto& animation = IMPL.m_animations[IMPL.m_modelIndices[modelName]];
+	auto& animationLayer = animation.Layers[layer];
+	// New or stopping layer comes back at full weight
+	if (!animationLayer.IsActive() || animationLayer.Stopping)
+	{
+		animationLayer.Weight = 1.0f;
+		animationLayer.TargetWeight = 1.0f;
+		animationLayer.Stopping = false;
+	}
+
+	if (fadeTime > 0.0f)
+	{
+		// Crossfade in progress -> new motion fades in from the pose layer has now
+		// Dropping either motion would make the pose jump
+		if (animationLayer.Fade < 1.0f && animationLayer.IsActive())
+		{
+			IMPL.FreezeLayerPose(animation, layer);
+		}
+		else
+		{
+			// Current motion keeps playing under the new one until crossfade finishes
+			// Layer without motion fades in over the layers below
+			std::swap(animationLayer.Previous, animationLayer.Current);
+			animationLayer.HasFadeFrom = false;
+		}
+		animationLayer.Fade = 0.0f;
+		animationLayer.FadeSpeed = 1.0f / fadeTime;
+	}
+	else
+	{
+		animationLayer.Previous.pMotionData = nullptr;
+		animationLayer.HasFadeFrom = false;
+		animationLayer.Fade = 1.0f;
+	}
+	animationLayer.BlendMode = blendMode;
+	animation.pBakedClip = nullptr;
+	IMPL.BindMotion(animation, animationLayer.Current, &IMPL.m_motionDatas[animationName]);
+	// New motion may start at the tick of the old one
+	animation.SampledTick = no_tick;
 
 	return true;
 }
 
-bool PMDManager::Move(const std::string& modelName, float moveX, float moveY, float moveZ)
+bool PMDManager::BakeAnimation(const std::string& clipName, const std::string& modelName,
+	const std::string& animationName, float frameRate, PMDBakeEncoding encoding)
 {
+	if (!IMPL.m_isInitDone) return false;
 	assert(IMPL.HasModel(modelName));
 	if (!IMPL.HasModel(modelName)) return false;
-	auto& world = IMPL.GetObjectConstant(modelName)->world;
-	world *= XMMatrixTranslation(moveX, moveY, moveZ);
+	assert(IMPL.HasAnimation(animationName));
+	if (!IMPL.HasAnimation(animationName)) return false;
+	if (frameRate <= 0.0f) return false;
+
+	return IMPL.BakeAnimation(clipName, IMPL.m_modelIndices[modelName], IMPL.m_motionDatas[animationName],
+		frameRate, encoding);
+}
+
+bool PMDManager::PlayBaked(const std::string& modelName, const std::string& clipName)
+{
+	if (!IMPL.m_isInitDone) return false;
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+	auto it = IMPL.m_bakedClips.find(clipName);
+	if (it == IMPL.m_bakedClips.end()) return false;
+
+	// Clip only fits models with the skeleton it was baked for
+	auto& animation = IMPL.m_animations[IMPL.m_modelIndices[modelName]];
+	auto& clip = it->second;
+	if (clip.SkeletonSignature() != animation.Skeleton.Signature() || clip.BoneCount() != animation.Transforms.size())
+		return false;
+
+	for (auto& layer : animation.Layers)
+	{
+		layer.Current.pMotionData = nullptr;
+		layer.Previous.pMotionData = nullptr;
+		layer.HasFadeFrom = false;
+		layer.Stopping = false;
+	}
+	animation.pBakedClip = &clip;
+	animation.BakedTime = 0.0f;
+	animation.SampledTick = no_tick;
 	return true;
 }
 
-bool PMDManager::RotateX(const std::string& modelName, float angle)
+bool PMDManager::SetLayerWeight(const std::string& modelName, uint8_t layer, float weight, float fadeTime)
 {
+	if (!IMPL.m_isInitDone) return false;
 	assert(IMPL.HasModel(modelName));
 	if (!IMPL.HasModel(modelName)) return false;
-	auto& world = IMPL.GetObjectConstant(modelName)->world;
-	world *= XMMatrixRotationX(angle);
+	if (layer >= pmd_animation_layer_count || weight < 0.0f) return false;
+
+	auto& animationLayer = IMPL.m_animations[IMPL.m_modelIndices[modelName]].Layers[layer];
+	animationLayer.TargetWeight = weight;
+	animationLayer.Stopping = false;
+	if (fadeTime > 0.0f)
+		animationLayer.WeightSpeed = std::abs(weight - animationLayer.Weight) / fadeTime;
+	else
+		animationLayer.Weight = weight;
+
 	return true;
 }
 
-bool PMDManager::RotateY(const std::string& modelName, float angle)
+bool PMDManager::SetLayerTime(const std::string& modelName, uint8_t layer, float time)
 {
+	if (!IMPL.m_isInitDone) return false;
 	assert(IMPL.HasModel(modelName));
 	if (!IMPL.HasModel(modelName)) return false;
-	auto& world = IMPL.GetObjectConstant(modelName)->world;
-	world *= XMMatrixRotationY(angle);
+	if (layer >= pmd_animation_layer_count || time < 0.0f) return false;
+
+	auto& animation = IMPL.m_animations[IMPL.m_modelIndices[modelName]];
+	auto& animationLayer = animation.Layers[layer];
+	if (!animationLayer.Current.pMotionData) return false;
+	// Track cursors find the new keyframes with binary search
+	animationLayer.Current.Time = time;
+	animation.SampledTick = no_tick;
+	return true;
+}
+
+bool PMDManager::StopLayer(const std::string& modelName, uint8_t layer, float fadeTime)
+{
+	if (!SetLayerWeight(modelName, layer, 0.0f, fadeTime)) return false;
+	// Motions are released by next Update when weight reaches 0
+	IMPL.m_animations[IMPL.m_modelIndices[modelName]].Layers[layer].Stopping = true;
 	return true;
 }
 
+bool PMDManager::Move(const std::string& modelName, float moveX, float moveY, float moveZ)
+{
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+	return IMPL.TransformWorld(modelName, XMMatrixTranslation(moveX, moveY, moveZ));
+}
+
+bool PMDManager::RotateX(const std::string& modelName, float angle)
+{
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+	return IMPL.TransformWorld(modelName, XMMatrixRotationX(angle));
+}
+
+bool PMDManager::RotateY(const std::string& modelName, float angle)
+{
+	assert(IMPL.HasModel(modelName));
+	if (!IMPL.HasModel(modelName)) return false;
+	return IMPL.TransformWorld(modelName, XMMatrixRotationY(angle));
+}
+
 bool PMDManager::RotateZ(const std::string& modelName, float angle)
 {
 	assert(IMPL.HasModel(modelName));
 	if (!IMPL.HasModel(modelName)) return false;
-	auto& world = IMPL.GetObjectConstant(modelName)->world;
-	world *= XMMatrixRotationZ(angle);
-	return true;
+	return IMPL.TransformWorld(modelName, XMMatrixRotationZ(angle));
 }
 
 bool PMDManager::Scale(const std::string& modelName, float scaleX, float scaleY, float scaleZ)
 {
 	assert(IMPL.HasModel(modelName));
 	if (!IMPL.HasModel(modelName)) return false;
-	auto& world = IMPL.GetObjectConstant(modelName)->world;
-	world *= XMMatrixScaling(scaleX, scaleY, scaleZ);
-	return true;
+	return IMPL.TransformWorld(modelName, XMMatrixScaling(scaleX, scaleY, scaleZ));
 }
 
@@ -1,6 +1,91 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <future>
 #include <d3d12.h>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "PMDBonePalette.h"
+#include "PMDPose.h"
+#include "PMDSkinning.h"
+#include "PMDBakedPalettes.h"
+#include "PMDSpringBones.h"
+#include "VMD/VMDMotion.h"
+
+// Animation level of detail, picked from model's size on screen
+// LOD 0 is updated every frame with all bones
+// Higher LODs are updated less often and short bone chains (fingers, hair tips...) follow their parent
+constexpr size_t pmd_animation_lod_count = 3;
+// Motions blended on one model, layer 0 is the base layer driven by Play
+constexpr size_t pmd_animation_layer_count = 4;
+
+// Counters of the last PMD Manager's Update
+struct PMDManagerStats
+{
+	// Models whose bone transforms were recalculated
+	uint32_t AnimatedModelCount = 0;
+	// Bytes of bone palettes written to upload heap
+	uint64_t BoneUploadBytes = 0;
+	// Poses sampled from motion and poses reused from pose cache
+	uint32_t PoseEvaluationCount = 0;
+	uint32_t PoseCacheHitCount = 0;
+	// Models with motion at each animation LOD
+	uint32_t LODModelCount[pmd_animation_lod_count] = {};
+	// Model updates skipped by LOD's update interval
+	uint32_t LODSkippedUpdateCount[pmd_animation_lod_count] = {};
+	// Bone tracks left out of evaluated poses by LOD
+	uint32_t LODSkippedBoneCount[pmd_animation_lod_count] = {};
+	// IK chains solved, CCD iterations run on them
+	// and chains whose effector reached its target
+	uint32_t IKChainCount = 0;
+	uint32_t IKIterationCount = 0;
+	uint32_t IKConvergedChainCount = 0;
+	// Models that got fewer CCD iterations than their chains ask for from IK iteration budget
+	uint32_t IKBudgetLimitedModelCount = 0;
+	// Poses looked up from baked clips
+	uint32_t BakedPoseCount = 0;
+	// Models whose morphs were re-evaluated, morphs active in them
+	// and vertex offsets accumulated
+	uint32_t MorphEvaluationCount = 0;
+	uint32_t ActiveMorphCount = 0;
+	uint32_t MorphVertexCount = 0;
+	// Bytes of morphed vertices copied to vertex buffer by Render after this Update
+	uint64_t MorphUploadBytes = 0;
+	// Spring bone particles simulated, particles x fixed steps run on them
+	// and models that got fewer steps than they needed from spring step budget
+	uint32_t SpringParticleCount = 0;
+	uint32_t SpringStepCount = 0;
+	uint32_t SpringBudgetLimitedModelCount = 0;
+	// Wall time of Update, time workers spent in models' pose update (summed over workers)
+	// and bones of models updated, ns per bone is AnimationWorkerNanoseconds / AnimatedBoneCount
+	uint64_t UpdateNanoseconds = 0;
+	uint64_t AnimationWorkerNanoseconds = 0;
+	uint32_t AnimatedBoneCount = 0;
+	uint32_t WorkerCount = 0;
+};
+
+// Counters of the last Render and RenderDepth
+struct PMDRenderStats
+{
+	// Models skipped because their box is outside camera (Render) or light (RenderDepth)
+	uint32_t CulledModelCount = 0;
+	uint32_t ShadowCulledModelCount = 0;
+};
+
+// Sums of PMDManagerStats over the updates of an animation profile
+struct PMDAnimationProfile
+{
+	uint32_t UpdateCount = 0;
+	uint64_t UpdateNanoseconds = 0;
+	uint64_t MaxUpdateNanoseconds = 0;
+	uint64_t AnimationWorkerNanoseconds = 0;
+	uint64_t AnimatedModelCount = 0;
+	uint64_t AnimatedBoneCount = 0;
+	uint64_t PoseEvaluationCount = 0;
+	uint64_t PoseCacheHitCount = 0;
+	uint64_t BoneUploadBytes = 0;
+	uint32_t WorkerCount = 0;
+};
 
 class PMDManager
 {
@@ -23,6 +108,44 @@ public:
 	// 3: GRADIENT TEXTURE
 	bool SetDefaultBuffer(ID3D12Resource* pWhiteTexture, ID3D12Resource* pBlackTexture,
 		ID3D12Resource* pGradTexture);
+	// Default is Matrix4x4, call before Init
+	// Affine3x4 needs vertex shader compiled with BONE_PALETTE_3X4
+	// DualQuaternion needs vertex shader compiled with BONE_PALETTE_DQ
+	// Set pipeline built for GetBonePaletteLayout before Render / RenderDepth
+	// Compare BoneUploadBytes of stats between layouts
+	bool SetBonePaletteLayout(PMDBonePaletteLayout layout);
+	PMDBonePaletteLayout GetBonePaletteLayout() const;
+	// FourBones after Init when a model has vertices on more than 2 bones (PMX)
+	// Its pipeline needs input layout with the PMDSkinWeights stream and vertex shader compiled with SKIN_4_BONES
+	PMDVertexLayout GetVertexLayout() const;
+	// Byte budget of poses shared between models playing the same motion
+	// 0 disables pose sharing
+	bool SetPoseCacheSize(size_t maxBytes);
+	// CCD iterations of IK chains of all models per update
+	// Each model takes up to the sum of its chains' iteration counts in PMD, in update order
+	// Models over it get fewer iterations, their feet may slide (see IKBudgetLimitedModelCount of stats)
+	// Models taking their pose from pose cache don't use any
+	// Default is 16384, 0 disables IK
+	bool SetIKIterationBudget(uint32_t maxIterations);
+	// Drop keyframes of animations created after this call where their neighbours' bezier segment
+	// stays within maxAngleError (radian) and maxLocationError, and pack rotations in 48 bits
+	// Footprint before and after is kept per animation (see GetMotionCompressionStats)
+	bool SetMotionCompression(bool isEnabled, float maxAngleError = 0.005f, float maxLocationError = 0.01f);
+	// Particles x fixed 60 Hz steps of spring bones of all models per update
+	// Models over it get fewer steps, their chains slow down instead of the frame (see SpringStepCount of stats)
+	// Default is 65536
+	bool SetSpringBoneBudget(uint32_t maxParticleSteps);
+	// Threads updating animations, including the one calling Update
+	// Default 0 is one per hardware thread, set it before Init to measure multi-thread scaling
+	bool SetAnimationWorkerCount(size_t workerCount);
+	// Resample animations created after this call to samplesPerFrame samples per motion frame (30 fps)
+	// Sampling becomes two reads and a lerp instead of keyframe search and bezier evaluation
+	// Tracks are stored in 16 bit where error stays within maxAngleError (radian) and maxLocationError
+	// 0 samples per frame (default) keeps keyframes
+	bool SetMotionResampling(uint32_t samplesPerFrame, float maxAngleError = 0.001f, float maxLocationError = 0.001f);
+	// Fraction of screen height covered by model under which LOD 1 and LOD 2 are used
+	// Default is 0.25 and 0.1
+	bool SetAnimationLODScreenSizes(float lod1ScreenSize, float lod2ScreenSize);
 
 	// Need to set up all resource for PMD Manager BEFORE initialize it
 	bool Init(ID3D12GraphicsCommandList* cmdList);
@@ -40,15 +163,55 @@ public:
 	bool CreateModel(const std::string& modelName, const char* modelFilePath);
 	bool CreateAnimation(const std::string& animationName, const char* animationFilePath);
 
+	/// <summary>
+	/// <para>Load model (PMD parsing and texture decoding) on worker threads and return immediately</para>
+	/// <para>Init waits for all asynchronous loads before building models</para>
+	/// </summary>
+	/// <returns>
+	/// <para>Result of loading, TRUE if model is loaded</para>
+	/// Invalid future if given name of model is already created
+	/// </returns>
+	std::shared_future<bool> CreateModelAsync(const std::string& modelName, const char* modelFilePath);
+	/// <summary>
+	/// <para>Add a model drawn from an already created model's data, nothing is loaded again</para>
+	/// <para>Instance has its own pose, motions, spring bones and world</para>
+	/// <para>Vertices, textures and materials are shared, morphs stay on the source model</para>
+	/// </summary>
+	/// <returns>
+	/// <para>FALSE if instance name is already created, source model isn't created</para>
+	/// Or PMD Manager is initialized
+	/// </returns>
+	bool CreateModelInstance(const std::string& instanceName, const std::string& sourceModelName);
+	std::shared_future<bool> CreateAnimationAsync(const std::string& animationName, const char* animationFilePath);
+
 	/// <summary>
 	/// <para>Clear all resources that updated to default buffer.</para>
 	/// <para>Call AFTER GPU updated subresources to default buffer.</para>
 	/// </summary>
 	bool ClearSubresources();
 public:
+	// Camera used to pick animation LOD, set it before Update
+	// Models are animated at LOD 0 until camera is set
+	// Render also culls models outside it
+	void SetCamera(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj);
+	// View projection of shadow map, RenderDepth culls models outside it
+	// Nothing is culled until these are set
+	void SetShadowCamera(const DirectX::XMFLOAT4X4& lightViewProj);
 	void Update(const float& deltaTime);
 	void Render(ID3D12GraphicsCommandList* cmdList);
 
+	// Counters of the last Update
+	const PMDManagerStats& GetStats() const;
+	// Counters of the last Render and RenderDepth, each reset when its pass starts
+	const PMDRenderStats& GetRenderStats() const;
+	// Keyframes and footprint of animation before and after compression (see SetMotionCompression)
+	// FALSE if animation doesn't exist or wasn't compressed, async animations are ready after Init
+	bool GetMotionCompressionStats(const std::string& animationName, VMDCompressionStats& stats);
+	// Sum stats of every Update from BeginAnimationProfile to EndAnimationProfile
+	// PMDBench's CrowdAnimation turns them into ns/bone, bones/s per thread, parallel efficiency...
+	bool BeginAnimationProfile();
+	bool EndAnimationProfile(PMDAnimationProfile& profile);
+
 	// Function use for taking models depth value
 	// This function DON'T set up ITS own PIPELINE
 	// or any pipeline
@@ -56,16 +219,77 @@ public:
 	void RenderDepth(ID3D12GraphicsCommandList* cmdList);
 
 	/// <summary>
-	/// Play animation
+	/// Play animation on base layer
 	/// <para>Need to use after PMDManager is initialized</para>
 	/// </summary>
 	/// <param name="modelName: ">name of model</param>
 	/// <param name="animationName: ">name of animation</param>
+	/// <param name="fadeTime: ">seconds to crossfade from current animation, 0 switches at once</param>
 	/// <returns>
 	/// <para> FALSE: if the name in one of the two variable is unvalid </para>
 	/// <para> or miss order between model and animation </para>
 	/// </returns>
-	bool Play(const std::string& modelName, const std::string& animationName);
+	bool Play(const std::string& modelName, const std::string& animationName, float fadeTime = 0.0f);
+	/// <summary>
+	/// Play animation on layer (0 ~ pmd_animation_layer_count - 1)
+	/// <para>Layers are blended in order over the layers below them by their weight</para>
+	/// <para>Override layer above the base only drives the bones its animation has</para>
+	/// <para>Playing during a crossfade fades in from the pose layer has at that moment</para>
+	/// </summary>
+	bool PlayLayer(const std::string& modelName, uint8_t layer, const std::string& animationName,
+		PMDLayerBlendMode blendMode = PMDLayerBlendMode::Override, float fadeTime = 0.0f);
+	/// <summary>
+	/// Sample animation on model's skeleton at frameRate into a clip of bone palettes
+	/// <para>Clip plays on every model with the same skeleton (see PlayBaked)</para>
+	/// <para>Baking the same clip name again replaces the clip, models playing it switch to the new frames</para>
+	/// </summary>
+	/// <returns>FALSE if clip name is already baked for another skeleton</returns>
+	bool BakeAnimation(const std::string& clipName, const std::string& modelName, const std::string& animationName,
+		float frameRate = 30.0f, PMDBakeEncoding encoding = PMDBakeEncoding::Float);
+	/// <summary>
+	/// Play baked clip, replacing model's layers
+	/// <para>Each update only looks up the clip's frame at model's time, no motion sampling</para>
+	/// <para>Play or PlayLayer switches back to motion sampling</para>
+	/// </summary>
+	/// <returns>FALSE if clip doesn't exist or was baked for another skeleton</returns>
+	bool PlayBaked(const std::string& modelName, const std::string& clipName);
+	// Move layer's weight to weight over fadeTime seconds
+	bool SetLayerWeight(const std::string& modelName, uint8_t layer, float weight, float fadeTime = 0.0f);
+	// Fade layer's weight to 0 over fadeTime seconds then stop its animation
+	bool StopLayer(const std::string& modelName, uint8_t layer, float fadeTime = 0.0f);
+	// Seek layer's current motion to time seconds from its start
+	bool SetLayerTime(const std::string& modelName, uint8_t layer, float time);
+
+	/// <summary>
+	/// Set weight of model's morph (facial skin), 0 is rest and 1 is full morph
+	/// <para>Need to use after PMDManager is initialized</para>
+	/// </summary>
+	/// <returns>FALSE if model doesn't have morph of that name</returns>
+	bool SetMorphWeight(const std::string& modelName, const std::string& morphName, float weight);
+
+	/// <summary>
+	/// Simulate model's hair, skirt... chains as springs on top of its animation
+	/// <para>boneNames are exact bone names (the bone and all bones under it)</para>
+	/// <para>or parts of bone names (Shift-JIS, matched whole characters), empty selects hair and skirt bones</para>
+	/// <para>Chains keep simulating when model has no motion, on its rest pose</para>
+	/// <para>Need to use after PMDManager is initialized, calling it again replaces the chains</para>
+	/// </summary>
+	/// <returns>FALSE if no bone is selected</returns>
+	bool EnableSpringBones(const std::string& modelName, const std::vector<std::string>& boneNames = {},
+		const PMDSpringParams& params = PMDSpringParams());
+	bool DisableSpringBones(const std::string& modelName);
+
+	/// <summary>
+	/// Skin model's vertices on CPU with its current pose and morphs
+	/// <para>Same math as VS.hlsl, in model space (world isn't applied)</para>
+	/// <para>Use for validation without GPU, bounds and picking</para>
+	/// </summary>
+	bool GetSkinnedVertices(const std::string& modelName, std::vector<PMDSkinnedVertex>& skinnedVertices);
+	/// <summary>
+	/// Axis aligned box of model's current pose in model space (world isn't applied)
+	/// <para>Union of per-bone boxes moved by bone transforms, contains every skinned vertex</para>
+	/// </summary>
+	bool GetModelBounds(const std::string& modelName, DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents);
 
 	// Move models
 	bool Move(const std::string& modelName, float moveX, float moveY, float moveZ);
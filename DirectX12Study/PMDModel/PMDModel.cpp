@@ -36,21 +36,31 @@ PMDModel::~PMDModel()
 void PMDModel::CreateModel(ID3D12GraphicsCommandList* cmdList, CD3DX12_CPU_DESCRIPTOR_HANDLE& heapHandle)
 {
 	auto heapSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	LoadTextureToBuffer();
+	SetDefaultToonTexturesToMissingToons();
 	CreateMaterialAndTextureBuffer(cmdList, heapHandle);
 	heapHandle.Offset(RenderResource.MaterialsHeapOffset, heapSize);
 }
 
-const std::vector<uint16_t>& PMDModel::Indices() const
+ArrayView<uint16_t> PMDModel::Indices() const
 {
 	return m_pmdLoader->Indices;
 }
 
-const std::vector<PMDVertex>& PMDModel::Vertices() const
+ArrayView<uint32_t> PMDModel::Indices32() const
+{
+	return m_pmdLoader->Indices32;
+}
+
+ArrayView<PMDVertex> PMDModel::Vertices() const
 {
 	return m_pmdLoader->Vertices;
 }
 
+ArrayView<PMDSkinWeights> PMDModel::SkinWeights() const
+{
+	return m_pmdLoader->SkinWeights;
+}
+
 void PMDModel::ClearSubresources()
 {
 	m_pmdLoader.reset();
@@ -76,9 +86,15 @@ void PMDModel::SetDefaultToonTextures(TextureManager* defaultToonTextutures)
 
 bool PMDModel::Load(const char* path)
 {
-	m_pmdLoader->Load(path);
+	if (!m_pmdLoader->Load(path)) return false;
+	// Textures are decoded here so that loading can run on worker threads
+	LoadTextureToBuffer();
 	Bones = std::move(m_pmdLoader->Bones);
 	BonesTable = std::move(m_pmdLoader->BonesTable);
+	IKChains = std::move(m_pmdLoader->IKChains);
+	IKLinks = std::move(m_pmdLoader->IKLinks);
+	Morphs = std::move(m_pmdLoader->Morphs);
+	MorphVertices = std::move(m_pmdLoader->MorphVertices);
 	RenderResource.SubMaterials = std::move(m_pmdLoader->SubMaterials);
 	RenderResource.MaterialsHeapOffset = RenderResource.SubMaterials.size() * material_descriptor_count_per_block;
 	MaterialDescriptorCount = RenderResource.MaterialsHeapOffset;
@@ -203,10 +219,12 @@ bool PMDModel::CreateMaterialAndTextureBuffer(ID3D12GraphicsCommandList* cmdList
 
 void PMDModel::LoadTextureToBuffer()
 {
-	Resource.Textures.resize(m_pmdLoader->ModelPaths.size());
-	Resource.sphTextures.resize(m_pmdLoader->ModelPaths.size());
-	Resource.spaTextures.resize(m_pmdLoader->ModelPaths.size());
-	Resource.ToonTextures.resize(m_pmdLoader->ToonPaths.size());
+	// Texture paths are resolved by loader (or read from baked cache)
+	auto& texturePaths = m_pmdLoader->TexturePaths;
+	Resource.Textures.resize(texturePaths.size());
+	Resource.sphTextures.resize(texturePaths.size());
+	Resource.spaTextures.resize(texturePaths.size());
+	Resource.ToonTextures.resize(texturePaths.size());
 
 	auto& Textures = Resource.Textures;
 	auto& sphTextures = Resource.sphTextures;
@@ -215,44 +233,31 @@ void PMDModel::LoadTextureToBuffer()
 
 	for (int i = 0; i < Textures.size(); ++i)
 	{
+		auto& paths = texturePaths[i];
 		// Load toon file
-		if (!m_pmdLoader->ToonPaths[i].empty())
+		if (!paths.Toon.empty())
 		{
-			std::string toonPath;
-			
-			toonPath = StringHelper::GetTexturePathFromModelPath(m_pmdLoader->Path, m_pmdLoader->ToonPaths[i].c_str());
-			ToonTextures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(toonPath));
-			if (!ToonTextures[i])
-			{
-				ToonTextures[i] = mp_texMng->Get(m_pmdLoader->ToonPaths[i]);
-			}
+			ToonTextures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(paths.Toon));
 		}
 		// Load png, sph, spa
-		if (!m_pmdLoader->ModelPaths[i].empty())
-		{
-			auto splittedPaths = StringHelper::SplitFilePath(m_pmdLoader->ModelPaths[i]);
-			for (auto& path : splittedPaths)
-			{
-				auto ext = StringHelper::GetFileExtension(path);
-				if (ext == "sph")
-				{
-					auto sphPath = StringHelper::GetTexturePathFromModelPath(m_pmdLoader->Path, path.c_str());
-					sphTextures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(sphPath));
-				}
-				else if (ext == "spa")
-				{
-					auto spaPath = StringHelper::GetTexturePathFromModelPath(m_pmdLoader->Path, path.c_str());
-					spaTextures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(spaPath));
-				}
-				else
-				{
-					auto texPath = StringHelper::GetTexturePathFromModelPath(m_pmdLoader->Path, path.c_str());
-					Textures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(texPath));
-				}
-			}
-		}
+		if (!paths.Texture.empty())
+			Textures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(paths.Texture));
+		if (!paths.Sph.empty())
+			sphTextures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(paths.Sph));
+		if (!paths.Spa.empty())
+			spaTextures[i] = D12Helper::CreateTextureFromFilePath(m_device.Get(), StringHelper::ConvertStringToWideString(paths.Spa));
 	}
+}
 
-	int i = 0;
-
+void PMDModel::SetDefaultToonTexturesToMissingToons()
+{
+	// Toon textures that model's folder doesn't have are default toon textures
+	// which are created by PMD Manager
+	auto& texturePaths = m_pmdLoader->TexturePaths;
+	auto& ToonTextures = Resource.ToonTextures;
+	for (size_t i = 0; i < ToonTextures.size(); ++i)
+	{
+		if (!ToonTextures[i] && !texturePaths[i].ToonName.empty())
+			ToonTextures[i] = mp_texMng->Get(texturePaths[i].ToonName);
+	}
 }
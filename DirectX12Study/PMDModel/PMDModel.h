@@ -9,6 +9,7 @@
 #include <d3dx12.h>
 
 #include "PMDCommon.h"
+#include "../Utility/ByteReader.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -84,8 +85,13 @@ public:
 	bool Load(const char* path);
 	void CreateModel(ID3D12GraphicsCommandList* cmdList, CD3DX12_CPU_DESCRIPTOR_HANDLE& heapHandle);
 
-	const std::vector<uint16_t>& Indices() const;
-	const std::vector<PMDVertex>& Vertices() const;
+	// Valid until ClearSubresources is called
+	ArrayView<uint16_t> Indices() const;
+	// Instead of Indices for models with more than 0x10000 vertices
+	ArrayView<uint32_t> Indices32() const;
+	ArrayView<PMDVertex> Vertices() const;
+	// Empty unless the model has vertices on more than 2 bones
+	ArrayView<PMDSkinWeights> SkinWeights() const;
 
 	void ClearSubresources();
 public:
@@ -94,6 +100,10 @@ public:
 	PMDRenderResource RenderResource;
 	std::vector<PMDBone> Bones;
 	std::unordered_map<std::string, uint16_t> BonesTable;
+	std::vector<PMDIKChain> IKChains;
+	std::vector<PMDIKLink> IKLinks;
+	std::vector<PMDMorph> Morphs;
+	std::vector<PMDMorphVertex> MorphVertices;
 	uint16_t MaterialDescriptorCount = 0;
 private:
 	// Resource from PMD Manager
@@ -109,6 +119,7 @@ private:
 private:
 	// Create texture from PMD file
 	void LoadTextureToBuffer();
+	void SetDefaultToonTexturesToMissingToons();
 	bool CreateMaterialAndTextureBuffer(ID3D12GraphicsCommandList* cmdList, CD3DX12_CPU_DESCRIPTOR_HANDLE& heapHandle);
 };
 
@@ -0,0 +1,156 @@
+#include "PMDMorpher.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+void PMDMorpher::Create(std::vector<PMDMorph>&& morphs, std::vector<PMDMorphVertex>&& morphVertices,
+	ArrayView<PMDVertex> vertices)
+{
+	m_morphs = std::move(morphs);
+	m_morphVertices = std::move(morphVertices);
+	m_morphTable.clear();
+	m_vertices.clear();
+	m_restPositions.clear();
+	m_positions.clear();
+
+	// Drop morphs pointing outside the model
+	const auto vertexCount = static_cast<uint32_t>(vertices.size());
+	auto it = std::remove_if(m_morphs.begin(), m_morphs.end(), [&](const PMDMorph& morph)
+		{
+			return morph.Count == 0 || morph.MaxVertex >= vertexCount ||
+				morph.First + morph.Count > m_morphVertices.size();
+		});
+	m_morphs.erase(it, m_morphs.end());
+	m_weights.assign(m_morphs.size(), 0.0f);
+	m_evaluatedWeights.assign(m_morphs.size(), 0.0f);
+	m_isWeightChanged = false;
+	m_isDirty = false;
+	if (m_morphs.empty()) return;
+
+	for (size_t i = 0; i < m_morphs.size(); ++i)
+		m_morphTable[m_morphs[i].Name] = i;
+
+	// Keep only the range of vertices morphs move, usually the face
+	auto firstVertex = vertexCount;
+	uint32_t lastVertex = 0;
+	for (auto& morph : m_morphs)
+	{
+		firstVertex = (std::min)(firstVertex, morph.MinVertex);
+		lastVertex = (std::max)(lastVertex, morph.MaxVertex);
+	}
+	m_firstVertex = firstVertex;
+	m_vertices.assign(vertices.begin() + firstVertex, vertices.begin() + lastVertex + 1);
+	m_restPositions.resize(m_vertices.size());
+	for (size_t i = 0; i < m_vertices.size(); ++i)
+	{
+		auto& pos = m_vertices[i].pos;
+		m_restPositions[i] = XMFLOAT4(pos.x, pos.y, pos.z, 0.0f);
+	}
+	m_positions = m_restPositions;
+}
+
+bool PMDMorpher::Empty() const
+{
+	return m_morphs.empty();
+}
+
+size_t PMDMorpher::FindMorph(const std::string& name) const
+{
+	auto it = m_morphTable.find(name);
+	return it == m_morphTable.end() ? no_morph : it->second;
+}
+
+bool PMDMorpher::SetWeight(size_t morph, float weight)
+{
+	if (morph >= m_morphs.size()) return false;
+	if (m_weights[morph] != weight)
+	{
+		m_weights[morph] = weight;
+		m_isWeightChanged = true;
+	}
+	return true;
+}
+
+bool PMDMorpher::IsWeightChanged() const
+{
+	return m_isWeightChanged;
+}
+
+bool PMDMorpher::Evaluate(PMDMorphStats& stats)
+{
+	if (!m_isWeightChanged) return false;
+	m_isWeightChanged = false;
+
+	// Vertices of morphs active now or at last evaluation are rebuilt from rest position
+	// Morphs are sparse and local (eyes, mouth...) -> the range is much smaller than the face
+	uint32_t first = UINT32_MAX;
+	uint32_t last = 0;
+	for (size_t i = 0; i < m_morphs.size(); ++i)
+	{
+		if (m_weights[i] == 0.0f && m_evaluatedWeights[i] == 0.0f) continue;
+		first = (std::min)(first, m_morphs[i].MinVertex);
+		last = (std::max)(last, m_morphs[i].MaxVertex);
+	}
+	if (first > last) return false;
+
+	const auto begin = first - m_firstVertex;
+	const auto end = last + 1 - m_firstVertex;
+	std::copy(m_restPositions.begin() + begin, m_restPositions.begin() + end, m_positions.begin() + begin);
+
+	for (size_t i = 0; i < m_morphs.size(); ++i)
+	{
+		const auto weight = m_weights[i];
+		m_evaluatedWeights[i] = weight;
+		if (weight == 0.0f) continue;
+
+		auto& morph = m_morphs[i];
+		const auto w = XMVectorReplicate(weight);
+		for (uint32_t v = morph.First; v < morph.First + morph.Count; ++v)
+		{
+			auto& morphVertex = m_morphVertices[v];
+			auto& position = m_positions[morphVertex.Index - m_firstVertex];
+			auto delta = XMLoadFloat3(&morphVertex.Delta);
+			XMStoreFloat4(&position, XMVectorMultiplyAdd(delta, w, XMLoadFloat4(&position)));
+		}
+		++stats.ActiveMorphCount;
+		stats.MorphVertexCount += morph.Count;
+	}
+
+	for (auto i = begin; i < end; ++i)
+		XMStoreFloat3(&m_vertices[i].pos, XMLoadFloat4(&m_positions[i]));
+
+	// Several evaluations can happen before the range is uploaded
+	m_dirtyFirst = m_isDirty ? (std::min)(m_dirtyFirst, first) : first;
+	m_dirtyLast = m_isDirty ? (std::max)(m_dirtyLast, last) : last;
+	m_isDirty = true;
+	return true;
+}
+
+bool PMDMorpher::GetDirtyRange(uint32_t& first, uint32_t& count) const
+{
+	if (!m_isDirty) return false;
+	first = m_dirtyFirst;
+	count = m_dirtyLast - m_dirtyFirst + 1;
+	return true;
+}
+
+void PMDMorpher::ClearDirty()
+{
+	m_isDirty = false;
+}
+
+const PMDVertex* PMDMorpher::Vertices() const
+{
+	return m_vertices.data();
+}
+
+uint32_t PMDMorpher::FirstVertex() const
+{
+	return m_firstVertex;
+}
+
+uint32_t PMDMorpher::VertexCount() const
+{
+	return static_cast<uint32_t>(m_vertices.size());
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "PMDCommon.h"
+#include "../Utility/ByteReader.h"
+
+// Counters of morph evaluations
+struct PMDMorphStats
+{
+	uint32_t ActiveMorphCount = 0;
+	// Vertex offsets accumulated
+	uint32_t MorphVertexCount = 0;
+};
+
+// Blend morphs (facial skins) of one model on CPU
+// Only the vertices some morph moves are kept, already in vertex buffer's layout
+// so changed ranges can be copied to vertex buffer as they are
+class PMDMorpher
+{
+public:
+	static constexpr size_t no_morph = static_cast<size_t>(-1);
+
+	// vertices are model's rest vertices
+	void Create(std::vector<PMDMorph>&& morphs, std::vector<PMDMorphVertex>&& morphVertices,
+		ArrayView<PMDVertex> vertices);
+	bool Empty() const;
+
+	// no_morph if model doesn't have morph of that name
+	size_t FindMorph(const std::string& name) const;
+	bool SetWeight(size_t morph, float weight);
+	// True when some weight changed since last Evaluate
+	bool IsWeightChanged() const;
+
+	// Rebuild morphed vertices moved by morphs whose weight changed
+	// Return false if nothing changed
+	bool Evaluate(PMDMorphStats& stats);
+
+	// Vertices in [first, first + count) changed since last ClearDirty
+	// Indices are model's vertex indices
+	bool GetDirtyRange(uint32_t& first, uint32_t& count) const;
+	void ClearDirty();
+
+	// Morphed copy of model's vertices from FirstVertex to FirstVertex + VertexCount
+	const PMDVertex* Vertices() const;
+	uint32_t FirstVertex() const;
+	uint32_t VertexCount() const;
+private:
+	std::vector<PMDMorph> m_morphs;
+	std::vector<PMDMorphVertex> m_morphVertices;
+	std::unordered_map<std::string, size_t> m_morphTable;
+	std::vector<float> m_weights;
+	// Weights of the last evaluation, morphs that were active have to go back to rest
+	std::vector<float> m_evaluatedWeights;
+
+	uint32_t m_firstVertex = 0;
+	std::vector<PMDVertex> m_vertices;
+	// Rest positions and accumulated positions, 16 bytes each for SIMD loads
+	std::vector<DirectX::XMFLOAT4> m_restPositions;
+	std::vector<DirectX::XMFLOAT4> m_positions;
+
+	bool m_isWeightChanged = false;
+	bool m_isDirty = false;
+	uint32_t m_dirtyFirst = 0;
+	uint32_t m_dirtyLast = 0;
+};
@@ -0,0 +1,192 @@
+#include "PMDPose.h"
+
+#include <algorithm>
+#include <DirectXMath.h>
+
+#include "../Utility/ScratchArena.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t lane_count = 4;
+	constexpr size_t pose_channel_count = 8;
+
+	size_t PaddedCount(size_t boneCount)
+	{
+		return (boneCount + lane_count - 1) / lane_count * lane_count;
+	}
+
+	inline XMVECTOR Load4(const float* p)
+	{
+		return XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(p));
+	}
+
+	inline void Store4(float* p, FXMVECTOR value)
+	{
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(p), value);
+	}
+}
+
+size_t PMDLocalPose::RequiredBytes(size_t boneCount)
+{
+	// Each array may lose up to 15 bytes to alignment
+	return pose_channel_count * (PaddedCount(boneCount) * sizeof(float) + 16);
+}
+
+bool PMDLocalPose::Allocate(ScratchArena& arena, size_t boneCount)
+{
+	const auto padded = PaddedCount(boneCount);
+	float** channels[pose_channel_count] = { &Qx, &Qy, &Qz, &Qw, &Tx, &Ty, &Tz, &Weight };
+	for (auto channel : channels)
+	{
+		*channel = arena.Allocate<float>(padded);
+		if (*channel == nullptr) return false;
+	}
+	BoneCount = boneCount;
+	return true;
+}
+
+void PMDLocalPose::SetIdentity(float weight)
+{
+	const auto padded = PaddedCount(BoneCount);
+	std::fill(Qx, Qx + padded, 0.0f);
+	std::fill(Qy, Qy + padded, 0.0f);
+	std::fill(Qz, Qz + padded, 0.0f);
+	std::fill(Qw, Qw + padded, 1.0f);
+	std::fill(Tx, Tx + padded, 0.0f);
+	std::fill(Ty, Ty + padded, 0.0f);
+	std::fill(Tz, Tz + padded, 0.0f);
+	std::fill(Weight, Weight + padded, weight);
+}
+
+void PMDLocalPose::Set(size_t bone, const float rotation[4], const float location[3])
+{
+	Qx[bone] = rotation[0];
+	Qy[bone] = rotation[1];
+	Qz[bone] = rotation[2];
+	Qw[bone] = rotation[3];
+	Tx[bone] = location[0];
+	Ty[bone] = location[1];
+	Tz[bone] = location[2];
+}
+
+void BlendPose(PMDLocalPose& destination, const PMDLocalPose& source, float weight, PMDLayerBlendMode mode)
+{
+	const auto padded = PaddedCount((std::min)(destination.BoneCount, source.BoneCount));
+	const auto layerWeight = XMVectorReplicate(weight);
+	const auto one = XMVectorSplatOne();
+	const auto zero = XMVectorZero();
+	for (size_t i = 0; i < padded; i += lane_count)
+	{
+		const auto w = XMVectorMultiply(layerWeight, Load4(source.Weight + i));
+
+		auto ax = Load4(destination.Qx + i);
+		auto ay = Load4(destination.Qy + i);
+		auto az = Load4(destination.Qz + i);
+		auto aw = Load4(destination.Qw + i);
+		auto bx = Load4(source.Qx + i);
+		auto by = Load4(source.Qy + i);
+		auto bz = Load4(source.Qz + i);
+		auto bw = Load4(source.Qw + i);
+
+		XMVECTOR qx, qy, qz, qw;
+		if (mode == PMDLayerBlendMode::Override)
+		{
+			// Take the shorter arc
+			auto dot = XMVectorMultiply(ax, bx);
+			dot = XMVectorMultiplyAdd(ay, by, dot);
+			dot = XMVectorMultiplyAdd(az, bz, dot);
+			dot = XMVectorMultiplyAdd(aw, bw, dot);
+			const auto sign = XMVectorSelect(one, XMVectorNegate(one), XMVectorLess(dot, zero));
+			qx = XMVectorMultiplyAdd(w, XMVectorSubtract(XMVectorMultiply(bx, sign), ax), ax);
+			qy = XMVectorMultiplyAdd(w, XMVectorSubtract(XMVectorMultiply(by, sign), ay), ay);
+			qz = XMVectorMultiplyAdd(w, XMVectorSubtract(XMVectorMultiply(bz, sign), az), az);
+			qw = XMVectorMultiplyAdd(w, XMVectorSubtract(XMVectorMultiply(bw, sign), aw), aw);
+		}
+		else
+		{
+			// Scale source's rotation from identity by weight (nlerp on the shorter arc)
+			const auto sign = XMVectorSelect(one, XMVectorNegate(one), XMVectorLess(bw, zero));
+			auto sx = XMVectorMultiply(w, XMVectorMultiply(bx, sign));
+			auto sy = XMVectorMultiply(w, XMVectorMultiply(by, sign));
+			auto sz = XMVectorMultiply(w, XMVectorMultiply(bz, sign));
+			auto sw = XMVectorMultiplyAdd(w, XMVectorSubtract(XMVectorMultiply(bw, sign), one), one);
+			auto invLength = XMVectorMultiply(sx, sx);
+			invLength = XMVectorMultiplyAdd(sy, sy, invLength);
+			invLength = XMVectorMultiplyAdd(sz, sz, invLength);
+			invLength = XMVectorMultiplyAdd(sw, sw, invLength);
+			invLength = XMVectorReciprocalSqrt(invLength);
+			sx = XMVectorMultiply(sx, invLength);
+			sy = XMVectorMultiply(sy, invLength);
+			sz = XMVectorMultiply(sz, invLength);
+			sw = XMVectorMultiply(sw, invLength);
+
+			// Rotation a followed by s, same as XMQuaternionMultiply(a, s)
+			qw = XMVectorMultiply(sw, aw);
+			qw = XMVectorNegativeMultiplySubtract(sx, ax, qw);
+			qw = XMVectorNegativeMultiplySubtract(sy, ay, qw);
+			qw = XMVectorNegativeMultiplySubtract(sz, az, qw);
+			qx = XMVectorMultiply(sw, ax);
+			qx = XMVectorMultiplyAdd(sx, aw, qx);
+			qx = XMVectorMultiplyAdd(sy, az, qx);
+			qx = XMVectorNegativeMultiplySubtract(sz, ay, qx);
+			qy = XMVectorMultiply(sw, ay);
+			qy = XMVectorNegativeMultiplySubtract(sx, az, qy);
+			qy = XMVectorMultiplyAdd(sy, aw, qy);
+			qy = XMVectorMultiplyAdd(sz, ax, qy);
+			qz = XMVectorMultiply(sw, az);
+			qz = XMVectorMultiplyAdd(sx, ay, qz);
+			qz = XMVectorNegativeMultiplySubtract(sy, ax, qz);
+			qz = XMVectorMultiplyAdd(sz, aw, qz);
+		}
+
+		// Normalize, bones with zero weight come out unchanged
+		auto invLength = XMVectorMultiply(qx, qx);
+		invLength = XMVectorMultiplyAdd(qy, qy, invLength);
+		invLength = XMVectorMultiplyAdd(qz, qz, invLength);
+		invLength = XMVectorMultiplyAdd(qw, qw, invLength);
+		invLength = XMVectorReciprocalSqrt(invLength);
+		Store4(destination.Qx + i, XMVectorMultiply(qx, invLength));
+		Store4(destination.Qy + i, XMVectorMultiply(qy, invLength));
+		Store4(destination.Qz + i, XMVectorMultiply(qz, invLength));
+		Store4(destination.Qw + i, XMVectorMultiply(qw, invLength));
+
+		const auto tx = Load4(destination.Tx + i);
+		const auto ty = Load4(destination.Ty + i);
+		const auto tz = Load4(destination.Tz + i);
+		if (mode == PMDLayerBlendMode::Override)
+		{
+			Store4(destination.Tx + i, XMVectorMultiplyAdd(w, XMVectorSubtract(Load4(source.Tx + i), tx), tx));
+			Store4(destination.Ty + i, XMVectorMultiplyAdd(w, XMVectorSubtract(Load4(source.Ty + i), ty), ty));
+			Store4(destination.Tz + i, XMVectorMultiplyAdd(w, XMVectorSubtract(Load4(source.Tz + i), tz), tz));
+		}
+		else
+		{
+			Store4(destination.Tx + i, XMVectorMultiplyAdd(w, Load4(source.Tx + i), tx));
+			Store4(destination.Ty + i, XMVectorMultiplyAdd(w, Load4(source.Ty + i), ty));
+			Store4(destination.Tz + i, XMVectorMultiplyAdd(w, Load4(source.Tz + i), tz));
+		}
+	}
+}
+
+void AccumulatePose(PMDLocalPose& destination, PMDLocalPose& source, float weight, PMDLayerBlendMode mode)
+{
+	if (mode == PMDLayerBlendMode::Additive)
+	{
+		BlendPose(destination, source, weight, mode);
+		return;
+	}
+
+	// Source covers weight * source weight of what destination leaves to the pose below
+	// and gets that share of destination's new coverage
+	const auto count = (std::min)(destination.BoneCount, source.BoneCount);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto sourceWeight = weight * source.Weight[i];
+		const auto coverage = destination.Weight[i] + (1.0f - destination.Weight[i]) * sourceWeight;
+		source.Weight[i] = coverage > 0.0f ? sourceWeight / coverage : 0.0f;
+		destination.Weight[i] = coverage;
+	}
+	BlendPose(destination, source, 1.0f, mode);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+
+class ScratchArena;
+
+// How an animation layer is combined with the layers below it
+enum class PMDLayerBlendMode
+{
+	// Blend toward layer's pose by layer's weight
+	Override,
+	// Add layer's rotation and movement on top of the layers below
+	Additive
+};
+
+// Local pose of every bone in SoA layout, padded to a multiple of 4 bones
+// Rotation is a quaternion, Location is the offset from bone's rest position
+// Weight is how much each bone takes part in a blend, 0 leaves the pose below untouched
+struct PMDLocalPose
+{
+	float* Qx = nullptr;
+	float* Qy = nullptr;
+	float* Qz = nullptr;
+	float* Qw = nullptr;
+	float* Tx = nullptr;
+	float* Ty = nullptr;
+	float* Tz = nullptr;
+	float* Weight = nullptr;
+	size_t BoneCount = 0;
+
+	// Bytes Allocate takes from arena for boneCount bones
+	static size_t RequiredBytes(size_t boneCount);
+	// Arrays live in arena until it is reset
+	bool Allocate(ScratchArena& arena, size_t boneCount);
+	// Rest pose (identity) with the same weight for every bone
+	void SetIdentity(float weight);
+	void Set(size_t bone, const float rotation[4], const float location[3]);
+};
+
+// Blend source over destination 4 bones at a time
+// Override: nlerp rotations and lerp locations by weight * source's bone weight
+// Additive: destination's rotation followed by source's rotation scaled by weight, locations are added
+void BlendPose(PMDLocalPose& destination, const PMDLocalPose& source, float weight, PMDLayerBlendMode mode);
+
+// Merge source into destination so that destination blended once gives the same pose
+// as blending destination then source by weight (exact for locations, nlerp for rotations)
+// Override: destination's Weight is how much of the pose below it replaces
+// -> start from SetIdentity(0.0f)
+// Additive: weights are applied to the rotations and locations -> start from SetIdentity(1.0f)
+// Source's weights are overwritten
+void AccumulatePose(PMDLocalPose& destination, PMDLocalPose& source, float weight, PMDLayerBlendMode mode);
@@ -0,0 +1,102 @@
+#include "PMDPoseCache.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace DirectX;
+
+PMDPoseCache::PMDPoseCache(size_t maxBytes) :m_maxBytes(maxBytes)
+{
+}
+
+bool PMDPoseCache::Find(const Key& key, std::vector<XMFLOAT3X4>& transforms)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_table.find(key);
+	if (it == m_table.end()) return false;
+
+	auto& cached = it->second->Transforms;
+	if (cached.size() != transforms.size()) return false;
+
+	// Copy under lock, entry may be evicted by other thread right after
+	std::copy(cached.begin(), cached.end(), transforms.begin());
+	// Mark as most recently used
+	m_entries.splice(m_entries.begin(), m_entries, it->second);
+	return true;
+}
+
+bool PMDPoseCache::Contains(const Key& key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_table.find(key) != m_table.end();
+}
+
+void PMDPoseCache::Insert(const Key& key, const std::vector<XMFLOAT3X4>& transforms)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_table.find(key);
+	if (it != m_table.end())
+	{
+		m_bytes -= EntryBytes(*it->second);
+		m_entries.erase(it->second);
+		m_table.erase(it);
+	}
+
+	Entry entry;
+	entry.PoseKey = key;
+	entry.Transforms = transforms;
+	auto bytes = EntryBytes(entry);
+	if (bytes > m_maxBytes) return;
+
+	EvictUntil(m_maxBytes - bytes);
+	m_entries.push_front(std::move(entry));
+	m_table[key] = m_entries.begin();
+	m_bytes += bytes;
+}
+
+void PMDPoseCache::SetMaxBytes(size_t maxBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_maxBytes = maxBytes;
+	EvictUntil(m_maxBytes);
+}
+
+size_t PMDPoseCache::Bytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_bytes;
+}
+
+void PMDPoseCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+	m_table.clear();
+	m_bytes = 0;
+}
+
+size_t PMDPoseCache::KeyHash::operator()(const Key& key) const
+{
+	auto hash = std::hash<const void*>()(key.pMotion);
+	hash ^= std::hash<uint64_t>()(key.SkeletonSignature) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<uint64_t>()(key.Frame) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<uint8_t>()(key.LOD) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+void PMDPoseCache::EvictUntil(size_t maxBytes)
+{
+	while (m_bytes > maxBytes && !m_entries.empty())
+	{
+		auto& last = m_entries.back();
+		m_bytes -= EntryBytes(last);
+		m_table.erase(last.PoseKey);
+		m_entries.pop_back();
+	}
+}
+
+size_t PMDPoseCache::EntryBytes(const Entry& entry)
+{
+	// Count list node and table slot too so the budget is close to real memory use
+	return sizeof(Entry) + entry.Transforms.size() * sizeof(XMFLOAT3X4) + sizeof(Key) + 2 * sizeof(void*);
+}
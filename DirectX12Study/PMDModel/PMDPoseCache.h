@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+// World bone transforms of already evaluated poses
+// Models playing the same motion frame with the same skeleton share one evaluation
+// Least recently used poses are evicted when cache grows over its byte budget
+// Thread-safe, models can be updated in parallel
+class PMDPoseCache
+{
+public:
+	struct Key
+	{
+		const void* pMotion = nullptr;
+		uint64_t SkeletonSignature = 0;
+		uint64_t Frame = 0;
+		// Animation LOD, low LODs don't sample every bone
+		uint8_t LOD = 0;
+
+		bool operator == (const Key& other) const
+		{
+			return pMotion == other.pMotion && SkeletonSignature == other.SkeletonSignature &&
+				Frame == other.Frame && LOD == other.LOD;
+		}
+	};
+
+	explicit PMDPoseCache(size_t maxBytes = default_max_bytes);
+
+	// Copy cached pose to transforms
+	// Return false if pose isn't cached or has a different bone count
+	bool Find(const Key& key, std::vector<DirectX::XMFLOAT3X4>& transforms);
+	// True if pose is cached, it may still be evicted before Find
+	bool Contains(const Key& key) const;
+	// Pose bigger than the whole budget isn't cached
+	void Insert(const Key& key, const std::vector<DirectX::XMFLOAT3X4>& transforms);
+
+	void SetMaxBytes(size_t maxBytes);
+	size_t Bytes() const;
+	void Clear();
+public:
+	static constexpr size_t default_max_bytes = 2 * 1024 * 1024;
+private:
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+	struct Entry
+	{
+		Key PoseKey;
+		std::vector<DirectX::XMFLOAT3X4> Transforms;
+	};
+	using EntryList_t = std::list<Entry>;
+
+	void EvictUntil(size_t maxBytes);
+	static size_t EntryBytes(const Entry& entry);
+private:
+	// Front is the most recently used pose
+	EntryList_t m_entries;
+	std::unordered_map<Key, EntryList_t::iterator, KeyHash> m_table;
+	size_t m_bytes = 0;
+	size_t m_maxBytes = 0;
+	mutable std::mutex m_mutex;
+};
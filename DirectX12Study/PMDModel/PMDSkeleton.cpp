@@ -0,0 +1,142 @@
+#include "PMDSkeleton.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "PMDCommon.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// FNV-1a
+	void HashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+}
+
+void PMDSkeleton::Create(const std::vector<PMDBone>& bones)
+{
+	const size_t boneCount = bones.size();
+	m_parents.resize(boneCount);
+	for (size_t i = 0; i < boneCount; ++i)
+	{
+		auto parentNo = bones[i].parentNo;
+		m_parents[i] = parentNo < boneCount && parentNo != i ? parentNo : no_parent;
+	}
+
+	// Depth of bone in hierarchy, walking up more than boneCount times means a cycle
+	std::vector<uint32_t> depths(boneCount, 0);
+	for (size_t i = 0; i < boneCount; ++i)
+	{
+		uint32_t depth = 0;
+		for (auto p = m_parents[i]; p != no_parent && depth <= boneCount; p = m_parents[p])
+			++depth;
+		if (depth > boneCount)
+		{
+			m_parents[i] = no_parent;
+			depth = 0;
+		}
+		depths[i] = depth;
+	}
+
+	// Sorting by depth puts parents before children
+	// stable sort keeps original order inside the same depth -> mostly sequential memory access
+	m_order.resize(boneCount);
+	std::iota(m_order.begin(), m_order.end(), 0);
+	std::stable_sort(m_order.begin(), m_order.end(),
+		[&depths](uint16_t a, uint16_t b)
+		{
+			return depths[a] < depths[b];
+		});
+
+	// Visit children before parents to add up the longest chain below every bone
+	m_chainLengths.assign(boneCount, 0.0f);
+	for (auto it = m_order.rbegin(); it != m_order.rend(); ++it)
+	{
+		auto bone = *it;
+		auto parent = m_parents[bone];
+		if (parent == no_parent) continue;
+		auto offset = XMVectorSubtract(XMLoadFloat3(&bones[bone].pos), XMLoadFloat3(&bones[parent].pos));
+		auto length = m_chainLengths[bone] + XMVectorGetX(XMVector3Length(offset));
+		m_chainLengths[parent] = (std::max)(m_chainLengths[parent], length);
+	}
+	m_size = m_chainLengths.empty() ? 0.0f : *std::max_element(m_chainLengths.begin(), m_chainLengths.end());
+
+	m_signature = 14695981039346656037ull;
+	for (size_t i = 0; i < boneCount; ++i)
+	{
+		// Name length keeps "ab"+"c" and "a"+"bc" apart
+		auto nameLength = bones[i].name.size();
+		HashBytes(m_signature, &nameLength, sizeof(nameLength));
+		HashBytes(m_signature, bones[i].name.data(), nameLength);
+		HashBytes(m_signature, &m_parents[i], sizeof(m_parents[i]));
+		HashBytes(m_signature, &bones[i].pos, sizeof(bones[i].pos));
+	}
+}
+
+size_t PMDSkeleton::BoneCount() const
+{
+	return m_parents.size();
+}
+
+const std::vector<uint16_t>& PMDSkeleton::Parents() const
+{
+	return m_parents;
+}
+
+const std::vector<uint16_t>& PMDSkeleton::Order() const
+{
+	return m_order;
+}
+
+const std::vector<float>& PMDSkeleton::ChainLengths() const
+{
+	return m_chainLengths;
+}
+
+float PMDSkeleton::Size() const
+{
+	return m_size;
+}
+
+uint64_t PMDSkeleton::Signature() const
+{
+	return m_signature;
+}
+
+void PMDSkeleton::CalculateWorldTransforms(XMFLOAT3X4* transforms) const
+{
+	for (auto bone : m_order)
+	{
+		auto parent = m_parents[bone];
+		if (parent == no_parent) continue;
+		MultiplyAffine(transforms[bone], transforms[parent], transforms[bone]);
+	}
+}
+
+void MultiplyAffine(const XMFLOAT3X4& a, const XMFLOAT3X4& b, XMFLOAT3X4& out)
+{
+	// Rows of 3x4 are columns of the 4x4 matrix -> out = transpose(a * b) = bT * aT
+	// Last row of aT is (0, 0, 0, 1) so it only adds b's translation
+	const auto a0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[0]));
+	const auto a1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[1]));
+	const auto a2 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[2]));
+	const auto translationMask = XMVectorSelectControl(0, 0, 0, 1);
+
+	for (size_t i = 0; i < 3; ++i)
+	{
+		const auto row = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(b.m[i]));
+		auto result = XMVectorMultiply(XMVectorSplatX(row), a0);
+		result = XMVectorMultiplyAdd(XMVectorSplatY(row), a1, result);
+		result = XMVectorMultiplyAdd(XMVectorSplatZ(row), a2, result);
+		result = XMVectorAdd(result, XMVectorAndInt(row, translationMask));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out.m[i]), result);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+struct PMDBone;
+
+// Bone hierarchy compiled for the per-frame transform pass
+// Bones are visited in an order where every parent comes before its children
+// so world transforms come from one linear loop instead of a recursive walk
+class PMDSkeleton
+{
+public:
+	static constexpr uint16_t no_parent = 0xffff;
+
+	// Bone with invalid or cyclic parent is treated as a root
+	void Create(const std::vector<PMDBone>& bones);
+
+	size_t BoneCount() const;
+	// Parent index of each bone, no_parent for roots
+	const std::vector<uint16_t>& Parents() const;
+	// Bone indices sorted so that parents come before children
+	const std::vector<uint16_t>& Order() const;
+	// Length of the longest bone chain hanging from each bone (rest pose, model units)
+	// Short chains are leaf-like bones such as fingers and hair tips
+	const std::vector<float>& ChainLengths() const;
+	// Longest chain from a root bone, roughly the height of model
+	float Size() const;
+	// Hash of bone names, hierarchy and rest positions
+	// Skeletons with the same signature get the same pose from the same motion
+	uint64_t Signature() const;
+
+	// Combine every bone's transform with its parent's in place
+	// transforms[bone] = transforms[bone] * transforms[parent]
+	// Transforms are affine and stored transposed in 3x4 (column-vector form)
+	void CalculateWorldTransforms(DirectX::XMFLOAT3X4* transforms) const;
+private:
+	std::vector<uint16_t> m_parents;
+	std::vector<uint16_t> m_order;
+	std::vector<float> m_chainLengths;
+	float m_size = 0.0f;
+	uint64_t m_signature = 0;
+};
+
+// Product of affine transforms stored transposed in 3x4, same as XMMatrixMultiply(a, b)
+void MultiplyAffine(const DirectX::XMFLOAT3X4& a, const DirectX::XMFLOAT3X4& b, DirectX::XMFLOAT3X4& out);
@@ -0,0 +1,402 @@
+#include "PMDSkinning.h"
+
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+#include <intrin.h>
+
+#include "../Utility/Jobs/JobSystem.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertices of one job, big enough to hide scheduling and small enough to balance workers
+	constexpr size_t skinning_grain_size = 2048;
+
+	const XMFLOAT3X4 identity_bone(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f);
+
+	const PMDDualQuaternion identity_dual_quaternion = {
+		XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f),
+		XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f) };
+
+	const PMDDualQuaternion& GetBone(const PMDDualQuaternion* palette, size_t boneCount, uint16_t boneNo)
+	{
+		return boneNo < boneCount ? palette[boneNo] : identity_dual_quaternion;
+	}
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 Cross(const Float3& a, const Float3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v)
+	Float3 Rotate(const XMFLOAT4& q, const Float3& v)
+	{
+		const Float3 axis = { q.x, q.y, q.z };
+		auto c = Cross(axis, v);
+		c = { c.x + q.w * v.x, c.y + q.w * v.y, c.z + q.w * v.z };
+		auto r = Cross(axis, c);
+		return { v.x + 2.0f * r.x, v.y + 2.0f * r.y, v.z + 2.0f * r.z };
+	}
+
+	const XMFLOAT3X4& GetBone(const XMFLOAT3X4* palette, size_t boneCount, uint16_t boneNo)
+	{
+		return boneNo < boneCount ? palette[boneNo] : identity_bone;
+	}
+
+	constexpr float skin_weight_scale = 1.0f / pmd_skin_weight_one;
+
+	// Bones and weights of one vertex for the scalar references
+	struct VertexBones
+	{
+		uint16_t boneNo[4];
+		float weight[4];
+		size_t count;
+	};
+
+	// skinWeights is null for 2-bone vertices
+	VertexBones GetVertexBones(const PMDVertex& vertex, const PMDSkinWeights* skinWeights)
+	{
+		if (skinWeights == nullptr)
+			return { { vertex.boneNo[0], vertex.boneNo[1] }, { vertex.weight, 1.0f - vertex.weight }, 2 };
+
+		VertexBones bones = {};
+		for (size_t b = 0; b < 4; ++b)
+		{
+			bones.boneNo[b] = skinWeights->boneNo[b];
+			bones.weight[b] = skinWeights->weight[b] * skin_weight_scale;
+		}
+		bones.count = 4;
+		return bones;
+	}
+
+	template<bool isStreaming, bool isFourBones>
+	void SkinRange(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+		const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& vertex = vertices[i];
+			XMMATRIX skin;
+			if (isFourBones)
+			{
+				// bone0 * weight0 + ... + bone3 * weight3
+				auto& weights = skinWeights[i];
+				auto& bone0 = palette.GetBone(weights.boneNo[0]);
+				auto weight = XMVectorReplicate(weights.weight[0] * skin_weight_scale);
+				for (size_t r = 0; r < 4; ++r)
+					skin.r[r] = XMVectorMultiply(bone0.r[r], weight);
+				for (size_t b = 1; b < 4; ++b)
+				{
+					auto& bone = palette.GetBone(weights.boneNo[b]);
+					weight = XMVectorReplicate(weights.weight[b] * skin_weight_scale);
+					for (size_t r = 0; r < 4; ++r)
+						skin.r[r] = XMVectorMultiplyAdd(bone.r[r], weight, skin.r[r]);
+				}
+			}
+			else
+			{
+				auto& bone0 = palette.GetBone(vertex.boneNo[0]);
+				auto& bone1 = palette.GetBone(vertex.boneNo[1]);
+
+				// bone1 + (bone0 - bone1) * weight
+				auto weight = XMVectorReplicate(vertex.weight);
+				for (size_t r = 0; r < 4; ++r)
+					skin.r[r] = XMVectorMultiplyAdd(XMVectorSubtract(bone0.r[r], bone1.r[r]), weight, bone1.r[r]);
+			}
+
+			auto position = XMVector3Transform(XMLoadFloat3(&vertex.pos), skin);
+			auto normal = XMVector3TransformNormal(XMLoadFloat3(&vertex.normal), skin);
+			auto& out = pDestination[i];
+			if (isStreaming)
+			{
+				_mm_stream_ps(&out.Position.x, position);
+				_mm_stream_ps(&out.Normal.x, normal);
+			}
+			else
+			{
+				XMStoreFloat4(&out.Position, position);
+				XMStoreFloat4(&out.Normal, normal);
+			}
+		}
+		// Make streaming stores visible before anyone reads or copies the output
+		if (isStreaming)
+			_mm_sfence();
+	}
+
+	// Rows r of two bones in the low and high half
+	inline __m256 LoadRows(const XMMATRIX& low, const XMMATRIX& high, size_t r)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(low.r[r]), high.r[r], 1);
+	}
+
+	// Same math as SkinRange, vertex i in the low half and vertex i + 1 in the high half
+	// Skinned vertex is 32 bytes -> each result is one 256-bit store
+	template<bool isStreaming, bool isFourBones>
+	void SkinRangeAVX(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+		const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination)
+	{
+		const auto one = _mm256_set1_ps(1.0f);
+		const auto zero = _mm256_setzero_ps();
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			auto& vertex0 = vertices[i];
+			auto& vertex1 = vertices[i + 1];
+			__m256 skin[4];
+			if (isFourBones)
+			{
+				auto& weights0 = skinWeights[i];
+				auto& weights1 = skinWeights[i + 1];
+				for (size_t b = 0; b < 4; ++b)
+				{
+					auto& bone0 = palette.GetBone(weights0.boneNo[b]);
+					auto& bone1 = palette.GetBone(weights1.boneNo[b]);
+					const auto weight = _mm256_insertf128_ps(
+						_mm256_set1_ps(weights0.weight[b] * skin_weight_scale),
+						_mm_set1_ps(weights1.weight[b] * skin_weight_scale), 1);
+					for (size_t r = 0; r < 4; ++r)
+					{
+						const auto row = _mm256_mul_ps(LoadRows(bone0, bone1, r), weight);
+						skin[r] = b == 0 ? row : _mm256_add_ps(skin[r], row);
+					}
+				}
+			}
+			else
+			{
+				auto& bone00 = palette.GetBone(vertex0.boneNo[0]);
+				auto& bone01 = palette.GetBone(vertex0.boneNo[1]);
+				auto& bone10 = palette.GetBone(vertex1.boneNo[0]);
+				auto& bone11 = palette.GetBone(vertex1.boneNo[1]);
+
+				const auto weight = _mm256_insertf128_ps(_mm256_set1_ps(vertex0.weight), _mm_set1_ps(vertex1.weight), 1);
+				for (size_t r = 0; r < 4; ++r)
+				{
+					const auto row0 = LoadRows(bone00, bone10, r);
+					const auto row1 = LoadRows(bone01, bone11, r);
+					skin[r] = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(row0, row1), weight), row1);
+				}
+			}
+
+			// 4 floats from pos and normal, the float after them is replaced by 1 and 0
+			auto position = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&vertex0.pos.x)),
+				_mm_loadu_ps(&vertex1.pos.x), 1);
+			auto normal = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&vertex0.normal.x)),
+				_mm_loadu_ps(&vertex1.normal.x), 1);
+			position = _mm256_blend_ps(position, one, 0x88);
+			normal = _mm256_blend_ps(normal, zero, 0x88);
+
+			// x * row0 + y * row1 + z * row2 (+ w * row3)
+			auto outPosition = _mm256_mul_ps(_mm256_permute_ps(position, 0x00), skin[0]);
+			outPosition = _mm256_add_ps(outPosition, _mm256_mul_ps(_mm256_permute_ps(position, 0x55), skin[1]));
+			outPosition = _mm256_add_ps(outPosition, _mm256_mul_ps(_mm256_permute_ps(position, 0xaa), skin[2]));
+			outPosition = _mm256_add_ps(outPosition, skin[3]);
+			auto outNormal = _mm256_mul_ps(_mm256_permute_ps(normal, 0x00), skin[0]);
+			outNormal = _mm256_add_ps(outNormal, _mm256_mul_ps(_mm256_permute_ps(normal, 0x55), skin[1]));
+			outNormal = _mm256_add_ps(outNormal, _mm256_mul_ps(_mm256_permute_ps(normal, 0xaa), skin[2]));
+
+			const auto out0 = _mm256_permute2f128_ps(outPosition, outNormal, 0x20);
+			const auto out1 = _mm256_permute2f128_ps(outPosition, outNormal, 0x31);
+			if (isStreaming)
+			{
+				_mm256_stream_ps(&pDestination[i].Position.x, out0);
+				_mm256_stream_ps(&pDestination[i + 1].Position.x, out1);
+			}
+			else
+			{
+				_mm256_storeu_ps(&pDestination[i].Position.x, out0);
+				_mm256_storeu_ps(&pDestination[i + 1].Position.x, out1);
+			}
+		}
+		// Upper halves of YMM registers slow down SSE code after this
+		_mm256_zeroupper();
+		// Odd vertex left, SkinRange fences streaming stores
+		SkinRange<isStreaming, isFourBones>(vertices + i, isFourBones ? skinWeights + i : nullptr, count - i,
+			palette, pDestination + i);
+	}
+
+	template<bool isFourBones>
+	void SkinVerticesKernel(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+		const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination, PMDSkinningStore store,
+		PMDSkinningKernel kernel)
+	{
+		const bool isAVX = kernel != PMDSkinningKernel::SSE && IsAVXSupported();
+		const uintptr_t alignment = isAVX ? 31 : 15;
+		const bool isStreaming = store == PMDSkinningStore::Streaming &&
+			(reinterpret_cast<uintptr_t>(pDestination) & alignment) == 0;
+		if (isAVX)
+		{
+			if (isStreaming)
+				SkinRangeAVX<true, isFourBones>(vertices, skinWeights, count, palette, pDestination);
+			else
+				SkinRangeAVX<false, isFourBones>(vertices, skinWeights, count, palette, pDestination);
+		}
+		else
+		{
+			if (isStreaming)
+				SkinRange<true, isFourBones>(vertices, skinWeights, count, palette, pDestination);
+			else
+				SkinRange<false, isFourBones>(vertices, skinWeights, count, palette, pDestination);
+		}
+	}
+}
+
+void PMDSkinningPalette::Create(const XMFLOAT3X4* transforms, size_t boneCount)
+{
+	m_bones.resize(boneCount + 1);
+	for (size_t i = 0; i < boneCount; ++i)
+		m_bones[i] = XMLoadFloat3x4(&transforms[i]);
+	m_bones[boneCount] = XMMatrixIdentity();
+}
+
+size_t PMDSkinningPalette::BoneCount() const
+{
+	return m_bones.size() - 1;
+}
+
+bool IsAVXSupported()
+{
+	static const bool isSupported = []()
+	{
+		int info[4];
+		__cpuid(info, 1);
+		const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+		const bool hasAVX = (info[2] & (1 << 28)) != 0;
+		// OS must save YMM registers (XCR0 bits 1 and 2) on context switch
+		return hasOSXSAVE && hasAVX && (_xgetbv(0) & 0x6) == 0x6;
+	}();
+	return isSupported;
+}
+
+void SkinVertices(const PMDVertex* vertices, size_t count, const PMDSkinningPalette& palette,
+	PMDSkinnedVertex* pDestination, PMDSkinningStore store, PMDSkinningKernel kernel)
+{
+	SkinVerticesKernel<false>(vertices, nullptr, count, palette, pDestination, store, kernel);
+}
+
+void SkinVertices(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination, PMDSkinningStore store,
+	PMDSkinningKernel kernel)
+{
+	SkinVerticesKernel<true>(vertices, skinWeights, count, palette, pDestination, store, kernel);
+}
+
+void SkinVertices(JobSystem& jobSystem, const PMDVertex* vertices, size_t count, const PMDSkinningPalette& palette,
+	PMDSkinnedVertex* pDestination, PMDSkinningStore store, PMDSkinningKernel kernel)
+{
+	jobSystem.ParallelFor(count, skinning_grain_size, [=, &palette](size_t begin, size_t end)
+		{
+			SkinVertices(vertices + begin, end - begin, palette, pDestination + begin, store, kernel);
+		});
+}
+
+void SkinVertices(JobSystem& jobSystem, const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination, PMDSkinningStore store,
+	PMDSkinningKernel kernel)
+{
+	jobSystem.ParallelFor(count, skinning_grain_size, [=, &palette](size_t begin, size_t end)
+		{
+			SkinVertices(vertices + begin, skinWeights + begin, end - begin, palette, pDestination + begin,
+				store, kernel);
+		});
+}
+
+void SkinVerticesReference(const PMDVertex* vertices, size_t count, const XMFLOAT3X4* palette,
+	size_t boneCount, PMDSkinnedVertex* pDestination)
+{
+	SkinVerticesReference(vertices, nullptr, count, palette, boneCount, pDestination);
+}
+
+void SkinVerticesReference(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const XMFLOAT3X4* palette, size_t boneCount, PMDSkinnedVertex* pDestination)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto& vertex = vertices[i];
+		const auto bones = GetVertexBones(vertex, skinWeights ? &skinWeights[i] : nullptr);
+
+		float skin[3][4] = {};
+		for (size_t b = 0; b < bones.count; ++b)
+		{
+			auto& bone = GetBone(palette, boneCount, bones.boneNo[b]);
+			for (size_t r = 0; r < 3; ++r)
+				for (size_t c = 0; c < 4; ++c)
+					skin[r][c] += bone.m[r][c] * bones.weight[b];
+		}
+
+		const float position[] = { vertex.pos.x, vertex.pos.y, vertex.pos.z };
+		const float normal[] = { vertex.normal.x, vertex.normal.y, vertex.normal.z };
+		float outPosition[3];
+		float outNormal[3];
+		for (size_t r = 0; r < 3; ++r)
+		{
+			outPosition[r] = skin[r][3];
+			outNormal[r] = 0.0f;
+			for (size_t c = 0; c < 3; ++c)
+			{
+				outPosition[r] += skin[r][c] * position[c];
+				outNormal[r] += skin[r][c] * normal[c];
+			}
+		}
+		pDestination[i].Position = XMFLOAT4(outPosition[0], outPosition[1], outPosition[2], 1.0f);
+		pDestination[i].Normal = XMFLOAT4(outNormal[0], outNormal[1], outNormal[2], 0.0f);
+	}
+}
+
+void SkinVerticesDualQuaternionReference(const PMDVertex* vertices, size_t count, const PMDDualQuaternion* palette,
+	size_t boneCount, PMDSkinnedVertex* pDestination)
+{
+	SkinVerticesDualQuaternionReference(vertices, nullptr, count, palette, boneCount, pDestination);
+}
+
+void SkinVerticesDualQuaternionReference(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const PMDDualQuaternion* palette, size_t boneCount, PMDSkinnedVertex* pDestination)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto& vertex = vertices[i];
+		const auto bones = GetVertexBones(vertex, skinWeights ? &skinWeights[i] : nullptr);
+		auto& bone0 = GetBone(palette, boneCount, bones.boneNo[0]);
+
+		XMFLOAT4 real(0.0f, 0.0f, 0.0f, 0.0f);
+		XMFLOAT4 dual(0.0f, 0.0f, 0.0f, 0.0f);
+		for (size_t b = 0; b < bones.count; ++b)
+		{
+			auto& bone = GetBone(palette, boneCount, bones.boneNo[b]);
+			// q and -q are the same rotation -> blend through the shorter arc from the first bone
+			auto dot = bone0.Real.x * bone.Real.x + bone0.Real.y * bone.Real.y +
+				bone0.Real.z * bone.Real.z + bone0.Real.w * bone.Real.w;
+			const auto weight = bones.weight[b] * (dot < 0.0f ? -1.0f : 1.0f);
+			real = XMFLOAT4(real.x + bone.Real.x * weight, real.y + bone.Real.y * weight,
+				real.z + bone.Real.z * weight, real.w + bone.Real.w * weight);
+			dual = XMFLOAT4(dual.x + bone.Dual.x * weight, dual.y + bone.Dual.y * weight,
+				dual.z + bone.Dual.z * weight, dual.w + bone.Dual.w * weight);
+		}
+		const auto length = std::sqrt(real.x * real.x + real.y * real.y + real.z * real.z + real.w * real.w);
+		real = XMFLOAT4(real.x / length, real.y / length, real.z / length, real.w / length);
+		dual = XMFLOAT4(dual.x / length, dual.y / length, dual.z / length, dual.w / length);
+
+		// Translation is 2 * dual * conjugate(real)
+		const Float3 axis = { real.x, real.y, real.z };
+		const auto c = Cross(axis, { dual.x, dual.y, dual.z });
+		const Float3 translation = {
+			2.0f * (real.w * dual.x - dual.w * real.x + c.x),
+			2.0f * (real.w * dual.y - dual.w * real.y + c.y),
+			2.0f * (real.w * dual.z - dual.w * real.z + c.z) };
+
+		auto position = Rotate(real, { vertex.pos.x, vertex.pos.y, vertex.pos.z });
+		auto normal = Rotate(real, { vertex.normal.x, vertex.normal.y, vertex.normal.z });
+		pDestination[i].Position = XMFLOAT4(position.x + translation.x, position.y + translation.y,
+			position.z + translation.z, 1.0f);
+		pDestination[i].Normal = XMFLOAT4(normal.x, normal.y, normal.z, 0.0f);
+	}
+}
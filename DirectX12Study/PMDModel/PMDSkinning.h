@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "PMDCommon.h"
+#include "PMDBonePalette.h"
+
+class JobSystem;
+
+// Vertex skinned on CPU, 32 bytes so it can be written with aligned (streaming) stores
+struct PMDSkinnedVertex
+{
+	// w is 1
+	DirectX::XMFLOAT4 Position;
+	// w is 0
+	DirectX::XMFLOAT4 Normal;
+};
+
+enum class PMDSkinningStore
+{
+	// Output is read by CPU soon after (bounds, picking)
+	Cached,
+	// Output goes to memory CPU won't read (upload heap), bypass cache with streaming stores
+	// Needs 16-byte (SSE) or 32-byte (AVX) aligned destination, falls back to cached stores otherwise
+	Streaming
+};
+
+// Bone transforms of SkinVertices, transposed once from 3x4 (see PMDSkeleton) to row-vector matrices
+// -> per vertex there is only the blend and the transform left
+// One more identity bone stands in for bone numbers out of palette
+class PMDSkinningPalette
+{
+public:
+	void Create(const DirectX::XMFLOAT3X4* transforms, size_t boneCount);
+	size_t BoneCount() const;
+	const DirectX::XMMATRIX& GetBone(uint16_t boneNo) const
+	{
+		return m_bones[boneNo < m_bones.size() ? boneNo : m_bones.size() - 1];
+	}
+private:
+	std::vector<DirectX::XMMATRIX> m_bones;
+};
+
+enum class PMDSkinningKernel
+{
+	// AVX when CPU and OS support it, SSE otherwise
+	Auto,
+	// One vertex at a time in 128-bit registers
+	SSE,
+	// Two vertices at a time in 256-bit registers, SSE when AVX isn't supported
+	AVX
+};
+
+// CPU has AVX and OS saves its registers
+bool IsAVXSupported();
+
+// Same two-bone linear blend as VS.hlsl :
+// skin = palette[boneNo[0]] * weight + palette[boneNo[1]] * (1 - weight)
+// Overloads with skinWeights blend the 4 bones of PMDSkinWeights instead (VS.hlsl with SKIN_4_BONES)
+// Create palette once per pose and skin all ranges of model with it
+// Not done yet: models sharing a pose through pose cache could draw one pre-skinned vertex buffer
+// That needs a vertex layout without BONENO / WEIGHT, a VS variant without skinning
+// and a buffer per shared pose that lives as long as models draw it
+void SkinVertices(const PMDVertex* vertices, size_t count, const PMDSkinningPalette& palette,
+	PMDSkinnedVertex* pDestination, PMDSkinningStore store = PMDSkinningStore::Cached,
+	PMDSkinningKernel kernel = PMDSkinningKernel::Auto);
+void SkinVertices(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination,
+	PMDSkinningStore store = PMDSkinningStore::Cached, PMDSkinningKernel kernel = PMDSkinningKernel::Auto);
+
+// Split vertices into chunks and skin them on job system's workers
+// Call from the thread that created job system
+void SkinVertices(JobSystem& jobSystem, const PMDVertex* vertices, size_t count, const PMDSkinningPalette& palette,
+	PMDSkinnedVertex* pDestination, PMDSkinningStore store = PMDSkinningStore::Cached,
+	PMDSkinningKernel kernel = PMDSkinningKernel::Auto);
+void SkinVertices(JobSystem& jobSystem, const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const PMDSkinningPalette& palette, PMDSkinnedVertex* pDestination,
+	PMDSkinningStore store = PMDSkinningStore::Cached, PMDSkinningKernel kernel = PMDSkinningKernel::Auto);
+
+// Scalar version of SkinVertices, one float at a time like the shader's math
+// Use for validating the SIMD kernel
+void SkinVerticesReference(const PMDVertex* vertices, size_t count, const DirectX::XMFLOAT3X4* palette,
+	size_t boneCount, PMDSkinnedVertex* pDestination);
+void SkinVerticesReference(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const DirectX::XMFLOAT3X4* palette, size_t boneCount, PMDSkinnedVertex* pDestination);
+
+// Same dual quaternion blend as VS.hlsl with BONE_PALETTE_DQ, scalar
+// Use for validating the shader and comparing quality with linear blend
+void SkinVerticesDualQuaternionReference(const PMDVertex* vertices, size_t count, const PMDDualQuaternion* palette,
+	size_t boneCount, PMDSkinnedVertex* pDestination);
+void SkinVerticesDualQuaternionReference(const PMDVertex* vertices, const PMDSkinWeights* skinWeights, size_t count,
+	const PMDDualQuaternion* palette, size_t boneCount, PMDSkinnedVertex* pDestination);
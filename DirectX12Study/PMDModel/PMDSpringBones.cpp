@@ -0,0 +1,343 @@
+#include "PMDSpringBones.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "PMDSkeleton.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t lane_count = 4;
+	constexpr uint16_t no_bone = 0xffff;
+	// Keeps length constraint finite when a particle sits on its parent
+	constexpr float min_length = 1e-6f;
+	// Bone already points to its child when sine of the angle between them is below this
+	constexpr float min_aim_sine = 1e-4f;
+	// "Hair" and "skirt" in Shift-JIS, the encoding of PMD bone names
+	const char* const default_spring_bone_names[] = {
+		"\x94\xaf",
+		"\x83\x58\x83\x4a\x81\x5b\x83\x67",
+	};
+
+	// First byte of a 2-byte Shift-JIS character
+	inline bool IsShiftJISLeadByte(char c)
+	{
+		const auto byte = static_cast<uint8_t>(c);
+		return (byte >= 0x81 && byte <= 0x9f) || (byte >= 0xe0 && byte <= 0xfc);
+	}
+
+	// Whether name contains part at a character boundary
+	// Byte search could match a trail byte and the next character's lead byte
+	bool ContainsShiftJIS(const std::string& name, const std::string& part)
+	{
+		for (size_t i = 0; i + part.size() <= name.size(); i += IsShiftJISLeadByte(name[i]) ? 2 : 1)
+		{
+			if (name.compare(i, part.size(), part) == 0) return true;
+		}
+		return false;
+	}
+
+	inline XMVECTOR Load4(const std::vector<float>& v, size_t index)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&v[index]));
+	}
+
+	inline void Store4(std::vector<float>& v, size_t index, FXMVECTOR value)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&v[index]), value);
+	}
+}
+
+bool PMDSpringBones::Create(const std::vector<PMDBone>& bones, const PMDSkeleton& skeleton,
+	const std::unordered_map<std::string, uint16_t>& bonesTable,
+	const std::vector<std::string>& names, const PMDSpringParams& params)
+{
+	*this = PMDSpringBones();
+	m_params = params;
+
+	const auto boneCount = bones.size();
+	const auto& parents = skeleton.Parents();
+	std::vector<std::string> defaultNames;
+	if (names.empty())
+		defaultNames.assign(std::begin(default_spring_bone_names), std::end(default_spring_bone_names));
+	auto& selectNames = names.empty() ? defaultNames : names;
+
+	std::vector<bool> isSelected(boneCount, false);
+	for (auto& name : selectNames)
+	{
+		auto it = bonesTable.find(name);
+		if (it != bonesTable.end())
+		{
+			if (it->second < boneCount) isSelected[it->second] = true;
+			continue;
+		}
+		for (size_t b = 0; b < boneCount; ++b)
+			if (ContainsShiftJIS(bones[b].name, name)) isSelected[b] = true;
+	}
+
+	// Bones under a selected bone belong to its chain, depth counts from chain's top bone
+	std::vector<std::vector<uint16_t>> depthBones;
+	std::vector<int32_t> depths(boneCount, -1);
+	for (auto bone : skeleton.Order())
+	{
+		auto parent = parents[bone];
+		if (parent != PMDSkeleton::no_parent && depths[parent] >= 0)
+			depths[bone] = depths[parent] + 1;
+		else if (isSelected[bone])
+		{
+			depths[bone] = 0;
+			++m_chainCount;
+		}
+		else
+			continue;
+
+		if (depthBones.size() <= static_cast<size_t>(depths[bone]))
+			depthBones.resize(depths[bone] + 1);
+		depthBones[depths[bone]].push_back(bone);
+		++m_particleCount;
+	}
+	if (m_particleCount == 0) return false;
+
+	// Lay particles out depth by depth, padding every depth to a whole SIMD group
+	std::vector<uint32_t> boneParticles(boneCount, no_particle);
+	for (auto& group : depthBones)
+	{
+		m_depthStarts.push_back(static_cast<uint32_t>(m_bones.size()));
+		for (auto bone : group)
+		{
+			boneParticles[bone] = static_cast<uint32_t>(m_bones.size());
+			m_bones.push_back(bone);
+		}
+		while (m_bones.size() % lane_count != 0)
+			m_bones.push_back(no_bone);
+	}
+	m_depthStarts.push_back(static_cast<uint32_t>(m_bones.size()));
+
+	m_positions.resize(boneCount);
+	for (size_t b = 0; b < boneCount; ++b)
+		m_positions[b] = bones[b].pos;
+
+	const auto count = m_bones.size();
+	m_parents.resize(count);
+	m_firstChildren.assign(count, no_particle);
+	m_restLengths.assign(count, 0.0f);
+	m_pinned.assign(count, 1.0f);
+	for (size_t c = 0; c < 3; ++c)
+	{
+		m_x[c].assign(count, 0.0f);
+		m_previous[c].assign(count, 0.0f);
+		m_target[c].assign(count, 0.0f);
+		m_lastTarget[c].assign(count, 0.0f);
+	}
+	m_animated.resize(count);
+	m_inverseAnimated.resize(count);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		// Padding and top bones are their own parent, length constraint doesn't move them
+		m_parents[i] = i;
+		auto bone = m_bones[i];
+		if (bone == no_bone || depths[bone] == 0) continue;
+
+		auto parent = boneParticles[parents[bone]];
+		m_parents[i] = parent;
+		if (m_firstChildren[parent] == no_particle)
+			m_firstChildren[parent] = i;
+		m_pinned[i] = 0.0f;
+		auto offset = XMVectorSubtract(XMLoadFloat3(&m_positions[bone]), XMLoadFloat3(&m_positions[parents[bone]]));
+		m_restLengths[i] = XMVectorGetX(XMVector3Length(offset));
+	}
+	return true;
+}
+
+bool PMDSpringBones::Empty() const
+{
+	return m_particleCount == 0;
+}
+
+size_t PMDSpringBones::ChainCount() const
+{
+	return m_chainCount;
+}
+
+size_t PMDSpringBones::ParticleCount() const
+{
+	return m_particleCount;
+}
+
+void PMDSpringBones::AddTime(float deltaTime)
+{
+	m_time += deltaTime;
+}
+
+uint32_t PMDSpringBones::PendingSteps() const
+{
+	return static_cast<uint32_t>(m_time / time_step);
+}
+
+void PMDSpringBones::ConsumeSteps()
+{
+	m_time -= PendingSteps() * time_step;
+}
+
+void PMDSpringBones::Simulate(XMFLOAT3X4* transforms, uint32_t stepCount, PMDSpringStats& stats)
+{
+	if (Empty()) return;
+
+	for (size_t i = 0; i < m_bones.size(); ++i)
+	{
+		auto bone = m_bones[i];
+		if (bone == no_bone) continue;
+		m_animated[i] = transforms[bone];
+		auto animated = XMLoadFloat3x4(&transforms[bone]);
+		XMStoreFloat3x4(&m_inverseAnimated[i], XMMatrixInverse(nullptr, animated));
+		XMFLOAT3 target;
+		XMStoreFloat3(&target, XMVector3Transform(XMLoadFloat3(&m_positions[bone]), animated));
+		m_target[0][i] = target.x;
+		m_target[1][i] = target.y;
+		m_target[2][i] = target.z;
+	}
+
+	// First pose starts at rest on the animation
+	if (!m_isStarted)
+	{
+		for (size_t c = 0; c < 3; ++c)
+			m_x[c] = m_previous[c] = m_lastTarget[c] = m_target[c];
+		m_isStarted = true;
+	}
+
+	// Targets move from last simulated pose to this one over the steps
+	// -> pinned bones don't jump in the first step
+	for (uint32_t s = 0; s < stepCount; ++s)
+	{
+		Integrate(static_cast<float>(s + 1) / stepCount);
+		SolveLengths();
+	}
+	if (stepCount > 0)
+	{
+		for (size_t c = 0; c < 3; ++c)
+			m_lastTarget[c] = m_target[c];
+	}
+	// Updates without a whole step still move pinned bones with animation
+	SnapPinned();
+
+	WriteBack(transforms);
+	stats.ParticleCount += static_cast<uint32_t>(m_particleCount);
+	stats.StepCount += static_cast<uint32_t>(m_particleCount) * stepCount;
+}
+
+void PMDSpringBones::Integrate(float targetWeight)
+{
+	constexpr float step_squared = time_step * time_step;
+	const XMVECTOR gravity[] = {
+		XMVectorReplicate(m_params.Gravity.x * step_squared),
+		XMVectorReplicate(m_params.Gravity.y * step_squared),
+		XMVectorReplicate(m_params.Gravity.z * step_squared),
+	};
+	const auto keep = XMVectorReplicate(1.0f - m_params.Damping);
+	const auto stiffness = XMVectorReplicate(m_params.Stiffness);
+	const auto zero = XMVectorZero();
+
+	for (size_t i = 0; i < m_bones.size(); i += lane_count)
+	{
+		auto pinned = XMVectorGreater(Load4(m_pinned, i), zero);
+		for (size_t c = 0; c < 3; ++c)
+		{
+			auto x = Load4(m_x[c], i);
+			auto target = XMVectorLerp(Load4(m_lastTarget[c], i), Load4(m_target[c], i), targetWeight);
+			// Verlet, velocity is the distance moved last step
+			auto velocity = XMVectorMultiply(XMVectorSubtract(x, Load4(m_previous[c], i)), keep);
+			auto next = XMVectorAdd(XMVectorAdd(x, velocity), gravity[c]);
+			next = XMVectorMultiplyAdd(XMVectorSubtract(target, next), stiffness, next);
+
+			Store4(m_previous[c], i, XMVectorSelect(x, target, pinned));
+			Store4(m_x[c], i, XMVectorSelect(next, target, pinned));
+		}
+	}
+}
+
+void PMDSpringBones::SnapPinned()
+{
+	// Depth 0 holds pinned particles only (and padding)
+	const auto end = m_depthStarts[1];
+	for (size_t c = 0; c < 3; ++c)
+	{
+		std::copy(m_target[c].begin(), m_target[c].begin() + end, m_x[c].begin());
+		std::copy(m_target[c].begin(), m_target[c].begin() + end, m_previous[c].begin());
+		std::copy(m_target[c].begin(), m_target[c].begin() + end, m_lastTarget[c].begin());
+	}
+}
+
+void PMDSpringBones::SolveLengths()
+{
+	const auto minLength = XMVectorReplicate(min_length);
+	for (size_t d = 1; d + 1 < m_depthStarts.size(); ++d)
+	{
+		for (size_t i = m_depthStarts[d]; i < m_depthStarts[d + 1]; i += lane_count)
+		{
+			// Parents are in shallower groups and already solved
+			XMVECTOR parent[3], delta[3];
+			for (size_t c = 0; c < 3; ++c)
+			{
+				auto& x = m_x[c];
+				parent[c] = XMVectorSet(x[m_parents[i]], x[m_parents[i + 1]], x[m_parents[i + 2]], x[m_parents[i + 3]]);
+				delta[c] = XMVectorSubtract(Load4(x, i), parent[c]);
+			}
+			auto lengthSq = XMVectorMultiply(delta[0], delta[0]);
+			lengthSq = XMVectorMultiplyAdd(delta[1], delta[1], lengthSq);
+			lengthSq = XMVectorMultiplyAdd(delta[2], delta[2], lengthSq);
+			auto scale = XMVectorDivide(Load4(m_restLengths, i), XMVectorMax(XMVectorSqrt(lengthSq), minLength));
+			for (size_t c = 0; c < 3; ++c)
+				Store4(m_x[c], i, XMVectorMultiplyAdd(delta[c], scale, parent[c]));
+		}
+	}
+}
+
+void PMDSpringBones::WriteBack(XMFLOAT3X4* transforms) const
+{
+	// Parents come first, every bone is placed relative to its already simulated parent
+	for (uint32_t i = 0; i < m_bones.size(); ++i)
+	{
+		auto bone = m_bones[i];
+		if (bone == no_bone) continue;
+
+		auto animated = XMLoadFloat3x4(&m_animated[i]);
+		auto transform = animated;
+		auto parent = m_parents[i];
+		if (parent != i)
+		{
+			// Keep bone's animated pose relative to its parent
+			auto toParent = XMLoadFloat3x4(&m_inverseAnimated[parent]);
+			transform = XMMatrixMultiply(XMMatrixMultiply(animated, toParent), XMLoadFloat3x4(&transforms[m_bones[parent]]));
+		}
+
+		// Parent only points to its first child, other children are moved to their particle
+		auto position = XMVectorSet(m_x[0][i], m_x[1][i], m_x[2][i], 1.0f);
+		auto offset = XMVectorSubtract(position, XMVector3Transform(XMLoadFloat3(&m_positions[bone]), transform));
+		transform.r[3] = XMVectorAdd(transform.r[3], XMVectorSetW(offset, 0.0f));
+
+		auto child = m_firstChildren[i];
+		if (child != no_particle)
+		{
+			// Where child is when this bone keeps its animated rotation
+			auto childBone = m_bones[child];
+			auto childAnimated = XMVector3Transform(XMLoadFloat3(&m_positions[childBone]), XMLoadFloat3x4(&m_animated[child]));
+			auto childPosition = XMVector3Transform(XMVector3Transform(childAnimated, XMLoadFloat3x4(&m_inverseAnimated[i])), transform);
+			auto from = XMVector3Normalize(XMVectorSubtract(childPosition, position));
+			auto to = XMVector3Normalize(XMVectorSubtract(XMVectorSet(m_x[0][child], m_x[1][child], m_x[2][child], 1.0f), position));
+			auto axis = XMVector3Cross(from, to);
+			auto sine = XMVectorGetX(XMVector3Length(axis));
+			if (sine > min_aim_sine)
+			{
+				auto angle = std::atan2(sine, XMVectorGetX(XMVector3Dot(from, to)));
+				transform *= XMMatrixTranslationFromVector(XMVectorNegate(position));
+				transform *= XMMatrixRotationAxis(axis, angle);
+				transform *= XMMatrixTranslationFromVector(position);
+			}
+		}
+		XMStoreFloat3x4(&transforms[bone], transform);
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "PMDCommon.h"
+
+class PMDSkeleton;
+
+// Behaviour of every spring chain of a model
+struct PMDSpringParams
+{
+	// Pull toward the animated pose each step, 0 swings freely and 1 follows animation
+	float Stiffness = 0.1f;
+	// Fraction of velocity lost each step
+	float Damping = 0.05f;
+	// Acceleration in model space, model units per second^2 (1 unit is about 8 cm)
+	DirectX::XMFLOAT3 Gravity = { 0.0f, -98.0f, 0.0f };
+};
+
+// Counters of spring simulations
+struct PMDSpringStats
+{
+	uint32_t ParticleCount = 0;
+	// Particles x fixed steps
+	uint32_t StepCount = 0;
+};
+
+// Secondary motion of bone chains (hair, skirts, ribbons...) of one model
+// Every bone of a chain is a particle integrated with Verlet at a fixed time step
+// Particles are stored in SoA and grouped by depth, each depth group is padded to 4
+// so integration and length constraints run 4 particles per SIMD instruction
+// Top bone of every chain is pinned to its animated position
+class PMDSpringBones
+{
+public:
+	// Seconds of one simulation step
+	static constexpr float time_step = 1.0f / 60.0f;
+
+	// Each name is either an exact bone name in bonesTable -> the bone and all bones under it
+	// or a part of bone names -> every bone containing it and all bones under it
+	// Empty names select hair and skirt bones of the usual PMD naming
+	// Return false if no bone is selected
+	bool Create(const std::vector<PMDBone>& bones, const PMDSkeleton& skeleton,
+		const std::unordered_map<std::string, uint16_t>& bonesTable,
+		const std::vector<std::string>& names, const PMDSpringParams& params);
+	bool Empty() const;
+	size_t ChainCount() const;
+	size_t ParticleCount() const;
+
+	// Accumulate time of an update, simulation runs it in fixed steps
+	void AddTime(float deltaTime);
+	// Whole fixed steps in accumulated time
+	uint32_t PendingSteps() const;
+	// Remove whole steps from accumulated time once they are handed to Simulate
+	// Steps that weren't handed are dropped too -> a slow frame or a cut budget doesn't slow the next update
+	void ConsumeSteps();
+	// transforms are model's bone transforms after skeleton pass and IK
+	// Run stepCount steps toward them, then overwrite chain bones with the simulated pose
+	// Pinned top bones follow transforms even when stepCount is 0
+	void Simulate(DirectX::XMFLOAT3X4* transforms, uint32_t stepCount, PMDSpringStats& stats);
+private:
+	// Move particles by velocity, gravity and pull toward targets, pinned particles snap to them
+	void Integrate(float targetWeight);
+	// Put pinned particles on their animated position, with no velocity
+	void SnapPinned();
+	// Put every particle back at its rest distance from its parent, one depth group at a time
+	// Parents are solved before children -> one pass satisfies every constraint
+	void SolveLengths();
+	// Rotate chain bones so they point to their simulated child
+	void WriteBack(DirectX::XMFLOAT3X4* transforms) const;
+private:
+	static constexpr uint32_t no_particle = 0xffffffff;
+
+	PMDSpringParams m_params;
+	size_t m_chainCount = 0;
+	size_t m_particleCount = 0;
+	// Particle index range of each depth, every range starts at a multiple of 4
+	// Depth 0 holds the pinned top bones
+	std::vector<uint32_t> m_depthStarts;
+	// Per particle, padding particles have no bone and are their own parent
+	std::vector<uint16_t> m_bones;
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_firstChildren;
+	std::vector<float> m_restLengths;
+	// 1 for pinned particles, 0 for simulated ones
+	std::vector<float> m_pinned;
+	// Current and previous positions, animated positions of this and last Simulate
+	std::vector<float> m_x[3], m_previous[3];
+	std::vector<float> m_target[3], m_lastTarget[3];
+	// Rest positions of bones
+	std::vector<DirectX::XMFLOAT3> m_positions;
+	// Animated transforms of chain bones and their inverses, WriteBack builds on them
+	std::vector<DirectX::XMFLOAT3X4> m_animated;
+	std::vector<DirectX::XMFLOAT3X4> m_inverseAnimated;
+	float m_time = 0.0f;
+	bool m_isStarted = false;
+};
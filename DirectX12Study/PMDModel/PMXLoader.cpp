@@ -0,0 +1,650 @@
+#include "PMXLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <Windows.h>
+
+#include "../Utility/MappedFile.h"
+#include "../Utility/ByteReader.h"
+#include "../Utility/StringHelper.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Shift-JIS, the encoding of PMD and VMD names
+	constexpr UINT name_code_page = 932;
+	constexpr int32_t no_index = -1;
+	constexpr size_t max_bone_weights = 4;
+	constexpr float max_quantized_weight = 255.0f;
+	// Internal toon textures are toon01.bmp ~ toon10.bmp
+	constexpr uint8_t internal_toon_count = 10;
+
+	enum class PMXGlobal : uint8_t
+	{
+		TextEncoding,
+		AdditionalUVCount,
+		VertexIndexSize,
+		TextureIndexSize,
+		MaterialIndexSize,
+		BoneIndexSize,
+		MorphIndexSize,
+		RigidBodyIndexSize,
+		Count
+	};
+
+	enum class PMXWeightType : uint8_t
+	{
+		BDEF1,
+		BDEF2,
+		BDEF4,
+		SDEF,
+		// PMX 2.1
+		QDEF
+	};
+
+	enum class PMXMorphType : uint8_t
+	{
+		Group,
+		Vertex,
+		Bone,
+		UV,
+		AdditionalUV1,
+		AdditionalUV2,
+		AdditionalUV3,
+		AdditionalUV4,
+		Material,
+		// PMX 2.1
+		Flip,
+		Impulse
+	};
+
+	enum PMXBoneFlag : uint16_t
+	{
+		tail_is_bone = 0x0001,
+		is_ik = 0x0020,
+		inherit_rotation = 0x0100,
+		inherit_translation = 0x0200,
+		fixed_axis = 0x0400,
+		local_axes = 0x0800,
+		external_parent = 0x2000,
+	};
+
+	enum class PMXSphereMode : uint8_t
+	{
+		Disabled,
+		Multiply,
+		Add,
+		SubTexture
+	};
+
+#pragma pack(1)
+	struct PMXHeader
+	{
+		char id[4];
+		float version;
+		uint8_t globalCount;
+	};
+
+	struct PMXMaterial
+	{
+		DirectX::XMFLOAT4 diffuse;
+		DirectX::XMFLOAT3 specular;
+		float specularity;
+		DirectX::XMFLOAT3 ambient;
+		uint8_t drawFlags;
+		DirectX::XMFLOAT4 edgeColor;
+		float edgeSize;
+	};
+
+	struct PMXIKLimit
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+	};
+#pragma pack()
+
+	// Bytes after the index of one offset of material morph
+	constexpr size_t material_morph_size = 1 + sizeof(float) * (4 + 3 + 1 + 3 + 4 + 1 + 4 + 4 + 4);
+	// Bytes after the index of one offset of impulse morph
+	constexpr size_t impulse_morph_size = 1 + sizeof(float) * (3 + 3);
+
+	// Index and offset sizes of one morph offset, false for unknown morph types
+	bool GetMorphOffsetSize(PMXMorphType type, const uint8_t* globals, size_t& indexSize, size_t& offsetSize)
+	{
+		auto global = [globals](PMXGlobal g) { return static_cast<size_t>(globals[static_cast<size_t>(g)]); };
+		switch (type)
+		{
+		case PMXMorphType::Group:
+		case PMXMorphType::Flip:
+			indexSize = global(PMXGlobal::MorphIndexSize);
+			offsetSize = sizeof(float);
+			return true;
+		case PMXMorphType::Vertex:
+			indexSize = global(PMXGlobal::VertexIndexSize);
+			offsetSize = sizeof(XMFLOAT3);
+			return true;
+		case PMXMorphType::Bone:
+			indexSize = global(PMXGlobal::BoneIndexSize);
+			offsetSize = sizeof(XMFLOAT3) + sizeof(XMFLOAT4);
+			return true;
+		case PMXMorphType::UV:
+		case PMXMorphType::AdditionalUV1:
+		case PMXMorphType::AdditionalUV2:
+		case PMXMorphType::AdditionalUV3:
+		case PMXMorphType::AdditionalUV4:
+			indexSize = global(PMXGlobal::VertexIndexSize);
+			offsetSize = sizeof(XMFLOAT4);
+			return true;
+		case PMXMorphType::Material:
+			indexSize = global(PMXGlobal::MaterialIndexSize);
+			offsetSize = material_morph_size;
+			return true;
+		case PMXMorphType::Impulse:
+			indexSize = global(PMXGlobal::RigidBodyIndexSize);
+			offsetSize = impulse_morph_size;
+			return true;
+		}
+		return false;
+	}
+
+	// Index fields are 1, 2 or 4 bytes
+	// Vertex indices are unsigned, other indices are signed and -1 means none
+	bool ReadIndex(ByteReader& reader, uint8_t size, bool isVertex, int32_t& out)
+	{
+		switch (size)
+		{
+		case 1:
+		{
+			uint8_t value = 0;
+			if (!reader.Read(value)) return false;
+			out = isVertex ? value : static_cast<int8_t>(value);
+			return true;
+		}
+		case 2:
+		{
+			uint16_t value = 0;
+			if (!reader.Read(value)) return false;
+			out = isVertex ? value : static_cast<int16_t>(value);
+			return true;
+		}
+		case 4:
+			return reader.Read(out);
+		}
+		return false;
+	}
+
+	bool IsValidIndexSize(uint8_t size)
+	{
+		return size == 1 || size == 2 || size == 4;
+	}
+
+	// Surface section is one array of vertex indices of the same width
+	template<typename T>
+	bool ReadIndices(ByteReader& reader, size_t count, std::vector<uint32_t>& indices)
+	{
+		auto p = reader.View<T>(count);
+		if (p == nullptr && count != 0) return false;
+		indices.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			T index;
+			std::memcpy(&index, p + i, sizeof(T));
+			indices[i] = index;
+		}
+		return true;
+	}
+
+	// Text fields are UTF-16LE or UTF-8, both go through one wide buffer
+	class PMXTextReader
+	{
+	public:
+		explicit PMXTextReader(bool isUTF8) :m_isUTF8(isUTF8) {}
+
+		bool Read(ByteReader& reader, UINT codePage, std::string& out)
+		{
+			int32_t size = 0;
+			if (!reader.Read(size) || size < 0) return false;
+			auto bytes = reader.View<char>(size);
+			if (bytes == nullptr && size != 0) return false;
+			out.clear();
+			if (size == 0) return true;
+
+			if (m_isUTF8)
+			{
+				auto length = MultiByteToWideChar(CP_UTF8, 0, bytes, size, nullptr, 0);
+				m_wide.resize(length);
+				MultiByteToWideChar(CP_UTF8, 0, bytes, size, &m_wide[0], length);
+			}
+			else
+			{
+				m_wide.resize(size / sizeof(uint16_t));
+				for (size_t i = 0; i < m_wide.size(); ++i)
+				{
+					uint16_t c;
+					std::memcpy(&c, bytes + i * sizeof(c), sizeof(c));
+					m_wide[i] = static_cast<wchar_t>(c);
+				}
+			}
+			if (m_wide.empty()) return true;
+
+			auto wideLength = static_cast<int>(m_wide.size());
+			auto length = WideCharToMultiByte(codePage, 0, m_wide.data(), wideLength, nullptr, 0, nullptr, nullptr);
+			out.resize(length);
+			if (length > 0)
+				WideCharToMultiByte(codePage, 0, m_wide.data(), wideLength, &out[0], length, nullptr, nullptr);
+			return true;
+		}
+
+		bool Skip(ByteReader& reader)
+		{
+			int32_t size = 0;
+			return reader.Read(size) && size >= 0 && reader.Skip(size);
+		}
+	private:
+		bool m_isUTF8;
+		std::wstring m_wide;
+	};
+
+	// Normalize weights of bones in [0, boneCount) and quantize them to 1/255
+	// Rounding error goes to the heaviest bone, vertex without any weight follows bone 0
+	void SetBoneWeights(PMXVertex& vertex, const int32_t* bones, const float* weights, size_t count, size_t boneCount)
+	{
+		float sum = 0.0f;
+		float valid[max_bone_weights] = {};
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (bones[i] < 0 || static_cast<size_t>(bones[i]) >= boneCount || !(weights[i] > 0.0f)) continue;
+			valid[i] = weights[i];
+			sum += weights[i];
+		}
+
+		std::memset(vertex.boneNo, 0, sizeof(vertex.boneNo));
+		std::memset(vertex.weight, 0, sizeof(vertex.weight));
+		if (sum <= 0.0f)
+		{
+			vertex.weight[0] = static_cast<uint8_t>(max_quantized_weight);
+			return;
+		}
+
+		int total = 0;
+		size_t heaviest = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			vertex.boneNo[i] = valid[i] > 0.0f ? static_cast<uint16_t>(bones[i]) : 0;
+			vertex.weight[i] = static_cast<uint8_t>(std::lround(valid[i] / sum * max_quantized_weight));
+			total += vertex.weight[i];
+			if (valid[i] > valid[heaviest]) heaviest = i;
+		}
+		vertex.weight[heaviest] = static_cast<uint8_t>(vertex.weight[heaviest] + static_cast<int>(max_quantized_weight) - total);
+	}
+
+	// IK link that can only rotate around X axis bends like a knee
+	bool IsKneeLimit(const PMXIKLimit& limit)
+	{
+		return limit.min.y == 0.0f && limit.max.y == 0.0f && limit.min.z == 0.0f && limit.max.z == 0.0f &&
+			limit.min.x != limit.max.x;
+	}
+}
+
+bool PMXLoader::Load(const char* path)
+{
+	Path = path;
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		OutputDebugStringA("PMXLoader: can't open PMX file\n");
+		return false;
+	}
+	ByteReader reader(file.Data(), file.Size());
+
+	PMXHeader header;
+	if (!reader.Read(header) || std::memcmp(header.id, "PMX ", 4) != 0 ||
+		header.globalCount < static_cast<uint8_t>(PMXGlobal::Count))
+	{
+		OutputDebugStringA("PMXLoader: file isn't PMX format\n");
+		return false;
+	}
+	// PMX 2.1 may have more globals than 2.0, only the first ones are known
+	uint8_t globals[static_cast<size_t>(PMXGlobal::Count)];
+	reader.Read(globals);
+	reader.Skip(header.globalCount - sizeof(globals));
+	auto global = [&globals](PMXGlobal g) { return globals[static_cast<size_t>(g)]; };
+
+	const auto additionalUVCount = global(PMXGlobal::AdditionalUVCount);
+	const auto vertexIndexSize = global(PMXGlobal::VertexIndexSize);
+	const auto textureIndexSize = global(PMXGlobal::TextureIndexSize);
+	const auto materialIndexSize = global(PMXGlobal::MaterialIndexSize);
+	const auto boneIndexSize = global(PMXGlobal::BoneIndexSize);
+	const auto morphIndexSize = global(PMXGlobal::MorphIndexSize);
+	const auto rigidBodyIndexSize = global(PMXGlobal::RigidBodyIndexSize);
+	if (additionalUVCount > 4 || !IsValidIndexSize(vertexIndexSize) || !IsValidIndexSize(textureIndexSize) ||
+		!IsValidIndexSize(materialIndexSize) || !IsValidIndexSize(boneIndexSize) ||
+		!IsValidIndexSize(morphIndexSize) || !IsValidIndexSize(rigidBodyIndexSize))
+	{
+		OutputDebugStringA("PMXLoader: PMX header is broken\n");
+		return false;
+	}
+
+	PMXTextReader text(global(PMXGlobal::TextEncoding) == 1);
+	// Model names and comments
+	for (int i = 0; i < 4; ++i)
+		text.Skip(reader);
+
+	// Vertices, bone indices are checked once bone count is known
+	int32_t vertexCount = 0;
+	if (!reader.Read(vertexCount) || vertexCount < 0 ||
+		static_cast<size_t>(vertexCount) > reader.Remaining() / sizeof(XMFLOAT3))
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+	Vertices.resize(vertexCount);
+	for (auto& vertex : Vertices)
+	{
+		reader.Read(vertex.pos);
+		reader.Read(vertex.normal);
+		reader.Read(vertex.uv);
+		reader.Skip(sizeof(XMFLOAT4) * additionalUVCount);
+
+		uint8_t weightType = 0;
+		reader.Read(weightType);
+		int32_t bones[max_bone_weights] = { no_index, no_index, no_index, no_index };
+		float weights[max_bone_weights] = {};
+		size_t weightCount = 0;
+		switch (static_cast<PMXWeightType>(weightType))
+		{
+		case PMXWeightType::BDEF1:
+			ReadIndex(reader, boneIndexSize, false, bones[0]);
+			weights[0] = 1.0f;
+			weightCount = 1;
+			break;
+		case PMXWeightType::BDEF2:
+		case PMXWeightType::SDEF:
+			ReadIndex(reader, boneIndexSize, false, bones[0]);
+			ReadIndex(reader, boneIndexSize, false, bones[1]);
+			reader.Read(weights[0]);
+			weights[1] = 1.0f - weights[0];
+			weightCount = 2;
+			// C, R0 and R1 of spherical deform
+			if (static_cast<PMXWeightType>(weightType) == PMXWeightType::SDEF)
+				reader.Skip(sizeof(XMFLOAT3) * 3);
+			break;
+		case PMXWeightType::BDEF4:
+		case PMXWeightType::QDEF:
+			for (auto& bone : bones)
+				ReadIndex(reader, boneIndexSize, false, bone);
+			reader.Read(weights);
+			weightCount = max_bone_weights;
+			break;
+		default:
+			OutputDebugStringA("PMXLoader: unknown vertex weight type\n");
+			return false;
+		}
+		// Bone count isn't known yet, bones out of skeleton are dropped after bones are read
+		SetBoneWeights(vertex, bones, weights, weightCount, 0xffff);
+
+		// Edge scale
+		reader.Skip(sizeof(float));
+	}
+	if (reader.Failed())
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+
+	int32_t indexCount = 0;
+	reader.Read(indexCount);
+	bool isIndicesRead = indexCount >= 0;
+	if (isIndicesRead)
+	{
+		switch (vertexIndexSize)
+		{
+		case 1: isIndicesRead = ReadIndices<uint8_t>(reader, indexCount, Indices); break;
+		case 2: isIndicesRead = ReadIndices<uint16_t>(reader, indexCount, Indices); break;
+		case 4: isIndicesRead = ReadIndices<uint32_t>(reader, indexCount, Indices); break;
+		}
+	}
+	if (!isIndicesRead)
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+	for (auto& index : Indices)
+	{
+		if (index >= Vertices.size()) index = 0;
+	}
+
+	// Texture table, materials refer to it by index
+	int32_t textureCount = 0;
+	reader.Read(textureCount);
+	std::vector<std::string> textures((std::max)(textureCount, 0));
+	for (auto& texture : textures)
+		text.Read(reader, CP_ACP, texture);
+
+	int32_t materialCount = 0;
+	reader.Read(materialCount);
+	materialCount = (std::max)(materialCount, 0);
+	if (static_cast<size_t>(materialCount) > reader.Remaining() / sizeof(PMXMaterial))
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+	Materials.reserve(materialCount);
+	SubMaterials.reserve(materialCount);
+	TexturePaths.resize(materialCount);
+	auto texturePath = [&](int32_t index) {
+		return index >= 0 && index < textureCount && !textures[index].empty() ?
+			StringHelper::GetTexturePathFromModelPath(path, textures[index].c_str()) : std::string();
+	};
+	for (auto& paths : TexturePaths)
+	{
+		// Names
+		text.Skip(reader);
+		text.Skip(reader);
+		PMXMaterial material;
+		reader.Read(material);
+
+		int32_t textureIndex = no_index, sphereIndex = no_index;
+		ReadIndex(reader, textureIndexSize, false, textureIndex);
+		ReadIndex(reader, textureIndexSize, false, sphereIndex);
+		uint8_t sphereMode = 0, isSharedToon = 0;
+		reader.Read(sphereMode);
+		reader.Read(isSharedToon);
+		paths.Texture = texturePath(textureIndex);
+		if (static_cast<PMXSphereMode>(sphereMode) == PMXSphereMode::Multiply)
+			paths.Sph = texturePath(sphereIndex);
+		else if (static_cast<PMXSphereMode>(sphereMode) == PMXSphereMode::Add)
+			paths.Spa = texturePath(sphereIndex);
+
+		if (isSharedToon)
+		{
+			// Shared toons are the default toon textures, found by name when the path can't be loaded
+			uint8_t toon = 0;
+			reader.Read(toon);
+			if (toon < internal_toon_count)
+			{
+				auto number = std::to_string(toon + 1);
+				paths.ToonName = "toon" + std::string(2 - number.size(), '0') + number + ".bmp";
+				paths.Toon = StringHelper::GetTexturePathFromModelPath(path, paths.ToonName.c_str());
+			}
+		}
+		else
+		{
+			int32_t toonIndex = no_index;
+			ReadIndex(reader, textureIndexSize, false, toonIndex);
+			paths.Toon = texturePath(toonIndex);
+			if (toonIndex >= 0 && toonIndex < textureCount)
+				paths.ToonName = textures[toonIndex];
+		}
+
+		// Memo
+		text.Skip(reader);
+		int32_t materialIndexCount = 0;
+		reader.Read(materialIndexCount);
+
+		Materials.push_back({ XMFLOAT3(material.diffuse.x, material.diffuse.y, material.diffuse.z), material.diffuse.w,
+			material.specular, material.specularity, material.ambient });
+		SubMaterials.push_back({ static_cast<uint32_t>((std::max)(materialIndexCount, 0)) });
+	}
+
+	int32_t boneCount = 0;
+	reader.Read(boneCount);
+	if (boneCount < 0 || boneCount >= 0xffff || reader.Failed())
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+	Bones.resize(boneCount);
+	for (int32_t i = 0; i < boneCount; ++i)
+	{
+		auto& bone = Bones[i];
+		text.Read(reader, name_code_page, bone.name);
+		text.Skip(reader);
+		reader.Read(bone.pos);
+		int32_t parent = no_index;
+		ReadIndex(reader, boneIndexSize, false, parent);
+		bone.parentNo = parent >= 0 && parent < boneCount && parent != i ? static_cast<uint16_t>(parent) : 0xffff;
+
+		// Deform layer
+		reader.Skip(sizeof(int32_t));
+		uint16_t flags = 0;
+		reader.Read(flags);
+		int32_t index = no_index;
+		if (flags & tail_is_bone)
+			ReadIndex(reader, boneIndexSize, false, index);
+		else
+			reader.Skip(sizeof(XMFLOAT3));
+		if (flags & (inherit_rotation | inherit_translation))
+		{
+			ReadIndex(reader, boneIndexSize, false, index);
+			reader.Skip(sizeof(float));
+		}
+		if (flags & fixed_axis)
+			reader.Skip(sizeof(XMFLOAT3));
+		if (flags & local_axes)
+			reader.Skip(sizeof(XMFLOAT3) * 2);
+		if (flags & external_parent)
+			reader.Skip(sizeof(int32_t));
+
+		if (flags & is_ik)
+		{
+			// Bone numbers are validated by PMDIKSolver
+			int32_t target = no_index, iterations = 0, linkCount = 0;
+			float limitAngle = 0.0f;
+			ReadIndex(reader, boneIndexSize, false, target);
+			reader.Read(iterations);
+			reader.Read(limitAngle);
+			reader.Read(linkCount);
+			if (linkCount < 0)
+			{
+				OutputDebugStringA("PMXLoader: PMX file is broken\n");
+				return false;
+			}
+
+			PMDIKChain chain = {};
+			chain.IKBone = static_cast<uint16_t>(i);
+			chain.EffectorBone = static_cast<uint16_t>(target);
+			chain.Iterations = static_cast<uint16_t>((std::min)((std::max)(iterations, 0), 0xffff));
+			chain.LinkCount = static_cast<uint16_t>((std::min)(linkCount, 0xffff));
+			chain.FirstLink = static_cast<uint32_t>(IKLinks.size());
+			chain.LimitAngle = limitAngle;
+			for (int32_t l = 0; l < linkCount; ++l)
+			{
+				int32_t linkBone = no_index;
+				uint8_t hasLimit = 0;
+				ReadIndex(reader, boneIndexSize, false, linkBone);
+				reader.Read(hasLimit);
+				PMDIKLink link = {};
+				link.Bone = static_cast<uint16_t>(linkBone);
+				if (hasLimit)
+				{
+					PMXIKLimit limit;
+					reader.Read(limit);
+					link.IsKnee = IsKneeLimit(limit);
+				}
+				if (l < chain.LinkCount)
+					IKLinks.push_back(link);
+			}
+			IKChains.push_back(chain);
+		}
+	}
+	if (reader.Failed())
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+	BonesTable.reserve(Bones.size());
+	for (uint16_t i = 0; i < Bones.size(); ++i)
+		BonesTable[Bones[i].name] = i;
+
+	// Vertices were read before bones, drop bone numbers out of skeleton now
+	for (auto& vertex : Vertices)
+	{
+		int32_t bones[max_bone_weights];
+		float weights[max_bone_weights];
+		bool isOutOfSkeleton = false;
+		for (size_t i = 0; i < max_bone_weights; ++i)
+		{
+			bones[i] = vertex.boneNo[i];
+			weights[i] = vertex.weight[i];
+			isOutOfSkeleton |= vertex.weight[i] > 0 && vertex.boneNo[i] >= Bones.size();
+		}
+		if (isOutOfSkeleton)
+			SetBoneWeights(vertex, bones, weights, max_bone_weights, Bones.size());
+	}
+
+	// Only vertex morphs move vertices of this renderer, the other types are skipped
+	int32_t morphCount = 0;
+	reader.Read(morphCount);
+	Morphs.reserve((std::max)(morphCount, 0));
+	for (int32_t i = 0; i < morphCount; ++i)
+	{
+		PMDMorph morph;
+		text.Read(reader, name_code_page, morph.Name);
+		text.Skip(reader);
+		uint8_t panel = 0, type = 0;
+		int32_t offsetCount = 0;
+		reader.Read(panel);
+		reader.Read(type);
+		reader.Read(offsetCount);
+		if (reader.Failed() || offsetCount < 0) break;
+
+		// Size of unknown morph is unknown, nothing after it can be read
+		size_t indexSize = 0, offsetSize = 0;
+		if (!GetMorphOffsetSize(static_cast<PMXMorphType>(type), globals, indexSize, offsetSize)) break;
+		if (static_cast<PMXMorphType>(type) != PMXMorphType::Vertex)
+		{
+			reader.Skip((indexSize + offsetSize) * static_cast<size_t>(offsetCount));
+			continue;
+		}
+
+		morph.First = static_cast<uint32_t>(MorphVertices.size());
+		morph.MinVertex = static_cast<uint32_t>(Vertices.size());
+		MorphVertices.reserve(MorphVertices.size() + offsetCount);
+		for (int32_t v = 0; v < offsetCount; ++v)
+		{
+			int32_t index = 0;
+			XMFLOAT3 delta;
+			ReadIndex(reader, vertexIndexSize, true, index);
+			if (!reader.Read(delta)) break;
+			if (static_cast<uint32_t>(index) >= Vertices.size()) continue;
+			auto vertex = static_cast<uint32_t>(index);
+			MorphVertices.push_back({ vertex, delta });
+			morph.MinVertex = (std::min)(morph.MinVertex, vertex);
+			morph.MaxVertex = (std::max)(morph.MaxVertex, vertex);
+		}
+		morph.Count = static_cast<uint32_t>(MorphVertices.size()) - morph.First;
+		if (morph.Count == 0)
+			morph.MinVertex = 0;
+		Morphs.push_back(std::move(morph));
+	}
+
+	if (reader.Failed())
+	{
+		OutputDebugStringA("PMXLoader: PMX file is truncated\n");
+		return false;
+	}
+	return true;
+}
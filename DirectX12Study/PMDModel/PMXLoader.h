@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "PMDCommon.h"
+
+// Vertex of PMX model with up to 4 bones, 44 bytes
+// Weights are in 1/255 and add up to 255, unused bones have weight 0
+// PMDLoader splits these into PMDVertex and, for models with vertices on more than 2 bones, PMDSkinWeights
+struct PMXVertex
+{
+	DirectX::XMFLOAT3 pos;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT2 uv;
+	uint16_t boneNo[4];
+	uint8_t weight[4];
+};
+
+// Load PMX 2.0 / 2.1 model with a single pass over the mapped file
+// Every array is reserved from the count before it in the file, text goes through one reused buffer
+// Data PMX shares with PMD (materials, bones, IK, vertex morphs) is stored in PMD structures
+// Names are converted to Shift-JIS like PMD's so bones match VMD motions
+// SDEF vertices keep their BDEF2 weights (no spherical correction), QDEF ones their BDEF4 weights
+// Inherit (fuyo) bones lose their inherit parent, they only follow their own parent and keyframes
+// Deform layers, fixed and local axes and external parents are skipped too, parents update before children
+// Display frames, rigid bodies and joints aren't read
+class PMXLoader
+{
+public:
+	bool Load(const char* path);
+
+	std::vector<PMXVertex> Vertices;
+	std::vector<uint32_t> Indices;
+	std::vector<PMDMaterial> Materials;
+	std::vector<PMDSubMaterial> SubMaterials;
+	std::vector<PMDTexturePaths> TexturePaths;
+	std::vector<PMDBone> Bones;
+	std::unordered_map<std::string, uint16_t> BonesTable;
+	std::vector<PMDIKChain> IKChains;
+	std::vector<PMDIKLink> IKLinks;
+	std::vector<PMDMorph> Morphs;
+	std::vector<PMDMorphVertex> MorphVertices;
+	std::string Path;
+};
@@ -0,0 +1,81 @@
+#include "VMDCurve.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Newton alone converges slowly where curve is flat (x'(t) ~ 0)
+	// Keeping a bracket and falling back to bisection bounds the error
+	constexpr size_t newton_iteration_count = 8;
+
+	// Polynomial coefficients of bezier with control points 0, p1, p2, 1
+	void GetCoefficients(float p1, float p2, float& a, float& b, float& c)
+	{
+		a = 3.0f * p1 - 3.0f * p2 + 1.0f;   // t^3
+		b = -6.0f * p1 + 3.0f * p2;          // t^2
+		c = 3.0f * p1;                       // t
+	}
+}
+
+VMDCurve CreateVMDCurve(const uint8_t interpolation[64])
+{
+	// First row of interpolation block is x1[X Y Z R], y1[X Y Z R], x2[X Y Z R], y2[X Y Z R]
+	// other rows repeat it shifted by one byte
+	float ax[4], bx[4], cx[4], ay[4], by[4], cy[4];
+	for (size_t c = 0; c < static_cast<size_t>(VMDChannel::Max); ++c)
+	{
+		auto x1 = interpolation[c] / 127.0f;
+		auto y1 = interpolation[4 + c] / 127.0f;
+		auto x2 = interpolation[8 + c] / 127.0f;
+		auto y2 = interpolation[12 + c] / 127.0f;
+		GetCoefficients(x1, x2, ax[c], bx[c], cx[c]);
+		GetCoefficients(y1, y2, ay[c], by[c], cy[c]);
+	}
+
+	VMDCurve curve;
+	curve.Ax = XMFLOAT4(ax);
+	curve.Bx = XMFLOAT4(bx);
+	curve.Cx = XMFLOAT4(cx);
+	curve.Ay = XMFLOAT4(ay);
+	curve.By = XMFLOAT4(by);
+	curve.Cy = XMFLOAT4(cy);
+	return curve;
+}
+
+XMVECTOR XM_CALLCONV EvaluateVMDCurve(const VMDCurve& curve, float x)
+{
+	if (x <= 0.0f) return XMVectorZero();
+	if (x >= 1.0f) return XMVectorSplatOne();
+
+	const auto ax = XMLoadFloat4(&curve.Ax);
+	const auto bx = XMLoadFloat4(&curve.Bx);
+	const auto cx = XMLoadFloat4(&curve.Cx);
+	const auto ax3 = XMVectorScale(ax, 3.0f);
+	const auto bx2 = XMVectorScale(bx, 2.0f);
+	const auto vx = XMVectorReplicate(x);
+	const auto half = XMVectorReplicate(0.5f);
+
+	// Solve x(t) = x for t, every channel at once
+	auto t = vx;
+	auto lo = XMVectorZero();
+	auto hi = XMVectorSplatOne();
+	for (size_t i = 0; i < newton_iteration_count; ++i)
+	{
+		auto f = XMVectorMultiplyAdd(XMVectorMultiplyAdd(XMVectorMultiplyAdd(ax, t, bx), t, cx), t, XMVectorNegate(vx));
+		auto d = XMVectorMultiplyAdd(XMVectorMultiplyAdd(ax3, t, bx2), t, cx);
+
+		auto below = XMVectorLess(f, XMVectorZero());
+		lo = XMVectorSelect(lo, t, below);
+		hi = XMVectorSelect(t, hi, below);
+
+		// Newton step leaving the bracket (or d = 0 -> NaN) is replaced by bisection
+		auto next = XMVectorSubtract(t, XMVectorDivide(f, d));
+		auto inBracket = XMVectorAndInt(XMVectorGreaterOrEqual(next, lo), XMVectorLessOrEqual(next, hi));
+		t = XMVectorSelect(XMVectorMultiply(XMVectorAdd(lo, hi), half), next, inBracket);
+	}
+
+	const auto ay = XMLoadFloat4(&curve.Ay);
+	const auto by = XMLoadFloat4(&curve.By);
+	const auto cy = XMLoadFloat4(&curve.Cy);
+	return XMVectorMultiply(XMVectorMultiplyAdd(XMVectorMultiplyAdd(ay, t, by), t, cy), t);
+}
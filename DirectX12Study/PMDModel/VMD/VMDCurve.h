@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <DirectXMath.h>
+
+// Interpolation channels of VMD keyframe, one per vector lane of VMDCurve
+enum class VMDChannel
+{
+	X,
+	Y,
+	Z,
+	Rotation,
+	Max
+};
+
+// Bezier interpolation curves of one keyframe segment for all 4 channels
+// Control points are (0,0),(x1,y1),(x2,y2),(1,1) so every curve is stored as
+// x(t) = ((Ax * t + Bx) * t + Cx) * t and y(t) = ((Ay * t + By) * t + Cy) * t
+struct VMDCurve
+{
+	DirectX::XMFLOAT4 Ax, Bx, Cx;
+	DirectX::XMFLOAT4 Ay, By, Cy;
+};
+
+// Precompute curve coefficients from VMD's 64 bytes interpolation block
+VMDCurve CreateVMDCurve(const uint8_t interpolation[64]);
+
+// Eased weight of every channel at progress x (0 ~ 1) of segment
+// Uses a fixed number of safeguarded Newton steps, |x(t) - x| stays below 3e-5
+DirectX::XMVECTOR XM_CALLCONV EvaluateVMDCurve(const VMDCurve& curve, float x);
@@ -0,0 +1,205 @@
+#include "VMDDenseTracks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <DirectXMath.h>
+
+#include "VMDMotion.h"
+#include "VMDSampler.h"
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr float snorm16_scale = 32767.0f;
+	constexpr float unorm16_scale = 65535.0f;
+
+	bool IsConstantTrack(const VMDKeyframes& keys, const VMDTrack& track)
+	{
+		const auto k0 = track.First;
+		for (auto k = k0 + 1; k < track.First + track.Count; ++k)
+		{
+			float q[4], q0[4];
+			keys.GetRotation(k, q);
+			keys.GetRotation(k0, q0);
+			if (!std::equal(q, q + 4, q0) ||
+				keys.Tx[k] != keys.Tx[k0] || keys.Ty[k] != keys.Ty[k0] || keys.Tz[k] != keys.Tz[k0])
+				return false;
+		}
+		return true;
+	}
+}
+
+void VMDDenseTracks::Reset(uint32_t samplesPerFrame, float maxAngleError, float maxLocationError)
+{
+	m_samplesPerFrame = (std::max)(samplesPerFrame, 1u);
+	m_maxAngleError = maxAngleError;
+	m_maxLocationError = maxLocationError;
+	m_tracks.clear();
+	m_samples.clear();
+	m_quantizedSamples.clear();
+}
+
+uint32_t VMDDenseTracks::AddTrack(const VMDKeyframes& keys, const VMDTrack& track)
+{
+	VMDDenseTrack dense;
+	const auto end = track.First + track.Count;
+	if (track.Count > 0)
+	{
+		dense.FirstFrame = keys.FrameNO[track.First];
+		const auto lastFrame = keys.FrameNO[end - 1];
+		dense.Count = IsConstantTrack(keys, track) ? 1 : (lastFrame - dense.FirstFrame) * m_samplesPerFrame + 1;
+	}
+
+	// Sample the grid with the same bezier easing and slerp as keyframe sampling
+	VMDSampleBatch batch;
+	batch.Reset(dense.Count);
+	auto k = track.First;
+	for (uint32_t s = 0; s < dense.Count; ++s)
+	{
+		const auto frame = dense.FirstFrame + static_cast<float>(s) / m_samplesPerFrame;
+		while (k + 1 < end && keys.FrameNO[k + 1] <= frame) ++k;
+		const auto k1 = k + 1 < end ? k + 1 : k;
+
+		XMFLOAT4 weights(0.0f, 0.0f, 0.0f, 0.0f);
+		if (k1 != k)
+		{
+			auto x = (frame - keys.FrameNO[k]) / static_cast<float>(keys.FrameNO[k1] - keys.FrameNO[k]);
+			XMStoreFloat4(&weights, EvaluateVMDCurve(keys.GetCurve(k1), x));
+		}
+		float q0[4], q1[4];
+		keys.GetRotation(k, q0);
+		keys.GetRotation(k1, q1);
+		const float t0[] = { keys.Tx[k], keys.Ty[k], keys.Tz[k] };
+		const float t1[] = { keys.Tx[k1], keys.Ty[k1], keys.Tz[k1] };
+		batch.Push(q0, q1, t0, t1, &weights.x);
+	}
+	batch.Sample();
+
+	m_trackSamples.resize(dense.Count);
+	for (uint32_t s = 0; s < dense.Count; ++s)
+	{
+		batch.GetRotation(s, m_trackSamples[s].Rotation);
+		batch.GetLocation(s, m_trackSamples[s].Location);
+	}
+
+	if (!Quantize(m_trackSamples, dense))
+	{
+		dense.First = static_cast<uint32_t>(m_samples.size());
+		m_samples.insert(m_samples.end(), m_trackSamples.begin(), m_trackSamples.end());
+	}
+	m_tracks.push_back(dense);
+	return static_cast<uint32_t>(m_tracks.size() - 1);
+}
+
+bool VMDDenseTracks::Quantize(const std::vector<Sample>& samples, VMDDenseTrack& track)
+{
+	if (samples.empty()) return false;
+
+	for (size_t c = 0; c < 3; ++c)
+	{
+		auto minValue = samples[0].Location[c];
+		auto maxValue = minValue;
+		for (auto& sample : samples)
+		{
+			minValue = (std::min)(minValue, sample.Location[c]);
+			maxValue = (std::max)(maxValue, sample.Location[c]);
+		}
+		track.LocationMin[c] = minValue;
+		track.LocationScale[c] = (maxValue - minValue) / unorm16_scale;
+	}
+
+	const auto first = m_quantizedSamples.size();
+	m_quantizedSamples.resize(first + samples.size());
+	for (size_t s = 0; s < samples.size(); ++s)
+	{
+		auto& sample = samples[s];
+		auto& quantized = m_quantizedSamples[first + s];
+		for (size_t c = 0; c < 4; ++c)
+		{
+			auto value = (std::min)((std::max)(sample.Rotation[c], -1.0f), 1.0f);
+			quantized.Rotation[c] = static_cast<int16_t>(std::lround(value * snorm16_scale));
+		}
+		for (size_t c = 0; c < 3; ++c)
+		{
+			auto value = track.LocationScale[c] > 0.0f ?
+				(sample.Location[c] - track.LocationMin[c]) / track.LocationScale[c] : 0.0f;
+			quantized.Location[c] = static_cast<uint16_t>(std::lround((std::min)((std::max)(value, 0.0f), unorm16_scale)));
+		}
+	}
+
+	// Measure the error of what Push will read back
+	track.First = static_cast<uint32_t>(first);
+	track.IsQuantized = true;
+	for (uint32_t s = 0; s < samples.size(); ++s)
+	{
+		float rotation[4], location[3];
+		GetSample(track, s, rotation, location);
+		auto q0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(samples[s].Rotation));
+		auto q1 = XMQuaternionNormalize(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(rotation)));
+		auto dot = (std::min)(std::abs(XMVectorGetX(XMQuaternionDot(q0, q1))), 1.0f);
+		bool isWithinBounds = 2.0f * std::acos(dot) <= m_maxAngleError;
+		for (size_t c = 0; c < 3; ++c)
+			isWithinBounds &= std::abs(location[c] - samples[s].Location[c]) <= m_maxLocationError;
+
+		if (!isWithinBounds)
+		{
+			m_quantizedSamples.resize(first);
+			track.IsQuantized = false;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool VMDDenseTracks::Push(VMDSampleBatch& batch, uint32_t track, float frame) const
+{
+	auto& dense = m_tracks[track];
+	if (dense.Count == 0 || frame < dense.FirstFrame) return false;
+
+	// Last sample holds its pose
+	const auto position = (frame - dense.FirstFrame) * m_samplesPerFrame;
+	const auto i0 = static_cast<uint32_t>((std::min)(position, static_cast<float>(dense.Count - 1)));
+	const auto i1 = (std::min)(i0 + 1, dense.Count - 1);
+	const auto t = i1 == i0 ? 0.0f : position - i0;
+
+	float q0[4], q1[4], t0[3], t1[3];
+	GetSample(dense, i0, q0, t0);
+	GetSample(dense, i1, q1, t1);
+	const float weights[] = { t, t, t, t };
+	batch.Push(q0, q1, t0, t1, weights);
+	return true;
+}
+
+void VMDDenseTracks::GetSample(const VMDDenseTrack& track, uint32_t index, float rotation[4], float location[3]) const
+{
+	if (!track.IsQuantized)
+	{
+		auto& sample = m_samples[track.First + index];
+		std::copy(sample.Rotation, sample.Rotation + 4, rotation);
+		std::copy(sample.Location, sample.Location + 3, location);
+		return;
+	}
+
+	auto& sample = m_quantizedSamples[track.First + index];
+	for (size_t c = 0; c < 4; ++c)
+		rotation[c] = sample.Rotation[c] / snorm16_scale;
+	for (size_t c = 0; c < 3; ++c)
+		location[c] = track.LocationMin[c] + sample.Location[c] * track.LocationScale[c];
+}
+
+size_t VMDDenseTracks::TrackCount() const
+{
+	return m_tracks.size();
+}
+
+size_t VMDDenseTracks::QuantizedTrackCount() const
+{
+	return std::count_if(m_tracks.begin(), m_tracks.end(), [](const VMDDenseTrack& track) { return track.IsQuantized; });
+}
+
+size_t VMDDenseTracks::SizeInBytes() const
+{
+	return m_tracks.size() * sizeof(VMDDenseTrack) + m_samples.size() * sizeof(Sample) +
+		m_quantizedSamples.size() * sizeof(QuantizedSample);
+}
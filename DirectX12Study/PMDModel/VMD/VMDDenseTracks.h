@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+struct VMDKeyframes;
+struct VMDTrack;
+class VMDSampleBatch;
+
+// Bone track resampled to a fixed rate grid
+struct VMDDenseTrack
+{
+	// Frame of the first sample (track's first keyframe)
+	uint32_t FirstFrame = 0;
+	// Range of track's samples in float or quantized samples
+	// Constant track has a single sample
+	uint32_t First = 0;
+	uint32_t Count = 0;
+	bool IsQuantized = false;
+	// location = LocationMin + value * LocationScale
+	float LocationMin[3] = {};
+	float LocationScale[3] = {};
+};
+
+// Keyframes of a motion resampled to samplesPerFrame samples per motion frame
+// Sampling any frame is two indexed reads and a lerp, no keyframe search or bezier evaluation
+// -> cheap random access for scrubbing, blending and animation LOD
+class VMDDenseTracks
+{
+public:
+	// Track is stored in 16 bit when it stays within maxAngleError (radian) and maxLocationError
+	// Otherwise it keeps float samples
+	void Reset(uint32_t samplesPerFrame, float maxAngleError, float maxLocationError);
+	// Resample keyframes of track, return index of dense track
+	uint32_t AddTrack(const VMDKeyframes& keys, const VMDTrack& track);
+
+	// Push the two samples around frame to batch with their lerp weight
+	// Return false if frame is before track's first keyframe (bone isn't animated yet)
+	bool Push(VMDSampleBatch& batch, uint32_t track, float frame) const;
+
+	size_t TrackCount() const;
+	size_t QuantizedTrackCount() const;
+	size_t SizeInBytes() const;
+private:
+	struct Sample
+	{
+		float Rotation[4];
+		float Location[3];
+	};
+
+	struct QuantizedSample
+	{
+		int16_t Rotation[4];
+		uint16_t Location[3];
+	};
+
+	void GetSample(const VMDDenseTrack& track, uint32_t index, float rotation[4], float location[3]) const;
+	// Append samples in 16 bit if they stay within error bounds
+	bool Quantize(const std::vector<Sample>& samples, VMDDenseTrack& track);
+private:
+	uint32_t m_samplesPerFrame = 1;
+	float m_maxAngleError = 0.0f;
+	float m_maxLocationError = 0.0f;
+	std::vector<VMDDenseTrack> m_tracks;
+	std::vector<Sample> m_samples;
+	std::vector<QuantizedSample> m_quantizedSamples;
+	// Scratch of AddTrack
+	std::vector<Sample> m_trackSamples;
+};
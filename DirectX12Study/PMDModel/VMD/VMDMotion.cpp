@@ -2,6 +2,198 @@
 #include <stdio.h>
 #include <windows.h>
 #include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include "VMDSampler.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Segments are checked at half frames, playback samples between frames too
+	constexpr uint32_t reduction_samples_per_frame = 2;
+	// Longest segment that dropping keyframes may create
+	// checking a segment costs its length for every keyframe it tries to drop
+	constexpr uint32_t max_reduced_segment_frames = 300;
+
+	struct ReductionSample
+	{
+		float Rotation[4];
+		float Location[3];
+	};
+
+	bool IsSameKeyframe(const VMDKeyframes& keys, uint32_t a, uint32_t b)
+	{
+		return keys.Qx[a] == keys.Qx[b] && keys.Qy[a] == keys.Qy[b] &&
+			keys.Qz[a] == keys.Qz[b] && keys.Qw[a] == keys.Qw[b] &&
+			keys.Tx[a] == keys.Tx[b] && keys.Ty[a] == keys.Ty[b] && keys.Tz[a] == keys.Tz[b];
+	}
+
+	// Angle between two rotations
+	// Taken from the chord |q0 - q1| = 2 sin(angle / 4), acos of the dot product
+	// loses most of its precision for small angles in float
+	float GetAngle(const float q0[4], const float q1[4])
+	{
+		auto v0 = XMQuaternionNormalize(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(q0)));
+		auto v1 = XMQuaternionNormalize(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(q1)));
+		if (XMVectorGetX(XMQuaternionDot(v0, v1)) < 0.0f)
+			v1 = XMVectorNegate(v1);
+		auto chord = XMVectorGetX(XMVector4Length(XMVectorSubtract(v0, v1)));
+		return 4.0f * std::asin((std::min)(0.5f * chord, 1.0f));
+	}
+
+	// Push one sample of segment k0 -> k1 for every frame of frames
+	void PushSegment(VMDSampleBatch& batch, const VMDKeyframes& keys, uint32_t k0, uint32_t k1, const std::vector<float>& frames)
+	{
+		const float q0[] = { keys.Qx[k0], keys.Qy[k0], keys.Qz[k0], keys.Qw[k0] };
+		const float q1[] = { keys.Qx[k1], keys.Qy[k1], keys.Qz[k1], keys.Qw[k1] };
+		const float t0[] = { keys.Tx[k0], keys.Ty[k0], keys.Tz[k0] };
+		const float t1[] = { keys.Tx[k1], keys.Ty[k1], keys.Tz[k1] };
+		const auto length = static_cast<float>(keys.FrameNO[k1] - keys.FrameNO[k0]);
+		for (auto frame : frames)
+		{
+			XMFLOAT4 weights(0.0f, 0.0f, 0.0f, 0.0f);
+			if (length > 0.0f)
+				XMStoreFloat4(&weights, EvaluateVMDCurve(keys.Curves[k1], (frame - keys.FrameNO[k0]) / length));
+			batch.Push(q0, q1, t0, t1, &weights.x);
+		}
+	}
+
+	// Keyframe reduction of one track, same sampling as playback
+	class TrackReducer
+	{
+	public:
+		TrackReducer(const VMDKeyframes& keys, float maxAngleError, float maxLocationError)
+			:m_keys(keys), m_maxAngleError(maxAngleError), m_maxLocationError(maxLocationError) {}
+
+		// Append kept keyframes of track to kept
+		void Reduce(const VMDTrack& track, std::vector<uint32_t>& kept)
+		{
+			if (track.Count == 0) return;
+			const auto end = track.First + track.Count;
+			SampleTrack(track);
+
+			uint32_t anchor = track.First;
+			kept.push_back(anchor);
+			for (auto k = track.First + 1; k + 1 < end; ++k)
+			{
+				if (CanSpan(anchor, k + 1)) continue;
+				kept.push_back(k);
+				anchor = k;
+			}
+			if (track.Count > 1)
+				kept.push_back(end - 1);
+		}
+	private:
+		// Reference pose of the original keyframes at every half frame of track
+		void SampleTrack(const VMDTrack& track)
+		{
+			m_firstFrame = m_keys.FrameNO[track.First];
+			const auto end = track.First + track.Count;
+			m_reference.clear();
+			for (auto k = track.First; k + 1 < end; ++k)
+			{
+				SegmentFrames(k, k + 1);
+				if (m_frames.empty()) continue;
+				m_batch.Reset(m_frames.size());
+				PushSegment(m_batch, m_keys, k, k + 1, m_frames);
+				m_batch.Sample();
+				for (size_t s = 0; s < m_frames.size(); ++s)
+				{
+					ReductionSample sample;
+					m_batch.GetRotation(s, sample.Rotation);
+					m_batch.GetLocation(s, sample.Location);
+					m_reference.push_back(sample);
+				}
+			}
+		}
+
+		// Frames strictly inside segment k0 -> k1 on the half frame grid
+		void SegmentFrames(uint32_t k0, uint32_t k1)
+		{
+			m_frames.clear();
+			const auto first = (m_keys.FrameNO[k0] - m_firstFrame) * reduction_samples_per_frame;
+			const auto last = (m_keys.FrameNO[k1] - m_firstFrame) * reduction_samples_per_frame;
+			for (auto s = first; s < last; ++s)
+				m_frames.push_back(m_firstFrame + static_cast<float>(s) / reduction_samples_per_frame);
+		}
+
+		// Whether segment k0 -> k1 alone reproduces every keyframe between them
+		bool CanSpan(uint32_t k0, uint32_t k1)
+		{
+			bool isConstant = true;
+			for (auto k = k0 + 1; k <= k1 && isConstant; ++k)
+				isConstant = IsSameKeyframe(m_keys, k0, k);
+			if (isConstant) return true;
+			if (m_keys.FrameNO[k1] - m_keys.FrameNO[k0] > max_reduced_segment_frames) return false;
+
+			SegmentFrames(k0, k1);
+			m_batch.Reset(m_frames.size());
+			PushSegment(m_batch, m_keys, k0, k1, m_frames);
+			m_batch.Sample();
+
+			const auto offset = (m_keys.FrameNO[k0] - m_firstFrame) * reduction_samples_per_frame;
+			for (size_t s = 0; s < m_frames.size(); ++s)
+			{
+				auto& reference = m_reference[offset + s];
+				float rotation[4], location[3];
+				m_batch.GetRotation(s, rotation);
+				m_batch.GetLocation(s, location);
+				for (size_t c = 0; c < 3; ++c)
+					if (std::abs(location[c] - reference.Location[c]) > m_maxLocationError) return false;
+
+				if (GetAngle(rotation, reference.Rotation) > m_maxAngleError) return false;
+			}
+			return true;
+		}
+	private:
+		const VMDKeyframes& m_keys;
+		float m_maxAngleError;
+		float m_maxLocationError;
+		uint32_t m_firstFrame = 0;
+		std::vector<ReductionSample> m_reference;
+		std::vector<float> m_frames;
+		VMDSampleBatch m_batch;
+	};
+}
+
+void VMDKeyframes::Resize(size_t count)
+{
+	FrameNO.resize(count);
+	Qx.resize(count); Qy.resize(count); Qz.resize(count); Qw.resize(count);
+	PackedRotations.clear();
+	Tx.resize(count); Ty.resize(count); Tz.resize(count);
+	Curves.resize(count);
+	CurveIndices.clear();
+}
+
+void VMDKeyframes::GetRotation(size_t index, float out[4]) const
+{
+	if (!PackedRotations.empty())
+	{
+		UnpackVMDQuaternion(PackedRotations[index], out);
+		return;
+	}
+	out[0] = Qx[index];
+	out[1] = Qy[index];
+	out[2] = Qz[index];
+	out[3] = Qw[index];
+}
+
+const VMDCurve& VMDKeyframes::GetCurve(size_t index) const
+{
+	return CurveIndices.empty() ? Curves[index] : Curves[CurveIndices[index]];
+}
+
+size_t VMDKeyframes::SizeInBytes() const
+{
+	return FrameNO.size() * sizeof(uint32_t) +
+		(Qx.size() + Qy.size() + Qz.size() + Qw.size()) * sizeof(float) +
+		PackedRotations.size() * sizeof(VMDPackedQuaternion) +
+		(Tx.size() + Ty.size() + Tz.size()) * sizeof(float) +
+		Curves.size() * sizeof(VMDCurve) + CurveIndices.size() * sizeof(uint32_t);
+}
 
 bool VMDMotion::Load(const char* path)
 {
@@ -12,6 +204,7 @@ bool VMDMotion::Load(const char* path)
 		char cerr[256];
 		strerror_s(cerr, _countof(cerr), err);
 		OutputDebugStringA(cerr);
+		return false;
 	}
 #pragma pack(1)
 	// [Vf[^
@@ -30,54 +223,144 @@ bool VMDMotion::Load(const char* path)
 
 	std::vector<VMD_MOTION> motions(motionCount);
 
-	fread_s(motions.data(), sizeof(motions[0]) * motions.size(), sizeof(motions[0]) * motions.size(), 1, fp);
+	auto readCount = fread_s(motions.data(), sizeof(motions[0]) * motions.size(), sizeof(motions[0]), motions.size(), fp);
+	fclose(fp);
+	motions.resize(readCount);
+	if (motions.empty())
+	{
+		OutputDebugStringA("VMDMotion: file has no motion\n");
+		return false;
+	}
+
+	// Bone name isn't always null-terminated
+	std::vector<std::string> boneNames(motions.size());
+	for (size_t i = 0; i < motions.size(); ++i)
+		boneNames[i].assign(motions[i].BoneName, strnlen(motions[i].BoneName, sizeof(motions[i].BoneName)));
+
+	// Group keyframes by bone then sort them by frame number
+	std::vector<uint32_t> order(motions.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(),
+		[&](uint32_t a, uint32_t b)
+		{
+			if (boneNames[a] != boneNames[b]) return boneNames[a] < boneNames[b];
+			return motions[a].FrameNo < motions[b].FrameNo;
+		});
+
+	m_keyframes.Resize(motions.size());
+	m_tracks.clear();
+	m_maxFrame = 0;
 
-	constexpr size_t bezierNO[] = { 3, 7 ,11 ,15 };
-	constexpr size_t offset = 15;
-	for (auto& motion : motions)
+	for (uint32_t i = 0; i < order.size(); ++i)
 	{
-		DirectX::XMFLOAT2 b1, b2;
-		b1.x = (motion.Interpolation[bezierNO[0] + offset])/127.0f;
-		b1.y = (motion.Interpolation[bezierNO[1] + offset])/127.0f;
-		b2.x = (motion.Interpolation[bezierNO[2] + offset])/127.0f;
-		b2.y = (motion.Interpolation[bezierNO[3] + offset])/127.0f;
-		m_vmdDatas[motion.BoneName].emplace_back(motion.FrameNo, motion.Rotatation, motion.Location, b1, b2);
+		auto& motion = motions[order[i]];
+		m_keyframes.FrameNO[i] = motion.FrameNo;
+		m_keyframes.Qx[i] = motion.Rotatation.x;
+		m_keyframes.Qy[i] = motion.Rotatation.y;
+		m_keyframes.Qz[i] = motion.Rotatation.z;
+		m_keyframes.Qw[i] = motion.Rotatation.w;
+		m_keyframes.Tx[i] = motion.Location.x;
+		m_keyframes.Ty[i] = motion.Location.y;
+		m_keyframes.Tz[i] = motion.Location.z;
+		m_keyframes.Curves[i] = CreateVMDCurve(motion.Interpolation);
+
+		auto& track = m_tracks[boneNames[order[i]]];
+		if (track.Count == 0) track.First = i;
+		++track.Count;
+
+		m_maxFrame = (std::max)(m_maxFrame, static_cast<size_t>(motion.FrameNo));
 	}
 
-	for (auto& vmdData : m_vmdDatas)
+	return true;
+}
+
+const VMDKeyframes& VMDMotion::GetKeyframes() const
+{
+	return m_keyframes;
+}
+
+const VMDTracks_t& VMDMotion::GetTracks() const
+{
+	return m_tracks;
+}
+
+size_t VMDMotion::GetMaxFrame() const
+{
+	return m_maxFrame;
+}
+
+bool VMDMotion::Compress(float maxAngleError, float maxLocationError)
+{
+	if (!m_keyframes.PackedRotations.empty()) return false;
+
+	auto& stats = m_compressionStats;
+
+	stats.KeyframeCount = m_keyframes.Size();
+	stats.SizeInBytes = m_keyframes.SizeInBytes();
+
+	// Indices of kept keyframes, track by track
+	std::vector<uint32_t> kept;
+	kept.reserve(m_keyframes.Size());
+	TrackReducer reducer(m_keyframes, maxAngleError, maxLocationError);
+	for (auto& track : m_tracks)
 	{
-		auto& keyframe = vmdData.second;
-		std::sort(keyframe.begin(), keyframe.end(),
-			[](const VMDData& k1, const VMDData& k2)
-			{
-				return k1.frameNO < k2.frameNO;
-			});
+		auto first = static_cast<uint32_t>(kept.size());
+		reducer.Reduce(track.second, kept);
+		track.second.First = first;
+		track.second.Count = static_cast<uint32_t>(kept.size()) - first;
 	}
 
-	std::vector<size_t> lastFrameNOList(m_vmdDatas.size());
-	int i = 0;
-	for (auto& vmdData : m_vmdDatas)
+	// Dense keyframes mostly share a few curves (often the linear one)
+	std::unordered_map<std::string, uint32_t> curveIndices;
+	VMDKeyframes compressed;
+	compressed.FrameNO.resize(kept.size());
+	compressed.PackedRotations.resize(kept.size());
+	compressed.Tx.resize(kept.size());
+	compressed.Ty.resize(kept.size());
+	compressed.Tz.resize(kept.size());
+	compressed.CurveIndices.resize(kept.size());
+	for (size_t i = 0; i < kept.size(); ++i)
 	{
-		lastFrameNOList[i] = vmdData.second.rbegin()->frameNO;
-		i++;
+		auto k = kept[i];
+		compressed.FrameNO[i] = m_keyframes.FrameNO[k];
+		const float rotation[] = { m_keyframes.Qx[k], m_keyframes.Qy[k], m_keyframes.Qz[k], m_keyframes.Qw[k] };
+		compressed.PackedRotations[i] = PackVMDQuaternion(rotation);
+		compressed.Tx[i] = m_keyframes.Tx[k];
+		compressed.Ty[i] = m_keyframes.Ty[k];
+		compressed.Tz[i] = m_keyframes.Tz[k];
+
+		auto& curve = m_keyframes.Curves[k];
+		std::string curveKey(reinterpret_cast<const char*>(&curve), sizeof(curve));
+		auto result = curveIndices.emplace(curveKey, static_cast<uint32_t>(compressed.Curves.size()));
+		if (result.second)
+			compressed.Curves.push_back(curve);
+		compressed.CurveIndices[i] = result.first->second;
 	}
+	compressed.Curves.shrink_to_fit();
+	m_keyframes = std::move(compressed);
 
-	std::sort(lastFrameNOList.begin(), lastFrameNOList.end(), [](const size_t& f1, const size_t& f2)
-		{return f1 < f2; });
+	stats.ReducedKeyframeCount = m_keyframes.Size();
+	stats.CompressedSizeInBytes = m_keyframes.SizeInBytes();
+	return true;
+}
 
-	m_maxFrame = *lastFrameNOList.rbegin();
-	
-	fclose(fp);
+bool VMDMotion::Resample(uint32_t samplesPerFrame, float maxAngleError, float maxLocationError)
+{
+	if (samplesPerFrame == 0) return false;
 
+	m_denseTracks.Reset(samplesPerFrame, maxAngleError, maxLocationError);
+	for (auto& track : m_tracks)
+		track.second.DenseTrack = m_denseTracks.AddTrack(m_keyframes, track.second);
+	m_isResampled = true;
 	return true;
 }
 
-const VMDData_t& VMDMotion::GetVMDMotionData() const
+const VMDCompressionStats& VMDMotion::GetCompressionStats() const
 {
-	return m_vmdDatas;
+	return m_compressionStats;
 }
 
-size_t VMDMotion::GetMaxFrame() const
+const VMDDenseTracks* VMDMotion::GetDenseTracks() const
 {
-	return m_maxFrame;
+	return m_isResampled ? &m_denseTracks : nullptr;
 }
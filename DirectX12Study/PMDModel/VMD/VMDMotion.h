@@ -3,36 +3,86 @@
 #include <string>
 #include <DirectXMath.h>
 #include <vector>
+#include <cstdint>
+#include "VMDCurve.h"
+#include "VMDDenseTracks.h"
+#include "VMDPackedQuaternion.h"
 
 // Load VMD file to VMDMotion data
 // Use XMMatrixRotationQuadternion to create Rotation Matrix
-// Use RecursiveCalculate 
+// Use PMDSkeleton to combine bone transforms
 
-struct VMDData
+// Keyframes of every bone in SoA layout
+// Keyframes of one bone are contiguous and sorted by frame number
+struct VMDKeyframes
 {
-	DirectX::XMFLOAT4 quaternion;
-	DirectX::XMFLOAT3 location;
-	size_t frameNO;
-	DirectX::XMFLOAT2 b1,b2;		// bezier data
-	explicit VMDData(const size_t& frameNo,
-		const DirectX::XMFLOAT4& quaternion,
-		const DirectX::XMFLOAT3& location,
-		const DirectX::XMFLOAT2& b1,
-		const DirectX::XMFLOAT2& b2):
-		quaternion(quaternion), frameNO(frameNo), location(location), b1(b1),b2(b2) {}
+	std::vector<uint32_t> FrameNO;
+	// Rotation quaternion, emptied by VMDMotion::Compress
+	std::vector<float> Qx, Qy, Qz, Qw;
+	// Rotation quaternion after VMDMotion::Compress
+	std::vector<VMDPackedQuaternion> PackedRotations;
+	// Location
+	std::vector<float> Tx, Ty, Tz;
+	// Interpolation curves of the segment ending at this keyframe
+	// After VMDMotion::Compress it only holds distinct curves and CurveIndices picks one per keyframe
+	std::vector<VMDCurve> Curves;
+	std::vector<uint32_t> CurveIndices;
+
+	size_t Size() const { return FrameNO.size(); }
+	void Resize(size_t count);
+	void GetRotation(size_t index, float out[4]) const;
+	const VMDCurve& GetCurve(size_t index) const;
+	size_t SizeInBytes() const;
+};
+
+// Range of one bone's keyframes in VMDKeyframes
+struct VMDTrack
+{
+	uint32_t First = 0;
+	uint32_t Count = 0;
+	// Index of track in dense tracks, valid after Resample
+	uint32_t DenseTrack = 0;
 };
 
-using VMDData_t = std::unordered_map <std::string,std::vector<VMDData>>;
+using VMDTracks_t = std::unordered_map<std::string, VMDTrack>;
+
+struct VMDCompressionStats
+{
+	size_t KeyframeCount = 0;
+	size_t ReducedKeyframeCount = 0;
+	size_t SizeInBytes = 0;
+	size_t CompressedSizeInBytes = 0;
+};
 
 class VMDMotion
 {
 public:
 	bool Load(const char* path);
-	const VMDData_t& GetVMDMotionData() const;
+	const VMDKeyframes& GetKeyframes() const;
+	// Bone name -> range of its keyframes
+	const VMDTracks_t& GetTracks() const;
 	size_t GetMaxFrame() const;
+
+	// Drop keyframes that the bezier segment of their neighbours reproduces
+	// within maxAngleError (radian) and maxLocationError, then pack rotations in 48 bits
+	// and share identical interpolation curves between keyframes
+	// Packing adds up to 1.5e-4 radian on top of maxAngleError
+	// Return false if motion is already compressed
+	bool Compress(float maxAngleError, float maxLocationError);
+	// Keyframes and footprint before and after Compress, all 0 until then
+	const VMDCompressionStats& GetCompressionStats() const;
+	// Resample every track to a dense grid of samplesPerFrame samples per frame
+	// Tracks are stored in 16 bit where they stay within the error bounds
+	bool Resample(uint32_t samplesPerFrame, float maxAngleError, float maxLocationError);
+	// nullptr until Resample
+	const VMDDenseTracks* GetDenseTracks() const;
 private:
-	VMDData_t m_vmdDatas;
+	VMDKeyframes m_keyframes;
+	VMDTracks_t m_tracks;
 	size_t m_maxFrame = 0;
+	VMDDenseTracks m_denseTracks;
+	bool m_isResampled = false;
+	VMDCompressionStats m_compressionStats;
 
 };
 
@@ -0,0 +1,58 @@
+#include "VMDPackedQuaternion.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr uint32_t component_bits = 15;
+	constexpr uint32_t component_mask = (1u << component_bits) - 1;
+	constexpr float component_range = 0.70710678f;
+	constexpr float component_scale = component_mask / (2.0f * component_range);
+}
+
+VMDPackedQuaternion PackVMDQuaternion(const float q[4])
+{
+	auto length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	auto invLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+	uint32_t largest = 3;
+	for (uint32_t c = 0; c < 3; ++c)
+		if (std::abs(q[c]) > std::abs(q[largest])) largest = c;
+	// Zero quaternion falls back to identity
+	if (invLength == 0.0f) largest = 3;
+	const auto sign = q[largest] < 0.0f ? -invLength : invLength;
+
+	uint64_t bits = largest;
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		if (c == largest) continue;
+		auto value = (std::min)((std::max)(q[c] * sign, -component_range), component_range);
+		auto quantized = static_cast<uint32_t>(std::lround((value + component_range) * component_scale));
+		bits = (bits << component_bits) | quantized;
+	}
+
+	VMDPackedQuaternion packed;
+	packed.Data[0] = static_cast<uint16_t>(bits);
+	packed.Data[1] = static_cast<uint16_t>(bits >> 16);
+	packed.Data[2] = static_cast<uint16_t>(bits >> 32);
+	return packed;
+}
+
+void UnpackVMDQuaternion(const VMDPackedQuaternion& packed, float q[4])
+{
+	uint64_t bits = packed.Data[0] | (static_cast<uint64_t>(packed.Data[1]) << 16) |
+		(static_cast<uint64_t>(packed.Data[2]) << 32);
+	const auto largest = static_cast<uint32_t>(bits >> (3 * component_bits)) & 3;
+
+	// Components were packed from the first one, so they come out from the last one
+	float sumOfSquares = 0.0f;
+	for (int c = 3; c >= 0; --c)
+	{
+		if (static_cast<uint32_t>(c) == largest) continue;
+		q[c] = (bits & component_mask) / component_scale - component_range;
+		sumOfSquares += q[c] * q[c];
+		bits >>= component_bits;
+	}
+	q[largest] = std::sqrt((std::max)(1.0f - sumOfSquares, 0.0f));
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Unit quaternion in 48 bits, "smallest three" encoding
+// 2 bits hold the index of the largest component and the other three components
+// are stored in 15 bits each, they always lie in [-1/sqrt(2), 1/sqrt(2)]
+// Largest component is rebuilt from unit length, q and -q are the same rotation
+// so it is always made positive
+// Error per component is below 2.2e-5, angle error stays below 1.5e-4 radian
+struct VMDPackedQuaternion
+{
+	uint16_t Data[3];
+};
+
+VMDPackedQuaternion PackVMDQuaternion(const float q[4]);
+void UnpackVMDQuaternion(const VMDPackedQuaternion& packed, float q[4]);
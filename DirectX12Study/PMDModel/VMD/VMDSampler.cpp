@@ -0,0 +1,146 @@
+#include "VMDSampler.h"
+
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr size_t lane_count = 4;
+
+	inline XMVECTOR Load4(const std::vector<float>& v, size_t index)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&v[index]));
+	}
+
+	inline void Store4(std::vector<float>& v, size_t index, FXMVECTOR value)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&v[index]), value);
+	}
+}
+
+void VMDSampleBatch::Reset(size_t capacity)
+{
+	m_count = 0;
+	Reserve(capacity);
+}
+
+void VMDSampleBatch::Reserve(size_t capacity)
+{
+	auto padded = (capacity + lane_count - 1) / lane_count * lane_count;
+	if (padded <= m_capacity) return;
+
+	m_capacity = padded;
+	for (size_t c = 0; c < 4; ++c)
+	{
+		m_fromRotation[c].resize(padded);
+		m_toRotation[c].resize(padded);
+		m_rotation[c].resize(padded);
+		m_weight[c].resize(padded);
+	}
+	for (size_t c = 0; c < 3; ++c)
+	{
+		m_fromLocation[c].resize(padded);
+		m_toLocation[c].resize(padded);
+		m_location[c].resize(padded);
+	}
+}
+
+void VMDSampleBatch::Push(const float fromRotation[4], const float toRotation[4],
+	const float fromLocation[3], const float toLocation[3], const float weights[4])
+{
+	if (m_count == m_capacity) Reserve(m_capacity * 2 + lane_count);
+
+	for (size_t c = 0; c < 4; ++c)
+	{
+		m_fromRotation[c][m_count] = fromRotation[c];
+		m_toRotation[c][m_count] = toRotation[c];
+		m_weight[c][m_count] = weights[c];
+	}
+	for (size_t c = 0; c < 3; ++c)
+	{
+		m_fromLocation[c][m_count] = fromLocation[c];
+		m_toLocation[c][m_count] = toLocation[c];
+	}
+	++m_count;
+}
+
+size_t VMDSampleBatch::Count() const
+{
+	return m_count;
+}
+
+void VMDSampleBatch::GetRotation(size_t index, float out[4]) const
+{
+	for (size_t c = 0; c < 4; ++c)
+		out[c] = m_rotation[c][index];
+}
+
+void VMDSampleBatch::GetLocation(size_t index, float out[3]) const
+{
+	for (size_t c = 0; c < 3; ++c)
+		out[c] = m_location[c][index];
+}
+
+void VMDSampleBatch::Sample()
+{
+	// Fill unused lanes of the last group with identity so they don't produce NaN
+	auto padded = (m_count + lane_count - 1) / lane_count * lane_count;
+	for (size_t i = m_count; i < padded; ++i)
+	{
+		for (size_t c = 0; c < 4; ++c)
+		{
+			m_fromRotation[c][i] = m_toRotation[c][i] = c == 3 ? 1.0f : 0.0f;
+			m_weight[c][i] = 0.0f;
+		}
+		for (size_t c = 0; c < 3; ++c)
+			m_fromLocation[c][i] = m_toLocation[c][i] = 0.0f;
+	}
+
+	// Each XMVECTOR lane holds one bone, the same steps as XMQuaternionSlerp
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR threshold = XMVectorReplicate(1.0f - 0.00001f);
+	for (size_t i = 0; i < padded; i += lane_count)
+	{
+		XMVECTOR q0[4], q1[4];
+		for (size_t c = 0; c < 4; ++c)
+		{
+			q0[c] = Load4(m_fromRotation[c], i);
+			q1[c] = Load4(m_toRotation[c], i);
+		}
+		auto t = Load4(m_weight[3], i);
+
+		auto cosOmega = XMVectorMultiply(q0[0], q1[0]);
+		cosOmega = XMVectorMultiplyAdd(q0[1], q1[1], cosOmega);
+		cosOmega = XMVectorMultiplyAdd(q0[2], q1[2], cosOmega);
+		cosOmega = XMVectorMultiplyAdd(q0[3], q1[3], cosOmega);
+
+		// Take the shorter arc
+		auto sign = XMVectorSelect(one, XMVectorNegate(one), XMVectorLess(cosOmega, zero));
+		cosOmega = XMVectorAbs(cosOmega);
+
+		auto sinOmega = XMVectorSqrt(XMVectorNegativeMultiplySubtract(cosOmega, cosOmega, one));
+		auto omega = XMVectorATan2(sinOmega, cosOmega);
+		auto invSinOmega = XMVectorReciprocal(sinOmega);
+
+		auto s0 = XMVectorMultiply(XMVectorSin(XMVectorMultiply(XMVectorSubtract(one, t), omega)), invSinOmega);
+		auto s1 = XMVectorMultiply(XMVectorSin(XMVectorMultiply(t, omega)), invSinOmega);
+
+		// Nearly the same rotation -> linear interpolation
+		auto nearlySame = XMVectorGreater(cosOmega, threshold);
+		s0 = XMVectorSelect(s0, XMVectorSubtract(one, t), nearlySame);
+		s1 = XMVectorSelect(s1, t, nearlySame);
+		s1 = XMVectorMultiply(s1, sign);
+
+		for (size_t c = 0; c < 4; ++c)
+			Store4(m_rotation[c], i, XMVectorMultiplyAdd(q1[c], s1, XMVectorMultiply(q0[c], s0)));
+
+		for (size_t c = 0; c < 3; ++c)
+		{
+			auto from = Load4(m_fromLocation[c], i);
+			auto to = Load4(m_toLocation[c], i);
+			Store4(m_location[c], i, XMVectorLerpV(from, to, Load4(m_weight[c], i)));
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Keyframe pairs of many bones gathered in SoA layout
+// so that SampleVMDBatch blends 4 bones per SIMD instruction
+class VMDSampleBatch
+{
+public:
+	// Make room for capacity bones and empty the batch
+	void Reset(size_t capacity);
+	// Add one bone, rotations are quaternion xyzw and locations are xyz
+	// weights are interpolation weights of channels X, Y, Z and rotation
+	void Push(const float fromRotation[4], const float toRotation[4],
+		const float fromLocation[3], const float toLocation[3], const float weights[4]);
+	size_t Count() const;
+
+	// Sampled pose of bone at index
+	void GetRotation(size_t index, float out[4]) const;
+	void GetLocation(size_t index, float out[3]) const;
+
+	// Slerp rotation and lerp location of every bone in batch
+	void Sample();
+private:
+	void Reserve(size_t capacity);
+private:
+	size_t m_count = 0;
+	// Arrays are padded to multiple of 4 -> no scalar tail loop
+	size_t m_capacity = 0;
+	std::vector<float> m_fromRotation[4], m_toRotation[4];
+	std::vector<float> m_fromLocation[3], m_toLocation[3];
+	// Interpolation weight of each bone and channel (already eased by bezier curve)
+	std::vector<float> m_weight[4];
+	std::vector<float> m_rotation[4], m_location[3];
+};
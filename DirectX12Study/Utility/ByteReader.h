@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Non-owning view of an array that lives in someone else's memory
+// (a mapped file, a vector, ...)
+template<typename T>
+struct ArrayView
+{
+	const T* Data = nullptr;
+	size_t Count = 0;
+
+	const T* begin() const { return Data; }
+	const T* end() const { return Data + Count; }
+	size_t size() const { return Count; }
+	bool empty() const { return Count == 0; }
+	const T& operator[](size_t index) const { return Data[index]; }
+};
+
+// Bounds-checked cursor over a block of bytes
+// Every read fails (returns false / nullptr) instead of walking past the end
+// and once a read fails the reader stays failed
+class ByteReader
+{
+public:
+	ByteReader() = default;
+	ByteReader(const uint8_t* data, size_t size) :m_data(data), m_size(size) {}
+
+	// Copy sizeof(T) bytes to out
+	template<typename T>
+	bool Read(T& out)
+	{
+		auto p = Take(sizeof(T));
+		if (p == nullptr) return false;
+		std::memcpy(&out, p, sizeof(T));
+		return true;
+	}
+
+	// Pointer to count elements of T straight in the byte block
+	// T should be a packed (#pragma pack(1)) struct or a type read with memcpy
+	// because the position isn't guaranteed to be aligned
+	template<typename T>
+	const T* View(size_t count)
+	{
+		if (count > Remaining() / sizeof(T))
+		{
+			m_failed = true;
+			return nullptr;
+		}
+		return reinterpret_cast<const T*>(Take(count * sizeof(T)));
+	}
+
+	template<typename T>
+	bool View(size_t count, ArrayView<T>& out)
+	{
+		auto p = View<T>(count);
+		if (p == nullptr && count != 0) return false;
+		out.Data = p;
+		out.Count = count;
+		return true;
+	}
+
+	// Fixed size text field that may not be null-terminated
+	bool ReadFixedString(size_t size, std::string& out)
+	{
+		auto p = reinterpret_cast<const char*>(Take(size));
+		if (p == nullptr) return false;
+		out.assign(p, strnlen(p, size));
+		return true;
+	}
+
+	bool Skip(size_t bytes)
+	{
+		return Take(bytes) != nullptr;
+	}
+
+	size_t Offset() const { return m_offset; }
+	size_t Remaining() const { return m_size - m_offset; }
+	bool Failed() const { return m_failed; }
+private:
+	const uint8_t* Take(size_t bytes)
+	{
+		if (m_failed || bytes > Remaining())
+		{
+			m_failed = true;
+			return nullptr;
+		}
+		auto p = m_data + m_offset;
+		m_offset += bytes;
+		return p;
+	}
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_offset = 0;
+	bool m_failed = false;
+};
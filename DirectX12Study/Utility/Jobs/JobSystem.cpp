@@ -0,0 +1,131 @@
+#include "JobSystem.h"
+
+#include <chrono>
+
+JobSystem::JobSystem(size_t workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::thread::hardware_concurrency();
+	if (workerCount == 0)
+		workerCount = 1;
+
+	m_queues.reserve(workerCount);
+	for (size_t i = 0; i < workerCount; ++i)
+		m_queues.push_back(std::make_unique<Queue_t>());
+
+	// Ids are written before any worker starts -> read without lock afterward
+	m_threadIds.resize(workerCount);
+	m_threadIds[0] = std::this_thread::get_id();
+	m_workers.reserve(workerCount - 1);
+	for (size_t i = 1; i < workerCount; ++i)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+		m_threadIds[i] = m_workers.back().get_id();
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_isStopping = true;
+	}
+	m_sleepCondition.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void JobSystem::Schedule(Job* jobs, size_t count, JobCounter& counter)
+{
+	counter.m_count.fetch_add(static_cast<uint32_t>(count), std::memory_order_relaxed);
+
+	auto workerIndex = GetWorkerIndex();
+	size_t queuedCount = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		jobs[i].pCounter = &counter;
+		if (workerIndex < m_queues.size() && m_queues[workerIndex]->Push(&jobs[i]))
+		{
+			++queuedCount;
+			continue;
+		}
+		// Not a worker or deque is full
+		Execute(&jobs[i]);
+	}
+
+	if (queuedCount == 0) return;
+	m_queuedJobCount.fetch_add(static_cast<uint32_t>(queuedCount), std::memory_order_release);
+	{
+		// Lock so a worker can't miss the wake up between checking and sleeping
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_sleepCondition.notify_all();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	auto workerIndex = GetWorkerIndex();
+	while (!counter.IsDone())
+	{
+		if (workerIndex < m_queues.size() && TryRunJob(workerIndex)) continue;
+		// Remaining jobs are running on other workers
+		std::this_thread::yield();
+	}
+}
+
+size_t JobSystem::WorkerCount() const
+{
+	return m_queues.size();
+}
+
+void JobSystem::WorkerLoop(size_t workerIndex)
+{
+	while (!m_isStopping.load(std::memory_order_acquire))
+	{
+		if (TryRunJob(workerIndex)) continue;
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		// Timeout covers jobs that were counted but not stolen yet
+		m_sleepCondition.wait_for(lock, std::chrono::milliseconds(1), [this]()
+			{
+				return m_isStopping.load(std::memory_order_relaxed) ||
+					m_queuedJobCount.load(std::memory_order_relaxed) > 0;
+			});
+	}
+}
+
+bool JobSystem::TryRunJob(size_t workerIndex)
+{
+	Job* pJob = nullptr;
+	if (!m_queues[workerIndex]->Pop(pJob))
+	{
+		// Start from the next worker so thieves spread over victims
+		const auto queueCount = m_queues.size();
+		bool isStolen = false;
+		for (size_t i = 1; i < queueCount && !isStolen; ++i)
+			isStolen = m_queues[(workerIndex + i) % queueCount]->Steal(pJob);
+		if (!isStolen) return false;
+	}
+
+	m_queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+	Execute(pJob);
+	return true;
+}
+
+void JobSystem::Execute(Job* pJob)
+{
+	auto pCounter = pJob->pCounter;
+	pJob->Function();
+	// Job may be destroyed by its owner as soon as the counter reaches zero
+	pCounter->m_count.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+size_t JobSystem::GetWorkerIndex() const
+{
+	auto id = std::this_thread::get_id();
+	for (size_t i = 0; i < m_threadIds.size(); ++i)
+	{
+		if (m_threadIds[i] == id) return i;
+	}
+	return m_threadIds.size();
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingQueue.h"
+
+// Number of unfinished jobs of a group
+class JobCounter
+{
+public:
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+private:
+	friend class JobSystem;
+	std::atomic<uint32_t> m_count{ 0 };
+};
+
+struct Job
+{
+	std::function<void()> Function;
+	JobCounter* pCounter = nullptr;
+};
+
+// Work-stealing scheduler for short CPU jobs (per-frame animation, skinning, ...)
+// Every worker owns a deque, idle workers steal from the others
+// The thread that creates JobSystem is worker 0 and helps executing jobs while it waits
+class JobSystem
+{
+public:
+	// workerCount includes the creating thread, 0 -> one worker per hardware thread
+	explicit JobSystem(size_t workerCount = 0);
+	~JobSystem();
+
+	// Jobs must stay alive until Wait(counter) returns
+	// From a thread that isn't a worker, jobs run immediately
+	void Schedule(Job* jobs, size_t count, JobCounter& counter);
+	// Execute jobs (any group) until counter's jobs are done
+	void Wait(JobCounter& counter);
+
+	// Call function(begin, end) on chunks of [0, count) in parallel and wait for all of them
+	// Each chunk has at least grainSize elements
+	template<typename Func>
+	void ParallelFor(size_t count, size_t grainSize, Func&& function);
+
+	size_t WorkerCount() const;
+private:
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator = (const JobSystem&) = delete;
+
+	void WorkerLoop(size_t workerIndex);
+	// Run one job from own deque or stolen from others, false if there was nothing to do
+	bool TryRunJob(size_t workerIndex);
+	void Execute(Job* pJob);
+	// Index of calling thread, WorkerCount() if it isn't a worker of this system
+	size_t GetWorkerIndex() const;
+private:
+	static constexpr size_t queue_capacity = 4096;
+	using Queue_t = WorkStealingQueue<Job*, queue_capacity>;
+
+	std::vector<std::unique_ptr<Queue_t>> m_queues;
+	std::vector<std::thread> m_workers;
+	std::vector<std::thread::id> m_threadIds;
+
+	// Sleeping workers are woken when jobs are scheduled
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCondition;
+	std::atomic<uint32_t> m_queuedJobCount{ 0 };
+	std::atomic<bool> m_isStopping{ false };
+};
+
+template<typename Func>
+inline void JobSystem::ParallelFor(size_t count, size_t grainSize, Func&& function)
+{
+	if (count == 0) return;
+	if (grainSize == 0) grainSize = 1;
+
+	// A few chunks per worker so stealing can even out uneven work
+	const size_t targetChunkCount = WorkerCount() * 4;
+	size_t chunkSize = (count + targetChunkCount - 1) / targetChunkCount;
+	if (chunkSize < grainSize) chunkSize = grainSize;
+	const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	if (chunkCount == 1)
+	{
+		function(static_cast<size_t>(0), count);
+		return;
+	}
+
+	std::vector<Job> jobs(chunkCount);
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		auto begin = i * chunkSize;
+		auto end = (std::min)(begin + chunkSize, count);
+		jobs[i].Function = [&function, begin, end]() { function(begin, end); };
+	}
+
+	JobCounter counter;
+	Schedule(jobs.data(), jobs.size(), counter);
+	Wait(counter);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Chase-Lev work-stealing deque with fixed capacity
+// Owner thread pushes and pops at the bottom without waiting (only pop of the last item needs one CAS)
+// Other threads steal from the top
+// Capacity must be a power of two
+template<typename T, size_t Capacity>
+class WorkStealingQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+public:
+	WorkStealingQueue() = default;
+
+	// Owner only, return false if queue is full
+	bool Push(T item)
+	{
+		auto bottom = m_bottom.load(std::memory_order_relaxed);
+		auto top = m_top.load(std::memory_order_acquire);
+		if (bottom - top >= static_cast<int64_t>(Capacity)) return false;
+
+		m_items[bottom & mask].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only, take the most recently pushed item
+	bool Pop(T& item)
+	{
+		auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			// Empty
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = m_items[bottom & mask].load(std::memory_order_relaxed);
+		if (top != bottom) return true;
+
+		// Last item -> race with thieves
+		bool isTaken = m_top.compare_exchange_strong(top, top + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return isTaken;
+	}
+
+	// Any thread, take the oldest item
+	bool Steal(T& item)
+	{
+		auto top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom) return false;
+
+		item = m_items[top & mask].load(std::memory_order_relaxed);
+		return m_top.compare_exchange_strong(top, top + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	bool Empty() const
+	{
+		return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+	}
+private:
+	WorkStealingQueue(const WorkStealingQueue&) = delete;
+	WorkStealingQueue& operator = (const WorkStealingQueue&) = delete;
+private:
+	static constexpr int64_t mask = static_cast<int64_t>(Capacity) - 1;
+
+	// Top and bottom on separate cache lines, thieves hammer top
+	alignas(64) std::atomic<int64_t> m_top{ 0 };
+	alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+	std::atomic<T> m_items[Capacity];
+};
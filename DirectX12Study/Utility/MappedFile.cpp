@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#include <utility>
+#include <Windows.h>
+
+MappedFile::MappedFile(const char* path)
+{
+	Open(path);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	:m_file(other.m_file),
+	m_mapping(other.m_mapping),
+	m_data(other.m_data),
+	m_size(other.m_size)
+{
+	other.m_file = nullptr;
+	other.m_mapping = nullptr;
+	other.m_data = nullptr;
+	other.m_size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_file, other.m_file);
+		std::swap(m_mapping, other.m_mapping);
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		OutputDebugStringA("MappedFile: can't open file\n");
+		return false;
+	}
+	m_file = file;
+
+	LARGE_INTEGER fileSize = {};
+	// Mapping an empty file fails, treat it as an invalid file
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != nullptr)
+		CloseHandle(m_file);
+
+	m_file = nullptr;
+	m_mapping = nullptr;
+	m_data = nullptr;
+	m_size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_data != nullptr;
+}
+
+const uint8_t* MappedFile::Data() const
+{
+	return m_data;
+}
+
+size_t MappedFile::Size() const
+{
+	return m_size;
+}
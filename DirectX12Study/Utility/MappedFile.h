@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Read-only view of a whole file mapped into memory
+// Pointers taken from Data() stay valid until the file is closed
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* path);
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator = (MappedFile&& other) noexcept;
+	~MappedFile();
+
+	// Return false if file can't be opened or it is empty
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const;
+	const uint8_t* Data() const;
+	size_t Size() const;
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+private:
+	// Windows handles, kept as void* so this header doesn't need <Windows.h>
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
+
@@ -0,0 +1,41 @@
+#include "ScratchArena.h"
+
+ScratchArena::ScratchArena(size_t bytes)
+{
+	Reserve(bytes);
+}
+
+void ScratchArena::Reserve(size_t bytes)
+{
+	m_offset = 0;
+	if (bytes <= m_capacity) return;
+	m_memory = std::make_unique<uint8_t[]>(bytes);
+	m_capacity = bytes;
+}
+
+void* ScratchArena::Allocate(size_t bytes, size_t alignment)
+{
+	// Align the address itself, new[] only guarantees default alignment
+	auto base = reinterpret_cast<uintptr_t>(m_memory.get());
+	auto aligned = (base + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	auto offset = static_cast<size_t>(aligned - base);
+	if (m_memory == nullptr || offset > m_capacity || bytes > m_capacity - offset) return nullptr;
+
+	m_offset = offset + bytes;
+	return m_memory.get() + offset;
+}
+
+void ScratchArena::Reset()
+{
+	m_offset = 0;
+}
+
+size_t ScratchArena::Capacity() const
+{
+	return m_capacity;
+}
+
+size_t ScratchArena::Used() const
+{
+	return m_offset;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Linear allocator for temporaries that live for one update
+// Memory is reserved up front, Allocate only moves an offset
+// and Reset releases everything at once -> no heap allocation per frame
+class ScratchArena
+{
+public:
+	ScratchArena() = default;
+	explicit ScratchArena(size_t bytes);
+
+	// Grow capacity to at least bytes
+	// Memory allocated before is invalidated, don't call it in the middle of a frame
+	void Reserve(size_t bytes);
+	// Return nullptr when arena doesn't have enough room left
+	void* Allocate(size_t bytes, size_t alignment = 16);
+	template<typename T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+	}
+	void Reset();
+
+	size_t Capacity() const;
+	size_t Used() const;
+private:
+	std::unique_ptr<uint8_t[]> m_memory;
+	size_t m_capacity = 0;
+	size_t m_offset = 0;
+};
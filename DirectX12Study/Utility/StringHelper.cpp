@@ -42,7 +42,10 @@ std::vector<std::string> StringHelper::SplitFilePath(const std::string& path, co
 	std::vector <std::string> ret;
 	auto idx = path.rfind(splitter);
 	if (idx == std::string::npos)
+	{
 		ret.push_back(path);
+		return ret;
+	}
 	ret.push_back(path.substr(0, idx));
 	++idx;
 	ret.push_back(path.substr(idx, path.length() - idx));
@@ -0,0 +1,55 @@
+#include "ThreadPool.h"
+
+#include <Windows.h>
+#include <objbase.h>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	m_workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i)
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+size_t ThreadPool::ThreadCount() const
+{
+	return m_workers.size();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	// WIC (texture decoding) needs COM on every thread that uses it
+	auto result = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+			// Drain queue before stopping
+			if (m_jobs.empty()) break;
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+		}
+		job();
+	}
+
+	if (SUCCEEDED(result))
+		CoUninitialize();
+}
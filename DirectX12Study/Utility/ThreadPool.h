@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// Fixed group of worker threads for blocking jobs (file loading, texture decoding)
+// Jobs run in submitted order, results come back through std::future
+class ThreadPool
+{
+public:
+	// threadCount = 0 -> one worker per hardware thread
+	explicit ThreadPool(size_t threadCount = 0);
+	// Finish all submitted jobs then join workers
+	~ThreadPool();
+
+	template<typename Func>
+	auto Submit(Func&& func)->std::future<decltype(func())>;
+
+	size_t ThreadCount() const;
+private:
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+
+	void WorkerLoop();
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_isStopping = false;
+};
+
+template<typename Func>
+inline auto ThreadPool::Submit(Func&& func)->std::future<decltype(func())>
+{
+	using Result_t = decltype(func());
+	// std::function needs a copyable callable -> share the packaged task
+	auto task = std::make_shared<std::packaged_task<Result_t()>>(std::forward<Func>(func));
+	auto result = task->get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.emplace([task]() { (*task)(); });
+	}
+	m_condition.notify_one();
+	return result;
+}
+
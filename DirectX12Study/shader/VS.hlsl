@@ -1,13 +1,25 @@
 #include "common.hlsli"
 #include "modelcommon.hlsli"
 
+#if SKIN_4_BONES
+#define SKIN_BONE_COUNT 4
+#else
+#define SKIN_BONE_COUNT 2
+#endif
+
 struct VsInput
 {
 	float4 pos : POSITION;
 	float2 uv : TEXCOORD;
 	float4 normal : NORMAL;
+#if SKIN_4_BONES
+	// Second vertex stream (PMDSkinWeights), weights add up to 1
+	min16uint4 boneno : BONENO;
+	float4 weight : WEIGHT;
+#else
 	min16uint2 boneno : BONENO;
 	float weight : WEIGHT;
+#endif
 	uint instanceID : SV_InstanceID;
 };
 
@@ -15,7 +27,15 @@ cbuffer objectConstant : register(b1)
 {
 	matrix g_world; // transform to world space matrix
 	matrix g_texTransform;
+#if BONE_PALETTE_3X4
+	// Affine bone transforms, 3 registers per bone
+	row_major float3x4 g_bones[512];
+#elif BONE_PALETTE_DQ
+	// Unit dual quaternions, real part then dual part, 2 registers per bone
+	float4 g_bones[512 * 2];
+#else
 	matrix g_bones[512];
+#endif
 }
 
 /// Vertex shader
@@ -25,12 +45,56 @@ cbuffer objectConstant : register(b1)
 VsOutput VS( VsInput input )
 {
 	VsOutput ret;
+
+#if SKIN_4_BONES
+	uint4 boneno = input.boneno;
+	float4 weight = input.weight;
+#else
+	// weight is boneno.x's, the rest is boneno.y's
+	uint4 boneno = input.boneno.xyxx;
+	float4 weight = float4(input.weight, 1.0f - input.weight, 0.0f, 0.0f);
+#endif
 	
-	matrix skinMat = g_bones[input.boneno.x] * input.weight + g_bones[input.boneno.y] * (1.0f - input.weight);
+#if BONE_PALETTE_3X4
+	float3x4 skinMat = g_bones[boneno.x] * weight.x;
+	[unroll]
+	for (uint i = 1; i < SKIN_BONE_COUNT; ++i)
+		skinMat += g_bones[boneno[i]] * weight[i];
+	ret.pos = mul(g_world, float4(mul(skinMat, input.pos), 1.0f));
+	// normal vector DOESN'T TRANSLATE -> only use 3x3 part
+	ret.norm = mul(g_world, float4(mul((float3x3)skinMat, input.normal.xyz), input.normal.w));
+#elif BONE_PALETTE_DQ
+	float4 real0 = g_bones[boneno.x * 2];
+	float4 real = 0.0f;
+	float4 dual = 0.0f;
+	[unroll]
+	for (uint i = 0; i < SKIN_BONE_COUNT; ++i)
+	{
+		float4 boneReal = g_bones[boneno[i] * 2];
+		// q and -q are the same rotation -> blend through the shorter arc from the first bone
+		float boneWeight = weight[i] * (dot(real0, boneReal) < 0.0f ? -1.0f : 1.0f);
+		real += boneReal * boneWeight;
+		dual += g_bones[boneno[i] * 2 + 1] * boneWeight;
+	}
+	float len = length(real);
+	real /= len;
+	dual /= len;
+	// rotate by real part then translate by 2 * dual * conjugate(real)
+	float3 skinPos = input.pos.xyz + 2.0f * cross(real.xyz, cross(real.xyz, input.pos.xyz) + real.w * input.pos.xyz);
+	skinPos += 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+	ret.pos = mul(g_world, float4(skinPos, 1.0f));
+	float3 skinNorm = input.normal.xyz + 2.0f * cross(real.xyz, cross(real.xyz, input.normal.xyz) + real.w * input.normal.xyz);
+	ret.norm = mul(g_world, float4(skinNorm, input.normal.w));
+#else
+	matrix skinMat = g_bones[boneno.x] * weight.x;
+	[unroll]
+	for (uint i = 1; i < SKIN_BONE_COUNT; ++i)
+		skinMat += g_bones[boneno[i]] * weight[i];
 	ret.pos = mul(g_world, mul(skinMat, input.pos));
 
 	skinMat._14_24_34 = 0.0f;		// remove translation of matrix
 	ret.norm = mul(g_world, mul(skinMat, input.normal)); // normal vector DOESN'T TRANSLATE position
+#endif
 
 #if SHADOW_PIPELINE
 	ret.svpos = mul(g_lights[0].ProjectMatrix, ret.pos);